@@ -14,11 +14,23 @@
 
 // vv QPDF specific
 
+// fouble is selected at build time (see epdf.pri): FOUBLE_FLOAT,
+// FOUBLE_DOUBLE, or fixed point with FOUBLE_FIXED_SHIFT fraction bits.
+// FOUBLE_NAME names the backend (for epdf-bench).
+#if defined(FOUBLE_FLOAT)
+typedef float fouble;
+#define FOUBLE_NAME "float"
+#elif defined(FOUBLE_DOUBLE)
+typedef double fouble;
+#define FOUBLE_NAME "double"
+#else
 #include "fixed.h"
-
-//template <> class fixed<10>;
-
-typedef fixt<10> fouble;
+#ifndef FOUBLE_FIXED_SHIFT
+#define FOUBLE_FIXED_SHIFT 10
+#endif
+typedef fixt<FOUBLE_FIXED_SHIFT> fouble;
+#define FOUBLE_NAME "fixed"
+#endif
 
 // ^^ QPDF specific
 
@@ -41,6 +53,7 @@ typedef fixt<10> fouble;
 /* #undef HAVE_BSTRING_H */
 #define HAVE_POPEN 1
 #define HAVE_MKSTEMP 1
+#define HAVE_MMAP 1
 /* #undef SELECT_TAKES_INT */
 
 #endif
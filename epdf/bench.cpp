@@ -0,0 +1,449 @@
+// epdf-bench: renders pages with QOutputDev, without a window, and
+// reports per page where the time went:
+//
+//   parse    reading, lexing and parsing the page's content stream
+//            (measured in a separate pass over the contents; 0 when
+//            the page was replayed from the page display list cache)
+//   interp   everything else in Gfx: operators, fonts, colour spaces,
+//            resources
+//   raster   time spent in the output device (QPainter drawing, image
+//            decoding, text collection, page image setup)
+//   total    wall clock time of PDFDoc::displayPage
+//
+// plus the peak resident set size of the process so far.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <QtGui/QApplication>
+#include <QImage>
+
+#include "goo/GString.h"
+#include "xpdf/Object.h"
+#include "xpdf/Stream.h"
+#include "xpdf/Lexer.h"
+#include "xpdf/Parser.h"
+#include "xpdf/XRef.h"
+#include "xpdf/Catalog.h"
+#include "xpdf/Page.h"
+#include "xpdf/PDFDoc.h"
+#include "xpdf/Gfx.h"
+#include "xpdf/GfxProfile.h"
+#include "xpdf/DisplayList.h"
+#include "xpdf/GlobalParams.h"
+#include "qoutputdev.h"
+#include "benchcore.h"
+
+#define maxDpis 16
+
+static void usage ( )
+{
+	fprintf ( stderr,
+	          "usage: epdf-bench [options] file.pdf[:first[-last]] ...\n"
+	          "       epdf-bench [options] -bench name [file.pdf ...]\n"
+	          "  -r dpi[,dpi...]  resolutions to render at (default 72)\n"
+	          "  -n count         render every page <count> times (default 1);\n"
+	          "                   with -bench, the number of runs\n"
+	          "  -png dir         write each page to dir/name-page-dpi.png\n"
+	          "  -profile file    write an operator profile (CSV if the name\n"
+	          "                   ends in .csv, JSON otherwise)\n"
+	          "  -nocache         don't cache display lists of forms and pages\n"
+	          "  -nommap          read files through a FileStream\n"
+	          "  -opw password    owner password for encrypted files\n"
+	          "  -upw password    user password for encrypted files\n"
+	          "  -q               don't print PDF errors\n"
+	          "  -rate KB/s       with -bench lin, read the files at this rate\n"
+	          "  -bench name      run a benchmark of the core instead:\n" );
+	printCoreBenches ( stderr );
+	fprintf ( stderr, "Times are in ms, peak RSS in KB.\n" );
+}
+
+static double now ( )
+{
+	return benchTime ( );
+}
+
+static long peakRSS ( )
+{
+	struct rusage ru;
+
+	if ( getrusage ( RUSAGE_SELF, &ru ))
+		return 0;
+#ifdef __APPLE__
+	return ru. ru_maxrss / 1024;	// bytes on Mac OS X
+#else
+	return ru. ru_maxrss;
+#endif
+}
+
+//------------------------------------------------------------------------
+// BenchOutputDev
+//------------------------------------------------------------------------
+
+// QOutputDev which adds up the time spent in its drawing calls.  Some
+// calls make others (updateAll calls updateFont, ...): only the
+// outermost one is counted.
+
+#define TIMED(call) \
+	double t0 = now ( ); \
+	++m_depth; \
+	call; \
+	if ( --m_depth == 0 ) \
+		m_rasterTime += now ( ) - t0
+
+class BenchOutputDev : public QOutputDev
+{
+public:
+	BenchOutputDev ( ) { m_rasterTime = 0; m_depth = 0; }
+
+	void resetRasterTime ( ) { m_rasterTime = 0; }
+	double rasterTime ( ) const { return m_rasterTime; }
+
+	virtual void startPage ( int pageNum, GfxState *state )
+	{ TIMED ( QOutputDev::startPage ( pageNum, state )); }
+	virtual void endPage ( )
+	{ TIMED ( QOutputDev::endPage ( )); }
+
+	virtual void saveState ( GfxState *state )
+	{ TIMED ( QOutputDev::saveState ( state )); }
+	virtual void restoreState ( GfxState *state )
+	{ TIMED ( QOutputDev::restoreState ( state )); }
+	virtual void updateAll ( GfxState *state )
+	{ TIMED ( QOutputDev::updateAll ( state )); }
+	virtual void updateFont ( GfxState *state )
+	{ TIMED ( QOutputDev::updateFont ( state )); }
+
+	virtual void stroke ( GfxState *state )
+	{ TIMED ( QOutputDev::stroke ( state )); }
+	virtual void fill ( GfxState *state )
+	{ TIMED ( QOutputDev::fill ( state )); }
+	virtual void eoFill ( GfxState *state )
+	{ TIMED ( QOutputDev::eoFill ( state )); }
+	virtual void clip ( GfxState *state )
+	{ TIMED ( QOutputDev::clip ( state )); }
+	virtual void eoClip ( GfxState *state )
+	{ TIMED ( QOutputDev::eoClip ( state )); }
+
+	virtual void drawChar ( GfxState *state, fp_t x, fp_t y,
+	                        fp_t dx, fp_t dy,
+	                        fp_t originX, fp_t originY,
+	                        CharCode code, Unicode *u, int uLen )
+	{ TIMED ( QOutputDev::drawChar ( state, x, y, dx, dy, originX, originY,
+	                                  code, u, uLen )); }
+
+	virtual GBool beginPatternTile ( GfxState *state, int tileW, int tileH )
+	{
+		GBool ret;
+		TIMED ( ret = QOutputDev::beginPatternTile ( state, tileW, tileH ));
+		return ret;
+	}
+	virtual void endPatternTile ( GfxState *state, fp_t *mat, GBool eoFill )
+	{ TIMED ( QOutputDev::endPatternTile ( state, mat, eoFill )); }
+
+	// the image stream is decoded while the device draws it, so the
+	// decoding is counted here
+	virtual void drawImageMask ( GfxState *state, Object *ref, Stream *str,
+	                             int width, int height, GBool invert,
+	                             GBool inlineImg )
+	{ TIMED ( QOutputDev::drawImageMask ( state, ref, str, width, height,
+	                                       invert, inlineImg )); }
+	virtual void drawImage ( GfxState *state, Object *ref, Stream *str,
+	                         int width, int height, GfxImageColorMap *colorMap,
+	                         int *maskColors, GBool inlineImg )
+	{ TIMED ( QOutputDev::drawImage ( state, ref, str, width, height,
+	                                   colorMap, maskColors, inlineImg )); }
+
+private:
+	double m_rasterTime;	// seconds spent in the calls above
+	int m_depth;		// nesting of the calls above
+};
+
+//------------------------------------------------------------------------
+
+// Lex and parse the contents of a page, the way Gfx does, without
+// executing anything.
+static double parseTime ( PDFDoc *doc, int pg )
+{
+	Page *page = doc-> getCatalog ( )-> getPage ( pg );
+	Parser *parser;
+	Stream *str;
+	Object contents, obj;
+	double t0, t;
+	int c1, c2;
+
+	t0 = now ( );
+	page-> getContents ( &contents );
+	if ( contents. isStream ( ) || contents. isArray ( )) {
+		parser = new Parser ( doc-> getXRef ( ),
+		                      new Lexer ( doc-> getXRef ( ), &contents ));
+		parser-> getObj ( &obj );
+		while ( !obj. isEOF ( )) {
+			// skip inline image data, as Gfx::doImage does
+			if ( obj. isCmd ( "ID" )) {
+				str = parser-> getStream ( );
+				c1 = str-> getChar ( );
+				c2 = str-> getChar ( );
+				while ( !( c1 == 'E' && c2 == 'I' ) && c2 != EOF ) {
+					c1 = c2;
+					c2 = str-> getChar ( );
+				}
+			}
+			obj. free ( );
+			parser-> getObj ( &obj );
+		}
+		obj. free ( );
+		delete parser;
+	}
+	t = now ( ) - t0;
+	contents. free ( );
+	return t;
+}
+
+// Split "file.pdf:first-last" into its parts.  Missing page numbers
+// are 0.
+static GString *parseFileArg ( const char *arg, int *first, int *last )
+{
+	const char *p = strrchr ( arg, ':' );
+	char *end;
+
+	*first = *last = 0;
+	if ( p && p[1] >= '0' && p[1] <= '9' ) {
+		*first = *last = strtol ( p + 1, &end, 10 );
+		if ( *end == '-' ) {
+			if ( end[1] )
+				*last = strtol ( end + 1, &end, 10 );
+			else {
+				*last = 0;	// to the last page
+				++end;
+			}
+		}
+		if ( *end == '\0' )
+			return new GString ( arg, p - arg );
+		*first = *last = 0;
+	}
+	return new GString ( arg );
+}
+
+static int parseDpis ( const char *arg, int *dpis )
+{
+	char *end;
+	int n = 0;
+
+	while ( n < maxDpis ) {
+		dpis[n] = strtol ( arg, &end, 10 );
+		if ( end == arg || dpis[n] <= 0 )
+			return 0;
+		++n;
+		if ( *end != ',' )
+			break;
+		arg = end + 1;
+	}
+	return n;
+}
+
+// dir/name-page-dpi.png, without the directory and extension of the
+// PDF file
+static QString pngName ( const char *dir, GString *fileName, int page, int dpi )
+{
+	const char *base = strrchr ( fileName-> getCString ( ), '/' );
+	QString name = QString::fromLocal8Bit ( base ? base + 1 : fileName-> getCString ( ));
+
+	if ( name. endsWith ( ".pdf", Qt::CaseInsensitive ))
+		name. chop ( 4 );
+	return QString ( "%1/%2-%3-%4.png" ). arg ( QString::fromLocal8Bit ( dir )). arg ( name ). arg ( page ). arg ( dpi );
+}
+
+int main ( int argc, char *argv[] )
+{
+	// no GUI: QImage and QPainter work without a display server
+	QApplication app ( argc, argv, false );
+
+	int dpis[maxDpis] = { 72 };
+	int nDpis = 1, repeat = 1;
+	const char *pngDir = NULL, *profileFile = NULL, *benchName = NULL;
+	bool noCache = false, quiet = false;
+	int i;
+
+	for ( i = 1; i < argc && argv[i][0] == '-'; ++i ) {
+		if ( !strcmp ( argv[i], "-r" ) && i + 1 < argc ) {
+			if ( !( nDpis = parseDpis ( argv[++i], dpis ))) {
+				usage ( );
+				return 1;
+			}
+		} else if ( !strcmp ( argv[i], "-n" ) && i + 1 < argc ) {
+			if (( repeat = atoi ( argv[++i] )) < 1 ) {
+				usage ( );
+				return 1;
+			}
+		} else if ( !strcmp ( argv[i], "-png" ) && i + 1 < argc ) {
+			pngDir = argv[++i];
+		} else if ( !strcmp ( argv[i], "-profile" ) && i + 1 < argc ) {
+			profileFile = argv[++i];
+		} else if ( !strcmp ( argv[i], "-nocache" )) {
+			noCache = true;
+		} else if ( !strcmp ( argv[i], "-nommap" )) {
+			benchOptions. mapFile = gFalse;
+		} else if ( !strcmp ( argv[i], "-opw" ) && i + 1 < argc ) {
+			benchOptions. ownerPassword = new GString ( argv[++i] );
+		} else if ( !strcmp ( argv[i], "-upw" ) && i + 1 < argc ) {
+			benchOptions. userPassword = new GString ( argv[++i] );
+		} else if ( !strcmp ( argv[i], "-rate" ) && i + 1 < argc ) {
+			if (( benchOptions. rate = atoi ( argv[++i] )) < 1 ) {
+				usage ( );
+				return 1;
+			}
+		} else if ( !strcmp ( argv[i], "-q" )) {
+			quiet = true;
+		} else if ( !strcmp ( argv[i], "-bench" ) && i + 1 < argc ) {
+			benchName = argv[++i];
+		} else {
+			usage ( );
+			return argv[i][1] == 'h' ? 0 : 1;
+		}
+	}
+	if ( i == argc && !benchName ) {
+		usage ( );
+		return 1;
+	}
+	benchOptions. repeat = repeat;
+
+	globalParams = new GlobalParams ( "" );
+	if ( quiet )
+		globalParams-> setErrQuiet ( gTrue );
+	if ( noCache ) {
+		globalParams-> setFormCacheSize ( 0 );
+		globalParams-> setPageListCacheSize ( 0 );
+	}
+
+	if ( benchName ) {
+		int ret = runCoreBench ( benchName, argv + i, argc - i );
+		if ( ret < 0 ) {
+			usage ( );
+			ret = 1;
+		}
+		delete benchOptions. ownerPassword;
+		delete benchOptions. userPassword;
+		delete globalParams;
+		return ret;
+	}
+
+	// operator CPU times would slow down every operator a lot, and the
+	// page times above are wall clock times anyway
+	GfxProfile *profile = NULL;
+	if ( profileFile ) {
+		profile = new GfxProfile ( gFalse );
+		Gfx::setProfile ( profile );
+	}
+
+	BenchOutputDev *dev = new BenchOutputDev ( );
+	double sumParse = 0, sumInterp = 0, sumRaster = 0, sumTotal = 0;
+	int nPages = 0, ret = 0;
+
+	printf ( "# fouble: %s\n", foubleName ( ));
+	printf ( "%-24s %5s %4s %9s %9s %9s %9s %9s\n",
+	         "file", "page", "dpi", "parse", "interp", "raster", "total", "rss" );
+
+	for ( ; i < argc; ++i ) {
+		int first, last;
+		GString *fileName = parseFileArg ( argv[i], &first, &last );
+
+		double t0 = now ( );
+		PDFDoc *doc = benchOpen ( fileName );
+		double openTime = now ( ) - t0;
+
+		if ( !doc ) {
+			delete fileName;
+			ret = 1;
+			continue;
+		}
+		if ( first < 1 )
+			first = 1;
+		if ( last < 1 || last > doc-> getNumPages ( ))
+			last = doc-> getNumPages ( );
+		printf ( "# %s: %d pages, open %.2f ms\n",
+		         fileName-> getCString ( ), doc-> getNumPages ( ), openTime * 1000 );
+		if ( profile )
+			profile-> setDocName ( fileName );
+
+		DisplayListCache *listCache = doc-> getXRef ( )-> getPageListCache ( );
+
+		for ( int pg = first; pg <= last; ++pg ) {
+			for ( int r = 0; r < repeat; ++r ) {
+				for ( int d = 0; d < nDpis; ++d ) {
+					int hits = listCache ? listCache-> getHits ( ) : 0;
+					double parse = parseTime ( doc, pg );
+
+					dev-> resetRasterTime ( );
+					t0 = now ( );
+					doc-> displayPage ( dev, pg, dpis[d], 0, gFalse );
+					double total = now ( ) - t0;
+
+					if ( listCache && listCache-> getHits ( ) != hits )
+						parse = 0;
+					double raster = dev-> rasterTime ( );
+					double interp = total - parse - raster;
+					if ( interp < 0 )
+						interp = 0;
+
+					printf ( "%-24s %5d %4d %9.2f %9.2f %9.2f %9.2f %9ld\n",
+					         fileName-> getCString ( ), pg, dpis[d],
+					         parse * 1000, interp * 1000, raster * 1000,
+					         total * 1000, peakRSS ( ));
+					fflush ( stdout );
+					sumParse += parse;
+					sumInterp += interp;
+					sumRaster += raster;
+					sumTotal += total;
+					++nPages;
+
+					if ( pngDir && r == 0 ) {
+						QString name = pngName ( pngDir, fileName, pg, dpis[d] );
+						if ( !dev-> getImage ( ). save ( name, "PNG" )) {
+							fprintf ( stderr, "%s: can't write\n",
+							          name. toLocal8Bit ( ). constData ( ));
+							ret = 1;
+						}
+					}
+				}
+			}
+		}
+
+		XRef *xref = doc-> getXRef ( );
+		printf ( "# %s: xref cache %d hits, %d misses\n", fileName-> getCString ( ),
+		         xref-> getCacheHits ( ), xref-> getCacheMisses ( ));
+		delete doc;
+		delete fileName;
+	}
+
+	printf ( "%-24s %5d %4s %9.2f %9.2f %9.2f %9.2f %9ld\n",
+	         "# total", nPages, "",
+	         sumParse * 1000, sumInterp * 1000, sumRaster * 1000,
+	         sumTotal * 1000, peakRSS ( ));
+
+	if ( profile ) {
+		FILE *f = fopen ( profileFile, "w" );
+		int n = strlen ( profileFile );
+
+		if ( f ) {
+			if ( n >= 4 && !strcmp ( profileFile + n - 4, ".csv" ))
+				profile-> writeCSV ( f );
+			else
+				profile-> writeJSON ( f );
+			fclose ( f );
+		} else {
+			fprintf ( stderr, "%s: can't write\n", profileFile );
+			ret = 1;
+		}
+		Gfx::setProfile ( NULL );
+		delete profile;
+	}
+
+	delete dev;
+	delete benchOptions. ownerPassword;
+	delete benchOptions. userPassword;
+	delete globalParams;
+	return ret;
+}
@@ -0,0 +1,1282 @@
+// Benchmarks of the xpdf core (see benchcore.h).  Each one prints a
+// header line and one line per measurement; times are in ms and are
+// the best of -n runs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "aconf.h"
+#include "goo/gmem.h"
+#include "goo/GString.h"
+#include "xpdf/Object.h"
+#include "xpdf/Dict.h"
+#include "xpdf/NameTable.h"
+#include "xpdf/Stream.h"
+#include "xpdf/Decrypt.h"
+#include "xpdf/Lexer.h"
+#include "xpdf/Parser.h"
+#include "xpdf/XRef.h"
+#include "xpdf/Catalog.h"
+#include "xpdf/PDFDoc.h"
+#include "xpdf/GfxState.h"
+#include "xpdf/GfxProfile.h"
+#include "xpdf/DisplayList.h"
+#include "xpdf/GlobalParams.h"
+#include "benchcore.h"
+
+BenchOptions benchOptions = { gTrue, 1, NULL, NULL, 0 };
+
+double benchTime ( )
+{
+	return GfxProfile::getWallTime ( );
+}
+
+const char *foubleName ( )
+{
+#if defined(FOUBLE_FLOAT) || defined(FOUBLE_DOUBLE)
+	return FOUBLE_NAME;
+#else
+	static char name[64];
+
+	sprintf ( name, "%s (%d fraction bits)", FOUBLE_NAME, FOUBLE_FIXED_SHIFT );
+	return name;
+#endif
+}
+
+PDFDoc *benchOpen ( GString *fileName )
+{
+	PDFDoc *doc = new PDFDoc ( fileName-> copy ( ), benchOptions. ownerPassword,
+	                           benchOptions. userPassword, gFalse,
+	                           benchOptions. mapFile );
+
+	if ( !doc-> isOk ( )) {
+		fprintf ( stderr, "%s: can't open (error %d)\n",
+		          fileName-> getCString ( ), doc-> getErrorCode ( ));
+		delete doc;
+		return NULL;
+	}
+	return doc;
+}
+
+static inline void keepBest ( double *best, double t, int run )
+{
+	if ( run == 0 || t < *best )
+		*best = t;
+}
+
+// Parse one object written in PDF syntax.
+static Object *parseObject ( GString *text, Object *obj )
+{
+	Object dict;
+
+	dict. initNull ( );
+	Parser *parser = new Parser ( NULL,
+	                              new Lexer ( NULL,
+	                                          new MemStream ( text-> getCString ( ),
+	                                                          text-> getLength ( ), &dict )));
+	parser-> getObj ( obj );
+	delete parser;
+	return obj;
+}
+
+//------------------------------------------------------------------------
+// io: FileStream against MmapStream
+//------------------------------------------------------------------------
+
+// Fetch every object in the xref table once.
+static void fetchAll ( XRef *xref )
+{
+	XRefEntry *e;
+	Object obj;
+
+	for ( int num = 0; num < xref-> getNumObjects ( ); ++num ) {
+		if (( e = xref-> getEntry ( num )) && e-> type != xrefEntryFree ) {
+			xref-> fetch ( num, e-> type == xrefEntryCompressed ? 0 : e-> gen,
+			               &obj );
+			obj. free ( );
+		}
+	}
+}
+
+// Open the file, display the first page and fetch every object, once
+// through each kind of stream.
+static int benchIO ( char **files, int nFiles )
+{
+	NullOutputDev dev;
+	GBool saveMap = benchOptions. mapFile;
+	int ret = 0;
+
+	printf ( "%-24s %-6s %9s %9s %9s\n", "file", "stream", "open", "page1",
+	         "fetchall" );
+	for ( int i = 0; i < nFiles; ++i ) {
+		GString *fileName = new GString ( files[i] );
+
+		for ( int m = 0; m < 2; ++m ) {
+			double open = 0, page1 = 0, fetch = 0, t0;
+
+			benchOptions. mapFile = m == 1;
+			for ( int r = 0; r < benchOptions. repeat; ++r ) {
+				t0 = benchTime ( );
+				PDFDoc *doc = benchOpen ( fileName );
+				if ( !doc ) {
+					ret = 1;
+					break;
+				}
+				keepBest ( &open, benchTime ( ) - t0, r );
+				t0 = benchTime ( );
+				doc-> displayPage ( &dev, 1, 72, 0, gFalse );
+				keepBest ( &page1, benchTime ( ) - t0, r );
+				t0 = benchTime ( );
+				fetchAll ( doc-> getXRef ( ));
+				keepBest ( &fetch, benchTime ( ) - t0, r );
+				delete doc;
+			}
+			printf ( "%-24s %-6s %9.2f %9.2f %9.2f\n", files[i],
+			         m == 1 ? "mmap" : "file",
+			         open * 1000, page1 * 1000, fetch * 1000 );
+		}
+		delete fileName;
+	}
+	benchOptions. mapFile = saveMap;
+	return ret;
+}
+
+//------------------------------------------------------------------------
+// xref: the parsed object cache of XRef::fetch
+//------------------------------------------------------------------------
+
+// Display every page, with the object cache off and then at its
+// configured size, and count the fetches it served.
+static int benchXRef ( char **files, int nFiles )
+{
+	NullOutputDev dev;
+	int saveSize = globalParams-> getObjectCacheSize ( );
+	int ret = 0;
+
+	printf ( "%-24s %9s %9s %9s %9s %6s\n", "file", "cache", "time",
+	         "hits", "misses", "hit%" );
+	for ( int i = 0; i < nFiles; ++i ) {
+		GString *fileName = new GString ( files[i] );
+
+		for ( int c = 0; c < 2; ++c ) {
+			double best = 0, t0;
+			int hits = 0, misses = 0;
+
+			globalParams-> setObjectCacheSize ( c == 0 ? 0 : saveSize );
+			for ( int r = 0; r < benchOptions. repeat; ++r ) {
+				PDFDoc *doc = benchOpen ( fileName );
+				if ( !doc ) {
+					ret = 1;
+					break;
+				}
+				t0 = benchTime ( );
+				for ( int pg = 1; pg <= doc-> getNumPages ( ); ++pg )
+					doc-> displayPage ( &dev, pg, 72, 0, gFalse );
+				keepBest ( &best, benchTime ( ) - t0, r );
+				hits = doc-> getXRef ( )-> getCacheHits ( );
+				misses = doc-> getXRef ( )-> getCacheMisses ( );
+				delete doc;
+			}
+			printf ( "%-24s %8dK %9.2f %9d %9d %6.1f\n", files[i],
+			         c == 0 ? 0 : saveSize / 1024, best * 1000, hits, misses,
+			         hits + misses ? 100.0 * hits / ( hits + misses ) : 0.0 );
+		}
+		delete fileName;
+	}
+	globalParams-> setObjectCacheSize ( saveSize );
+	return ret;
+}
+
+//------------------------------------------------------------------------
+// open: lazy page tree
+//------------------------------------------------------------------------
+
+// Time opening the file, displaying page 1, reading the last page and
+// then every page.  Reading every page is what opening cost before the
+// page tree was read lazily.
+static int benchOpenTime ( char **files, int nFiles )
+{
+	NullOutputDev dev;
+	int ret = 0;
+
+	printf ( "%-24s %6s %9s %9s %9s %9s\n", "file", "pages", "open", "page1",
+	         "last", "all" );
+	for ( int i = 0; i < nFiles; ++i ) {
+		GString *fileName = new GString ( files[i] );
+		double open = 0, page1 = 0, last = 0, all = 0, t0;
+		int nPages = 0;
+
+		for ( int r = 0; r < benchOptions. repeat; ++r ) {
+			t0 = benchTime ( );
+			PDFDoc *doc = benchOpen ( fileName );
+			if ( !doc ) {
+				ret = 1;
+				break;
+			}
+			keepBest ( &open, benchTime ( ) - t0, r );
+			Catalog *catalog = doc-> getCatalog ( );
+			nPages = doc-> getNumPages ( );
+			t0 = benchTime ( );
+			doc-> displayPage ( &dev, 1, 72, 0, gFalse );
+			keepBest ( &page1, benchTime ( ) - t0, r );
+			t0 = benchTime ( );
+			catalog-> getPage ( nPages );
+			keepBest ( &last, benchTime ( ) - t0, r );
+			t0 = benchTime ( );
+			for ( int pg = 1; pg <= nPages; ++pg )
+				catalog-> getPage ( pg );
+			keepBest ( &all, benchTime ( ) - t0, r );
+			delete doc;
+		}
+		printf ( "%-24s %6d %9.2f %9.2f %9.2f %9.2f\n", files[i], nPages,
+		         open * 1000, page1 * 1000, last * 1000, all * 1000 );
+		delete fileName;
+	}
+	return ret;
+}
+
+//------------------------------------------------------------------------
+// lin: bytes read before the first page of a linearized file
+//------------------------------------------------------------------------
+
+#define rangeBlockSize 4096
+
+// A file read over a slow link, the way a browser plug-in or a network
+// file system reads it: in blocks of rangeBlockSize bytes, each fetched
+// once.  A block that doesn't follow the last one fetched costs a new
+// request.  With -rate, each block takes as long as the link would.
+struct RangeFile
+{
+	char *data;		// the whole file
+	Guint length;
+	Guchar *fetched;	// one flag per block
+	int lastBlock;		// last block fetched, or -2
+	int nBlocks;		// blocks fetched
+	int requests;		// runs of adjacent blocks fetched
+};
+
+// A BaseStream on a RangeFile.  Positions are file offsets, as in
+// MmapStream.
+class RangeStream : public BaseStream
+{
+public:
+	RangeStream ( RangeFile *fileA, Guint startA, GBool limitedA,
+	              Guint lengthA, Object *dictA );
+	virtual Stream *makeSubStream ( Guint startA, GBool limitedA,
+	                                Guint lengthA, Object *dictA )
+		{ return new RangeStream ( file, startA, limitedA, lengthA, dictA ); }
+	virtual StreamKind getKind ( ) { return strFile; }
+	virtual void reset ( ) { pos = start; }
+	virtual int getChar ( )
+		{ int c = lookChar ( ); if ( c != EOF ) ++pos; return c; }
+	virtual int lookChar ( );
+	virtual int getBlock ( char *blk, int size );
+	virtual int getPos ( ) { return pos; }
+	virtual void setPos ( Guint posA, int dir = 0 );
+	virtual GBool isBinary ( GBool last = gTrue ) { return last; }
+	virtual Guint getStart ( ) { return start; }
+	virtual void moveStart ( int delta ) { start += delta; setEnd ( ); pos = start; }
+
+private:
+	void setEnd ( );
+	void fetch ( Guint first, Guint n );
+
+	RangeFile *file;
+	Guint start;
+	GBool limited;
+	Guint length;
+	Guint end;		// end of the readable range
+	Guint pos;		// next byte to read
+};
+
+RangeStream::RangeStream ( RangeFile *fileA, Guint startA, GBool limitedA,
+                          Guint lengthA, Object *dictA ) : BaseStream ( dictA )
+{
+	file = fileA;
+	start = startA;
+	limited = limitedA;
+	length = lengthA;
+	setEnd ( );
+	pos = start;
+}
+
+void RangeStream::setEnd ( )
+{
+	if ( start > file-> length )
+		start = file-> length;
+	end = limited && length < file-> length - start ? start + length : file-> length;
+}
+
+// Fetch the blocks of bytes [first, first + n) that haven't been.
+void RangeStream::fetch ( Guint first, Guint n )
+{
+	for ( int b = first / rangeBlockSize; b <= (int) (( first + n - 1 ) / rangeBlockSize ); ++b ) {
+		if ( file-> fetched[b] )
+			continue;
+		file-> fetched[b] = 1;
+		++file-> nBlocks;
+		if ( b != file-> lastBlock + 1 )
+			++file-> requests;
+		file-> lastBlock = b;
+		if ( benchOptions. rate > 0 )
+			usleep ( (useconds_t) ( 1e6 * rangeBlockSize / ( benchOptions. rate * 1024.0 )));
+	}
+}
+
+int RangeStream::lookChar ( )
+{
+	if ( pos >= end )
+		return EOF;
+	if ( !file-> fetched[pos / rangeBlockSize] )
+		fetch ( pos, 1 );
+	return file-> data[pos] & 0xff;
+}
+
+int RangeStream::getBlock ( char *blk, int size )
+{
+	int n = end - pos;
+
+	if ( n > size )
+		n = size;
+	if ( n <= 0 )
+		return 0;
+	fetch ( pos, n );
+	memcpy ( blk, file-> data + pos, n );
+	pos += n;
+	return n;
+}
+
+void RangeStream::setPos ( Guint posA, int dir )
+{
+	if ( dir < 0 )
+		posA = posA > file-> length ? 0 : file-> length - posA;
+	pos = posA > end ? end : posA;
+}
+
+// Read a whole file into memory (allocated with gmalloc).  Reports
+// errors and returns NULL if it can't.
+static char *readFile ( const char *fileName, int *length )
+{
+	FILE *f = fopen ( fileName, "rb" );
+	char *buf;
+
+	if ( !f ) {
+		fprintf ( stderr, "%s: can't open\n", fileName );
+		return NULL;
+	}
+	fseek ( f, 0, SEEK_END );
+	*length = (int) ftell ( f );
+	fseek ( f, 0, SEEK_SET );
+	buf = (char *) gmalloc ( *length > 0 ? *length : 1 );
+	if ( (int) fread ( buf, 1, *length, f ) != *length ) {
+		fprintf ( stderr, "%s: can't read\n", fileName );
+		gfree ( buf );
+		buf = NULL;
+	}
+	fclose ( f );
+	return buf;
+}
+
+// Open the file through a RangeStream and display page 1, then the
+// last page.  Reports what had been fetched at the first paint and
+// after the last page.
+static int benchLin ( char **files, int nFiles )
+{
+	NullOutputDev dev;
+	int ret = 0;
+
+	printf ( "%-24s %6s %7s %7s %5s %9s %7s %5s\n", "file", "pages", "KB",
+	         "page1KB", "reqs", "page1", "lastKB", "reqs" );
+	for ( int i = 0; i < nFiles; ++i ) {
+		int length;
+		char *data = readFile ( files[i], &length );
+
+		if ( !data ) {
+			ret = 1;
+			continue;
+		}
+
+		RangeFile file;
+		int nBlocks = ( length + rangeBlockSize - 1 ) / rangeBlockSize;
+		int nPages = 0, page1Blocks = 0, page1Requests = 0;
+		double page1 = 0;
+
+		file. data = data;
+		file. length = length;
+		file. fetched = (Guchar *) gmalloc ( nBlocks > 0 ? nBlocks : 1 );
+		for ( int r = 0; r < benchOptions. repeat; ++r ) {
+			Object obj;
+
+			memset ( file. fetched, 0, nBlocks > 0 ? nBlocks : 1 );
+			file. lastBlock = -2;
+			file. nBlocks = file. requests = 0;
+			double t0 = benchTime ( );
+			obj. initNull ( );
+			PDFDoc *doc = new PDFDoc ( new RangeStream ( &file, 0, gFalse, 0, &obj ),
+			                           benchOptions. ownerPassword,
+			                           benchOptions. userPassword );
+			if ( !doc-> isOk ( )) {
+				fprintf ( stderr, "%s: can't open (error %d)\n", files[i],
+				          doc-> getErrorCode ( ));
+				delete doc;
+				ret = 1;
+				break;
+			}
+			nPages = doc-> getNumPages ( );
+			doc-> displayPage ( &dev, 1, 72, 0, gFalse );
+			keepBest ( &page1, benchTime ( ) - t0, r );
+			page1Blocks = file. nBlocks;
+			page1Requests = file. requests;
+			doc-> displayPage ( &dev, nPages, 72, 0, gFalse );
+			delete doc;
+		}
+		if ( nPages > 0 )
+			printf ( "%-24s %6d %7.1f %7.1f %5d %9.2f %7.1f %5d\n", files[i], nPages,
+			         length / 1024.0, page1Blocks * ( rangeBlockSize / 1024.0 ),
+			         page1Requests, page1 * 1000,
+			         file. nBlocks * ( rangeBlockSize / 1024.0 ), file. requests );
+		gfree ( file. fetched );
+		gfree ( data );
+	}
+	return ret;
+}
+
+//------------------------------------------------------------------------
+// fouble: the numeric backend
+//------------------------------------------------------------------------
+
+// The kinds of arithmetic the interpreter does most with fouble.  Each
+// one is also done in double, and the largest difference is reported.
+
+#define foubleN 100000
+
+// Transform points by a matrix, as GfxState::transform does.
+static double foubleTransform ( fouble *x, fouble *y, double *err )
+{
+	fouble m[6] = { 1.5, 0.25, -0.25, 1.5, 36, 720 };
+	double md[6] = { 1.5, 0.25, -0.25, 1.5, 36, 720 };
+	fouble tx, ty;
+	double t0 = benchTime ( );
+
+	for ( int r = 0; r < 10; ++r ) {
+		for ( int i = 0; i < foubleN; ++i ) {
+			tx = m[0] * x[i] + m[2] * y[i] + m[4];
+			ty = m[1] * x[i] + m[3] * y[i] + m[5];
+			x[i] = tx * 0.5;
+			y[i] = ty * 0.5;
+		}
+	}
+	double t = benchTime ( ) - t0;
+
+	*err = 0;
+	for ( int i = 0; i < foubleN; ++i ) {
+		double xd = ( i % 600 ), yd = ( i / 600 );
+		for ( int r = 0; r < 10; ++r ) {
+			double txd = md[0] * xd + md[2] * yd + md[4];
+			double tyd = md[1] * xd + md[3] * yd + md[5];
+			xd = txd * 0.5;
+			yd = tyd * 0.5;
+		}
+		*err = fmax ( *err, fmax ( fabs ( xd - (double) x[i] ),
+		                           fabs ( yd - (double) y[i] )));
+	}
+	return t;
+}
+
+// Flatten Bezier curves into 16 points each.
+static double foubleCurves ( fouble *x, fouble *y, double *err )
+{
+	fouble x0, y0 = 10, x1, y1 = 80, x2, y2 = -40, x3, y3 = 30, t, u;
+	double t0 = benchTime ( );
+
+	for ( int i = 0; i < foubleN; ++i ) {
+		x0 = ( i / 16 ) % 500;
+		x1 = x0 + 20;
+		x2 = x0 + 60;
+		x3 = x0 + 100;
+		t = fouble ( i % 16 + 1 ) / 16;
+		u = 1 - t;
+		x[i] = u * u * u * x0 + 3 * t * u * u * x1 + 3 * t * t * u * x2 + t * t * t * x3;
+		y[i] = u * u * u * y0 + 3 * t * u * u * y1 + 3 * t * t * u * y2 + t * t * t * y3;
+	}
+	double time = benchTime ( ) - t0;
+
+	*err = 0;
+	for ( int i = 0; i < foubleN; ++i ) {
+		double xd0 = ( i / 16 ) % 500, td = ( i % 16 + 1 ) / 16.0, ud = 1 - td;
+		double xd = ud * ud * ud * xd0 + 3 * td * ud * ud * ( xd0 + 20 ) +
+		            3 * td * td * ud * ( xd0 + 60 ) + td * td * td * ( xd0 + 100 );
+		double yd = ud * ud * ud * 10 + 3 * td * ud * ud * 80 -
+		            3 * td * td * ud * 40 + td * td * td * 30;
+		*err = fmax ( *err, fmax ( fabs ( xd - (double) x[i] ),
+		                           fabs ( yd - (double) y[i] )));
+	}
+	return time;
+}
+
+// Run the arithmetic kernels and print the rate and the largest error
+// against double.  Compare backends by building epdf-bench with each
+// (see tests/fouble-bench.sh).
+static int benchFouble ( char ** /*files*/, int /*nFiles*/ )
+{
+	fouble *x = new fouble[foubleN], *y = new fouble[foubleN];
+	double transform = 0, curves = 0, errT = 0, errC = 0;
+
+	printf ( "# fouble: %s\n", foubleName ( ));
+	for ( int r = 0; r < benchOptions. repeat; ++r ) {
+		for ( int i = 0; i < foubleN; ++i ) {
+			x[i] = i % 600;
+			y[i] = i / 600;
+		}
+		keepBest ( &transform, foubleTransform ( x, y, &errT ), r );
+		keepBest ( &curves, foubleCurves ( x, y, &errC ), r );
+	}
+	printf ( "%-10s %12s %12s\n", "kernel", "points/s", "max error" );
+	printf ( "%-10s %12.3g %12.3g\n", "transform", 10.0 * foubleN / transform, errT );
+	printf ( "%-10s %12.3g %12.3g\n", "curves", foubleN / curves, errC );
+	delete[] x;
+	delete[] y;
+	return 0;
+}
+
+//------------------------------------------------------------------------
+// dct: DCTStream inner loops
+//------------------------------------------------------------------------
+
+static const char *dctKernelNames[] = { "auto", "scalar", "sse2", "avx2" };
+
+// Return true if <obj> is a stream whose last filter is DCTDecode.
+static GBool isDCTStream ( Object *obj )
+{
+	Object filter, last;
+	GBool ret = gFalse;
+
+	if ( !obj-> isStream ( ))
+		return gFalse;
+	obj-> streamGetDict ( )-> lookup ( "Filter", &filter );
+	if ( filter. isArray ( ) && filter. arrayGetLength ( ) > 0 ) {
+		filter. arrayGet ( filter. arrayGetLength ( ) - 1, &last );
+		ret = last. isName ( "DCTDecode" ) || last. isName ( "DCT" );
+		last. free ( );
+	} else {
+		ret = filter. isName ( "DCTDecode" ) || filter. isName ( "DCT" );
+	}
+	filter. free ( );
+	return ret;
+}
+
+// Decode a stream to the end.  Returns the number of bytes and adds
+// them to the FNV-1a hash <h>.
+static int decodeStream ( Object *obj, unsigned *h )
+{
+	char buf[4096];
+	int n, total = 0;
+
+	obj-> streamReset ( );
+	while (( n = obj-> getStream ( )-> getBlock ( buf, sizeof ( buf ))) > 0 ) {
+		for ( int i = 0; i < n; ++i )
+			*h = ( *h ^ (Guchar) buf[i] ) * 16777619;
+		total += n;
+	}
+	obj-> streamClose ( );
+	return total;
+}
+
+// Decode every DCT image in the files with each kernel the CPU has,
+// and check that they give the same bytes.
+static int benchDCT ( char **files, int nFiles )
+{
+	int ret = 0;
+
+	printf ( "%-24s %6s %9s", "file", "images", "MB" );
+	for ( int k = dctKernelScalar; k <= dctKernelAVX2; ++k )
+		printf ( " %9s", dctKernelNames[k] );
+	printf ( "\n" );
+	for ( int i = 0; i < nFiles; ++i ) {
+		GString *fileName = new GString ( files[i] );
+		PDFDoc *doc = benchOpen ( fileName );
+
+		delete fileName;
+		if ( !doc ) {
+			ret = 1;
+			continue;
+		}
+
+		XRef *xref = doc-> getXRef ( );
+		Object *images = NULL;
+		int nImages = 0;
+		XRefEntry *e;
+		Object obj;
+
+		for ( int num = 0; num < xref-> getNumObjects ( ); ++num ) {
+			if ( !( e = xref-> getEntry ( num )) || e-> type == xrefEntryFree )
+				continue;
+			xref-> fetch ( num, e-> type == xrefEntryCompressed ? 0 : e-> gen, &obj );
+			if ( isDCTStream ( &obj )) {
+				images = (Object *) grealloc ( images, ( nImages + 1 ) * sizeof ( Object ));
+				images[nImages++] = obj;
+			} else {
+				obj. free ( );
+			}
+		}
+
+		double times[dctKernelAVX2 + 1];
+		unsigned hashes[dctKernelAVX2 + 1];
+		int bytes = 0;
+		printf ( "%-24s %6d", files[i], nImages );
+		for ( int k = dctKernelScalar; k <= dctKernelAVX2; ++k ) {
+			times[k] = -1;
+			if ( !DCTStream::setKernel ( (DCTKernel) k ))
+				continue;
+			for ( int r = 0; r < benchOptions. repeat; ++r ) {
+				hashes[k] = 2166136261u;
+				bytes = 0;
+				double t0 = benchTime ( );
+				for ( int j = 0; j < nImages; ++j )
+					bytes += decodeStream ( &images[j], &hashes[k] );
+				keepBest ( &times[k], benchTime ( ) - t0, r );
+			}
+		}
+		printf ( " %9.2f", bytes / 1048576.0 );
+		for ( int k = dctKernelScalar; k <= dctKernelAVX2; ++k ) {
+			if ( times[k] < 0 )
+				printf ( " %9s", "-" );
+			else
+				printf ( " %9.2f", times[k] * 1000 );
+		}
+		printf ( "\n" );
+		for ( int k = dctKernelSSE2; k <= dctKernelAVX2; ++k ) {
+			if ( times[k] >= 0 && hashes[k] != hashes[dctKernelScalar] ) {
+				fprintf ( stderr, "%s: %s output differs from scalar\n",
+				          files[i], dctKernelNames[k] );
+				ret = 1;
+			}
+		}
+
+		for ( int j = 0; j < nImages; ++j )
+			images[j]. free ( );
+		gfree ( images );
+		delete doc;
+	}
+	DCTStream::setKernel ( dctKernelAuto );
+	return ret;
+}
+
+//------------------------------------------------------------------------
+// color: GfxImageColorMap::getRGBLine
+//------------------------------------------------------------------------
+
+// A type 4 (PostScript) function stream with <m> inputs and <n>
+// outputs, all in [0 1].
+static GString *type4Function ( int m, int n, const char *code )
+{
+	GString *s = new GString ( "<< /FunctionType 4 /Domain [" );
+
+	for ( int i = 0; i < m; ++i )
+		s-> append ( " 0 1" );
+	s-> append ( " ] /Range [" );
+	for ( int i = 0; i < n; ++i )
+		s-> append ( " 0 1" );
+	GString *len = GString::fromInt ( strlen ( code ));
+	s-> append ( " ] /Length " )-> append ( len )-> append ( " >>\nstream\n" );
+	s-> append ( code )-> append ( "\nendstream" );
+	delete len;
+	return s;
+}
+
+// The color spaces of the benchmark, in PDF syntax.
+static GString *colorSpaceText ( int i, const char **name, int *bits )
+{
+	GString *s;
+
+	*bits = 8;
+	switch ( i ) {
+	case 0:
+		*name = "DeviceGray";
+		return new GString ( "/DeviceGray" );
+	case 1:
+		*name = "DeviceRGB";
+		return new GString ( "/DeviceRGB" );
+	case 2:
+		*name = "DeviceRGB 4-bit";
+		*bits = 4;
+		return new GString ( "/DeviceRGB" );
+	case 3:
+		*name = "CalRGB";
+		return new GString ( "[/CalRGB << /WhitePoint [0.9505 1 1.089] "
+		                     "/Gamma [2.2 2.2 2.2] >>]" );
+	case 4:
+		*name = "ICCBased RGB";
+		return new GString ( "[/ICCBased << /N 3 /Alternate /DeviceRGB "
+		                     "/Length 0 >>\nstream\n\nendstream]" );
+	case 5:
+		*name = "Indexed";
+		s = new GString ( "[/Indexed /DeviceRGB 255 <" );
+		for ( int j = 0; j < 256; ++j ) {
+			char hex[8];
+			sprintf ( hex, "%02x%02x%02x", j, ( j * 7 ) & 0xff, 255 - j );
+			s-> append ( hex );
+		}
+		return s-> append ( ">]" );
+	case 6:
+		*name = "Separation";
+		return new GString ( "[/Separation /Spot /DeviceCMYK << /FunctionType 2 "
+		                     "/Domain [0 1] /C0 [0 0 0 0] /C1 [0.1 0.6 0.9 0.05] "
+		                     "/N 1 >>]" );
+	case 7:
+		*name = "DeviceCMYK";
+		return new GString ( "/DeviceCMYK" );
+	case 8:
+		*name = "ICCBased CMYK";
+		return new GString ( "[/ICCBased << /N 4 /Alternate /DeviceCMYK "
+		                     "/Length 0 >>\nstream\n\nendstream]" );
+	case 9:
+		*name = "DeviceN, 3 in";
+		s = new GString ( "[/DeviceN [/A /B /C] /DeviceRGB " );
+		return s-> append ( type4Function ( 3, 3, "{ exch dup mul exch 3 1 roll }" ))-> append ( "]" );
+	case 10:
+		*name = "DeviceN, 4 in";
+		s = new GString ( "[/DeviceN [/A /B /C /D] /DeviceCMYK " );
+		return s-> append ( type4Function ( 4, 4, "{ 4 1 roll }" ))-> append ( "]" );
+	case 11:
+		*name = "Lab";
+		return new GString ( "[/Lab << /WhitePoint [0.9505 1 1.089] "
+		                     "/Range [-100 100 -100 100] >>]" );
+	}
+	return NULL;
+}
+
+// A color component as a level, the way getRGBLine rounds it.
+static inline Guint level ( fouble x )
+{
+	return (Guint) (int) (( x < 0 ? 0 : x > 1 ? 1 : (double) x ) * 255 + 0.5 );
+}
+
+static inline int levelDiff ( Guint a, Guint b, int shift )
+{
+	return abs ( (int) (( a >> shift ) & 0xff ) - (int) (( b >> shift ) & 0xff ));
+}
+
+// Convert a 1000x1000 image of noise in each color space a line at a
+// time with getRGBLine and a pixel at a time with getRGB, and report the
+// time per pixel and the largest difference in levels.
+static int benchColor ( char ** /*files*/, int /*nFiles*/ )
+{
+	const int width = 1000, height = 1000;
+	const char *name;
+	int bits;
+	GString *text;
+
+	printf ( "%-16s %9s %9s %6s\n", "color space", "getRGB", "line", "error" );
+	for ( int c = 0; ( text = colorSpaceText ( c, &name, &bits )); ++c ) {
+		Object obj, decode;
+
+		parseObject ( text, &obj );
+		GfxColorSpace *cs = GfxColorSpace::parse ( &obj );
+		obj. free ( );
+		if ( !cs ) {
+			fprintf ( stderr, "%s: can't parse the color space\n", name );
+			delete text;
+			return 1;
+		}
+		int nComps = cs-> getNComps ( );
+		Guchar *pixels = (Guchar *) gmalloc ( width * height * nComps );
+		Guint *line = (Guint *) gmalloc ( width * height * sizeof ( Guint ));
+		Guint *ref = (Guint *) gmalloc ( width * height * sizeof ( Guint ));
+		unsigned seed = 1;
+		for ( int i = 0; i < width * height * nComps; ++i ) {
+			seed = seed * 1103515245 + 12345;
+			pixels[i] = ( seed >> 16 ) & (( 1 << bits ) - 1 );
+		}
+
+		double slow = 0, fast = 0, t0;
+		for ( int r = 0; r < benchOptions. repeat; ++r ) {
+			// a new color map each time, so the tables are built again
+			decode. initNull ( );
+			GfxImageColorMap *map = new GfxImageColorMap ( bits, &decode, cs-> copy ( ));
+			GfxRGB rgb;
+
+			t0 = benchTime ( );
+			for ( int i = 0; i < width * height; ++i ) {
+				map-> getRGB ( pixels + i * nComps, &rgb );
+				ref[i] = 0xff000000 | ( level ( rgb. r ) << 16 ) |
+				         ( level ( rgb. g ) << 8 ) | level ( rgb. b );
+			}
+			keepBest ( &slow, benchTime ( ) - t0, r );
+			t0 = benchTime ( );
+			for ( int y = 0; y < height; ++y )
+				map-> getRGBLine ( pixels + y * width * nComps, line + y * width, width );
+			keepBest ( &fast, benchTime ( ) - t0, r );
+			delete map;
+		}
+
+		int err = 0;
+		for ( int i = 0; i < width * height; ++i ) {
+			for ( int sh = 0; sh < 24; sh += 8 ) {
+				int d = levelDiff ( line[i], ref[i], sh );
+				if ( d > err )
+					err = d;
+			}
+		}
+		printf ( "%-16s %9.1f %9.1f %6d\n", name, slow * 1e9 / ( width * height ),
+		         fast * 1e9 / ( width * height ), err );
+
+		gfree ( pixels );
+		gfree ( line );
+		gfree ( ref );
+		delete cs;
+		delete text;
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------
+// decrypt: encrypted documents against their unencrypted originals
+//------------------------------------------------------------------------
+
+// Decode every stream object in the document.  Returns the number of
+// bytes and adds them to the hash <h>.
+static int decodeAll ( XRef *xref, unsigned *h )
+{
+	XRefEntry *e;
+	Object obj;
+	int bytes = 0;
+
+	for ( int num = 0; num < xref-> getNumObjects ( ); ++num ) {
+		if ( !( e = xref-> getEntry ( num )) || e-> type == xrefEntryFree )
+			continue;
+		xref-> fetch ( num, e-> type == xrefEntryCompressed ? 0 : e-> gen, &obj );
+		if ( obj. isStream ( ))
+			bytes += decodeStream ( &obj, h );
+		obj. free ( );
+	}
+	return bytes;
+}
+
+// The files come in pairs, plain.pdf enc.pdf.  Open each one, decode
+// every stream and display every page, and report how much longer the
+// encrypted one takes.  The passwords are those of -upw / -opw.
+static int benchDecrypt ( char **files, int nFiles )
+{
+	NullOutputDev dev;
+	int ret = 0;
+
+	if ( nFiles == 0 || nFiles % 2 ) {
+		fprintf ( stderr, "decrypt: give the files as pairs: plain.pdf enc.pdf\n" );
+		return 1;
+	}
+	printf ( "%-24s %-7s %9s %9s %9s %9s %9s\n", "file", "crypt", "open",
+	         "streams", "pages", "total", "overhead" );
+	for ( int i = 0; i < nFiles; i += 2 ) {
+		double total[2] = { 0, 0 };
+		unsigned hashes[2];
+
+		for ( int f = 0; f < 2; ++f ) {
+			GString *fileName = new GString ( files[i + f] );
+			double open = 0, streams = 0, pages = 0, t0;
+			const char *crypt = "none";
+
+			for ( int r = 0; r < benchOptions. repeat; ++r ) {
+				t0 = benchTime ( );
+				PDFDoc *doc = benchOpen ( fileName );
+				if ( !doc ) {
+					ret = 1;
+					break;
+				}
+				keepBest ( &open, benchTime ( ) - t0, r );
+				if ( doc-> isEncrypted ( ))
+					crypt = "yes";
+				hashes[f] = 2166136261u;
+				t0 = benchTime ( );
+				decodeAll ( doc-> getXRef ( ), &hashes[f] );
+				keepBest ( &streams, benchTime ( ) - t0, r );
+				t0 = benchTime ( );
+				for ( int pg = 1; pg <= doc-> getNumPages ( ); ++pg )
+					doc-> displayPage ( &dev, pg, 72, 0, gFalse );
+				keepBest ( &pages, benchTime ( ) - t0, r );
+				delete doc;
+			}
+			delete fileName;
+			if ( ret )
+				return ret;
+			total[f] = open + streams + pages;
+			printf ( "%-24s %-7s %9.2f %9.2f %9.2f %9.2f", files[i + f], crypt,
+			         open * 1000, streams * 1000, pages * 1000, total[f] * 1000 );
+			if ( f == 1 )
+				printf ( " %8.1f%%", ( total[1] / total[0] - 1 ) * 100 );
+			printf ( "\n" );
+		}
+		if ( hashes[0] != hashes[1] )
+			fprintf ( stderr, "%s: decoded streams differ from %s\n",
+			          files[i + 1], files[i] );
+	}
+	return ret;
+}
+
+//------------------------------------------------------------------------
+// crypt: Decrypt throughput
+//------------------------------------------------------------------------
+
+// Decrypt 16 MB of noise in 64 KB calls with each algorithm, the way
+// DecryptStream and the Parser's strings use it.
+static int benchCrypt ( char **, int )
+{
+	static struct {
+		const char *name;
+		CryptAlgorithm alg;
+		int keyLength;
+	} algs[] = {
+		{ "rc4-40", cryptRC4, 5 },
+		{ "rc4-128", cryptRC4, 16 },
+		{ "aes-128", cryptAES, 16 },
+		{ "aes-256", cryptAES256, 32 },
+	};
+	const int size = 16 << 20, chunk = 65536;
+	Guchar *in = (Guchar *) gmalloc ( size );
+	Guchar *out = (Guchar *) gmalloc ( chunk + 32 );
+	Guchar fileKey[maxFileKeyLength];
+	unsigned seed = 1;
+
+	for ( int i = 0; i < size; ++i ) {
+		seed = seed * 1103515245 + 12345;
+		in[i] = (Guchar) ( seed >> 16 );
+	}
+	for ( int i = 0; i < maxFileKeyLength; ++i )
+		fileKey[i] = (Guchar) i;
+
+	printf ( "%-10s %9s %9s\n", "cipher", "time", "MB/s" );
+	for ( int a = 0; a < (int) ( sizeof ( algs ) / sizeof ( algs[0] )); ++a ) {
+		double best = 0;
+
+		for ( int r = 0; r < benchOptions. repeat; ++r ) {
+			double t0 = benchTime ( );
+			Decrypt decrypt ( fileKey, algs[a]. keyLength, algs[a]. alg, 1, 0 );
+			for ( int i = 0; i < size; i += chunk )
+				decrypt. decryptBlock ( in + i, out, chunk, i + chunk == size );
+			keepBest ( &best, benchTime ( ) - t0, r );
+		}
+		printf ( "%-10s %9.2f %9.1f\n", algs[a]. name, best * 1000,
+		         size / 1048576.0 / best );
+	}
+	gfree ( in );
+	gfree ( out );
+	return 0;
+}
+
+//------------------------------------------------------------------------
+// pattern: tiling patterns drawn a cell per step or from a cached tile
+//------------------------------------------------------------------------
+
+// Counts fills, and takes pattern tiles if <tiles> is set.
+class PatternCountDev : public NullOutputDev
+{
+public:
+	PatternCountDev ( GBool tilesA ) { tiles = tilesA; nFills = nTiles = 0; }
+	virtual GBool useTilingPatternCache ( ) { return tiles; }
+	virtual GBool beginPatternTile ( GfxState *, int, int ) { ++nTiles; return gTrue; }
+	virtual void fill ( GfxState * ) { ++nFills; }
+	virtual void eoFill ( GfxState * ) { ++nFills; }
+
+	GBool tiles;
+	int nFills;		// fills, including those of pattern cells
+	int nTiles;		// tiles begun
+};
+
+// Display each page with the pattern cell drawn at every step and then
+// from a cached tile, and count the fills each one makes.
+static int benchPattern ( char **files, int nFiles )
+{
+	int ret = 0;
+
+	printf ( "%-24s %4s %9s %7s %9s %7s %5s\n", "file", "page", "steps",
+	         "fills", "tile", "fills", "tiles" );
+	for ( int i = 0; i < nFiles; ++i ) {
+		GString *fileName = new GString ( files[i] );
+		PDFDoc *doc = benchOpen ( fileName );
+
+		delete fileName;
+		if ( !doc ) {
+			ret = 1;
+			continue;
+		}
+		for ( int pg = 1; pg <= doc-> getNumPages ( ); ++pg ) {
+			double times[2] = { 0, 0 };
+			int fills[2] = { 0, 0 }, tiles = 0;
+
+			for ( int m = 0; m < 2; ++m ) {
+				for ( int r = 0; r < benchOptions. repeat; ++r ) {
+					PatternCountDev dev ( m == 1 );
+					double t0 = benchTime ( );
+					doc-> displayPage ( &dev, pg, 72, 0, gFalse );
+					keepBest ( &times[m], benchTime ( ) - t0, r );
+					fills[m] = dev. nFills;
+					if ( m == 1 )
+						tiles = dev. nTiles;
+				}
+			}
+			printf ( "%-24s %4d %9.2f %7d %9.2f %7d %5d\n", files[i], pg,
+			         times[0] * 1000, fills[0], times[1] * 1000, fills[1], tiles );
+		}
+		delete doc;
+	}
+	return ret;
+}
+
+//------------------------------------------------------------------------
+// zoom: re-rendering pages from their display lists
+//------------------------------------------------------------------------
+
+static int zoomDpis[] = { 100, 150, 200, 300 };
+
+#define nZoomDpis ( (int) ( sizeof ( zoomDpis ) / sizeof ( int )))
+
+// Display every page at 72 dpi and then again at each of zoomDpis, the
+// way a zoom re-renders it, with the page display list cache off and
+// then at its configured size.
+static int benchZoom ( char **files, int nFiles )
+{
+	NullOutputDev dev;
+	int saveSize = globalParams-> getPageListCacheSize ( );
+	int ret = 0;
+
+	printf ( "%-24s %9s %9s %9s %9s %9s\n", "file", "cache", "first",
+	         "rerender", "hits", "listKB" );
+	for ( int i = 0; i < nFiles; ++i ) {
+		GString *fileName = new GString ( files[i] );
+
+		for ( int c = 0; c < 2; ++c ) {
+			double first = 0, rerender = 0, t0;
+			int hits = 0, bytes = 0;
+
+			globalParams-> setPageListCacheSize ( c == 0 ? 0 : saveSize );
+			for ( int r = 0; r < benchOptions. repeat; ++r ) {
+				PDFDoc *doc = benchOpen ( fileName );
+				if ( !doc ) {
+					ret = 1;
+					break;
+				}
+				t0 = benchTime ( );
+				for ( int pg = 1; pg <= doc-> getNumPages ( ); ++pg )
+					doc-> displayPage ( &dev, pg, 72, 0, gFalse );
+				keepBest ( &first, benchTime ( ) - t0, r );
+				t0 = benchTime ( );
+				for ( int pg = 1; pg <= doc-> getNumPages ( ); ++pg ) {
+					for ( int z = 0; z < nZoomDpis; ++z )
+						doc-> displayPage ( &dev, pg, zoomDpis[z], 0, gFalse );
+				}
+				keepBest ( &rerender, benchTime ( ) - t0, r );
+				DisplayListCache *cache = doc-> getXRef ( )-> getPageListCache ( );
+				hits = cache ? cache-> getHits ( ) : 0;
+				bytes = cache ? cache-> getBytes ( ) : 0;
+				delete doc;
+			}
+			printf ( "%-24s %8dK %9.2f %9.2f %9d %9d\n", files[i],
+			         c == 0 ? 0 : saveSize / 1024, first * 1000, rerender * 1000,
+			         hits, bytes / 1024 );
+		}
+		delete fileName;
+	}
+	globalParams-> setPageListCacheSize ( saveSize );
+	return ret;
+}
+
+//------------------------------------------------------------------------
+// dict: Dict lookups
+//------------------------------------------------------------------------
+
+// Look up every key of <dict> in turn, <n> times in all.  If <linear>
+// is set, scan the keys with strcmp, as Dict::lookup did before it had
+// a hash index.
+static double dictLookups ( Dict *dict, char **keys, int nKeys, int n,
+                            GBool linear )
+{
+	Object obj;
+	int found = 0;
+	double t0 = benchTime ( );
+
+	for ( int i = 0; i < n; ++i ) {
+		char *key = keys[i % nKeys];
+		if ( linear ) {
+			for ( int j = 0; j < dict-> getLength ( ); ++j ) {
+				if ( !strcmp ( dict-> getKey ( j ), key )) {
+					++found;
+					break;
+				}
+			}
+		} else {
+			if ( !dict-> lookupNF ( key, &obj )-> isNull ( ))
+				++found;
+			obj. free ( );
+		}
+	}
+	if ( found != n )
+		fprintf ( stderr, "dict: %d of %d keys not found\n", n - found, n );
+	return benchTime ( ) - t0;
+}
+
+// Parse a dictionary of <size> integers, then look its keys up through
+// the hash index and by a linear scan.
+static int benchDict ( char ** /*files*/, int /*nFiles*/ )
+{
+	static int sizes[] = { 8, 16, 100, 10000 };
+
+	printf ( "%-8s %9s %12s %12s\n", "entries", "parse", "hash/s", "linear/s" );
+	for ( unsigned s = 0; s < sizeof ( sizes ) / sizeof ( int ); ++s ) {
+		int size = sizes[s];
+		char **keys = new char *[size];
+		GString *text = new GString ( "<<" );
+		double parse = 0, hash = 0, linear = 0, t0;
+		Object obj;
+
+		for ( int i = 0; i < size; ++i ) {
+			GString *key = GString::fromInt ( i );
+			key-> insert ( 0, "Key" );
+			keys[i] = copyString ( key-> getCString ( ));
+			text-> append ( " /" )-> append ( key )-> append ( " " )-> append ( key-> getCString ( ) + 3 );
+			delete key;
+		}
+		text-> append ( " >>" );
+
+		// 2 million lookups (20000 for the linear scan of the
+		// big dictionary)
+		int nHash = 2000000, nLinear = size > 1000 ? 20000 : nHash;
+		for ( int r = 0; r < benchOptions. repeat; ++r ) {
+			t0 = benchTime ( );
+			parseObject ( text, &obj );
+			keepBest ( &parse, benchTime ( ) - t0, r );
+			keepBest ( &hash, dictLookups ( obj. getDict ( ), keys, size, nHash, gFalse ), r );
+			keepBest ( &linear, dictLookups ( obj. getDict ( ), keys, size, nLinear, gTrue ), r );
+			obj. free ( );
+		}
+		printf ( "%-8d %9.3f %12.3g %12.3g\n", size, parse * 1000,
+		         nHash / hash, nLinear / linear );
+
+		for ( int i = 0; i < size; ++i )
+			gfree ( keys[i] );
+		delete[] keys;
+		delete text;
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------
+// names: NameTable
+//------------------------------------------------------------------------
+
+// Intern <n> new names, then look them and <n> unknown names up.  Every
+// call takes the table's lock.
+static int benchNames ( char ** /*files*/, int /*nFiles*/ )
+{
+	static int counts[] = { 1000, 100000 };
+	static int serial = 0;
+
+	printf ( "%-8s %12s %12s %12s\n", "names", "intern/s", "find/s", "miss/s" );
+	for ( unsigned c = 0; c < sizeof ( counts ) / sizeof ( int ); ++c ) {
+		int n = counts[c];
+		char **names = new char *[n], **unknown = new char *[n];
+		double intern = 0, find = 0, miss = 0, t0;
+		int found = 0;
+
+		// 1 million finds
+		int nFind = 1000000;
+		for ( int r = 0; r < benchOptions. repeat; ++r ) {
+			// new names on each run, so that intern() adds them all
+			for ( int i = 0; i < n; ++i ) {
+				GString *name = GString::fromInt ( serial );
+				name-> insert ( 0, "BenchName" );
+				names[i] = copyString ( name-> getCString ( ));
+				name-> insert ( 0, "Unknown" );
+				unknown[i] = copyString ( name-> getCString ( ));
+				delete name;
+				++serial;
+			}
+			t0 = benchTime ( );
+			for ( int i = 0; i < n; ++i )
+				NameTable::intern ( names[i] );
+			keepBest ( &intern, benchTime ( ) - t0, r );
+			found = 0;
+			t0 = benchTime ( );
+			for ( int i = 0; i < nFind; ++i ) {
+				if ( NameTable::find ( names[i % n] ) != atomNone )
+					++found;
+			}
+			keepBest ( &find, benchTime ( ) - t0, r );
+			t0 = benchTime ( );
+			for ( int i = 0; i < nFind; ++i ) {
+				if ( NameTable::find ( unknown[i % n] ) != atomNone )
+					++found;
+			}
+			keepBest ( &miss, benchTime ( ) - t0, r );
+			for ( int i = 0; i < n; ++i ) {
+				gfree ( names[i] );
+				gfree ( unknown[i] );
+			}
+		}
+		if ( found != nFind )
+			fprintf ( stderr, "names: %d of %d names not found\n",
+			          nFind - found, nFind );
+		printf ( "%-8d %12.3g %12.3g %12.3g\n", n, n / intern, nFind / find,
+		         nFind / miss );
+		delete[] names;
+		delete[] unknown;
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------
+
+struct CoreBench
+{
+	const char *name;
+	int ( *func ) ( char **files, int nFiles );
+	const char *help;
+};
+
+static CoreBench coreBenches[] = {
+	{ "io", &benchIO,
+	  "FileStream vs MmapStream: open, page 1, fetch every object" },
+	{ "xref", &benchXRef,
+	  "XRef object cache off vs on: all pages, hits and misses" },
+	{ "open", &benchOpenTime,
+	  "open time with the lazy page tree: page 1, last page, all pages" },
+	{ "lin", &benchLin,
+	  "KB fetched in 4 KB blocks before page 1 is displayed, and after the last" },
+	{ "fouble", &benchFouble,
+	  "fouble arithmetic rate and error against double (no files)" },
+	{ "dct", &benchDCT,
+	  "decode the DCT images with the scalar, SSE2 and AVX2 kernels" },
+	{ "color", &benchColor,
+	  "image color conversion, getRGB vs getRGBLine, per color space (no files)" },
+	{ "decrypt", &benchDecrypt,
+	  "pairs plain.pdf enc.pdf: open, decode streams, all pages, overhead" },
+	{ "crypt", &benchCrypt,
+	  "RC4, AES-128 and AES-256 decryption rates (no files)" },
+	{ "pattern", &benchPattern,
+	  "tiling patterns drawn a cell per step vs from a tile: time, fills" },
+	{ "zoom", &benchZoom,
+	  "page list cache off vs on: every page at 72 dpi, then at 4 zooms" },
+	{ "dict", &benchDict,
+	  "Dict lookups by hash index vs linear scan (no files)" },
+	{ "names", &benchNames,
+	  "NameTable intern and find rates (no files)" },
+};
+
+#define nCoreBenches ( (int) ( sizeof ( coreBenches ) / sizeof ( CoreBench )))
+
+int runCoreBench ( const char *name, char **files, int nFiles )
+{
+	for ( int i = 0; i < nCoreBenches; ++i ) {
+		if ( !strcmp ( coreBenches[i]. name, name ))
+			return ( *coreBenches[i]. func ) ( files, nFiles );
+	}
+	return -1;
+}
+
+void printCoreBenches ( FILE *f )
+{
+	for ( int i = 0; i < nCoreBenches; ++i )
+		fprintf ( f, "    %-12s %s\n", coreBenches[i]. name, coreBenches[i]. help );
+}
@@ -0,0 +1,61 @@
+#ifndef BENCHCORE_H
+#define BENCHCORE_H
+
+#include <stdio.h>
+
+#include "goo/gtypes.h"
+#include "xpdf/OutputDev.h"
+
+class GString;
+class PDFDoc;
+
+//------------------------------------------------------------------------
+// Benchmarks of the xpdf core, run by 'epdf-bench -bench <name>'.  They
+// don't need Qt; the rendering benchmark itself is in bench.cpp.
+//------------------------------------------------------------------------
+
+// Options shared with bench.cpp.
+struct BenchOptions
+{
+	GBool mapFile;		// open files through an MmapStream
+	int repeat;		// -n: number of runs (benchmarks report the best)
+	GString *ownerPassword;	// -opw, or NULL
+	GString *userPassword;	// -upw, or NULL
+	int rate;		// -rate: link speed of the lin benchmark, in
+				//   KB/s (0 = not throttled)
+};
+
+extern BenchOptions benchOptions;
+
+// Wall clock time, in seconds.
+double benchTime ( );
+
+// The fouble backend this was built with, e.g. "fixed (10 fraction
+// bits)".
+const char *foubleName ( );
+
+// Open a document the way the options say.  Reports errors and
+// returns NULL if it can't be opened.
+PDFDoc *benchOpen ( GString *fileName );
+
+// Run benchmark <name> on <files>.  Returns the exit status, or -1 if
+// there is no such benchmark.
+int runCoreBench ( const char *name, char **files, int nFiles );
+
+// List the benchmarks, for the usage message.
+void printCoreBenches ( FILE *f );
+
+//------------------------------------------------------------------------
+// NullOutputDev
+//------------------------------------------------------------------------
+
+// Draws nothing, so only the interpretation is timed.
+class NullOutputDev : public OutputDev
+{
+public:
+	virtual GBool upsideDown ( ) { return gTrue; }
+	virtual GBool useDrawChar ( ) { return gTrue; }
+	virtual GBool interpretType3Chars ( ) { return gFalse; }
+};
+
+#endif
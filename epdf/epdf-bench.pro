@@ -0,0 +1,28 @@
+# -------------------------------------------------
+# epdf-bench: renders pages without a window and reports
+# parse / interpret / rasterize times and peak memory.
+#   epdf-bench -h   for the options
+# -------------------------------------------------
+include(./epdf.pri)
+
+TARGET = epdf-bench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += bench.cpp \
+	benchcore.cpp \
+	qoutputdev.cpp \
+	gooStub.cpp \
+	goo/*.cc \
+	xpdf/*.cc
+
+HEADERS += qoutputdev.h \
+	benchcore.h \
+	aconf.h fixed.h UTF8.h \
+	goo/*.h \
+	xpdf/*.h
+
+DESTDIR	= $$BUILDDIR/app
+OBJECTS_DIR	= $$BUILDDIR/bench-obj
+MOC_DIR	= $$BUILDDIR/bench-moc
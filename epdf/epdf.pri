@@ -1,5 +1,16 @@
 PWD=$$(PWD)
 INSTALLDIR	=$$PWD/../install
-BUILDDIR	=$$PWD/../build
-
+# can be set on the qmake command line: qmake BUILDDIR=dir
+isEmpty(BUILDDIR): BUILDDIR	=$$PWD/../build
 
+# Numeric type used for fouble (coordinates, matrices, colors):
+#   CONFIG += fouble_float    native float
+#   CONFIG += fouble_double   native double
+#   otherwise                 fixed point, FOUBLE_FIXED_SHIFT fraction bits
+fouble_float {
+	DEFINES += FOUBLE_FLOAT
+} else:fouble_double {
+	DEFINES += FOUBLE_DOUBLE
+} else {
+	DEFINES += FOUBLE_FIXED_SHIFT=10
+}
@@ -5,10 +5,13 @@ include(./epdf.pri)
 
 TARGET = epdf
 TEMPLATE = app
+
 SOURCES += main.cpp \
     mainwindow.cpp \
 	qoutputdev.cpp \
     myoutputdev.cpp \
+	pagecache.cpp \
+	renderworker.cpp \
 	qbusybar.cpp \
 	gooStub.cpp \
 	goo/*.cc \
@@ -18,6 +21,8 @@ SOURCES += main.cpp \
 HEADERS += mainwindow.h \
 	qoutputdev.h \
     myoutputdev.h \
+	pagecache.h \
+	renderworker.h \
 	qbusybar.h \
 	aconf.h fixed.h UTF8.h \
 	goo/*.h \
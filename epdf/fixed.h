@@ -2,6 +2,7 @@
 #define __FIXED_H__
 
 #include <stdlib.h>
+#include <math.h>
 #include <iostream>
 
 #define _GCC_TEMPLATE_BUG_ 1
@@ -181,6 +182,35 @@ template <unsigned int SH> inline fixt<SH> sqrt ( const fixt<SH> &f )
 	return fixt<SH> ( a1, true );
 }
 
+// fixt converts to int, float and double, so calls to the <math.h>
+// functions would be ambiguous -- provide fixt overloads
+template <unsigned int SH> inline fixt<SH> floor ( const fixt<SH> &f )
+{
+	return fixt<SH> ( f. m_f & ~(( 1 << SH ) - 1 ), true );
+}
+
+template <unsigned int SH> inline fixt<SH> ceil ( const fixt<SH> &f )
+{
+	return -floor ( -f );
+}
+
+template <unsigned int SH> inline fixt<SH> sin ( const fixt<SH> &f )   { return fixt<SH> ( ::sin ( (double) f )); }
+template <unsigned int SH> inline fixt<SH> cos ( const fixt<SH> &f )   { return fixt<SH> ( ::cos ( (double) f )); }
+template <unsigned int SH> inline fixt<SH> acos ( const fixt<SH> &f )  { return fixt<SH> ( ::acos ( (double) f )); }
+template <unsigned int SH> inline fixt<SH> log ( const fixt<SH> &f )   { return fixt<SH> ( ::log ( (double) f )); }
+template <unsigned int SH> inline fixt<SH> log10 ( const fixt<SH> &f ) { return fixt<SH> ( ::log10 ( (double) f )); }
+template <unsigned int SH> inline fixt<SH> exp ( const fixt<SH> &f )   { return fixt<SH> ( ::exp ( (double) f )); }
+
+template <unsigned int SH> inline fixt<SH> pow ( const fixt<SH> &f1, const fixt<SH> &f2 )
+{
+	return fixt<SH> ( ::pow ( (double) f1, (double) f2 ));
+}
+
+template <unsigned int SH> inline fixt<SH> atan2 ( const fixt<SH> &f1, const fixt<SH> &f2 )
+{
+	return fixt<SH> ( ::atan2 ( (double) f1, (double) f2 ));
+}
+
 #if 0 // no std::ostream needed in OPIE
 template <unsigned int SH> inline std::ostream &operator << ( std::ostream &o, const fixt<SH> &f )
 {
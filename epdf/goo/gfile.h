@@ -60,7 +60,8 @@ extern GString *getHomeDir();
 extern GString *getCurrentDir();
 
 // Append a file name to a path string.  <path> may be an empty
-// string, denoting the current directory).  Returns <path>.
+// string, denoting the current directory).  Returns a new string;
+// <path> is left unchanged.
 extern GString *appendToPath(GString *path, char *fileName);
 
 // Grab the path from the front of the file name.  If there is no
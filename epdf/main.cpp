@@ -1,15 +1,22 @@
 #include <QtGui/QApplication>
 #include "mainwindow.h"
+#include "xpdf/GlobalParams.h"
 
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
     // read config file
-//    globalParams = new GlobalParams ( "" );
+    globalParams = new GlobalParams ( "" );
 //    globalParams-> setErrQuiet ( true );
-    MainWindow w;
-    w.setGeometry(100, 100, 600, 480);
-    w.show();
-    return a.exec();
+    int ret;
+    {
+        MainWindow w;
+        w.setGeometry(100, 100, 600, 480);
+        w.show();
+        ret = a.exec();
+    }
+    // after the window (and its document) is gone
+    delete globalParams;
+    return ret;
 }
@@ -8,11 +8,14 @@
 #include <QSizePolicy>
 #include <QLineEdit>
 #include <QFileInfo>
+#include <QMutexLocker>
 #include <QtDebug>
 
 #include "mainwindow.h"
 #include "myoutputdev.h"
+#include "renderworker.h"
 #include "library/fileselector.h"
+#include "goo/GString.h"
 #include "xpdf/PDFDoc.h"
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
@@ -50,6 +53,7 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent)
 
 MainWindow::~MainWindow()
 {
+	m_outdev->setDocument(NULL);
 	delete m_doc;
 }
 
@@ -136,8 +140,15 @@ bool MainWindow::busy() const
 	return m_busy;
 }
 
+// Ask the output device for the current page.  Returns at once: the
+// page is rendered in the background, and a render still running for
+// the previous page or zoom is abandoned.
 void MainWindow::renderPage()
 {
+	if(!m_doc)
+		return;
+	m_outdev->setPageCount(m_currentpage, m_pages);
+	m_outdev->render(m_currentpage, m_zoom);
 }
 
 void MainWindow::delayedInit()
@@ -169,21 +180,54 @@ void MainWindow::copyToClipboard(const QRect &r)
 
 void MainWindow::firstPage ( )
 {
+	gotoPage(1);
 }
 void MainWindow::prevPage ( )
 {
+	gotoPage(m_currentpage - 1);
 }
 void MainWindow::nextPage ( )
 {
+	gotoPage(m_currentpage + 1);
 }
 void MainWindow::lastPage ( )
 {
+	gotoPage(m_pages);
 }
 void MainWindow::gotoPage ( int n )
 {
+	if(!m_doc || n < 1 || n > m_pages || n == m_currentpage)
+		return;
+	m_currentpage = n;
+	renderPage();
 }
 void MainWindow::setZoom ( QAction* aid)
 {
+	int z = aid->data().toInt();
+	int dpi = m_zoom;
+
+	if(!m_doc)
+		return;
+	if(z == 1 || z == 2) {
+		// the page size comes from the document, which the render
+		// thread may be using
+		m_outdev->cancelRender();
+		QMutexLocker lock(m_outdev->renderWorker()->documentMutex());
+		double pw = (double)m_doc->getPageWidth(m_currentpage);
+		double ph = (double)m_doc->getPageHeight(m_currentpage);
+		QSize vs = m_outdev->viewport()->size();
+		if(pw <= 0 || ph <= 0)
+			return;
+		dpi = (int)(72 * vs.width() / pw);
+		if(z == 2 && (int)(72 * vs.height() / ph) < dpi)
+			dpi = (int)(72 * vs.height() / ph);
+	} else if(z > 0) {
+		dpi = 72 * z / 100;
+	}
+	if(dpi < 1)
+		dpi = 1;
+	m_zoom = dpi;
+	renderPage();
 }
 void MainWindow::gotoPageDialog ( )
 {
@@ -225,12 +269,39 @@ void MainWindow::openFile ( const QString &f )
 	QFileInfo fi(f);
 	if(fi.exists())
 	{
-		
+		setDocument(fi.absoluteFilePath());
+		closeFileSelector();
 	}
 }
 //    void MainWindow::openFile ( const DocLnk &f ){}
-void MainWindow::setDocument ( const QString & )
+void MainWindow::setDocument ( const QString &f )
 {
+	RenderWorker *w = m_outdev->renderWorker();
+	PDFDoc *doc;
+	int pages;
+
+	{
+		// the xpdf core is shared with the render thread
+		m_outdev->cancelRender();
+		QMutexLocker lock(w->documentMutex());
+		doc = new PDFDoc(new GString(f.toLocal8Bit().data()));
+		if(!doc->isOk()) {
+			qWarning("Cannot open %s", f.toLocal8Bit().data());
+			delete doc;
+			return;
+		}
+		pages = doc->getNumPages();
+	}
+
+	// the render thread must let go of the old document first
+	m_outdev->setDocument(doc);
+	delete m_doc;
+	m_doc = doc;
+	m_currentdoc = QFileInfo(f).fileName();
+	m_pages = pages;
+	m_currentpage = 0;
+	updateCaption();
+	gotoPage(1);
 }
 QMenu * MainWindow::createPopupMenu()
 {
@@ -1,7 +1,18 @@
 #include "qbusybar.h"
 #include "myoutputdev.h"
+#include "renderworker.h"
+#include "pagecache.h"
 #include <QRubberBand>
 #include <QMouseEvent>
+#include <QPixmap>
+#include <QSettings>
+#include <QTimer>
+#include <QtDebug>
+
+static const QString INIT = "epdf.ini";
+static const QString CACHE_KEY = "pagecache";	// KB, 0 disables
+static const QString PREFETCH_KEY = "prefetch";
+static const int defPageCache = 32 * 1024;
 
 OutputLabel::OutputLabel(QWidget *parent) : QLabel(parent)
 {
@@ -62,9 +73,19 @@ void OutputLabel::mouseReleaseEvent(QMouseEvent *e)
 //MyOutputDev
 //*************************************************************
 
-MyOutputDev::MyOutputDev(QWidget *parent) : QOutputDev(parent)
+MyOutputDev::MyOutputDev(QWidget *parent) : QScrollArea(parent)
 {
 	m_isbusy = false;
+	m_page = m_dpi = m_rotate = 0;
+	m_newpage = false;
+	m_wpage = m_wdpi = m_wrotate = 0;
+	m_pages = 0;
+
+	QSettings setting(INIT, QSettings::IniFormat);
+	m_cache = new PageCache(setting.value(CACHE_KEY, defPageCache).toInt());
+	m_prefetch = setting.value(PREFETCH_KEY, true).toBool();
+
+	setBackgroundRole(QPalette::Dark);
 
 	m_outlabel = new OutputLabel;
 	setWidget( m_outlabel );
@@ -84,26 +105,155 @@ MyOutputDev::MyOutputDev(QWidget *parent) : QOutputDev(parent)
 			this, SLOT(setVisible(const QRect &)));
 	connect(m_outlabel, SIGNAL(selectionChanged(const QRect &)),
 			this, SIGNAL(selectionChanged(const QRect &)));
+
+	m_worker = new RenderWorker(this);
+	connect(m_worker, SIGNAL(pageUpdated(int, int, int, const QImage &)),
+			this, SLOT(pageUpdated(int, int, int, const QImage &)),
+			Qt::QueuedConnection);
+	connect(m_worker, SIGNAL(pageRendered(int, int, int, const QImage &,
+										  const PageText &, int)),
+			this, SLOT(pageRendered(int, int, int, const QImage &,
+									const PageText &, int)),
+			Qt::QueuedConnection);
 }
 
 MyOutputDev::~MyOutputDev()
 {
+	// m_worker is a child: its destructor stops the thread
+	delete m_cache;
 }
 
-void MyOutputDev::setVisible(const QRect &rect)
+void MyOutputDev::setDocument(PDFDoc *doc)
 {
-	QPoint c = rect.center();
-	ensureVisible(c.x(), c.y(), rect.width()/2+5, rect.height()/2+5);
+	m_worker->setDocument(doc);
+	m_cache->clear();
+	m_text = PageText();
+	m_page = m_wpage = 0;
+	setBusy(false);
+}
+
+void MyOutputDev::render(int page, int dpi, int rotate)
+{
+	QImage img;
+
+	m_page = page;
+	m_dpi = dpi;
+	m_rotate = rotate;
+	m_newpage = true;
+
+	if(m_cache->find(PageKey(page, dpi, rotate), img, m_text)) {
+		logStats("hit", page);
+		showImage(img);
+		setBusy(false);
+		QTimer::singleShot(0, this, SLOT(prefetch()));
+		return;
+	}
+	logStats("miss", page);
+	m_text = PageText();
+
+	setBusy(true);
+	// the worker may already be on it, prefetching
+	if(m_wpage != page || m_wdpi != dpi || m_wrotate != rotate) {
+		m_wpage = page;
+		m_wdpi = dpi;
+		m_wrotate = rotate;
+		m_worker->render(page, dpi, rotate);
+	}
+}
+
+// Stop the worker.  A cancelled job reports nothing, so forget about
+// it here: otherwise render() would wait for it forever, and prefetch()
+// would never run again.
+void MyOutputDev::cancelRender()
+{
+	m_worker->cancel();
+	m_wpage = m_wdpi = m_wrotate = 0;
+	setBusy(false);
+}
+
+// Render the next missing neighbour of the current page, N+1 first.
+// Called whenever the viewer goes idle; each finished page calls it
+// again, until both neighbours are in the cache.
+void MyOutputDev::prefetch()
+{
+	int i, n;
+
+	if(!m_prefetch || m_isbusy || m_wpage || m_page < 1)
+		return;
+	for(i = 0; i < 2; ++i) {
+		n = i == 0 ? m_page + 1 : m_page - 1;
+		if(n < 1 || n > m_pages ||
+		   m_cache->contains(PageKey(n, m_dpi, m_rotate)))
+			continue;
+		m_wpage = n;
+		m_wdpi = m_dpi;
+		m_wrotate = m_rotate;
+		m_worker->render(n, m_dpi, m_rotate);
+		return;
+	}
 }
 
-void MyOutputDev::startPage(int pn, GfxState *st)
+void MyOutputDev::logStats(const char *what, int page, int msecs)
 {
-	m_outlabel->getRubberBand()->hide();
-	QOutputDev::startPage(pn, st);
+	QString s = QString("page %1 @%2dpi: %3").arg(page).arg(m_dpi).arg(what);
+	if(msecs >= 0)
+		s += QString(" in %1 ms").arg(msecs);
+	qDebug() << qPrintable(s) << "- cache" << m_cache->hits() << "hits"
+			 << m_cache->misses() << "misses" << m_cache->count() << "pages"
+			 << m_cache->kBytes() << "/" << m_cache->maxKBytes() << "KB";
+}
+
+RenderWorker * MyOutputDev::renderWorker() const
+{
+	return m_worker;
+}
+
+void MyOutputDev::pageUpdated(int page, int dpi, int rotate, const QImage &img)
+{
+	// drop leftovers of an abandoned render
+	if(page != m_page || dpi != m_dpi || rotate != m_rotate)
+		return;
+	showImage(img);
+}
+
+void MyOutputDev::pageRendered(int page, int dpi, int rotate, const QImage &img,
+							   const PageText &text, int msecs)
+{
+	if(page != m_wpage || dpi != m_wdpi || rotate != m_wrotate)
+		return;
+	m_wpage = 0;
+	m_cache->insert(PageKey(page, dpi, rotate), img, text);
+
+	if(page == m_page && dpi == m_dpi && rotate == m_rotate) {
+		logStats("rendered", page, msecs);
+		m_text = text;
+		showImage(img);
+		setBusy(false);
+	} else {
+		logStats("prefetched", page, msecs);
+	}
+	QTimer::singleShot(0, this, SLOT(prefetch()));
+}
+
+void MyOutputDev::showImage(const QImage &img)
+{
+	if(m_newpage) {
+		m_outlabel->getRubberBand()->hide();
+		m_newpage = false;
+	}
+	m_outlabel->setPixmap(QPixmap::fromImage(img));
+	m_outlabel->adjustSize();
+}
+
+void MyOutputDev::setVisible(const QRect &rect)
+{
+	QPoint c = rect.center();
+	ensureVisible(c.x(), c.y(), rect.width()/2+5, rect.height()/2+5);
 }
 
 void MyOutputDev::setPageCount(int actp, int maxp)
 {
+	m_pages = maxp;
 	m_counter->setText(QString("%1 / %2").arg(actp).arg(maxp));
 }
 
@@ -143,15 +293,19 @@ void MyOutputDev::setSelection(const QRect &r, bool scrollto)
 	}
 }
 
-void MyOutputDev::keyPressEvent(QKeyEvent *e)
+// The text came with the page (from the worker or the cache), so these
+// don't wait for a render in progress.  Nothing is found until the page
+// is complete.
+QString MyOutputDev::getText(const QRect &r)
 {
+	return m_text.getText(r);
 }
 
-void MyOutputDev::drawContents()
+bool MyOutputDev::findText(const QString &str, QRect &r, bool top, bool bottom)
+{
+	return m_text.findText(str, r, top, bottom);
+}
+
+void MyOutputDev::keyPressEvent(QKeyEvent *e)
 {
-	QPixmap *tmp = this->getMyPixmap();
-	if(tmp) {
-		m_outlabel->setPixmap(*tmp);
-		m_outlabel->adjustSize();
-	}
 }
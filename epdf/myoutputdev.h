@@ -1,15 +1,17 @@
 #ifndef MYOUTPUTDEV_H
 #define MYOUTPUTDEV_H
 
-#include "qoutputdev.h"
-
+#include <QScrollArea>
 #include <QWidget>
 #include <QRect>
 #include <QPoint>
 #include <QLabel>
-class GfxState;
+#include <QImage>
+#include "pagecache.h"
 class QRubberBand;
 class QBusyBar;
+class PDFDoc;
+class RenderWorker;
 
 //------------------------------------------------------------------------
 //OutputLabel
@@ -35,32 +37,57 @@ private:
 };
 
 
-class MyOutputDev : public QOutputDev
+//------------------------------------------------------------------------
+//MyOutputDev
+//------------------------------------------------------------------------
+// Shows the pages rendered by a RenderWorker.  Rendered pages are kept
+// in a PageCache, and while the viewer is idle the pages next to the
+// current one are rendered ahead of time.
+class MyOutputDev : public QScrollArea
 {
     Q_OBJECT
 public:
     MyOutputDev(QWidget *parent = 0);
     virtual ~MyOutputDev();
+	void setDocument(PDFDoc *doc);
+	void render(int page, int dpi, int rotate = 0);
+	void cancelRender();
+	RenderWorker * renderWorker() const;
 	void setPageCount(int actp, int maxp);
 	virtual void setBusy(bool b = true);
 	virtual bool isBusy() const;
 	QRect selection() const;
 	void setSelection(const QRect &r, bool scrollto = false);
-	virtual void startPage(int pn, GfxState *gs);
+	QString getText(const QRect &r);
+	bool findText(const QString &str, QRect &r, bool top = 0, bool bottom = 0);
 
 signals:
 	void selectionChanged(const QRect &sel);
 
 protected:
 	virtual void keyPressEvent(QKeyEvent *e);
-	virtual void drawContents();	
+	void showImage(const QImage &img);
 private slots:
 	void setVisible(const QRect &rect);
+	void pageUpdated(int page, int dpi, int rotate, const QImage &img);
+	void pageRendered(int page, int dpi, int rotate, const QImage &img,
+					  const PageText &text, int msecs);
+	void prefetch();
 private:
+	void logStats(const char *what, int page, int msecs = -1);
+
 	OutputLabel *m_outlabel;
 	QLabel *m_counter;
 	QBusyBar *m_busybar;
 	bool m_isbusy;
+	RenderWorker *m_worker;
+	int m_page, m_dpi, m_rotate;	// page we are waiting for
+	bool m_newpage;			// nothing of it shown yet
+	int m_wpage, m_wdpi, m_wrotate;	// page the worker is on (0: idle)
+	int m_pages;
+	PageCache *m_cache;
+	PageText m_text;		// text of the page shown, if complete
+	bool m_prefetch;		// render neighbours ahead of time
 };
 
 #endif // OUTPUTDEV_H
@@ -0,0 +1,121 @@
+#include "pagecache.h"
+#include "goo/GString.h"
+#include "xpdf/TextOutputDev.h"
+
+#include <math.h>
+
+//------------------------------------------------------------------------
+// PageText
+//------------------------------------------------------------------------
+
+PageText::PageText(TextPage *text) : m_text(text)
+{
+}
+
+bool PageText::isNull() const
+{
+	return m_text.isNull();
+}
+
+QString PageText::getText(const QRect &r) const
+{
+	if(!m_text)
+		return QString();
+	GString *gstr = m_text->getText(r.left(), r.top(), r.right(), r.bottom());
+	QString str = gstr->getCString();
+	delete gstr;
+	return str;
+}
+
+bool PageText::findText(const QString &str, QRect &r, bool top, bool bottom) const
+{
+	if(!m_text)
+		return false;
+
+	int len = str.length();
+	Unicode *s = new Unicode[len];
+	for(int i = 0; i < len; i++)
+		s[i] = str[i].unicode();
+
+	fouble x1 = (fouble)r.left();
+	fouble y1 = (fouble)r.top();
+	fouble x2 = (fouble)r.right();
+	fouble y2 = (fouble)r.bottom();
+	bool found = m_text->findText(s, len, top, bottom, &x1, &y1, &x2, &y2);
+	if(found)
+		r.setCoords(lrint(x1), lrint(y1), lrint(x2), lrint(y2));
+	delete [] s;
+	return found;
+}
+
+//------------------------------------------------------------------------
+// PageCache
+//------------------------------------------------------------------------
+
+PageCache::PageCache(int maxKBytes) : m_cache(maxKBytes)
+{
+	m_hits = 0;
+	m_misses = 0;
+}
+
+PageCache::~PageCache()
+{
+}
+
+bool PageCache::find(const PageKey &key, QImage &img, PageText &text)
+{
+	Page *p = m_cache.object(key);
+	if(!p) {
+		++m_misses;
+		return false;
+	}
+	++m_hits;
+	img = p->img;
+	text = p->text;
+	return true;
+}
+
+bool PageCache::contains(const PageKey &key) const
+{
+	return m_cache.contains(key);
+}
+
+void PageCache::insert(const PageKey &key, const QImage &img,
+					   const PageText &text)
+{
+	Page *p = new Page;
+	p->img = img;
+	p->text = text;
+	// a page bigger than the whole budget is simply not kept
+	m_cache.insert(key, p, (img.numBytes() + 1023) / 1024);
+}
+
+void PageCache::clear()
+{
+	m_cache.clear();
+}
+
+int PageCache::maxKBytes() const
+{
+	return m_cache.maxCost();
+}
+
+int PageCache::kBytes() const
+{
+	return m_cache.totalCost();
+}
+
+int PageCache::count() const
+{
+	return m_cache.count();
+}
+
+int PageCache::hits() const
+{
+	return m_hits;
+}
+
+int PageCache::misses() const
+{
+	return m_misses;
+}
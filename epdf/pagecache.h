@@ -0,0 +1,100 @@
+#ifndef PAGECACHE_H
+#define PAGECACHE_H
+
+#include <QCache>
+#include <QImage>
+#include <QMetaType>
+#include <QRect>
+#include <QSharedPointer>
+#include <QString>
+
+class TextPage;
+
+//------------------------------------------------------------------------
+// PageKey
+//------------------------------------------------------------------------
+struct PageKey
+{
+	PageKey(int p = 0, int d = 0, int r = 0) : page(p), dpi(d), rotate(r) {}
+	bool operator==(const PageKey &k) const
+		{ return page == k.page && dpi == k.dpi && rotate == k.rotate; }
+
+	int page;
+	int dpi;
+	int rotate;
+};
+
+inline uint qHash(const PageKey &k)
+{
+	return (uint)k.page * 31 * 31 + (uint)k.dpi * 31 + (uint)k.rotate;
+}
+
+//------------------------------------------------------------------------
+// PageText
+//------------------------------------------------------------------------
+// The text of a rendered page.  Copies share the TextPage, which is
+// deleted with the last of them; a finished page's text is only read,
+// so it can be handed from the render thread to the GUI.
+class PageText
+{
+public:
+	PageText(TextPage *text = 0);
+
+	bool isNull() const;
+
+	// Text inside <r> (page pixels).
+	QString getText(const QRect &r) const;
+
+	// Find a string.  If <top> is true, starts looking at the top left
+	// of <r>; otherwise at the top of the page.  If <bottom> is true,
+	// stops looking at its bottom right; otherwise at the bottom of the
+	// page.  If found, sets <r> to the text's bounding box.
+	bool findText(const QString &str, QRect &r, bool top = 0,
+				  bool bottom = 0) const;
+
+private:
+	QSharedPointer<TextPage> m_text;
+};
+
+Q_DECLARE_METATYPE(PageText)
+
+//------------------------------------------------------------------------
+// PageCache
+//------------------------------------------------------------------------
+// Rendered page images, with their text, least recently used dropped first once their
+// total size exceeds the budget.
+class PageCache
+{
+public:
+	PageCache(int maxKBytes);
+	~PageCache();
+
+	// Returns false and leaves <img> and <text> alone if the page is
+	// not cached.  Counts as a hit or a miss.
+	bool find(const PageKey &key, QImage &img, PageText &text);
+
+	// Like find, but doesn't count and doesn't touch the LRU order.
+	bool contains(const PageKey &key) const;
+
+	void insert(const PageKey &key, const QImage &img, const PageText &text);
+	void clear();
+
+	int maxKBytes() const;
+	int kBytes() const;
+	int count() const;
+	int hits() const;
+	int misses() const;
+
+private:
+	struct Page
+	{
+		QImage img;
+		PageText text;
+	};
+
+	QCache<PageKey, Page> m_cache;	// cost is in KB (of the image)
+	int m_hits;
+	int m_misses;
+};
+
+#endif // PAGECACHE_H
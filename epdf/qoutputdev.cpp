@@ -26,7 +26,6 @@
 
 #include <QtGlobal>
 #include <QColor>
-#include <QPixmap>
 #include <QImage>
 #include <QPainter>
 #include <QRect>
@@ -39,9 +38,6 @@
 #include <QMouseEvent>
 #include <QMatrix>
 
-#include <qtimer.h>
-#include <qapplication.h>
-#include <qclipboard.h>
 
 //#define EPDFDBG(x) x		// special debug mode
 #define EPDFDBG(x)   		// normal compilation
@@ -172,12 +168,11 @@ QFont QOutputDev::matchFont ( GfxFont *gfxFont, fp_t m11, fp_t m12, fp_t m21, fp
 // QOutputDev
 //------------------------------------------------------------------------
 
-QOutputDev::QOutputDev ( QWidget *parent ) : QScrollArea (parent)
+QOutputDev::QOutputDev ( )
 {
-	m_pixmap = NULL;
 	m_painter = NULL;
+	m_pagePainter = NULL;
 
-    setBackgroundRole(QPalette::Dark);
 	// create text object
 	m_text = new TextPage ( gFalse );
 }
@@ -185,31 +180,34 @@ QOutputDev::QOutputDev ( QWidget *parent ) : QScrollArea (parent)
 QOutputDev::~QOutputDev ( )
 {
 	delete m_painter;
-	delete m_pixmap;
 	delete m_text;
 }
 
-QPixmap * QOutputDev::getMyPixmap()
+const QImage &QOutputDev::getImage ( ) const
 {
-	return m_pixmap;
+	return m_image;
+}
+
+QImage QOutputDev::snapshot ( ) const
+{
+	// m_image shares its data with any shallow copy, and the painter
+	// keeps writing into it -- so hand out a deep copy
+	return m_image. copy ( );
 }
 
 void QOutputDev::startPage ( int /*pageNum*/, GfxState *state )
 {
-	delete m_pixmap;
 	delete m_painter;
 
-	m_pixmap = new QPixmap ( lrint ( state-> getPageWidth ( )), lrint ( state-> getPageHeight ( )));
-	m_painter = new QPainter ( m_pixmap );
+	// a fresh image: the previous page may still be referenced by
+	// whoever we handed it to
+	m_image = QImage ( lrint ( state-> getPageWidth ( )), lrint ( state-> getPageHeight ( )), QImage::Format_RGB32 );
+	m_image. fill ( 0xffffffff ); // clear page
+	m_painter = new QPainter ( &m_image );
 
-	EPDFDBG( printf ( "NEW PIXMAP (%ld x %ld)\n", lrint ( state-> getPageWidth ( )),  lrint ( state-> getPageHeight ( ))));
+	EPDFDBG( printf ( "NEW IMAGE (%ld x %ld)\n", lrint ( state-> getPageWidth ( )),  lrint ( state-> getPageHeight ( ))));
 	
-	m_pixmap-> fill ( Qt::white ); // clear window
 	m_text-> clear ( ); // cleat text object
-	//m_label->setPixmap(*m_pixmap);
-	//m_label->adjustSize();
-	drawContents();
-	//m_label->adjustSize();
 }
 
 void QOutputDev::endPage ( )
@@ -219,16 +217,10 @@ void QOutputDev::endPage ( )
 
         /*
          * I get stupid crashes after endPage is called and then we do clipping
-         * and other stuff.....
+         * and other stuff..... so keep the painter object around, just
+         * stop painting: the image must not change once it is handed out.
          */
-#if 0
-	delete m_painter;
-	m_painter = 0;
-#endif
-
-	//updateContents ( 0, 0, contentsWidth ( ), contentsHeight ( ));
-	//m_label->setPixmap(*m_pixmap);
-	drawContents();
+	m_painter-> end ( );
 }
 
 void QOutputDev::drawLink ( Link *link, Catalog */*catalog*/ )
@@ -411,7 +403,8 @@ void QOutputDev::updateFont ( GfxState *state )
 	QFont font = matchFont ( gfxFont, m11, m12, m21, m22 );
 
 	m_painter-> setFont ( font );
-	m_text-> updateFont ( state );
+	if ( !m_pagePainter )
+		m_text-> updateFont ( state );
 }
 
 void QOutputDev::stroke ( GfxState *state )
@@ -441,7 +434,6 @@ void QOutputDev::stroke ( GfxState *state )
 		}
 		j += len;
 	}
-	qApp-> processEvents ( );
 }
 
 void QOutputDev::fill ( GfxState *state )
@@ -496,7 +488,6 @@ void QOutputDev::doFill ( GfxState *state, bool winding )
 	}
 	m_painter-> setPen ( oldpen );
 
-	qApp-> processEvents ( );
 }
 
 void QOutputDev::clip ( GfxState *state )
@@ -547,7 +538,6 @@ void QOutputDev::doClip ( GfxState *state, bool winding )
 
 //	m_painter-> fillRect ( 0, 0, m_pixmap-> width ( ), m_pixmap-> height ( ), red );
 //	m_painter-> drawText ( points [0]. x ( ) + 10, points [0]. y ( ) + 10, "Bla bla" );
-	qApp-> processEvents ( );
 }
 
 //
@@ -617,14 +607,19 @@ int QOutputDev::convertSubpath ( GfxState *state, GfxSubpath *subpath, QPolygon
 }
 
 
+// text in a pattern tile is not in page coordinates, so it is drawn
+// but not added to the page text
+
 void QOutputDev::beginString ( GfxState *state, GString * /*s*/ )
 {
-	m_text-> beginString ( state );
+	if ( !m_pagePainter )
+		m_text-> beginString ( state );
 }
 
 void QOutputDev::endString ( GfxState * /*state*/ )
 {
-	m_text-> endString ( );
+	if ( !m_pagePainter )
+		m_text-> endString ( );
 }
 
 void QOutputDev::drawChar ( GfxState *state, fp_t x, fp_t y,
@@ -633,7 +628,7 @@ void QOutputDev::drawChar ( GfxState *state, fp_t x, fp_t y,
 {
 	fp_t x1, y1, dx1, dy1;
 
-	if ( uLen > 0 )
+	if (( uLen > 0 ) && !m_pagePainter )
 		m_text-> addChar ( state, x, y, dx, dy, u, uLen );
 
 	// check for invisible text -- this is used by Acrobat Capture
@@ -721,7 +716,49 @@ void QOutputDev::drawChar ( GfxState *state, fp_t x, fp_t y,
 		// some PDF files use CID 0, which is .notdef, so just ignore it
 		qWarning ( "Unknown character (CID=%d Unicode=%hx)\n", code, (unsigned short) ( uLen > 0 ? u [0] : (Unicode) 0 ));
 	}
-	qApp-> processEvents ( );
+}
+
+GBool QOutputDev::beginPatternTile ( GfxState *state, int tileW, int tileH )
+{
+#ifndef QT_NO_TRANSFORMATIONS
+	// one tile at a time: a pattern inside a pattern cell is skipped
+	if ( !m_painter || m_pagePainter )
+		return gFalse;
+
+	m_tile = QImage ( tileW, tileH, QImage::Format_ARGB32_Premultiplied );
+	if ( m_tile. isNull ( ))
+		return gFalse;
+	m_tile. fill ( 0 ); // transparent
+
+	EPDFDBG( printf ( "PATTERN TILE (%dx%d)\n", tileW, tileH ));
+
+	m_pagePainter = m_painter;
+	m_painter = new QPainter ( &m_tile );
+	updateAll ( state );
+	return gTrue;
+#else
+	return gFalse;
+#endif
+}
+
+void QOutputDev::endPatternTile ( GfxState *state, fp_t *mat, GBool eoFill )
+{
+#ifndef QT_NO_TRANSFORMATIONS
+	delete m_painter;
+	m_painter = m_pagePainter;
+	m_pagePainter = NULL;
+
+	// the brush repeats the tile; its matrix places it on the page
+	QBrush brush ( m_tile );
+	brush. setMatrix ( QMatrix ( mat [0], mat [1], mat [2], mat [3], mat [4], mat [5] ));
+
+	QBrush oldbrush = m_painter-> brush ( );
+	m_painter-> setBrush ( brush );
+	doFill ( state, !eoFill );
+	m_painter-> setBrush ( oldbrush );
+
+	m_tile = QImage ( );
+#endif
 }
 
 void QOutputDev::drawImageMask ( GfxState *state, Object * /*ref*/, Stream *str, int width, int height, GBool invert, GBool inlineImg )
@@ -763,14 +800,13 @@ void QOutputDev::drawImageMask ( GfxState *state, Object * /*ref*/, Stream *str,
 
 	for ( int y = 0; y < height; y++ ) {
 		QRgb *scanline = (QRgb *) img.scanLine(scanlines);
+		Guchar *pix = imgStr-> getLine ( );
 
 		if ( ctm [0] < 0 )
 			scanline += ( width - 1 );
 
 		for ( int x = 0; x < width; x++ ) {
-			Guchar alpha;
-
-			imgStr-> getPixel ( &alpha );
+			Guchar alpha = pix [x];
 
 			if ( invert )
 				alpha ^= 1;
@@ -780,8 +816,6 @@ void QOutputDev::drawImageMask ( GfxState *state, Object * /*ref*/, Stream *str,
 			ctm [0] < 0 ? scanline-- : scanline++;
 		}
 		ctm [3] > 0 ? scanlines-- : scanlines++;
-
-		qApp-> processEvents ( );
 	}
 
 #ifndef QT_NO_TRANSFORMATIONS
@@ -827,17 +861,32 @@ void QOutputDev::drawImageMask ( GfxState *state, Object * /*ref*/, Stream *str,
 
 		img = img.scaled(w, h , 
 			Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-		qApp-> processEvents ( );
 		m_painter-> drawImage ( x, y, img );
 	}
 
 #endif
 
 	delete imgStr;
-	qApp-> processEvents ( );
 }
 
 
+void QOutputDev::getImageTargetSize ( GfxState *state, int width, int height, int *targetWidth, int *targetHeight )
+{
+	// the image is mapped onto the unit square, so the CTM's columns
+	// are its width and height on the page (in double: squaring would
+	// overflow a fixed point fp_t)
+	fp_t *ctm = state-> getCTM ( );
+	double m11 = ctm [0], m12 = ctm [1], m21 = ctm [2], m22 = ctm [3];
+
+	*targetWidth = (int) ceil ( sqrt ( m11 * m11 + m12 * m12 ));
+	*targetHeight = (int) ceil ( sqrt ( m21 * m21 + m22 * m22 ));
+
+	if ( *targetWidth > width )
+		*targetWidth = width;
+	if ( *targetHeight > height )
+		*targetHeight = height;
+}
+
 void QOutputDev::drawImage(GfxState *state, Object * /*ref*/, Stream *str, int width, int height, GfxImageColorMap *colorMap, int *maskColors, GBool inlineImg )
 {
 	int nComps, nVals, nBits;
@@ -875,42 +924,44 @@ void QOutputDev::drawImage(GfxState *state, Object * /*ref*/, Stream *str, int w
 	ImageStream *imgStr = new ImageStream ( str, width, nComps, nBits );
 	imgStr-> reset ( );
 
-	Guchar pixBuf [gfxColorMaxComps];
-	GfxRGB rgb;
-
-
 	int scanlines = 0;
 
 	if ( ctm [3] > 0 )
 		scanlines += ( height - 1 );
 
-	for ( int y = 0; y < height; y++ ) {
-		QRgb *scanline = (QRgb *)img.scanLine(scanlines);
-
-		if ( ctm [0] < 0 )
-			scanline += ( width - 1 );
-
-		for ( int x = 0; x < width; x++ ) {
-			imgStr-> getPixel ( pixBuf );
-			colorMap-> getRGB ( pixBuf, &rgb );
+	// lines are converted straight into the image, except mirrored
+	// ones, which go through lineBuf
+	QVector<Guint> lineBuf ( ctm [0] < 0 ? width : 0 );
 
-			uint val = ( lrint ( rgb. r * 255 ) & 0xff ) << 16 | ( lrint ( rgb. g * 255 ) & 0xff ) << 8 | ( lrint ( rgb. b * 255 ) & 0xff );
+	// ImageStream cuts 16-bit components to 8 bits
+	int maskShift = ( nBits == 16 ) ? 8 : 0;
 
-			if ( maskColors ) {
-				for ( int k = 0; k < nComps; ++k ) {
-					if (( pixBuf [k] < maskColors [2 * k] ) || ( pixBuf [k] > maskColors [2 * k] )) {
-						val |= 0xff000000;
+	for ( int y = 0; y < height; y++ ) {
+		QRgb *scanline = (QRgb *) img. scanLine ( scanlines );
+		Guchar *pix = imgStr-> getLine ( );
+		Guint *out = ( ctm [0] < 0 ) ? lineBuf. data ( ) : (Guint *) scanline;
+
+		colorMap-> getRGBLine ( pix, out, width );
+
+		// pixels whose components all lie within the mask ranges are
+		// transparent
+		if ( maskColors ) {
+			for ( int x = 0; x < width; x++, pix += nComps ) {
+				int k;
+				for ( k = 0; k < nComps; ++k ) {
+					if (( pix [k] < ( maskColors [2 * k] >> maskShift )) || ( pix [k] > ( maskColors [2 * k + 1] >> maskShift )))
 						break;
-					}
 				}
+				if ( k == nComps )
+					out [x] &= 0x00ffffff;
 			}
-			*scanline = val;
+		}
 
-			ctm [0] < 0 ? scanline-- : scanline++;
+		if ( ctm [0] < 0 ) {
+			for ( int x = 0; x < width; x++ )
+				scanline [width - 1 - x] = lineBuf [x];
 		}
 		ctm [3] > 0 ? scanlines-- : scanlines++;
-
-		qApp-> processEvents ( );
 	}
 
 
@@ -958,54 +1009,15 @@ void QOutputDev::drawImage(GfxState *state, Object * /*ref*/, Stream *str, int w
 
 		img = img.scaled(w, h , 
 			Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-		qApp-> processEvents ( );
 		m_painter-> drawImage ( x, y, img );
 	}
 
 #endif
 
 	delete imgStr;
-	qApp-> processEvents ( );
-}
-
-
-
-bool QOutputDev::findText ( const QString &str, QRect &r, bool top, bool bottom )
-{
-	int l, t, w, h;
-	r. getRect ( &l, &t, &w, &h );
-
-	bool res = findText ( str, l, t, w, h, top, bottom );
-
-	r. setRect ( l, t, w, h );
-	return res;
 }
 
-bool QOutputDev::findText ( const QString &str, int &l, int &t, int &w, int &h, bool top, bool bottom )
-{
-	bool found = false;
-	uint len = str. length ( );
-	Unicode *s = new Unicode [len];
-
-	for ( uint i = 0; i < len; i++ )
-		s [i] = str [i]. unicode ( );
-
-	fp_t x1 = (fp_t) l;
-	fp_t y1 = (fp_t) t;
-	fp_t x2 = (fp_t) l + w - 1;
-	fp_t y2 = (fp_t) t + h - 1;
-
-	if ( m_text-> findText ( s, len, top, bottom, &x1, &y1, &x2, &y2 )) {
-		l = lrint ( x1 );
-		t = lrint ( y1 );
-		w = lrint ( x2 ) - l + 1;
-		h = lrint ( y2 ) - t + 1;
-		found = true;
-	}
-	delete [] s;
 
-	return found;
-}
 
 GBool QOutputDev::findText ( Unicode *s, int len, GBool top, GBool bottom, int *xMin, int *yMin, int *xMax, int *yMax )
 {
@@ -1025,25 +1037,12 @@ GBool QOutputDev::findText ( Unicode *s, int len, GBool top, GBool bottom, int *
 	return found;
 }
 
-QString QOutputDev::getText ( int l, int t, int w, int h )
+PageText QOutputDev::takeText ( )
 {
-	GString *gstr = m_text-> getText ( l, t, l + w - 1, t + h - 1 );
-	QString str = gstr-> getCString ( );
-	delete gstr;
-	return str;
-}
+	PageText text ( m_text );
 
-QString QOutputDev::getText ( const QRect &r )
-{
-	return getText ( r. left ( ), r. top ( ), r. width ( ), r. height ( ));
+	m_text = new TextPage ( gFalse );
+	return text;
 }
 
 
-
-void QOutputDev::drawContents ( )
-{
-//	if ( m_pixmap ){
-//		m_label->setPixmap(*m_pixmap);
-//		m_label->adjustSize();
-//	}
-}
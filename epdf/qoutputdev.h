@@ -8,9 +8,10 @@
 #include "aconf.h"
 #include <stddef.h>
 
-#include <QScrollArea>
 #include <QFont>
+#include <QImage>
 #include "xpdf/OutputDev.h"
+#include "pagecache.h"
 
 class Object;
 
@@ -33,21 +34,21 @@ class UnicodeMap;
 class CharCodeToUnicode;
 
 class QPainter;
-class QPixmap;
 class QPolygon;
 
 typedef fouble fp_t;
 
 //------------------------------------------------------------------------
-// XOutputDev
+// QOutputDev
 //------------------------------------------------------------------------
 
-class QOutputDev : public QScrollArea, public OutputDev 
-{
-	Q_OBJECT
+// Draws a page into a QImage.  QOutputDev does not touch any widget,
+// so it can be used from a worker thread (see RenderWorker).
 
+class QOutputDev : public OutputDev 
+{
 public:
-	QOutputDev( QWidget *parent = 0);
+	QOutputDev( );
 
 	// Destructor.
 	virtual ~QOutputDev();
@@ -68,6 +69,15 @@ public:
 	// Does this device need non-text content?
 	virtual GBool needNonText() { return gFalse; }
 
+	// Tiling patterns are drawn from a cached tile.  Those that can't
+	// be are skipped, since needNonText() is false.
+	virtual GBool useTilingPatternCache() { return gTrue; }
+
+	// Images are drawn scaled by the CTM: that is all the detail the
+	// page can show.
+	virtual void getImageTargetSize(GfxState *state, int width, int height,
+	                                int *targetWidth, int *targetHeight);
+
 	//----- initialization and control
 
 	// Start a page.
@@ -116,6 +126,10 @@ public:
 	                      fp_t originX, fp_t originY,
 	                      CharCode code, Unicode *u, int uLen);
 
+	//----- tiling patterns
+	virtual GBool beginPatternTile(GfxState *state, int tileW, int tileH);
+	virtual void endPatternTile(GfxState *state, fp_t *mat, GBool eoFill);
+
 	//----- image drawing
 	virtual void drawImageMask(GfxState *state, Object *ref, Stream *str,
 	                          int width, int height, GBool invert,
@@ -133,20 +147,24 @@ public:
 	
 	//----- special QT access
 
-	bool findText ( const QString &str, int &l, int &t, int &w, int &h, bool top = 0, bool bottom = 0 );
-	bool findText ( const QString &str, QRect &r, bool top = 0, bool bottom = 0 );
+	// The text of the page, once endPage() has been called.  The device
+	// starts a new TextPage for the next page.
+	PageText takeText ( );
+
+	// The page image.  Complete once endPage() has been called.
+	const QImage &getImage ( ) const;
 
-	// Get the text which is inside the specified rectangle.
-	QString getText ( int left, int top, int width, int height );
-	QString getText ( const QRect &r );
-	QPixmap *getMyPixmap();
-protected:
-	virtual void drawContents ( );
+	// A copy of the page as drawn so far, safe to hand to another
+	// thread while drawing continues.
+	QImage snapshot ( ) const;
 
 private:
-	QPixmap *m_pixmap;   		// pixmap to draw into
+	QImage m_image;   		// image to draw into
 	QPainter *m_painter;
 
+	QImage m_tile;			// pattern tile being drawn
+	QPainter *m_pagePainter;	// page painter, while drawing a tile
+
 	TextPage *m_text;		// text from the current page
 
 private:	
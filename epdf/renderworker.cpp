@@ -0,0 +1,133 @@
+#include <QMutexLocker>
+
+#include "renderworker.h"
+#include "qoutputdev.h"
+#include "xpdf/PDFDoc.h"
+
+// minimum time between two pageUpdated signals (ms)
+static const int updateInterval = 250;
+
+//------------------------------------------------------------------------
+// RenderWorker
+//------------------------------------------------------------------------
+
+RenderWorker::RenderWorker ( QObject *parent ) : QThread ( parent )
+{
+	// pageRendered is queued to the GUI thread
+	qRegisterMetaType<PageText> ( "PageText" );
+
+	m_page = m_dpi = m_rotate = 0;
+	m_pending = false;
+	m_cancel = false;
+	m_quit = false;
+
+	m_doc = NULL;
+	m_dev = new QOutputDev ( );
+
+	m_curPage = m_curDpi = m_curRotate = 0;
+}
+
+RenderWorker::~RenderWorker ( )
+{
+	m_mutex. lock ( );
+	m_quit = true;
+	m_cond. wakeOne ( );
+	m_mutex. unlock ( );
+
+	wait ( );
+
+	delete m_dev;
+}
+
+void RenderWorker::setDocument ( PDFDoc *doc )
+{
+	cancel ( );
+
+	QMutexLocker docLock ( &m_docMutex );
+	m_doc = doc;
+}
+
+void RenderWorker::render ( int page, int dpi, int rotate )
+{
+	QMutexLocker lock ( &m_mutex );
+
+	m_page = page;
+	m_dpi = dpi;
+	m_rotate = rotate;
+	m_pending = true;
+
+	if ( !isRunning ( ))
+		start ( LowPriority );
+	else
+		m_cond. wakeOne ( );
+}
+
+void RenderWorker::cancel ( )
+{
+	QMutexLocker lock ( &m_mutex );
+
+	m_pending = false;
+	m_cancel = true;
+}
+
+QMutex *RenderWorker::documentMutex ( )
+{
+	return &m_docMutex;
+}
+
+// Called by Gfx every few operators: stop as soon as the render has
+// been superseded, and send out the partial page now and then.
+GBool RenderWorker::abortCheck ( void *data )
+{
+	RenderWorker *w = (RenderWorker *) data;
+
+	if ( w-> m_pending || w-> m_cancel || w-> m_quit )
+		return gTrue;
+
+	if ( w-> m_updateTime. elapsed ( ) >= updateInterval ) {
+		emit w-> pageUpdated ( w-> m_curPage, w-> m_curDpi, w-> m_curRotate,
+		                       w-> m_dev-> snapshot ( ));
+		w-> m_updateTime. restart ( );
+	}
+	return gFalse;
+}
+
+void RenderWorker::run ( )
+{
+	forever {
+		m_mutex. lock ( );
+		while ( !m_pending && !m_quit )
+			m_cond. wait ( &m_mutex );
+		if ( m_quit ) {
+			m_mutex. unlock ( );
+			return;
+		}
+		m_curPage = m_page;
+		m_curDpi = m_dpi;
+		m_curRotate = m_rotate;
+		m_pending = false;
+		m_cancel = false;
+		m_mutex. unlock ( );
+
+		QImage image;
+		PageText text;
+		QTime renderTime;
+
+		m_docMutex. lock ( );
+		if ( m_doc && m_curPage >= 1 && m_curPage <= m_doc-> getNumPages ( )) {
+			renderTime. start ( );
+			m_updateTime. start ( );
+			m_doc-> displayPage ( m_dev, m_curPage, m_curDpi, m_curRotate,
+			                      gTrue, &abortCheck, this );
+			if ( !m_pending && !m_cancel && !m_quit ) {
+				image = m_dev-> getImage ( );
+				text = m_dev-> takeText ( );
+			}
+		}
+		m_docMutex. unlock ( );
+
+		if ( !image. isNull ( ))
+			emit pageRendered ( m_curPage, m_curDpi, m_curRotate, image, text,
+			                    renderTime. elapsed ( ));
+	}
+}
@@ -0,0 +1,79 @@
+#ifndef RENDERWORKER_H
+#define RENDERWORKER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QImage>
+#include <QTime>
+
+#include "goo/gtypes.h"
+#include "pagecache.h"
+
+class PDFDoc;
+class QOutputDev;
+
+//------------------------------------------------------------------------
+// RenderWorker
+//------------------------------------------------------------------------
+
+// Renders pages on a background thread into a QOutputDev.  Results come
+// back through (queued) signals, tagged with the page, zoom and rotation
+// they were rendered for, so the receiver can drop stale ones.  A
+// complete page comes with its text, which the receiver then owns: text
+// queries never wait for the worker.
+//
+// The xpdf core is not thread safe: while the worker runs, any other
+// access to the document must hold documentMutex().
+
+class RenderWorker : public QThread
+{
+	Q_OBJECT
+
+public:
+	RenderWorker ( QObject *parent = 0 );
+	virtual ~RenderWorker ( );
+
+	// Use <doc> for the following renders.  Stops the current render;
+	// the caller keeps ownership of <doc>.
+	void setDocument ( PDFDoc *doc );
+
+	// Render <page> at <dpi>.  A render in progress is abandoned.
+	void render ( int page, int dpi, int rotate = 0 );
+
+	// Abandon the current render, and any render not yet started.
+	void cancel ( );
+
+	// Lock this while using the document from another thread.
+	QMutex *documentMutex ( );
+
+signals:
+	// Part of the page, sent periodically while a slow page renders.
+	void pageUpdated ( int page, int dpi, int rotate, const QImage &image );
+
+	// The complete page, its text, and how long it took to render.
+	void pageRendered ( int page, int dpi, int rotate, const QImage &image,
+	                    const PageText &text, int msecs );
+
+protected:
+	virtual void run ( );
+
+private:
+	static GBool abortCheck ( void *data );
+
+	QMutex m_mutex;			// protects the request below
+	QWaitCondition m_cond;
+	int m_page, m_dpi, m_rotate;	// requested render
+	volatile bool m_pending;	// a new request is waiting
+	volatile bool m_cancel;		// drop the current render
+	volatile bool m_quit;		// thread should exit
+
+	QMutex m_docMutex;		// protects m_doc, m_dev
+	PDFDoc *m_doc;
+	QOutputDev *m_dev;
+
+	int m_curPage, m_curDpi, m_curRotate;	// render in progress
+	QTime m_updateTime;		// time since the last pageUpdated
+};
+
+#endif
@@ -0,0 +1,53 @@
+#!/bin/sh
+# Build epdf-bench with each fouble backend (fixed, float, double) and
+# run it on the same files: the fouble arithmetic benchmark, then all
+# pages rendered to PNG.  Prints the total times of each backend and
+# how many pages look different from the double ones.
+#
+#   tests/fouble-bench.sh [-r dpi[,dpi...]] file.pdf ...
+#
+# The builds and PNGs go to ../build/fouble/<backend>.  Set QMAKE and
+# MAKE to use other tools than qmake and make.
+
+set -e
+
+dpis=72
+if [ "$1" = "-r" ]; then
+	dpis=$2
+	shift 2
+fi
+if [ $# -eq 0 ]; then
+	echo "usage: $0 [-r dpi[,dpi...]] file.pdf ..." >&2
+	exit 1
+fi
+
+src=$(cd "$(dirname "$0")/.." && pwd)
+out=$src/../build/fouble
+QMAKE=${QMAKE:-qmake}
+MAKE=${MAKE:-make}
+
+for backend in fixed float double; do
+	dir=$out/$backend
+	mkdir -p "$dir/png"
+	rm -f "$dir"/png/*.png
+	config=
+	[ $backend != fixed ] && config=CONFIG+=fouble_$backend
+	( cd "$dir" && PWD=$src $QMAKE "$src/epdf-bench.pro" BUILDDIR="$dir" $config &&
+	  $MAKE -s ) > "$dir/build.log" 2>&1 || {
+		echo "$backend: build failed, see $dir/build.log" >&2
+		exit 1
+	}
+	"$dir/app/epdf-bench" -n 5 -bench fouble
+	"$dir/app/epdf-bench" -n 3 -q -r "$dpis" -png "$dir/png" "$@" | tail -n 1
+done
+
+for backend in fixed float; do
+	total=0
+	diff=0
+	for png in "$out"/double/png/*.png; do
+		[ -f "$png" ] || continue
+		total=$((total + 1))
+		cmp -s "$png" "$out/$backend/png/$(basename "$png")" || diff=$((diff + 1))
+	done
+	echo "$backend: $diff of $total pages differ from double"
+done
@@ -0,0 +1,168 @@
+// epdf-test: runs the tests defined with TEST() (see test.h), or the
+// ones named on the command line, and prints the failures.  The exit
+// status is the number of failed tests.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include "goo/gmem.h"
+#include "goo/GString.h"
+#include "xpdf/Object.h"
+#include "xpdf/Stream.h"
+#include "xpdf/Lexer.h"
+#include "xpdf/Parser.h"
+#include "xpdf/GlobalParams.h"
+#include "xpdf/PDFDoc.h"
+#include "test.h"
+
+#ifndef TEST_DATA_DIR
+#define TEST_DATA_DIR "data"
+#endif
+
+static TestRegistration *tests = NULL;
+static TestRegistration **lastTest = &tests;
+static const char *dataDir = TEST_DATA_DIR;
+static int checkFailures = 0;
+
+TestRegistration::TestRegistration ( const char *nameA, TestFunc funcA )
+{
+	name = nameA;
+	func = funcA;
+	next = NULL;
+	*lastTest = this;
+	lastTest = &next;
+}
+
+GBool testCheck ( GBool ok, const char *file, int line, const char *fmt, ... )
+{
+	va_list args;
+
+	if ( ok )
+		return gTrue;
+	fprintf ( stderr, "%s:%d: failed: ", file, line );
+	va_start ( args, fmt );
+	vfprintf ( stderr, fmt, args );
+	va_end ( args );
+	fprintf ( stderr, "\n" );
+	++checkFailures;
+	return gFalse;
+}
+
+GString *testDataPath ( const char *name )
+{
+	GString *path = new GString ( dataDir );
+
+	path-> append ( '/' )-> append ( name );
+	return path;
+}
+
+char *testReadData ( const char *name, int *length )
+{
+	GString *path = testDataPath ( name );
+	FILE *f = fopen ( path-> getCString ( ), "rb" );
+	char *buf = NULL;
+
+	*length = 0;
+	if ( f ) {
+		fseek ( f, 0, SEEK_END );
+		*length = (int) ftell ( f );
+		fseek ( f, 0, SEEK_SET );
+		buf = (char *) gmalloc ( *length > 0 ? *length : 1 );
+		if ( (int) fread ( buf, 1, *length, f ) != *length ) {
+			gfree ( buf );
+			buf = NULL;
+		}
+		fclose ( f );
+	}
+	CHECK_MSG ( buf != NULL, "can't read %s", path-> getCString ( ));
+	delete path;
+	return buf;
+}
+
+PDFDoc *testOpenDoc ( const char *name, const char *userPW )
+{
+	GString *user = userPW ? new GString ( userPW ) : (GString *) NULL;
+	PDFDoc *doc = new PDFDoc ( testDataPath ( name ), NULL, user );
+
+	delete user;
+	if ( !CHECK_MSG ( doc-> isOk ( ), "%s: can't open", name )) {
+		delete doc;
+		return NULL;
+	}
+	return doc;
+}
+
+void testRemoveDir ( const char *dir )
+{
+	DIR *d = opendir ( dir );
+	struct dirent *ent;
+	char path[1024];
+
+	while ( d && ( ent = readdir ( d ))) {
+		if ( ent-> d_name[0] == '.' )
+			continue;
+		snprintf ( path, sizeof ( path ), "%s/%s", dir, ent-> d_name );
+		unlink ( path );
+	}
+	if ( d )
+		closedir ( d );
+	rmdir ( dir );
+}
+
+Object *testParseObject ( GString *text, Object *obj )
+{
+	Object dict;
+
+	dict. initNull ( );
+	Parser *parser = new Parser ( NULL,
+	                              new Lexer ( NULL,
+	                                          new MemStream ( text-> getCString ( ),
+	                                                          text-> getLength ( ), &dict )));
+	parser-> getObj ( obj );
+	delete parser;
+	return obj;
+}
+
+int main ( int argc, char *argv[] )
+{
+	int i, failed = 0, run = 0;
+
+	for ( i = 1; i < argc && argv[i][0] == '-'; ++i ) {
+		if ( !strcmp ( argv[i], "-d" ) && i + 1 < argc ) {
+			dataDir = argv[++i];
+		} else {
+			fprintf ( stderr, "usage: epdf-test [-d datadir] [test ...]\n" );
+			return argv[i][1] == 'h' ? 0 : 1;
+		}
+	}
+
+	// the tests feed broken data on purpose
+	globalParams = new GlobalParams ( "" );
+	globalParams-> setErrQuiet ( gTrue );
+
+	for ( TestRegistration *t = tests; t; t = t-> next ) {
+		GBool wanted = i == argc;
+		for ( int j = i; j < argc && !wanted; ++j )
+			wanted = !strcmp ( argv[j], t-> name );
+		if ( !wanted )
+			continue;
+
+		int before = checkFailures;
+		( *t-> func ) ( );
+		++run;
+		if ( checkFailures > before ) {
+			printf ( "FAIL %s\n", t-> name );
+			++failed;
+		} else {
+			printf ( "ok   %s\n", t-> name );
+		}
+	}
+	printf ( "%d of %d tests failed\n", failed, run );
+
+	delete globalParams;
+	return failed;
+}
@@ -0,0 +1,59 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include "goo/gtypes.h"
+
+class GString;
+class Object;
+class PDFDoc;
+
+//------------------------------------------------------------------------
+// A minimal test harness for epdf-test.  A test is a function defined
+// with TEST(name) in any of the test*.cpp files; it reports failures
+// with CHECK() and goes on.
+//------------------------------------------------------------------------
+
+typedef void ( *TestFunc ) ( );
+
+// Registers a test (TEST() does this with a static instance).
+class TestRegistration
+{
+public:
+	TestRegistration ( const char *name, TestFunc func );
+
+	const char *name;
+	TestFunc func;
+	TestRegistration *next;
+};
+
+#define TEST(name) \
+	static void name ( ); \
+	static TestRegistration name##Registration ( #name, &name ); \
+	static void name ( )
+
+// Report a failure of <cond> (with the printf-style message, if any)
+// and return false, or return true.
+#define CHECK(cond) testCheck ( ( cond ), __FILE__, __LINE__, "%s", #cond )
+#define CHECK_MSG(cond, ...) testCheck ( ( cond ), __FILE__, __LINE__, __VA_ARGS__ )
+
+GBool testCheck ( GBool ok, const char *file, int line, const char *fmt, ... );
+
+// Return the path of a file in the test data directory.
+GString *testDataPath ( const char *name );
+
+// Read a file of the test data directory into memory (allocated with
+// gmalloc).  Returns NULL, and reports a failure, if it can't.
+char *testReadData ( const char *name, int *length );
+
+// Open a document of the test data directory.  Returns NULL, and
+// reports a failure, if it can't.
+PDFDoc *testOpenDoc ( const char *name, const char *userPW = NULL );
+
+// Remove the files of <dir>, and <dir> (a directory made by a test).
+void testRemoveDir ( const char *dir );
+
+// Parse one object written in PDF syntax (with no indirect
+// references).  Streams point into <text>, which must outlive them.
+Object *testParseObject ( GString *text, Object *obj );
+
+#endif
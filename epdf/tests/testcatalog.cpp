@@ -0,0 +1,23 @@
+// Page tree /Count entries: data/badcount.pdf has a top-level /Count
+// of 5 over two pages.  Once a page can't be found by /Count, the whole
+// tree is read, and its page count is the one used from then on.
+
+#include "goo/GString.h"
+#include "xpdf/Object.h"
+#include "xpdf/Page.h"
+#include "xpdf/PDFDoc.h"
+#include "test.h"
+
+TEST ( catalogCountCorrected )
+{
+	PDFDoc *doc = new PDFDoc ( testDataPath ( "badcount.pdf" ));
+
+	if ( CHECK ( doc-> isOk ( ))) {
+		CHECK ( doc-> getNumPages ( ) == 5 );
+		CHECK ( (int) doc-> getPageWidth ( 2 ) == 300 );
+		doc-> getPageWidth ( 3 );
+		CHECK_MSG ( doc-> getNumPages ( ) == 2, "%d pages after reading the tree",
+		            doc-> getNumPages ( ));
+	}
+	delete doc;
+}
@@ -0,0 +1,171 @@
+// GfxImageColorMap::getRGBLine against getRGB, for each of the ways it
+// converts pixels: tables of every pixel (Lookup), level tables (RGB),
+// integer DeviceCMYK (CMYK) and the interpolated grid (Grid).
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "goo/gmem.h"
+#include "goo/GString.h"
+#include "xpdf/Object.h"
+#include "xpdf/GfxState.h"
+#include "test.h"
+
+// A type 4 (PostScript) function stream with <m> inputs and <n>
+// outputs, all in [0 1].
+static GString *type4Function ( int m, int n, const char *code )
+{
+	GString *s = new GString ( "<< /FunctionType 4 /Domain [" );
+
+	for ( int i = 0; i < m; ++i )
+		s-> append ( " 0 1" );
+	s-> append ( " ] /Range [" );
+	for ( int i = 0; i < n; ++i )
+		s-> append ( " 0 1" );
+	GString *len = GString::fromInt ( strlen ( code ));
+	s-> append ( " ] /Length " )-> append ( len )-> append ( " >>\nstream\n" );
+	s-> append ( code )-> append ( "\nendstream" );
+	delete len;
+	return s;
+}
+
+// getRGB as a 0xffRRGGBB value, rounded the way getRGBLine rounds.
+static Guint refARGB ( GfxImageColorMap *map, Guchar *x )
+{
+	GfxRGB rgb;
+	fouble c[3];
+	Guint argb = 0xff000000;
+
+	map-> getRGB ( x, &rgb );
+	c[0] = rgb. r;
+	c[1] = rgb. g;
+	c[2] = rgb. b;
+	for ( int i = 0; i < 3; ++i ) {
+		fouble v = c[i] < 0 ? fouble ( 0 ) : c[i] > 1 ? fouble ( 1 ) : c[i];
+		argb |= (Guint) (int) ( v * 255 + 0.5 ) << ( 16 - 8 * i );
+	}
+	return argb;
+}
+
+// Convert <nLines> lines of noise with getRGBLine and compare each pixel
+// with getRGB.  Returns the largest difference in levels.
+static int maxLineError ( GfxImageColorMap *map, int nLines, unsigned *seed )
+{
+	const int width = 1000;
+	int nComps = map-> getNumPixelComps ( );
+	int mask = ( 1 << map-> getBits ( )) - 1;
+	Guchar *pixels = (Guchar *) gmalloc ( width * nComps );
+	Guint *line = (Guint *) gmalloc ( width * sizeof ( Guint ));
+	int err = 0;
+
+	for ( int y = 0; y < nLines; ++y ) {
+		for ( int i = 0; i < width * nComps; ++i ) {
+			*seed = *seed * 1103515245 + 12345;
+			pixels[i] = ( *seed >> 16 ) & mask;
+		}
+		map-> getRGBLine ( pixels, line, width );
+		for ( int i = 0; i < width; ++i ) {
+			Guint ref = refARGB ( map, pixels + i * nComps );
+			for ( int sh = 0; sh < 24; sh += 8 ) {
+				int d = abs ( (int) (( line[i] >> sh ) & 0xff ) -
+				              (int) (( ref >> sh ) & 0xff ));
+				if ( d > err )
+					err = d;
+			}
+			if (( line[i] >> 24 ) != 0xff )
+				err = 256;
+		}
+	}
+	gfree ( pixels );
+	gfree ( line );
+	return err;
+}
+
+// Check getRGBLine in color space <csText> against getRGB.  The first
+// <exactLines> lines must match exactly (the grid isn't built until
+// enough pixels have been converted); after those, <nLines> more may
+// be off by <tolerance> levels.
+static void checkColorSpace ( const char *name, GString *csText, int bits,
+                              int exactLines, int nLines, int tolerance )
+{
+	Object obj, decode;
+	unsigned seed = 1;
+
+	testParseObject ( csText, &obj );
+	GfxColorSpace *cs = GfxColorSpace::parse ( &obj );
+	obj. free ( );
+	if ( !CHECK_MSG ( cs != NULL, "%s: can't parse the color space", name )) {
+		delete csText;
+		return;
+	}
+	decode. initNull ( );
+	GfxImageColorMap *map = new GfxImageColorMap ( bits, &decode, cs );
+	if ( CHECK_MSG ( map-> isOk ( ), "%s: bad color map", name )) {
+		int err;
+		if ( exactLines > 0 ) {
+			err = maxLineError ( map, exactLines, &seed );
+			CHECK_MSG ( err == 0, "%s: %d levels off before the grid is built",
+			            name, err );
+		}
+		err = maxLineError ( map, nLines, &seed );
+		CHECK_MSG ( err <= tolerance, "%s: %d levels off, expected at most %d",
+		            name, err, tolerance );
+	}
+	delete map;
+	delete csText;
+}
+
+TEST ( colorLookupMatchesGetRGB )
+{
+	GString *indexed = new GString ( "[/Indexed /DeviceRGB 255 <" );
+	for ( int j = 0; j < 256; ++j ) {
+		char hex[8];
+		sprintf ( hex, "%02x%02x%02x", j, ( j * 7 ) & 0xff, 255 - j );
+		indexed-> append ( hex );
+	}
+	indexed-> append ( ">]" );
+
+	checkColorSpace ( "DeviceGray", new GString ( "/DeviceGray" ), 8, 0, 2, 0 );
+	checkColorSpace ( "DeviceGray 1-bit", new GString ( "/DeviceGray" ), 1, 0, 2, 0 );
+	checkColorSpace ( "Indexed", indexed, 8, 0, 2, 0 );
+	checkColorSpace ( "DeviceRGB 4-bit", new GString ( "/DeviceRGB" ), 4, 0, 2, 0 );
+	checkColorSpace ( "Separation",
+	                  new GString ( "[/Separation /Spot /DeviceCMYK << /FunctionType 2 "
+	                                "/Domain [0 1] /C0 [0 0 0 0] /C1 [0.1 0.6 0.9 0.05] "
+	                                "/N 1 >>]" ), 8, 0, 2, 0 );
+}
+
+TEST ( colorRGBMatchesGetRGB )
+{
+	checkColorSpace ( "DeviceRGB", new GString ( "/DeviceRGB" ), 8, 0, 20, 0 );
+	checkColorSpace ( "CalRGB",
+	                  new GString ( "[/CalRGB << /WhitePoint [0.9505 1 1.089] "
+	                                "/Gamma [2.2 2.2 2.2] >>]" ), 8, 0, 20, 0 );
+}
+
+TEST ( colorCMYKMatchesGetRGB )
+{
+	checkColorSpace ( "DeviceCMYK", new GString ( "/DeviceCMYK" ), 8, 0, 20, 2 );
+	checkColorSpace ( "ICCBased CMYK",
+	                  new GString ( "[/ICCBased << /N 4 /Alternate /DeviceCMYK "
+	                                "/Length 0 >>\nstream\n\nendstream]" ), 8, 0, 20, 2 );
+}
+
+TEST ( colorGridMatchesGetRGB )
+{
+	GString *deviceN3 = new GString ( "[/DeviceN [/A /B /C] /DeviceRGB " );
+	GString *deviceN4 = new GString ( "[/DeviceN [/A /B /C /D] /DeviceCMYK " );
+	GString *f;
+
+	f = type4Function ( 3, 3, "{ exch dup mul exch 3 1 roll }" );
+	deviceN3-> append ( f )-> append ( "]" );
+	delete f;
+	f = type4Function ( 4, 4, "{ 4 1 roll }" );
+	deviceN4-> append ( f )-> append ( "]" );
+	delete f;
+
+	// 33^3 and 17^4 grid nodes: the grid is built after about 36 and
+	// 84 lines of 1000 pixels
+	checkColorSpace ( "DeviceN, 3 in", deviceN3, 8, 30, 20, 2 );
+	checkColorSpace ( "DeviceN, 4 in", deviceN4, 8, 80, 20, 6 );
+}
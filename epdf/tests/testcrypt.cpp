@@ -0,0 +1,294 @@
+// The Standard security handler: AES-128 and AES-256 known answers, the
+// revision 6 password hash, and data/*.pdf, one document stored
+// unencrypted and with each algorithm, which must all read the same.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "goo/gmem.h"
+#include "goo/GString.h"
+#include "xpdf/Object.h"
+#include "xpdf/Stream.h"
+#include "xpdf/XRef.h"
+#include "xpdf/Decrypt.h"
+#include "xpdf/PDFDoc.h"
+#include "test.h"
+
+// Decode a string of hex digits.
+static GString *fromHex ( const char *hex )
+{
+	GString *s = new GString ( );
+
+	for ( ; hex[0] && hex[1]; hex += 2 ) {
+		int c;
+		sscanf ( hex, "%2x", &c );
+		s-> append ( (char) c );
+	}
+	return s;
+}
+
+// GString::cmp stops at a NUL; keys and plain text may have them.
+static GBool sameBytes ( GString *a, GString *b )
+{
+	return a-> getLength ( ) == b-> getLength ( ) &&
+	       !memcmp ( a-> getCString ( ), b-> getCString ( ), a-> getLength ( ));
+}
+
+// Decrypt <in> (IV and cipher text), giving it to the decryptor
+// <chunk> bytes at a time.  Returns the plain text.
+static GString *decryptAll ( Guchar *fileKey, int keyLength,
+                             CryptAlgorithm alg, int objNum,
+                             GString *in, int chunk )
+{
+	Decrypt decrypt ( fileKey, keyLength, alg, objNum, 0 );
+	Guchar *out = (Guchar *) gmalloc ( in-> getLength ( ) + 32 );
+	int n = 0;
+
+	for ( int i = 0; i < in-> getLength ( ); i += chunk ) {
+		int k = in-> getLength ( ) - i < chunk ? in-> getLength ( ) - i : chunk;
+		n += decrypt. decryptBlock ( (Guchar *) in-> getCString ( ) + i, out + n,
+		                             k, i + k == in-> getLength ( ));
+	}
+	GString *s = new GString ( (char *) out, n );
+	gfree ( out );
+	return s;
+}
+
+// Decrypt <ct> in chunks of every size from 1 to 40 bytes and compare
+// with <pt>.
+static void checkDecrypt ( const char *name, GString *key, CryptAlgorithm alg,
+                           int objNum, const char *ct, const char *pt )
+{
+	GString *in = fromHex ( ct );
+	GString *expected = fromHex ( pt );
+
+	for ( int chunk = 1; chunk <= 40; ++chunk ) {
+		GString *out = decryptAll ( (Guchar *) key-> getCString ( ),
+		                            key-> getLength ( ), alg, objNum, in, chunk );
+		CHECK_MSG ( sameBytes ( out, expected ), "%s, %d-byte chunks: wrong plain text",
+		            name, chunk );
+		delete out;
+	}
+	delete in;
+	delete expected;
+}
+
+// FIPS-197 appendix C.3, in CBC mode with a zero IV and one block of
+// padding.  AESV3 uses the file key as it is.
+TEST ( cryptAES256KnownAnswer )
+{
+	GString *key = fromHex ( "000102030405060708090a0b0c0d0e0f"
+	                         "101112131415161718191a1b1c1d1e1f" );
+
+	checkDecrypt ( "AES-256", key, cryptAES256, 1,
+	               "00000000000000000000000000000000"
+	               "8ea2b7ca516745bfeafc49904b496089"
+	               "56423350859cf424d4459534a8f5aaf2",
+	               "00112233445566778899aabbccddeeff" );
+	delete key;
+}
+
+// AESV2 uses MD5(file key, object number, generation, "sAlT") as the
+// key: 8be05f4432358a80b1989cd329ba6e21 for object 7 here.  The cipher
+// text was made with OpenSSL.
+TEST ( cryptAES128KnownAnswer )
+{
+	GString *key = fromHex ( "000102030405060708090a0b0c0d0e0f" );
+
+	checkDecrypt ( "AES-128", key, cryptAES, 7,
+	               "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff"
+	               "23504ec2bd9870bc62e87b0373b34451"
+	               "243f9f97edbb8081e0c0b86e5536a2eb"
+	               "cb3771d52b1bf5a7206fd480e5948de2",
+	               "54686520717569636b2062726f776e20"	// "The quick brown "
+	               "666f78206a756d7073206f7665722074"	// "fox jumps over t"
+	               "6865206c617a7920646f67" );		// "he lazy dog"
+	delete key;
+}
+
+// The /Encrypt entries of data/aes256.pdf (revision 6, user password
+// "user", owner password "owner") and the file key they wrap.
+static const char *r6Owner =
+	"694a5ab4481b734d72a4c34c4a7f57f55f655245b59211e8472255fa30e5afdf"
+	"07c3c20624292e3b83d5a9c6eae1ec2a";
+static const char *r6User =
+	"6a5b1b01200f6028ec370e22ee0cc69cdc4aa91f72ce0ef0ce89b1f5a85892a3"
+	"a3452526e7bc1642aeb42bf227d50fff";
+static const char *r6OwnerEnc =
+	"48f0f653b56b3aa7b2fa6728ce3a4f767c14014923038e8321ea4e399270a3ac";
+static const char *r6UserEnc =
+	"949c3cdba4cc72b177da25261cff297d0dbf21d9077819b6b716750a1cf48da8";
+static const char *r6FileKey =
+	"8f6c68082389d2e47f1e175a90bc432fb946e6a9471109f3b79f110a26f6229f";
+
+// Run makeFileKey for revision 6.  Returns true if a password was
+// accepted; <fileKey> gets the key.
+static GBool makeR6FileKey ( const char *ownerPW, const char *userPW,
+                             GString *fileKey, GBool *ownerOk )
+{
+	GString *o = fromHex ( r6Owner ), *u = fromHex ( r6User );
+	GString *oe = fromHex ( r6OwnerEnc ), *ue = fromHex ( r6UserEnc );
+	GString *fileID = new GString ( );
+	GString *owner = ownerPW ? new GString ( ownerPW ) : (GString *) NULL;
+	GString *user = userPW ? new GString ( userPW ) : (GString *) NULL;
+	Guchar key[maxFileKeyLength];
+
+	*ownerOk = gFalse;
+	GBool ok = Decrypt::makeFileKey ( 5, 6, 32, o, u, oe, ue, -4, fileID, gTrue,
+	                                  owner, user, key, ownerOk );
+	fileKey-> clear ( );
+	if ( ok )
+		fileKey-> append ( (char *) key, 32 );
+	delete o;
+	delete u;
+	delete oe;
+	delete ue;
+	delete fileID;
+	delete owner;
+	delete user;
+	return ok;
+}
+
+TEST ( cryptR6FileKey )
+{
+	GString *expected = fromHex ( r6FileKey );
+	GString *key = new GString ( );
+	GBool ownerOk;
+
+	CHECK ( makeR6FileKey ( NULL, "user", key, &ownerOk ));
+	CHECK ( sameBytes ( key, expected ));
+	CHECK ( !ownerOk );
+
+	CHECK ( makeR6FileKey ( "owner", NULL, key, &ownerOk ));
+	CHECK ( sameBytes ( key, expected ));
+	CHECK ( ownerOk );
+
+	// a wrong owner password falls back to the user password
+	CHECK ( makeR6FileKey ( "wrong", "user", key, &ownerOk ));
+	CHECK ( sameBytes ( key, expected ));
+	CHECK ( !ownerOk );
+
+	CHECK ( !makeR6FileKey ( "wrong", "wrong", key, &ownerOk ));
+	CHECK ( !makeR6FileKey ( NULL, NULL, key, &ownerOk ));
+
+	delete key;
+	delete expected;
+}
+
+//------------------------------------------------------------------------
+
+// The Info Title and the FNV-1a hash of every decoded stream, in
+// object order.
+static unsigned docHash ( PDFDoc *doc, GString *title )
+{
+	XRef *xref = doc-> getXRef ( );
+	unsigned h = 2166136261u;
+	XRefEntry *e;
+	Object obj, info;
+	int c;
+
+	for ( int num = 0; num < xref-> getNumObjects ( ); ++num ) {
+		if ( !( e = xref-> getEntry ( num )) || e-> type == xrefEntryFree )
+			continue;
+		xref-> fetch ( num, e-> type == xrefEntryCompressed ? 0 : e-> gen, &obj );
+		if ( obj. isStream ( )) {
+			obj. streamReset ( );
+			while (( c = obj. streamGetChar ( )) != EOF )
+				h = ( h ^ (Guchar) c ) * 16777619;
+			obj. streamClose ( );
+		}
+		obj. free ( );
+	}
+
+	title-> clear ( );
+	if ( doc-> getDocInfo ( &info )-> isDict ( )) {
+		info. dictLookup ( "Title", &obj );
+		if ( obj. isString ( ))
+			title-> append ( obj. getString ( ));
+		obj. free ( );
+	}
+	info. free ( );
+	return h;
+}
+
+TEST ( cryptDocumentsMatchPlain )
+{
+	static struct {
+		const char *name, *userPW;
+	} docs[] = {
+		{ "rc4.pdf", NULL },		// RC4 128-bit, revision 3
+		{ "aes128.pdf", NULL },		// AESV2, revision 4
+		{ "aes256.pdf", "user" },	// AESV3, revision 6
+		{ "identity.pdf", NULL },	// StmF /Identity, StrF AESV2
+	};
+	GString *plainTitle = new GString ( ), *title = new GString ( );
+	PDFDoc *plain = testOpenDoc ( "plain.pdf" );
+
+	if ( !plain ) {
+		delete plainTitle;
+		delete title;
+		return;
+	}
+	unsigned plainHash = docHash ( plain, plainTitle );
+	CHECK ( !plainTitle-> cmp ( "Encryption test document" ));
+
+	for ( int i = 0; i < (int) ( sizeof ( docs ) / sizeof ( docs[0] )); ++i ) {
+		PDFDoc *doc = testOpenDoc ( docs[i]. name, docs[i]. userPW );
+		if ( !doc )
+			continue;
+		CHECK_MSG ( doc-> isEncrypted ( ), "%s: not encrypted", docs[i]. name );
+		CHECK_MSG ( doc-> getNumPages ( ) == plain-> getNumPages ( ),
+		            "%s: %d pages", docs[i]. name, doc-> getNumPages ( ));
+		CHECK_MSG ( docHash ( doc, title ) == plainHash,
+		            "%s: streams differ from plain.pdf", docs[i]. name );
+		CHECK_MSG ( !title-> cmp ( plainTitle ), "%s: title \"%s\"",
+		            docs[i]. name, title-> getCString ( ));
+		delete doc;
+	}
+	delete plain;
+	delete plainTitle;
+	delete title;
+}
+
+// Wrong passwords must not open the document.
+TEST ( cryptWrongPassword )
+{
+	GString *path = testDataPath ( "aes256.pdf" );
+	PDFDoc *doc = new PDFDoc ( path );
+
+	CHECK ( !doc-> isOk ( ));
+	delete doc;
+	GString *pw = new GString ( "wrong" );
+	doc = new PDFDoc ( testDataPath ( "aes256.pdf" ), pw, pw );
+	CHECK ( !doc-> isOk ( ));
+	delete doc;
+	delete pw;
+}
+
+// With StmF /Identity the streams are stored as they are: they get no
+// decryptor, while the strings (StrF) are still decrypted.
+TEST ( cryptIdentityFilter )
+{
+	PDFDoc *doc = testOpenDoc ( "identity.pdf" );
+	XRef *xref;
+	XRefEntry *e;
+	Object obj;
+	int nStreams = 0;
+
+	if ( !doc )
+		return;
+	xref = doc-> getXRef ( );
+	for ( int num = 0; num < xref-> getNumObjects ( ); ++num ) {
+		if ( !( e = xref-> getEntry ( num )) || e-> type == xrefEntryFree )
+			continue;
+		xref-> fetch ( num, e-> type == xrefEntryCompressed ? 0 : e-> gen, &obj );
+		if ( obj. isStream ( )) {
+			CHECK_MSG ( !obj. getStream ( )-> getBaseStream ( )-> getDecrypt ( ),
+			            "object %d: stream has a decryptor", num );
+			++nStreams;
+		}
+		obj. free ( );
+	}
+	CHECK ( nStreams > 0 );
+	delete doc;
+}
@@ -0,0 +1,148 @@
+// DCTStream: the SSE2 and AVX2 inner loops must give exactly the same
+// bytes as the scalar ones, for every kind of JPEG and for damaged
+// ones, and the scalar ones the same bytes as the original decoder.
+
+#include <string.h>
+
+#include "goo/gmem.h"
+#include "xpdf/Object.h"
+#include "xpdf/Stream.h"
+#include "test.h"
+
+// data/*.jpg, made with libjpeg: the sampling factors, colour
+// transforms, restart intervals, progressive mode and quantizer
+// extremes the decoder handles differently.  <hash> is the FNV-1a hash
+// of the full size output of the original (pre-SIMD) decoder; it
+// didn't read progressive files, so prog420.jpg's is that of the
+// scalar kernel when they were added.
+static struct {
+	const char *name;
+	int width, height, comps;
+	Guint hash;
+} dctImages[] = {
+	{ "gray.jpg", 61, 47, 1, 0xfe11058d },
+	{ "ycc444.jpg", 64, 48, 3, 0x558e2866 },
+	{ "ycc420.jpg", 61, 47, 3, 0x05cc44d9 },	// restart interval 3
+	{ "ycc422.jpg", 80, 40, 3, 0x116a58a0 },
+	{ "ycc440.jpg", 40, 80, 3, 0xda498ea0 },
+	{ "ycc411.jpg", 96, 32, 3, 0xedfbfa6f },
+	{ "rgb.jpg", 48, 48, 3, 0xfe1fe97d },	// no colour transform
+	{ "cmyk.jpg", 40, 40, 4, 0x406743fc },
+	{ "ycck.jpg", 40, 40, 4, 0x10497a43 },
+	{ "prog420.jpg", 64, 64, 3, 0xfc3b4f25 },
+	{ "q100.jpg", 48, 48, 3, 0x2b004eb9 },
+	{ "q5.jpg", 48, 48, 3, 0xb93b78f3 },
+	{ "wide.jpg", 331, 67, 3, 0x48443da8 },	// restart interval 5
+};
+
+#define nDCTImages ( (int) ( sizeof ( dctImages ) / sizeof ( dctImages[0] )))
+
+// Decode <buf> with the current kernel at 1/<scale> size.  Returns the
+// output (allocated with gmalloc) and its length.
+static char *dctDecode ( char *buf, int length, int scale, int *outLength )
+{
+	Object dict;
+	char *out = NULL;
+	int n, size = 0;
+
+	dict. initNull ( );
+	DCTStream *str = new DCTStream ( new MemStream ( buf, length, &dict ));
+	str-> setScale ( scale );
+	str-> reset ( );
+	*outLength = 0;
+	do {
+		if ( *outLength + 4096 > size ) {
+			size = 2 * size + 4096;
+			out = (char *) grealloc ( out, size );
+		}
+		n = str-> getBlock ( out + *outLength, 4096 );
+		*outLength += n;
+	} while ( n > 0 );
+	delete str;
+	return out;
+}
+
+static Guint hashBytes ( char *p, int n )
+{
+	Guint h = 2166136261u;
+
+	for ( int i = 0; i < n; ++i )
+		h = ( h ^ (Guchar) p[i] ) * 16777619u;
+	return h;
+}
+
+// Decode with each kernel the CPU has and compare with scalar, and
+// scalar with <hash> if it isn't 0.
+static void checkKernels ( const char *name, char *buf, int length,
+                           int scale, int expected, Guint hash )
+{
+	static const char *kernelNames[] = { "auto", "scalar", "sse2", "avx2" };
+	char *ref, *out;
+	int refLength, outLength;
+
+	DCTStream::setKernel ( dctKernelScalar );
+	ref = dctDecode ( buf, length, scale, &refLength );
+	if ( expected >= 0 )
+		CHECK_MSG ( refLength == expected, "%s 1/%d: %d bytes, expected %d",
+		            name, scale, refLength, expected );
+	if ( hash )
+		CHECK_MSG ( hashBytes ( ref, refLength ) == hash, "%s 1/%d: output hash %08x, expected %08x",
+		            name, scale, hashBytes ( ref, refLength ), hash );
+	for ( int k = dctKernelSSE2; k <= dctKernelAVX2; ++k ) {
+		if ( !DCTStream::setKernel ( (DCTKernel) k ))
+			continue;
+		out = dctDecode ( buf, length, scale, &outLength );
+		CHECK_MSG ( outLength == refLength && !memcmp ( out, ref, refLength ),
+		            "%s 1/%d: %s output differs from scalar", name, scale,
+		            kernelNames[k] );
+		gfree ( out );
+	}
+	DCTStream::setKernel ( dctKernelAuto );
+	gfree ( ref );
+}
+
+TEST ( dctKernelsMatchScalar )
+{
+	static int scales[] = { 1, 2, 8 };
+
+	for ( int i = 0; i < nDCTImages; ++i ) {
+		int length;
+		char *buf = testReadData ( dctImages[i]. name, &length );
+		if ( !buf )
+			continue;
+		for ( unsigned s = 0; s < sizeof ( scales ) / sizeof ( int ); ++s ) {
+			int scale = scales[s];
+			int w = ( dctImages[i]. width + scale - 1 ) / scale;
+			int h = ( dctImages[i]. height + scale - 1 ) / scale;
+			checkKernels ( dctImages[i]. name, buf, length, scale,
+			               w * h * dctImages[i]. comps,
+			               scale == 1 ? dctImages[i]. hash : 0 );
+		}
+		gfree ( buf );
+	}
+}
+
+// Damaged entropy-coded data takes the decoder's error paths, which
+// must not depend on the kernel either.
+TEST ( dctKernelsMatchScalarOnDamagedData )
+{
+	for ( int i = 0; i < nDCTImages; ++i ) {
+		int length;
+		char *buf = testReadData ( dctImages[i]. name, &length );
+		if ( !buf )
+			continue;
+		char *bad = (char *) gmalloc ( length );
+		for ( int m = 1; m <= 8; ++m ) {
+			memcpy ( bad, buf, length );
+			// flip bits in the second half of the file, which is
+			// mostly scan data
+			for ( int j = 0; j < m; ++j )
+				bad[length / 2 + ( j * 97 + m * 31 ) % ( length / 2 )] ^= 1 << ( j % 8 );
+			checkKernels ( dctImages[i]. name, bad, length, 1, -1, 0 );
+		}
+		// and truncated data
+		checkKernels ( dctImages[i]. name, buf, length * 3 / 4, 1, -1, 0 );
+		gfree ( bad );
+		gfree ( buf );
+	}
+}
@@ -0,0 +1,121 @@
+// Page display lists saved in the document structure cache: a page
+// drawn twice has its list saved, and the next time the file is opened
+// the page is drawn from it, the same as from its content stream.  A
+// saved list that fails Gfx's checks is not used.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "goo/GString.h"
+#include "xpdf/Object.h"
+#include "xpdf/GfxState.h"
+#include "xpdf/OutputDev.h"
+#include "xpdf/GlobalParams.h"
+#include "xpdf/DisplayList.h"
+#include "xpdf/DocCache.h"
+#include "xpdf/XRef.h"
+#include "xpdf/PDFDoc.h"
+#include "test.h"
+
+// Hashes the paths, colors and characters drawn.
+class HashDev : public OutputDev
+{
+public:
+	HashDev ( ) { h = 2166136261u; }
+	virtual GBool upsideDown ( ) { return gTrue; }
+	virtual GBool useDrawChar ( ) { return gTrue; }
+	virtual GBool interpretType3Chars ( ) { return gFalse; }
+	virtual void stroke ( GfxState *state ) { mix ( 1 ); mixPath ( state ); }
+	virtual void fill ( GfxState *state ) { mix ( 2 ); mixFill ( state ); }
+	virtual void eoFill ( GfxState *state ) { mix ( 3 ); mixFill ( state ); }
+	virtual void drawChar ( GfxState *, fouble x, fouble y, fouble, fouble,
+	                        fouble, fouble, CharCode code, Unicode *, int )
+		{ mix ( code ); mix ( (int) x ); mix ( (int) y ); }
+
+	unsigned h;
+
+private:
+	void mix ( int x ) { h = ( h ^ (unsigned) x ) * 16777619; }
+	void mixFill ( GfxState *state )
+	{
+		GfxRGB rgb;
+		state-> getFillRGB ( &rgb );
+		mix ( (int) ( rgb. r * 255 )); mix ( (int) ( rgb. g * 255 )); mix ( (int) ( rgb. b * 255 ));
+		mixPath ( state );
+	}
+	void mixPath ( GfxState *state )
+	{
+		GfxPath *path = state-> getPath ( );
+		for ( int i = 0; i < path-> getNumSubpaths ( ); ++i ) {
+			GfxSubpath *sub = path-> getSubpath ( i );
+			for ( int j = 0; j < sub-> getNumPoints ( ); ++j ) {
+				mix ( (int) sub-> getX ( j ));
+				mix ( (int) sub-> getY ( j ));
+			}
+		}
+	}
+};
+
+static unsigned drawPage ( PDFDoc *doc, int pg )
+{
+	HashDev dev;
+
+	doc-> displayPage ( &dev, pg, 72, 0, gFalse );
+	return dev. h;
+}
+
+TEST ( displayListSavedAndReplayed )
+{
+	char dir[] = "/tmp/epdf-test-XXXXXX";
+	unsigned ref, h;
+	PDFDoc *doc;
+
+	if ( !CHECK ( mkdtemp ( dir ) != NULL ))
+		return;
+	globalParams-> setDocCache ( gTrue );
+	globalParams-> setDocCacheDir ( dir );
+
+	// first drawing: nothing recorded
+	doc = new PDFDoc ( testDataPath ( "plain.pdf" ));
+	if ( CHECK ( doc-> isOk ( ) && doc-> getXRef ( )-> getDocCache ( ))) {
+		DisplayListCache *lists = doc-> getXRef ( )-> getPageListCache ( );
+		ref = drawPage ( doc, 1 );
+		CHECK_MSG ( lists-> getBytes ( ) == 0, "%d bytes of lists after one drawing",
+		            lists-> getBytes ( ));
+		// second drawing: recorded and saved
+		CHECK ( drawPage ( doc, 1 ) == ref );
+		CHECK ( lists-> getBytes ( ) > 0 );
+		CHECK ( drawPage ( doc, 1 ) == ref );
+	}
+	delete doc;
+
+	// reopened: the first drawing is from the saved list
+	doc = new PDFDoc ( testDataPath ( "plain.pdf" ));
+	if ( CHECK ( doc-> isOk ( ))) {
+		h = drawPage ( doc, 1 );
+		CHECK_MSG ( h == ref, "saved list draws %08x, contents %08x", h, ref );
+		CHECK_MSG ( doc-> getXRef ( )-> getPageListCache ( )-> getBytes ( ) > 0,
+		            "saved list not used" );
+
+		// replace it with a list that calls an operator Gfx doesn't have
+		DisplayList *bad = new DisplayList ( );
+		bad-> addOp ( 100000, NULL, 0 );
+		doc-> getXRef ( )-> getDocCache ( )-> writePageList ( 1, bad );
+		delete bad;
+	}
+	delete doc;
+
+	// reopened: the bad list is refused, and the page drawn from its
+	// contents
+	doc = new PDFDoc ( testDataPath ( "plain.pdf" ));
+	if ( CHECK ( doc-> isOk ( ))) {
+		h = drawPage ( doc, 1 );
+		CHECK_MSG ( h == ref, "page draws %08x after a bad list, expected %08x", h, ref );
+		CHECK ( doc-> getXRef ( )-> getPageListCache ( )-> getBytes ( ) == 0 );
+	}
+	delete doc;
+
+	globalParams-> setDocCache ( gFalse );
+	testRemoveDir ( dir );
+}
@@ -0,0 +1,55 @@
+// The document structure cache: the first time a file is opened its
+// whole page tree is read and saved; the next time the pages come from
+// the cache.  data/badcount.pdf has a wrong top-level /Count, so the
+// saved page count is the one found in the tree.  A linearized file
+// which isn't in the cache is read through its hint table.
+
+#include <stdlib.h>
+
+#include "goo/GString.h"
+#include "xpdf/Object.h"
+#include "xpdf/GlobalParams.h"
+#include "xpdf/DocCache.h"
+#include "xpdf/XRef.h"
+#include "xpdf/Catalog.h"
+#include "xpdf/PDFDoc.h"
+#include "test.h"
+
+TEST ( docCachePages )
+{
+	char dir[] = "/tmp/epdf-test-XXXXXX";
+	PDFDoc *doc;
+
+	if ( !CHECK ( mkdtemp ( dir ) != NULL ))
+		return;
+	globalParams-> setDocCache ( gTrue );
+	globalParams-> setDocCacheDir ( dir );
+
+	for ( int pass = 0; pass < 2; ++pass ) {
+		doc = new PDFDoc ( testDataPath ( "badcount.pdf" ));
+		if ( CHECK ( doc-> isOk ( ) && doc-> getXRef ( )-> getDocCache ( ))) {
+			CHECK_MSG ( doc-> getXRef ( )-> getDocCache ( )-> isLoaded ( ) == ( pass == 1 ),
+			            "pass %d: cache %sloaded", pass,
+			            pass == 1 ? "not " : "" );
+			CHECK_MSG ( doc-> getNumPages ( ) == 2, "pass %d: %d pages", pass,
+			            doc-> getNumPages ( ));
+			CHECK ( (int) doc-> getPageWidth ( 1 ) == 200 );
+			CHECK ( (int) doc-> getPageWidth ( 2 ) == 300 );
+		}
+		delete doc;
+	}
+
+	// the linearized file is opened the same way twice: it isn't saved
+	for ( int pass = 0; pass < 2; ++pass ) {
+		doc = new PDFDoc ( testDataPath ( "lin.pdf" ));
+		if ( CHECK ( doc-> isOk ( ))) {
+			CHECK ( doc-> getNumPages ( ) == 40 );
+			CHECK ( !doc-> getXRef ( )-> getDocCache ( )-> isLoaded ( ));
+			CHECK ( doc-> getCatalog ( )-> getPageRef ( 40 )-> num > 0 );
+		}
+		delete doc;
+	}
+
+	globalParams-> setDocCache ( gFalse );
+	testRemoveDir ( dir );
+}
@@ -0,0 +1,45 @@
+// Linearized files: pages found through the hint table, and through
+// the page tree when the hint table is bad, must be the pages of the
+// unlinearized copy.  data/lin.pdf is a 40-page linearized file,
+// linplain.pdf the same objects with a plain xref table, and
+// linbadhint.pdf lin.pdf with the start of its hint stream overwritten.
+
+#include "goo/GString.h"
+#include "xpdf/Object.h"
+#include "xpdf/Catalog.h"
+#include "xpdf/PDFDoc.h"
+#include "test.h"
+
+// Compare the page object IDs of <name> with those of linplain.pdf.
+// Pages are looked up last first, so the hint table (or the fallback)
+// is used rather than a walk that has already passed them.
+static void checkPageRefs ( const char *name )
+{
+	PDFDoc *plain = testOpenDoc ( "linplain.pdf" );
+	PDFDoc *doc = testOpenDoc ( name );
+
+	if ( plain && doc ) {
+		int nPages = plain-> getNumPages ( );
+		CHECK_MSG ( doc-> getNumPages ( ) == nPages, "%s: %d pages, expected %d",
+		            name, doc-> getNumPages ( ), nPages );
+		for ( int pg = nPages; pg >= 1 && pg <= doc-> getNumPages ( ); --pg ) {
+			Ref *ref = doc-> getCatalog ( )-> getPageRef ( pg );
+			Ref *expected = plain-> getCatalog ( )-> getPageRef ( pg );
+			CHECK_MSG ( ref-> num == expected-> num && ref-> gen == expected-> gen,
+			            "%s: page %d is %d %d R, expected %d %d R", name, pg,
+			            ref-> num, ref-> gen, expected-> num, expected-> gen );
+		}
+	}
+	delete doc;
+	delete plain;
+}
+
+TEST ( linPagesMatchPlain )
+{
+	checkPageRefs ( "lin.pdf" );
+}
+
+TEST ( linBadHintTableFallsBack )
+{
+	checkPageRefs ( "linbadhint.pdf" );
+}
@@ -0,0 +1,57 @@
+// The name table: a dictionary lookup of a name that was never interned,
+// or whose key failed to intern, finds nothing, and names interned
+// while a document is open go away when the last document is closed.
+
+#include <stdio.h>
+
+#include "goo/gmem.h"
+#include "goo/GString.h"
+#include "xpdf/Object.h"
+#include "xpdf/PDFDoc.h"
+#include "test.h"
+
+TEST ( namesUnknownKeysMatchNothing )
+{
+	Object dict, obj;
+
+	// one small dictionary (searched by string), one large one (indexed)
+	for ( int n = 2; n <= 40; n += 38 ) {
+		dict. initDict ( (XRef *) NULL );
+		for ( int i = 0; i < n; ++i ) {
+			char key[16];
+			sprintf ( key, "K%d", i );
+			obj. initInt ( i );
+			dict. dictAdd ( copyString ( key ), &obj );
+		}
+		obj. initInt ( -1 );
+		dict. dictAdd ( atomNone, &obj );
+
+		CHECK ( dict. dictLookup ( "K1", &obj )-> isInt ( ) && obj. getInt ( ) == 1 );
+		obj. free ( );
+		CHECK_MSG ( dict. dictLookup ( "NotAKeyAnywhere", &obj )-> isNull ( ),
+		            "%d entries: unknown name found", n );
+		obj. free ( );
+		CHECK_MSG ( dict. dictLookup ( "", &obj )-> isNull ( ),
+		            "%d entries: empty name found", n );
+		obj. free ( );
+		CHECK ( dict. dictLookup ( atomNone, &obj )-> isNull ( ));
+		obj. free ( );
+		dict. free ( );
+	}
+}
+
+TEST ( namesRemovedWithLastDocument )
+{
+	PDFDoc *doc1, *doc2;
+	Object obj;
+
+	doc1 = new PDFDoc ( testDataPath ( "plain.pdf" ));
+	doc2 = new PDFDoc ( testDataPath ( "plain.pdf" ));
+	obj. initName ( "NameOnlyInTheseDocuments" );
+	obj. free ( );
+	delete doc1;
+	CHECK ( NameTable::find ( "NameOnlyInTheseDocuments" ) != atomNone );
+	delete doc2;
+	CHECK ( NameTable::find ( "NameOnlyInTheseDocuments" ) == atomNone );
+	CHECK ( NameTable::find ( "MediaBox" ) == atomMediaBox );
+}
@@ -0,0 +1,32 @@
+// Object streams: data/objstm.pdf keeps its catalog and page tree in an
+// object stream.  The others are broken on purpose and must fail to
+// open rather than crash: objstmself.pdf has an object stream whose
+// /Length is an object of the same stream, objstmcycle.pdf two streams
+// whose lengths are in each other, and objstmbign.pdf an /N far larger
+// than its header.
+
+#include "goo/GString.h"
+#include "xpdf/Object.h"
+#include "xpdf/PDFDoc.h"
+#include "test.h"
+
+TEST ( objStmOpens )
+{
+	PDFDoc *doc = new PDFDoc ( testDataPath ( "objstm.pdf" ));
+
+	CHECK ( doc-> isOk ( ) && doc-> getNumPages ( ) == 1 );
+	delete doc;
+}
+
+TEST ( objStmBrokenFilesFail )
+{
+	static const char *names[] = {
+		"objstmself.pdf", "objstmcycle.pdf", "objstmbign.pdf"
+	};
+
+	for ( int i = 0; i < (int) ( sizeof ( names ) / sizeof ( names[0] )); ++i ) {
+		PDFDoc *doc = new PDFDoc ( testDataPath ( names[i] ));
+		CHECK_MSG ( !doc-> isOk ( ), "%s: opened", names[i] );
+		delete doc;
+	}
+}
@@ -0,0 +1,394 @@
+// Tiling patterns drawn from a cached tile: the cell is drawn once per
+// fill when the device takes tiles, and at every step when it can't,
+// and the two look the same.  data/pattern.pdf has four pages of four
+// pattern fills each: an axis-aligned cell, a rotated one, a scaled
+// uncoloured (PaintType 2) one, and one whose BBox is larger than its
+// step, which can't be tiled.
+
+#include <string.h>
+#include <math.h>
+
+#include "goo/gmem.h"
+#include "goo/GString.h"
+#include "xpdf/Object.h"
+#include "xpdf/GfxState.h"
+#include "xpdf/OutputDev.h"
+#include "xpdf/PDFDoc.h"
+#include "test.h"
+
+// Counts fills and tiles; takes tiles if <tiles> is set.
+class PatternTestDev : public OutputDev
+{
+public:
+	PatternTestDev ( GBool tilesA ) { tiles = tilesA; nFills = nTiles = 0; }
+	virtual GBool upsideDown ( ) { return gTrue; }
+	virtual GBool useDrawChar ( ) { return gTrue; }
+	virtual GBool interpretType3Chars ( ) { return gFalse; }
+	virtual GBool useTilingPatternCache ( ) { return tiles; }
+	virtual GBool beginPatternTile ( GfxState *, int, int ) { ++nTiles; return gTrue; }
+	virtual void fill ( GfxState * ) { ++nFills; }
+	virtual void eoFill ( GfxState * ) { ++nFills; }
+
+	GBool tiles;
+	int nFills, nTiles;
+};
+
+TEST ( patternTileDrawnOncePerFill )
+{
+	// fills of one cell: four rectangles, or two for PaintType 2
+	static int cellFills[] = { 4, 4, 2, 4 };
+	PDFDoc *doc = new PDFDoc ( testDataPath ( "pattern.pdf" ));
+
+	if ( !CHECK ( doc-> isOk ( ) && doc-> getNumPages ( ) == 4 )) {
+		delete doc;
+		return;
+	}
+	for ( int pg = 1; pg <= 4; ++pg ) {
+		PatternTestDev steps ( gFalse ), tiles ( gTrue );
+
+		doc-> displayPage ( &steps, pg, 72, 0, gFalse );
+		doc-> displayPage ( &tiles, pg, 72, 0, gFalse );
+		CHECK_MSG ( steps. nTiles == 0, "page %d: tiles without the cache", pg );
+		CHECK_MSG ( steps. nFills > 100 * 4 * cellFills[pg - 1],
+		            "page %d: %d fills drawing every step", pg, steps. nFills );
+		if ( pg < 4 ) {
+			CHECK_MSG ( tiles. nTiles == 4 && tiles. nFills == 4 * cellFills[pg - 1],
+			            "page %d: %d tiles, %d fills", pg, tiles. nTiles, tiles. nFills );
+		} else {
+			// BBox larger than the step: drawn a cell at a time
+			CHECK_MSG ( tiles. nTiles == 0 && tiles. nFills == steps. nFills,
+			            "page %d: %d tiles, %d fills, expected %d", pg,
+			            tiles. nTiles, tiles. nFills, steps. nFills );
+		}
+	}
+	delete doc;
+}
+
+//------------------------------------------------------------------------
+// A small rasterizer, to compare the drawn pages.  Paths are filled at
+// pixel centres, with curves drawn as their control polygons (the
+// pattern cells have none); clips are kept as coverage masks.
+//------------------------------------------------------------------------
+
+// Pixels covered by a path (or a clip), within its bounding box.
+struct RasterMask
+{
+	int x0, y0, w, h;
+	unsigned char *data;
+	int ref;
+
+	GBool at ( int x, int y )
+	{
+		x -= x0;
+		y -= y0;
+		return x >= 0 && y >= 0 && x < w && y < h && data[y * w + x];
+	}
+};
+
+static void releaseMask ( RasterMask *mask )
+{
+	if ( mask && --mask-> ref == 0 ) {
+		gfree ( mask-> data );
+		delete mask;
+	}
+}
+
+// Pixels, and the clip stack.  A NULL mask is the whole surface.
+struct RasterSurface
+{
+	int w, h;
+	unsigned *px;			// 0 = nothing drawn (in a tile)
+	RasterMask **clips;
+	int nClips;
+};
+
+class RasterDev : public OutputDev
+{
+public:
+	RasterDev ( GBool tilesA, GBool upsideDownA )
+	{
+		tiles = tilesA;
+		upside = upsideDownA;
+		page. px = tile. px = NULL;
+		page. clips = tile. clips = NULL;
+		page. nClips = tile. nClips = 0;
+		cur = &page;
+		nTiles = 0;
+		color = 0;
+	}
+	~RasterDev ( ) { freeSurface ( &page ); freeSurface ( &tile ); }
+
+	virtual GBool upsideDown ( ) { return upside; }
+	virtual GBool useDrawChar ( ) { return gTrue; }
+	virtual GBool interpretType3Chars ( ) { return gFalse; }
+	virtual GBool useTilingPatternCache ( ) { return tiles; }
+
+	virtual void startPage ( int, GfxState *state )
+	{
+		initSurface ( &page, (int) state-> getPageWidth ( ) + 1,
+		              (int) state-> getPageHeight ( ) + 1, 0xffffff );
+		cur = &page;
+	}
+	virtual void saveState ( GfxState * )
+	{
+		RasterMask *mask = cur-> clips[cur-> nClips - 1];
+
+		if ( mask )
+			++mask-> ref;
+		cur-> clips = (RasterMask **) grealloc ( cur-> clips, ( cur-> nClips + 1 ) * sizeof ( RasterMask * ));
+		cur-> clips[cur-> nClips++] = mask;
+	}
+	virtual void restoreState ( GfxState * )
+	{
+		if ( cur-> nClips > 1 )
+			releaseMask ( cur-> clips[--cur-> nClips] );
+	}
+	virtual void updateFillColor ( GfxState *state )
+	{
+		GfxRGB rgb;
+
+		state-> getFillRGB ( &rgb );
+		color = 0x1000000 | ( toByte ( rgb. r ) << 16 ) | ( toByte ( rgb. g ) << 8 ) | toByte ( rgb. b );
+	}
+	virtual void fill ( GfxState *state ) { doFill ( state, gFalse, NULL ); }
+	virtual void eoFill ( GfxState *state ) { doFill ( state, gTrue, NULL ); }
+	virtual void clip ( GfxState *state ) { doClip ( state, gFalse ); }
+	virtual void eoClip ( GfxState *state ) { doClip ( state, gTrue ); }
+
+	virtual GBool beginPatternTile ( GfxState *, int tileW, int tileH )
+	{
+		++nTiles;
+		initSurface ( &tile, tileW, tileH, 0 );
+		cur = &tile;
+		return gTrue;
+	}
+	virtual void endPatternTile ( GfxState *state, fouble *mat, GBool eoFill )
+	{
+		cur = &page;
+		doFill ( state, eoFill, mat );
+	}
+
+	RasterSurface page;
+	int nTiles;
+
+private:
+	static int toByte ( fouble x ) { return (int) ( x * 255 + 0.5 ); }
+
+	void initSurface ( RasterSurface *s, int w, int h, unsigned bg )
+	{
+		freeSurface ( s );
+		s-> w = w;
+		s-> h = h;
+		s-> px = (unsigned *) gmalloc ( w * h * sizeof ( unsigned ));
+		for ( int i = 0; i < w * h; ++i )
+			s-> px[i] = bg;
+		s-> clips = (RasterMask **) gmalloc ( sizeof ( RasterMask * ));
+		s-> clips[0] = NULL;
+		s-> nClips = 1;
+	}
+	void freeSurface ( RasterSurface *s )
+	{
+		for ( int i = 0; i < s-> nClips; ++i )
+			releaseMask ( s-> clips[i] );
+		gfree ( s-> clips );
+		gfree ( s-> px );
+		s-> clips = NULL;
+		s-> px = NULL;
+		s-> nClips = 0;
+	}
+
+	// The pixels of the current surface whose centres are inside the
+	// current path, and the current clip.
+	RasterMask *scan ( GfxState *state, GBool eo )
+	{
+		GfxPath *path = state-> getPath ( );
+		RasterMask *clipMask = cur-> clips[cur-> nClips - 1];
+		RasterMask *mask = new RasterMask;
+		double *xs, *ys, *cross;
+		int *dir;
+		int n = 0, nPts = 0;
+		double yMin = 1e30, yMax = -1e30, xMin = 1e30, xMax = -1e30;
+
+		for ( int i = 0; i < path-> getNumSubpaths ( ); ++i )
+			nPts += path-> getSubpath ( i )-> getNumPoints ( ) + 1;
+		xs = (double *) gmalloc ( ( nPts + 1 ) * sizeof ( double ));
+		ys = (double *) gmalloc ( ( nPts + 1 ) * sizeof ( double ));
+		cross = (double *) gmalloc ( ( nPts + 1 ) * sizeof ( double ));
+		dir = (int *) gmalloc ( ( nPts + 1 ) * sizeof ( int ));
+
+		// edges: consecutive points, each subpath closed
+		int *subStart = (int *) gmalloc (( path-> getNumSubpaths ( ) + 1 ) * sizeof ( int ));
+		for ( int i = 0; i < path-> getNumSubpaths ( ); ++i ) {
+			GfxSubpath *sub = path-> getSubpath ( i );
+			subStart[i] = n;
+			for ( int j = 0; j < sub-> getNumPoints ( ); ++j ) {
+				fouble x, y;
+				state-> transform ( sub-> getX ( j ), sub-> getY ( j ), &x, &y );
+				xs[n] = x;
+				ys[n] = y;
+				if ( xs[n] < xMin ) xMin = xs[n];
+				if ( xs[n] > xMax ) xMax = xs[n];
+				if ( ys[n] < yMin ) yMin = ys[n];
+				if ( ys[n] > yMax ) yMax = ys[n];
+				++n;
+			}
+		}
+		subStart[path-> getNumSubpaths ( )] = n;
+
+		mask-> x0 = xMin < 0 ? 0 : (int) xMin;
+		mask-> y0 = yMin < 0 ? 0 : (int) yMin;
+		mask-> w = ( xMax + 1 > cur-> w ? cur-> w : (int) xMax + 1 ) - mask-> x0;
+		mask-> h = ( yMax + 1 > cur-> h ? cur-> h : (int) yMax + 1 ) - mask-> y0;
+		if ( mask-> w < 0 || n == 0 )
+			mask-> w = 0;
+		if ( mask-> h < 0 || n == 0 )
+			mask-> h = 0;
+		mask-> data = (unsigned char *) gmalloc ( mask-> w * mask-> h + 1 );
+		memset ( mask-> data, 0, mask-> w * mask-> h );
+		mask-> ref = 1;
+
+		for ( int y = mask-> y0; y < mask-> y0 + mask-> h; ++y ) {
+			double cy = y + 0.5;
+			int nCross = 0;
+
+			for ( int i = 0; i < path-> getNumSubpaths ( ); ++i ) {
+				for ( int j = subStart[i]; j < subStart[i + 1]; ++j ) {
+					int k = j + 1 < subStart[i + 1] ? j + 1 : subStart[i];
+					if (( ys[j] <= cy ) != ( ys[k] <= cy )) {
+						cross[nCross] = xs[j] + ( cy - ys[j] ) * ( xs[k] - xs[j] ) / ( ys[k] - ys[j] );
+						dir[nCross++] = ys[j] < ys[k] ? 1 : -1;
+					}
+				}
+			}
+			// insertion sort of the crossings
+			for ( int i = 1; i < nCross; ++i ) {
+				for ( int j = i; j > 0 && cross[j - 1] > cross[j]; --j ) {
+					double t = cross[j]; cross[j] = cross[j - 1]; cross[j - 1] = t;
+					int d = dir[j]; dir[j] = dir[j - 1]; dir[j - 1] = d;
+				}
+			}
+			int wind = 0;
+			for ( int i = 0; i + 1 < nCross; ++i ) {
+				wind += dir[i];
+				if ( eo ? !( i & 1 ) : wind == 0 )
+					continue;
+				for ( int x = mask-> x0; x < mask-> x0 + mask-> w; ++x ) {
+					double cx = x + 0.5;
+					if ( cx >= cross[i] && cx < cross[i + 1] &&
+					     ( !clipMask || clipMask-> at ( x, y )))
+						mask-> data[( y - mask-> y0 ) * mask-> w + x - mask-> x0] = 1;
+				}
+			}
+		}
+		gfree ( subStart );
+		gfree ( xs );
+		gfree ( ys );
+		gfree ( cross );
+		gfree ( dir );
+		return mask;
+	}
+
+	// Fill with the fill color, or with the tile mapped by <mat>
+	// (tile space -> device space) and repeated.
+	void doFill ( GfxState *state, GBool eo, fouble *mat )
+	{
+		RasterMask *mask = scan ( state, eo );
+		double im[6], det;
+
+		if ( mat ) {
+			det = (double) mat[0] * mat[3] - (double) mat[1] * mat[2];
+			im[0] = mat[3] / det;
+			im[1] = -mat[1] / det;
+			im[2] = -mat[2] / det;
+			im[3] = mat[0] / det;
+			im[4] = ( (double) mat[2] * mat[5] - (double) mat[3] * mat[4] ) / det;
+			im[5] = ( (double) mat[1] * mat[4] - (double) mat[0] * mat[5] ) / det;
+		}
+		for ( int y = mask-> y0; y < mask-> y0 + mask-> h; ++y ) {
+			for ( int x = mask-> x0; x < mask-> x0 + mask-> w; ++x ) {
+				unsigned c = color;
+				if ( !mask-> at ( x, y ))
+					continue;
+				if ( mat ) {
+					double cx = x + 0.5, cy = y + 0.5;
+					int tx = (int) floor ( cx * im[0] + cy * im[2] + im[4] ) % tile. w;
+					int ty = (int) floor ( cx * im[1] + cy * im[3] + im[5] ) % tile. h;
+					if ( tx < 0 )
+						tx += tile. w;
+					if ( ty < 0 )
+						ty += tile. h;
+					if ( !( c = tile. px[ty * tile. w + tx] ))
+						continue;
+				}
+				cur-> px[y * cur-> w + x] = c;
+			}
+		}
+		releaseMask ( mask );
+	}
+	void doClip ( GfxState *state, GBool eo )
+	{
+		RasterMask *mask = scan ( state, eo );
+
+		releaseMask ( cur-> clips[cur-> nClips - 1] );
+		cur-> clips[cur-> nClips - 1] = mask;
+	}
+
+	GBool tiles, upside;
+	RasterSurface tile, *cur;
+	unsigned color;
+};
+
+// Count the pixels of <a> with no pixel of the same color in <b> within
+// two pixels.  The cell is sampled twice on its way through a tile (and
+// the tile is a whole number of pixels, the step not), so its edges
+// may move by a pixel or two.
+static int countMisses ( RasterSurface *a, RasterSurface *b )
+{
+	int misses = 0;
+
+	for ( int y = 0; y < a-> h; ++y ) {
+		for ( int x = 0; x < a-> w; ++x ) {
+			unsigned c = a-> px[y * a-> w + x];
+			GBool found = gFalse;
+			for ( int dy = -2; !found && dy <= 2; ++dy ) {
+				for ( int dx = -2; !found && dx <= 2; ++dx ) {
+					int bx = x + dx, by = y + dy;
+					found = bx >= 0 && by >= 0 && bx < b-> w && by < b-> h &&
+					        b-> px[by * b-> w + bx] == c;
+				}
+			}
+			if ( !found )
+				++misses;
+		}
+	}
+	return misses;
+}
+
+TEST ( patternTileMatchesSteps )
+{
+	PDFDoc *doc = new PDFDoc ( testDataPath ( "pattern.pdf" ));
+
+	if ( !CHECK ( doc-> isOk ( ) && doc-> getNumPages ( ) == 4 )) {
+		delete doc;
+		return;
+	}
+	for ( int upside = 0; upside < 2; ++upside ) {
+		for ( int pg = 1; pg <= 4; ++pg ) {
+			RasterDev steps ( gFalse, upside ), tiles ( gTrue, upside );
+
+			doc-> displayPage ( &steps, pg, 72, 0, gFalse );
+			doc-> displayPage ( &tiles, pg, 72, 0, gFalse );
+			CHECK_MSG ( tiles. nTiles == ( pg < 4 ? 4 : 0 ),
+			            "page %d: %d tiles", pg, tiles. nTiles );
+			// slivers of cells cut by the edge of the fill may be lost
+			int misses = countMisses ( &tiles. page, &steps. page ) +
+			             countMisses ( &steps. page, &tiles. page );
+			int ink = 0;
+			for ( int i = 0; i < steps. page. w * steps. page. h; ++i )
+				ink += steps. page. px[i] != 0xffffff;
+			CHECK_MSG ( misses * 1000 <= ink, "page %d%s: %d of %d pixels differ",
+			            pg, upside ? "" : " (not upside down)", misses, ink );
+		}
+	}
+	delete doc;
+}
@@ -0,0 +1,38 @@
+# -------------------------------------------------
+# epdf-test: checks of the xpdf core that can't be seen in the viewer
+# (optimized code paths against the plain ones, crypto known answers).
+#   epdf-test [-d datadir] [test ...]
+# -------------------------------------------------
+include(../epdf.pri)
+
+TARGET = epdf-test
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+QT -= gui
+
+DEFINES += TEST_DATA_DIR=\\\"$$PWD/data\\\"
+INCLUDEPATH += ..
+
+SOURCES += main.cpp \
+	testcatalog.cpp \
+	testcolor.cpp \
+	testcrypt.cpp \
+	testdct.cpp \
+	testdisplaylist.cpp \
+	testdoccache.cpp \
+	testlin.cpp \
+	testnames.cpp \
+	testobjstm.cpp \
+	testpattern.cpp \
+	../gooStub.cpp \
+	../goo/*.cc \
+	../xpdf/*.cc
+
+HEADERS += test.h \
+	../aconf.h ../fixed.h ../UTF8.h \
+	../goo/*.h \
+	../xpdf/*.h
+
+DESTDIR	= $$BUILDDIR/app
+OBJECTS_DIR	= $$BUILDDIR/test-obj
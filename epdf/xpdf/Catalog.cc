@@ -12,6 +12,7 @@
 
 #include <aconf.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include "../goo/gmem.h"
 #include "../goo/GString.h"
 #include "Object.h"
@@ -21,24 +22,68 @@
 #include "Page.h"
 #include "Error.h"
 #include "Link.h"
+#include "DocCache.h"
+#include "Linearization.h"
 #include "Catalog.h"
 
+// Page trees nested deeper than this are assumed to contain a loop.
+#define maxPageTreeDepth 64
+
+//------------------------------------------------------------------------
+// PageRefEntry
+//------------------------------------------------------------------------
+
+struct PageRefEntry {
+  Ref ref;			// page object ID
+  int page;			// page number (1-based)
+};
+
+static int cmpPageRefEntries(const void *p1, const void *p2) {
+  const PageRefEntry *e1 = (const PageRefEntry *)p1;
+  const PageRefEntry *e2 = (const PageRefEntry *)p2;
+
+  if (e1->ref.num != e2->ref.num) {
+    return e1->ref.num < e2->ref.num ? -1 : 1;
+  }
+  return e1->page - e2->page;
+}
+
 //------------------------------------------------------------------------
 // Catalog
 //------------------------------------------------------------------------
 
-Catalog::Catalog(XRef *xrefA, GBool printCommands) {
+Catalog::Catalog(XRef *xrefA, GBool printCommandsA, DocCache *docCache,
+		 Linearization *linA) {
   Object catDict, pagesDict;
   Object obj, obj2;
-  int numPages0;
-  int i;
+  DocCachePage *info;
+  PDFRectangle *box;
+  XRefEntry *e;
+  int n, i;
 
   ok = gTrue;
   xref = xrefA;
   pages = NULL;
   pageRefs = NULL;
+  pageBoxes = NULL;
+  pageRotates = NULL;
   numPages = pagesSize = 0;
+  pagesRoot = (Object *)gmalloc(sizeof(Object));
+  pagesRoot->initNull();
+  lin = linA;
+  pageTreeRead = gFalse;
+  pageIndex = NULL;
+  pageIndexLen = 0;
+  printCommands = printCommandsA;
+  dests = (Object *)gmalloc(sizeof(Object));
+  dests->initNull();
+  names = (Object *)gmalloc(sizeof(Object));
+  names->initNull();
   baseURI = NULL;
+  metadata = (Object *)gmalloc(sizeof(Object));
+  metadata->initNull();
+  structTreeRoot = (Object *)gmalloc(sizeof(Object));
+  structTreeRoot->initNull();
 
   xref->getCatalog(&catDict);
   if (!catDict.isDict()) {
@@ -46,23 +91,37 @@ Catalog::Catalog(XRef *xrefA, GBool printCommands) {
     goto err1;
   }
 
+  // the page tree of a linearized file is at the end of the file, so
+  // it isn't read until a page other than the first one is needed;
+  // the page count comes from the linearization dictionary
+  if (lin) {
+    catDict.dictLookupNF("Pages", pagesRoot);
+    pagesSize = numPages = lin->getNumPages();
+
   // read page tree
-  catDict.dictLookup("Pages", &pagesDict);
-  // This should really be isDict("Pages"), but I've seen at least one
-  // PDF file where the /Type entry is missing.
-  if (!pagesDict.isDict()) {
-    error(-1, "Top-level pages object is wrong type (%s)",
-	  pagesDict.getTypeName());
-    goto err2;
-  }
-  pagesDict.dictLookup("Count", &obj);
-  if (!obj.isInt()) {
-    error(-1, "Page count in top-level pages object is wrong type (%s)",
-	  obj.getTypeName());
-    goto err3;
+  } else {
+    catDict.dictLookup("Pages", &pagesDict);
+    // This should really be isDict("Pages"), but I've seen at least one
+    // PDF file where the /Type entry is missing.
+    if (!pagesDict.isDict()) {
+      error(-1, "Top-level pages object is wrong type (%s)",
+	    pagesDict.getTypeName());
+      goto err2;
+    }
+    pagesDict.dictLookup(atomCount, &obj);
+    if (!obj.isInt() || obj.getInt() < 0) {
+      error(-1, "Page count in top-level pages object is wrong type (%s)",
+	    obj.getTypeName());
+      goto err3;
+    }
+    // pages are read on demand (see getPage)
+    pagesSize = numPages = obj.getInt();
+    obj.free();
+    if (docCache && docCache->isLoaded()) {
+      pagesSize = numPages = docCache->getNumPages();
+    }
+    *pagesRoot = pagesDict;
   }
-  pagesSize = numPages0 = obj.getInt();
-  obj.free();
   pages = (Page **)gmalloc(pagesSize * sizeof(Page *));
   pageRefs = (Ref *)gmalloc(pagesSize * sizeof(Ref));
   for (i = 0; i < pagesSize; ++i) {
@@ -70,23 +129,63 @@ Catalog::Catalog(XRef *xrefA, GBool printCommands) {
     pageRefs[i].num = -1;
     pageRefs[i].gen = -1;
   }
-  numPages = readPageTree(pagesDict.getDict(), NULL, 0, printCommands);
-  if (numPages != numPages0) {
-    error(-1, "Page count in top-level pages object is incorrect");
+
+  // the first page object is named in the linearization dictionary
+  if (lin && (e = xref->getEntry(lin->getFirstPageObjNum())) &&
+      e->type != xrefEntryFree) {
+    pageRefs[0].num = lin->getFirstPageObjNum();
+    pageRefs[0].gen = e->type == xrefEntryCompressed ? 0 : e->gen;
   }
-  pagesDict.free();
 
-  dests = (Object *)gmalloc(sizeof(Object));
-  // read named destination dictionary
-  catDict.dictLookup("Dests", dests);
-
-  nameTree = (Object *)gmalloc(sizeof(Object));
-  // read root of named destination tree
-  if (catDict.dictLookup("Names", &obj)->isDict())
-    obj.dictLookup("Dests", nameTree);
-  else
-    nameTree->initNull();
-  obj.free();
+  // the document structure cache has the object ID, box, and
+  // rotation of each page; if it wasn't loaded, read the whole page
+  // tree to fill it in (a linearized file's page tree is left unread,
+  // and the file isn't cached)
+  if (docCache && docCache->isLoaded()) {
+    info = docCache->getPages();
+    pageBoxes = (PDFRectangle *)gmalloc(numPages * sizeof(PDFRectangle));
+    pageRotates = (int *)gmalloc(numPages * sizeof(int));
+    for (i = 0; i < numPages; ++i) {
+      pageRefs[i] = info[i].ref;
+      pageBoxes[i].x1 = info[i].x1;
+      pageBoxes[i].y1 = info[i].y1;
+      pageBoxes[i].x2 = info[i].x2;
+      pageBoxes[i].y2 = info[i].y2;
+      pageRotates[i] = info[i].rotate;
+    }
+  } else if (docCache && !lin && numPages > 0 &&
+	     !xref->isReconstructed()) {
+    pageTreeRead = gTrue;
+    n = readPageTree(getPagesDict(), NULL, 0, 0);
+    if (n >= 0 && n != numPages) {
+      error(-1, "Page count in top-level pages object is incorrect");
+      numPages = n;
+    }
+    info = (DocCachePage *)gmalloc(numPages * sizeof(DocCachePage));
+    for (i = 0; n > 0 && i < numPages; ++i) {
+      if (!pages[i] || pageRefs[i].num < 0) {
+	break;
+      }
+      info[i].ref = pageRefs[i];
+      box = pages[i]->getBox();
+      info[i].x1 = box->x1;
+      info[i].y1 = box->y1;
+      info[i].x2 = box->x2;
+      info[i].y2 = box->y2;
+      info[i].rotate = pages[i]->getRotate();
+    }
+    if (n > 0 && i == numPages) {
+      docCache->setPages(info, numPages);
+    }
+    gfree(info);
+  }
+
+  // the named destination dictionary, names dictionary, metadata,
+  // and structure tree are read on first use (see resolve)
+  catDict.dictLookupNF("Dests", dests);
+  catDict.dictLookupNF("Names", names);
+  catDict.dictLookupNF("Metadata", metadata);
+  catDict.dictLookupNF("StructTreeRoot", structTreeRoot);
 
   // read base URI
   if (catDict.dictLookup("URI", &obj)->isDict()) {
@@ -97,14 +196,6 @@ Catalog::Catalog(XRef *xrefA, GBool printCommands) {
   }
   obj.free();
 
-  metadata = (Object *)gmalloc(sizeof(Object));
-  // get the metadata stream
-  catDict.dictLookup("Metadata", metadata);
-
-  structTreeRoot = (Object *)gmalloc(sizeof(Object));
-  // get the structure tree root
-  catDict.dictLookup("StructTreeRoot", structTreeRoot);
-
   catDict.free();
   return;
 
@@ -114,8 +205,6 @@ Catalog::Catalog(XRef *xrefA, GBool printCommands) {
   pagesDict.free();
  err1:
   catDict.free();
-  dests->initNull();
-  nameTree->initNull();
   ok = gFalse;
 }
 
@@ -131,10 +220,15 @@ Catalog::~Catalog() {
     gfree(pages);
     gfree(pageRefs);
   }
+  gfree(pageBoxes);
+  gfree(pageRotates);
+  pagesRoot->free();
+  gfree(pagesRoot);
+  gfree(pageIndex);
   dests->free();
   gfree(dests);
-  nameTree->free();
-  gfree(nameTree);
+  names->free();
+  gfree(names);
   if (baseURI) {
     delete baseURI;
   }
@@ -150,7 +244,7 @@ GString *Catalog::readMetadata() {
   Object obj;
   int c;
 
-  if (!metadata->isStream()) {
+  if (!resolve(metadata)->isStream()) {
     return NULL;
   }
   dict = metadata->streamGetDict();
@@ -168,17 +262,252 @@ GString *Catalog::readMetadata() {
   return s;
 }
 
+// Fetch <obj> in place if it is an indirect reference.  Entries of
+// the catalog are resolved this way on first use, so opening a file
+// reads as little of it as possible (in a linearized file, most of
+// these objects are at the end).
+Object *Catalog::resolve(Object *obj) {
+  Object obj1;
+
+  if (obj->isRef()) {
+    obj->fetch(xref, &obj1);
+    obj->free();
+    *obj = obj1;
+  }
+  return obj;
+}
+
+// Return the top-level pages dictionary.  If it is missing, an empty
+// dictionary is used, so the page tree appears to be empty.
+Dict *Catalog::getPagesDict() {
+  if (!resolve(pagesRoot)->isDict()) {
+    error(-1, "Top-level pages object is wrong type (%s)",
+	  pagesRoot->getTypeName());
+    pagesRoot->free();
+    pagesRoot->initDict(xref);
+  }
+  return pagesRoot->getDict();
+}
+
+Page *Catalog::getPage(int i) {
+  if (!pages[i-1]) {
+    loadPage(i);
+  }
+  return pages[i-1];
+}
+
+Ref *Catalog::getPageRef(int i) {
+  if (!pages[i-1] && !pageBoxes) {
+    loadPage(i);
+  }
+  return &pageRefs[i-1];
+}
+
+PDFRectangle *Catalog::getPageBox(int i) {
+  if (!pages[i-1] && pageBoxes) {
+    return &pageBoxes[i-1];
+  }
+  return getPage(i)->getBox();
+}
+
+int Catalog::getPageRotate(int i) {
+  if (!pages[i-1] && pageRotates) {
+    return pageRotates[i-1];
+  }
+  return getPage(i)->getRotate();
+}
+
+// Read page <i>, descending the page tree directly to it by using the
+// /Count entries of the intermediate nodes to skip whole subtrees.
+// If the /Count entries turn out to be wrong, fall back to reading
+// the whole tree.
+void Catalog::loadPage(int i) {
+  Object node, kids, kid, kidRef, obj;
+  PageAttrs *attrs, *attrs1;
+  Dict *emptyDict;
+  GBool found, descend;
+  int start, depth, n, j;
+
+  // with the page list from the document structure cache, go
+  // straight to the page object
+  if (pageBoxes && loadPageByRef(i)) {
+    return;
+  }
+
+  // in a linearized file, the first page's object ID is known, and
+  // the others can be found with the hint table
+  if (lin && (pageRefs[i-1].num >= 0 ||
+	      lin->getPageRef(i, xref, &pageRefs[i-1]))) {
+    if (loadPageByRef(i)) {
+      return;
+    }
+    pageRefs[i-1].num = -1;
+    pageRefs[i-1].gen = -1;
+  }
+
+  found = gFalse;
+  attrs = new PageAttrs(NULL, getPagesDict());
+  pagesRoot->copy(&node);
+  start = 0;
+  for (depth = 0; !found && depth < maxPageTreeDepth; ++depth) {
+    descend = gFalse;
+    if (!node.dictLookup(atomKids, &kids)->isArray()) {
+      kids.free();
+      break;
+    }
+    for (j = 0; j < kids.arrayGetLength(); ++j) {
+      // skip pages whose object IDs were seen on an earlier walk
+      // without reading them again, so that reading every page of a
+      // flat tree doesn't read O(n^2) objects
+      kids.arrayGetNF(j, &kidRef);
+      if (start < i - 1 && start < numPages && kidRef.isRef() &&
+	  pageRefs[start].num == kidRef.getRefNum() &&
+	  pageRefs[start].gen == kidRef.getRefGen()) {
+	kidRef.free();
+	++start;
+	continue;
+      }
+      kids.arrayGet(j, &kid);
+      if (kid.isDict("Page")) {
+	if (start < numPages && kidRef.isRef()) {
+	  pageRefs[start].num = kidRef.getRefNum();
+	  pageRefs[start].gen = kidRef.getRefGen();
+	}
+	kidRef.free();
+	if (start == i - 1) {
+	  attrs1 = new PageAttrs(attrs, kid.getDict());
+	  pages[i-1] = new Page(xref, i, kid.getDict(), attrs1, printCommands);
+	  kid.free();
+	  found = gTrue;
+	  break;
+	}
+	++start;
+      } else if (kid.isDict()) {
+	kidRef.free();
+	n = kid.dictLookup(atomCount, &obj)->isInt() ? obj.getInt() : -1;
+	obj.free();
+	if (n < 0) {
+	  kid.free();
+	  break;
+	}
+	if (i - 1 < start + n) {
+	  attrs1 = new PageAttrs(attrs, kid.getDict());
+	  delete attrs;
+	  attrs = attrs1;
+	  node.free();
+	  node = kid;
+	  descend = gTrue;
+	  break;
+	}
+	start += n;
+      } else {
+	kidRef.free();
+	kid.free();
+	break;
+      }
+      kid.free();
+    }
+    kids.free();
+    if (!descend) {
+      break;
+    }
+  }
+  node.free();
+  delete attrs;
+
+  if (!found && !pageTreeRead) {
+    error(-1, "Page tree /Count entries are inconsistent (page %d)", i);
+    pageTreeRead = gTrue;
+    gfree(pageIndex);
+    pageIndex = NULL;
+    n = readPageTree(getPagesDict(), NULL, 0, 0);
+    if (n >= 0 && n != numPages) {
+      error(-1, "Page count in top-level pages object is incorrect");
+      numPages = n;
+    }
+  }
+
+  // if the page still can't be found, use an empty page so callers
+  // always get a valid Page
+  if (!pages[i-1]) {
+    emptyDict = new Dict(xref);
+    pages[i-1] = new Page(xref, i, emptyDict, new PageAttrs(NULL, emptyDict),
+			  printCommands);
+    delete emptyDict;
+  }
+}
+
+// Read page <i> from its object ID in <pageRefs>.  Inherited
+// attributes are picked up by following the /Parent links, so only
+// the page and its ancestors are read.  Returns false if the ID
+// doesn't lead to a usable page.
+GBool Catalog::loadPageByRef(int i) {
+  Object page, ancestors[maxPageTreeDepth], box, resources;
+  PageAttrs *attrs, *attrs1;
+  GBool ownAttrs;
+  int n, j;
+
+  xref->fetch(pageRefs[i-1].num, pageRefs[i-1].gen, &page);
+  if (!page.isDict("Page")) {
+    page.free();
+    return gFalse;
+  }
+
+  // the page objects of a linearized file normally have all of their
+  // attributes, so the ancestors (which are at the end of the file)
+  // are only read if one of the main ones is missing
+  ownAttrs = gFalse;
+  if (lin) {
+    page.dictLookupNF("MediaBox", &box);
+    page.dictLookupNF("Resources", &resources);
+    ownAttrs = !box.isNull() && !resources.isNull();
+    box.free();
+    resources.free();
+  }
+  for (n = 0; !ownAttrs && n < maxPageTreeDepth; ++n) {
+    (n == 0 ? &page : &ancestors[n-1])->dictLookup("Parent", &ancestors[n]);
+    if (!ancestors[n].isDict()) {
+      ancestors[n].free();
+      break;
+    }
+  }
+  if (n == maxPageTreeDepth) {
+    for (j = 0; j < n; ++j) {
+      ancestors[j].free();
+    }
+    page.free();
+    return gFalse;
+  }
+  attrs = NULL;
+  for (j = n - 1; j >= 0; --j) {
+    attrs1 = new PageAttrs(attrs, ancestors[j].getDict());
+    if (attrs) {
+      delete attrs;
+    }
+    attrs = attrs1;
+    ancestors[j].free();
+  }
+  pages[i-1] = new Page(xref, i, page.getDict(),
+			new PageAttrs(attrs, page.getDict()), printCommands);
+  if (attrs) {
+    delete attrs;
+  }
+  page.free();
+  return gTrue;
+}
+
+// Read the whole page tree, creating Page objects for all pages that
+// haven't been read yet.
 int Catalog::readPageTree(Dict *pagesDict, PageAttrs *attrs, int start,
-			  GBool printCommands) {
+			  int depth) {
   Object kids;
   Object kid;
   Object kidRef;
   PageAttrs *attrs1, *attrs2;
-  Page *page;
   int i, j;
 
   attrs1 = new PageAttrs(attrs, pagesDict);
-  pagesDict->lookup("Kids", &kids);
+  pagesDict->lookup(atomKids, &kids);
   if (!kids.isArray()) {
     error(-1, "Kids object (page %d) is wrong type (%s)",
 	  start+1, kids.getTypeName());
@@ -187,12 +516,6 @@ int Catalog::readPageTree(Dict *pagesDict, PageAttrs *attrs, int start,
   for (i = 0; i < kids.arrayGetLength(); ++i) {
     kids.arrayGet(i, &kid);
     if (kid.isDict("Page")) {
-      attrs2 = new PageAttrs(attrs1, kid.getDict());
-      page = new Page(xref, start+1, kid.getDict(), attrs2, printCommands);
-      if (!page->isOk()) {
-	++start;
-	goto err3;
-      }
       if (start >= pagesSize) {
 	pagesSize += 32;
 	pages = (Page **)grealloc(pages, pagesSize * sizeof(Page *));
@@ -203,18 +526,22 @@ int Catalog::readPageTree(Dict *pagesDict, PageAttrs *attrs, int start,
 	  pageRefs[j].gen = -1;
 	}
       }
-      pages[start] = page;
-      kids.arrayGetNF(i, &kidRef);
-      if (kidRef.isRef()) {
-	pageRefs[start].num = kidRef.getRefNum();
-	pageRefs[start].gen = kidRef.getRefGen();
+      if (!pages[start]) {
+	attrs2 = new PageAttrs(attrs1, kid.getDict());
+	pages[start] = new Page(xref, start+1, kid.getDict(), attrs2,
+				printCommands);
+	kids.arrayGetNF(i, &kidRef);
+	if (kidRef.isRef()) {
+	  pageRefs[start].num = kidRef.getRefNum();
+	  pageRefs[start].gen = kidRef.getRefGen();
+	}
+	kidRef.free();
       }
-      kidRef.free();
       ++start;
     // This should really be isDict("Pages"), but I've seen at least one
     // PDF file where the /Type entry is missing.
-    } else if (kid.isDict()) {
-      if ((start = readPageTree(kid.getDict(), attrs1, start, printCommands))
+    } else if (kid.isDict() && depth < maxPageTreeDepth) {
+      if ((start = readPageTree(kid.getDict(), attrs1, start, depth + 1))
 	  < 0)
 	goto err2;
     } else {
@@ -228,23 +555,85 @@ int Catalog::readPageTree(Dict *pagesDict, PageAttrs *attrs, int start,
   kids.free();
   return start;
 
- err3:
-  delete page;
  err2:
   kid.free();
  err1:
   kids.free();
   delete attrs1;
-  ok = gFalse;
   return -1;
 }
 
-int Catalog::findPage(int num, int gen) {
+// Collect the object IDs of all pages, without creating Page objects.
+int Catalog::readPageRefs(Dict *pagesDict, int start, int depth) {
+  Object kids, kid, kidRef;
+  int i;
+
+  if (!pagesDict->lookup(atomKids, &kids)->isArray()) {
+    kids.free();
+    return start;
+  }
+  for (i = 0; i < kids.arrayGetLength() && start < numPages; ++i) {
+    kids.arrayGet(i, &kid);
+    if (kid.isDict("Page")) {
+      if (pageRefs[start].num < 0) {
+	kids.arrayGetNF(i, &kidRef);
+	if (kidRef.isRef()) {
+	  pageRefs[start].num = kidRef.getRefNum();
+	  pageRefs[start].gen = kidRef.getRefGen();
+	}
+	kidRef.free();
+      }
+      ++start;
+    } else if (kid.isDict() && depth < maxPageTreeDepth) {
+      start = readPageRefs(kid.getDict(), start, depth + 1);
+    }
+    kid.free();
+  }
+  kids.free();
+  return start;
+}
+
+void Catalog::buildPageIndex() {
   int i;
 
+  // the page tree doesn't need to be read if the page IDs came from
+  // the document structure cache
+  if (!pageTreeRead && !pageBoxes) {
+    readPageRefs(getPagesDict(), 0, 0);
+  }
+  pageIndex = (PageRefEntry *)gmalloc((numPages + 1) * sizeof(PageRefEntry));
+  pageIndexLen = 0;
   for (i = 0; i < numPages; ++i) {
-    if (pageRefs[i].num == num && pageRefs[i].gen == gen)
-      return i + 1;
+    if (pageRefs[i].num >= 0) {
+      pageIndex[pageIndexLen].ref = pageRefs[i];
+      pageIndex[pageIndexLen].page = i + 1;
+      ++pageIndexLen;
+    }
+  }
+  qsort(pageIndex, pageIndexLen, sizeof(PageRefEntry), &cmpPageRefEntries);
+}
+
+int Catalog::findPage(int num, int gen) {
+  int a, b, m;
+
+  if (!pageIndex) {
+    buildPageIndex();
+  }
+  // find the first entry with ref.num >= num
+  a = 0;
+  b = pageIndexLen;
+  while (a < b) {
+    m = (a + b) / 2;
+    if (pageIndex[m].ref.num < num) {
+      a = m + 1;
+    } else {
+      b = m;
+    }
+  }
+  for (; a < pageIndexLen && pageIndex[a].ref.num == num; ++a) {
+    if (pageIndex[a].ref.gen == gen) {
+      return pageIndex[a].page;
+    }
   }
   return 0;
 }
@@ -256,17 +645,20 @@ LinkDest *Catalog::findDest(GString *name) {
 
   // try named destination dictionary then name tree
   found = gFalse;
-  if (dests->isDict()) {
+  if (resolve(dests)->isDict()) {
     if (!dests->dictLookup(name->getCString(), &obj1)->isNull())
       found = gTrue;
     else
       obj1.free();
   }
-  if (!found && nameTree->isDict()) {
-    if (!findDestInTree(nameTree, name, &obj1)->isNull())
-      found = gTrue;
-    else
-      obj1.free();
+  if (!found && resolve(names)->isDict()) {
+    if (names->dictLookup("Dests", &obj2)->isDict()) {
+      if (!findDestInTree(&obj2, name, &obj1)->isNull())
+	found = gTrue;
+      else
+	obj1.free();
+    }
+    obj2.free();
   }
   if (!found)
     return NULL;
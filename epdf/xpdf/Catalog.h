@@ -23,6 +23,10 @@ class GString;
 class Dict;
 struct Ref;
 class LinkDest;
+struct PageRefEntry;
+struct PDFRectangle;
+class DocCache;
+class Linearization;
 
 //------------------------------------------------------------------------
 // Catalog
@@ -31,8 +35,12 @@ class LinkDest;
 class Catalog {
 public:
 
-  // Constructor.
-  Catalog(XRef *xrefA, GBool printCommands = gFalse);
+  // Constructor.  If <docCache> is given, the page list is read from
+  // it if it has been loaded, and stored in it otherwise.  If <linA>
+  // is given, the page tree isn't read until a page other than the
+  // first one is needed, and pages are found with its hint table.
+  Catalog(XRef *xrefA, GBool printCommands = gFalse,
+	  DocCache *docCache = NULL, Linearization *linA = NULL);
 
   // Destructor.
   ~Catalog();
@@ -40,14 +48,21 @@ public:
   // Is catalog valid?
   GBool isOk() { return ok; }
 
-  // Get number of pages.
+  // Get number of pages (from the /Count of the top-level pages
+  // object).
   int getNumPages() { return numPages; }
 
-  // Get a page.
-  Page *getPage(int i) { return pages[i-1]; }
+  // Get a page.  Pages are read from the page tree on first use.
+  Page *getPage(int i);
 
   // Get the reference for a page object.
-  Ref *getPageRef(int i) { return &pageRefs[i-1]; }
+  Ref *getPageRef(int i);
+
+  // Get the box (see Page::getBox) and rotation of a page.  These
+  // come from the document structure cache, if it was loaded, until
+  // the page is read.
+  PDFRectangle *getPageBox(int i);
+  int getPageRotate(int i);
 
   // Return base URI, or NULL if none.
   GString *getBaseURI() { return baseURI; }
@@ -57,10 +72,11 @@ public:
   GString *readMetadata();
 
   // Return the structure tree root object.
-  Object *getStructTreeRoot() { return structTreeRoot; }
+  Object *getStructTreeRoot() { return resolve(structTreeRoot); }
 
   // Find a page, given its object ID.  Returns page number, or 0 if
-  // not found.
+  // not found.  The first call walks the page tree (without creating
+  // Page objects) to build a reverse index.
   int findPage(int num, int gen);
 
   // Find a named destination.  Returns the link destination, or
@@ -72,17 +88,35 @@ private:
   XRef *xref;			// the xref table for this PDF file
   Page **pages;			// array of pages
   Ref *pageRefs;		// object ID for each page
+  PDFRectangle *pageBoxes;	// box and rotation of each page, from
+  int *pageRotates;		//   the document structure cache (NULL
+				//   if it wasn't loaded)
   int numPages;			// number of pages
   int pagesSize;		// size of pages array
+  Object *pagesRoot;		// top-level pages dictionary (or a
+				//   reference to it, until it is used)
+  Linearization *lin;		// linearization data (NULL if the file
+				//   isn't linearized)
+  GBool pageTreeRead;		// set once the whole page tree has been
+				//   read (for the document structure
+				//   cache, or for a broken /Count)
+  PageRefEntry *pageIndex;	// page refs sorted by object number
+  int pageIndexLen;		// number of entries in <pageIndex>
+  GBool printCommands;		// passed on to each Page
   Object *dests;			// named destination dictionary
-  Object *nameTree;		// name tree
+  Object *names;		// names dictionary
   GString *baseURI;		// base URI for URI-type links
   Object *metadata;		// metadata stream
   Object *structTreeRoot;	// structure tree root dictionary
   GBool ok;			// true if catalog is valid
 
-  int readPageTree(Dict *pages, PageAttrs *attrs, int start,
-		   GBool printCommands);
+  Object *resolve(Object *obj);
+  Dict *getPagesDict();
+  void loadPage(int i);
+  GBool loadPageByRef(int i);
+  int readPageTree(Dict *pages, PageAttrs *attrs, int start, int depth);
+  int readPageRefs(Dict *pages, int start, int depth);
+  void buildPageIndex();
   Object *findDestInTree(Object *tree, GString *name, Object *obj);
 };
 
@@ -10,13 +10,22 @@
 #pragma implementation
 #endif
 
+#include <string.h>
 #include "../goo/gmem.h"
 #include "../goo/GString.h"
 #include "Decrypt.h"
 
-static void rc4InitKey(Guchar *key, int keyLen, Guchar *state);
-static Guchar rc4DecryptByte(Guchar *state, Guchar *x, Guchar *y, Guchar c);
+static void rc4InitKey(Guchar *key, int keyLen, Guint *state);
+static void rc4Decrypt(Guint *state, Guchar *x, Guchar *y,
+		       Guchar *in, Guchar *out, int n);
+static int aesKeyExpansion(Guchar *key, int keyLen, Guint *rk);
+static void aesDecryptKeys(Guint *rk, int rounds);
+static void aesEncryptBlock(Guint *rk, int rounds, Guchar *in, Guchar *out);
+static void aesDecryptBlock(Guint *rk, int rounds, Guchar *in, Guchar *out);
+static void aes256DecryptCBC(Guchar *key, Guchar *in, Guchar *out, int n);
 static void md5(Guchar *msg, int msgLen, Guchar *digest);
+static void sha256(Guchar *msg, int msgLen, Guchar *hash);
+static void sha512(Guchar *msg, int msgLen, Guchar *hash, int hashLen);
 
 static Guchar passwordPad[32] = {
   0x28, 0xbf, 0x4e, 0x5e, 0x4e, 0x75, 0x8a, 0x41,
@@ -29,47 +38,148 @@ static Guchar passwordPad[32] = {
 // Decrypt
 //------------------------------------------------------------------------
 
-Decrypt::Decrypt(Guchar *fileKey, int keyLength, int objNum, int objGen) {
+Decrypt::Decrypt(Guchar *fileKey, int keyLength, CryptAlgorithm algA,
+		 int objNum, int objGen) {
+  Guchar buf[maxFileKeyLength + 9];
   int i;
 
-  // construct object key
-  for (i = 0; i < keyLength; ++i) {
-    objKey[i] = fileKey[i];
+  alg = algA;
+
+  // construct object key; AESV3 uses the file key as it is
+  if (alg == cryptAES256) {
+    memcpy(objKey, fileKey, 32);
+    objKeyLength = 32;
+  } else {
+    for (i = 0; i < keyLength; ++i) {
+      buf[i] = fileKey[i];
+    }
+    buf[keyLength] = objNum & 0xff;
+    buf[keyLength + 1] = (objNum >> 8) & 0xff;
+    buf[keyLength + 2] = (objNum >> 16) & 0xff;
+    buf[keyLength + 3] = objGen & 0xff;
+    buf[keyLength + 4] = (objGen >> 8) & 0xff;
+    if (alg == cryptAES) {
+      memcpy(buf + keyLength + 5, "sAlT", 4);
+      md5(buf, keyLength + 9, objKey);
+    } else {
+      md5(buf, keyLength + 5, objKey);
+    }
+    if ((objKeyLength = keyLength + 5) > 16) {
+      objKeyLength = 16;
+    }
   }
-  objKey[keyLength] = objNum & 0xff;
-  objKey[keyLength + 1] = (objNum >> 8) & 0xff;
-  objKey[keyLength + 2] = (objNum >> 16) & 0xff;
-  objKey[keyLength + 3] = objGen & 0xff;
-  objKey[keyLength + 4] = (objGen >> 8) & 0xff;
-  md5(objKey, keyLength + 5, objKey);
 
   // set up for decryption
-  x = y = 0;
-  if ((objKeyLength = keyLength + 5) > 16) {
-    objKeyLength = 16;
+  if (alg == cryptAES || alg == cryptAES256) {
+    aesRounds = aesKeyExpansion(objKey, objKeyLength, aesKey);
+    aesDecryptKeys(aesKey, aesRounds);
   }
-  rc4InitKey(objKey, objKeyLength, state);
+  reset();
 }
 
 void Decrypt::reset() {
-  x = y = 0;
-  rc4InitKey(objKey, objKeyLength, state);
+  if (alg == cryptRC4) {
+    x = y = 0;
+    rc4InitKey(objKey, objKeyLength, state);
+  } else {
+    ivSet = gFalse;
+    partialLen = 0;
+    haveHeld = gFalse;
+  }
 }
 
-Guchar Decrypt::decryptByte(Guchar c) {
-  return rc4DecryptByte(state, &x, &y, c);
+int Decrypt::decryptBlock(Guchar *in, Guchar *out, int n, GBool last) {
+  int nOut, k, pad;
+
+  if (alg == cryptRC4) {
+    rc4Decrypt(state, &x, &y, in, out, n);
+    return n;
+  }
+
+  // AES: finish the block left over from the last call, then go
+  // straight through the whole blocks
+  nOut = 0;
+  if (partialLen > 0) {
+    k = 16 - partialLen;
+    if (k > n) {
+      k = n;
+    }
+    memcpy(partial + partialLen, in, k);
+    partialLen += k;
+    in += k;
+    n -= k;
+    if (partialLen == 16) {
+      aesBlock(partial, out, &nOut);
+      partialLen = 0;
+    }
+  }
+  for (; n >= 16; in += 16, n -= 16) {
+    aesBlock(in, out, &nOut);
+  }
+  if (n > 0) {
+    memcpy(partial, in, n);
+    partialLen = n;
+  }
+
+  // the final block ends with its padding (a bad pad length is left
+  // alone)
+  if (last && haveHeld) {
+    pad = held[15];
+    if (pad < 1 || pad > 16) {
+      pad = 0;
+    }
+    memcpy(out + nOut, held, 16 - pad);
+    nOut += 16 - pad;
+    haveHeld = gFalse;
+  }
+  return nOut;
+}
+
+// Take one AES cipher text block: the first one is the IV; for the
+// others, write out the block held back from before, and hold this
+// one.
+void Decrypt::aesBlock(Guchar *in, Guchar *out, int *nOut) {
+  Guchar block[16];
+  int i;
+
+  if (!ivSet) {
+    memcpy(iv, in, 16);
+    ivSet = gTrue;
+    return;
+  }
+  if (haveHeld) {
+    memcpy(out + *nOut, held, 16);
+    *nOut += 16;
+  }
+  aesDecryptBlock(aesKey, aesRounds, in, block);
+  for (i = 0; i < 16; ++i) {
+    held[i] = block[i] ^ iv[i];
+  }
+  memcpy(iv, in, 16);
+  haveHeld = gTrue;
 }
 
 GBool Decrypt::makeFileKey(int encVersion, int encRevision, int keyLength,
 			   GString *ownerKey, GString *userKey,
+			   GString *ownerEnc, GString *userEnc,
 			   int permissions, GString *fileID,
+			   GBool encryptMetadata,
 			   GString *ownerPassword, GString *userPassword,
 			   Guchar *fileKey, GBool *ownerPasswordOk) {
   Guchar test[32];
+  Guchar ownerHash[16];
   GString *userPassword2;
-  Guchar fState[256];
+  Guint fState[256];
+  Guchar tmpKey[16];
   Guchar fx, fy;
-  int len, i;
+  int len, i, j;
+
+  // revisions 5 and 6 (AESV3) are different altogether
+  if (encRevision == 5 || encRevision == 6) {
+    return makeFileKey256(encRevision, ownerKey, userKey, ownerEnc, userEnc,
+			  ownerPassword, userPassword, fileKey,
+			  ownerPasswordOk);
+  }
 
   // try using the supplied owner password to generate the user password
   if (ownerPassword) {
@@ -84,19 +194,31 @@ GBool Decrypt::makeFileKey(int encVersion, int encRevision, int keyLength,
     memcpy(test, passwordPad, 32);
   }
   md5(test, 32, test);
-  if (encRevision == 3) {
+  if (encRevision >= 3) {
     for (i = 0; i < 50; ++i) {
       md5(test, 16, test);
     }
   }
-  rc4InitKey(test, keyLength, fState);
-  fx = fy = 0;
-  for (i = 0; i < 32; ++i) {
-    test[i] = rc4DecryptByte(fState, &fx, &fy, ownerKey->getChar(i));
+  if (encRevision == 2) {
+    rc4InitKey(test, keyLength, fState);
+    fx = fy = 0;
+    rc4Decrypt(fState, &fx, &fy, (Guchar *)ownerKey->getCString(), test, 32);
+  } else {
+    memcpy(ownerHash, test, 16);
+    memcpy(test, ownerKey->getCString(), 32);
+    for (i = 19; i >= 0; --i) {
+      for (j = 0; j < keyLength; ++j) {
+	tmpKey[j] = ownerHash[j] ^ i;
+      }
+      rc4InitKey(tmpKey, keyLength, fState);
+      fx = fy = 0;
+      rc4Decrypt(fState, &fx, &fy, test, test, 32);
+    }
   }
   userPassword2 = new GString((char *)test, 32);
   if (makeFileKey2(encVersion, encRevision, keyLength, ownerKey, userKey,
-		   permissions, fileID, userPassword2, fileKey)) {
+		   permissions, fileID, encryptMetadata, userPassword2,
+		   fileKey)) {
     *ownerPasswordOk = gTrue;
     delete userPassword2;
     return gTrue;
@@ -106,23 +228,25 @@ GBool Decrypt::makeFileKey(int encVersion, int encRevision, int keyLength,
 
   // try using the supplied user password
   return makeFileKey2(encVersion, encRevision, keyLength, ownerKey, userKey,
-		      permissions, fileID, userPassword, fileKey);
+		      permissions, fileID, encryptMetadata, userPassword,
+		      fileKey);
 }
 
 GBool Decrypt::makeFileKey2(int encVersion, int encRevision, int keyLength,
 			    GString *ownerKey, GString *userKey,
 			    int permissions, GString *fileID,
+			    GBool encryptMetadata,
 			    GString *userPassword, Guchar *fileKey) {
   Guchar *buf;
   Guchar test[32];
-  Guchar fState[256];
+  Guint fState[256];
   Guchar tmpKey[16];
   Guchar fx, fy;
-  int len, i, j;
+  int len, n, i, j;
   GBool ok;
 
   // generate file key
-  buf = (Guchar *)gmalloc(68 + fileID->getLength());
+  buf = (Guchar *)gmalloc(72 + fileID->getLength());
   if (userPassword) {
     len = userPassword->getLength();
     if (len < 32) {
@@ -140,10 +264,17 @@ GBool Decrypt::makeFileKey2(int encVersion, int encRevision, int keyLength,
   buf[66] = (permissions >> 16) & 0xff;
   buf[67] = (permissions >> 24) & 0xff;
   memcpy(buf + 68, fileID->getCString(), fileID->getLength());
-  md5(buf, 68 + fileID->getLength(), fileKey);
-  if (encRevision == 3) {
+  n = 68 + fileID->getLength();
+  if (encRevision >= 4 && !encryptMetadata) {
+    buf[n++] = 0xff;
+    buf[n++] = 0xff;
+    buf[n++] = 0xff;
+    buf[n++] = 0xff;
+  }
+  md5(buf, n, fileKey);
+  if (encRevision >= 3) {
     for (i = 0; i < 50; ++i) {
-      md5(fileKey, 16, fileKey);
+      md5(fileKey, keyLength, fileKey);
     }
   }
 
@@ -151,11 +282,9 @@ GBool Decrypt::makeFileKey2(int encVersion, int encRevision, int keyLength,
   if (encRevision == 2) {
     rc4InitKey(fileKey, keyLength, fState);
     fx = fy = 0;
-    for (i = 0; i < 32; ++i) {
-      test[i] = rc4DecryptByte(fState, &fx, &fy, userKey->getChar(i));
-    }
+    rc4Decrypt(fState, &fx, &fy, (Guchar *)userKey->getCString(), test, 32);
     ok = memcmp(test, passwordPad, 32) == 0;
-  } else if (encRevision == 3) {
+  } else if (encRevision == 3 || encRevision == 4) {
     memcpy(test, userKey->getCString(), 32);
     for (i = 19; i >= 0; --i) {
       for (j = 0; j < keyLength; ++j) {
@@ -163,9 +292,7 @@ GBool Decrypt::makeFileKey2(int encVersion, int encRevision, int keyLength,
       }
       rc4InitKey(tmpKey, keyLength, fState);
       fx = fy = 0;
-      for (j = 0; j < 32; ++j) {
-	test[j] = rc4DecryptByte(fState, &fx, &fy, test[j]);
-      }
+      rc4Decrypt(fState, &fx, &fy, test, test, 32);
     }
     memcpy(buf, passwordPad, 32);
     memcpy(buf + 32, fileID->getCString(), fileID->getLength());
@@ -179,13 +306,139 @@ GBool Decrypt::makeFileKey2(int encVersion, int encRevision, int keyLength,
   return ok;
 }
 
+// Revision 5 and 6 password hash of <password> (cut to 127 bytes)
+// with an 8-byte <salt>, and the 48-byte U string for the owner
+// password (NULL for the user password).  Revision 5 is a plain
+// SHA-256; revision 6 iterates with AES-128 and SHA-256/384/512.
+static void passwordHash256(int encRevision, GString *password,
+			    Guchar *salt, Guchar *userKey, Guchar *hash) {
+  Guchar k[64];
+  Guchar *buf, *p;
+  Guint rk[44];
+  int pwLen, uLen, kLen, seqLen, n, rounds, sum, i, j;
+
+  pwLen = password ? password->getLength() : 0;
+  if (pwLen > 127) {
+    pwLen = 127;
+  }
+  uLen = userKey ? 48 : 0;
+  buf = (Guchar *)gmalloc(64 * (127 + 64 + 48));
+  if (pwLen > 0) {
+    memcpy(buf, password->getCString(), pwLen);
+  }
+  memcpy(buf + pwLen, salt, 8);
+  if (uLen) {
+    memcpy(buf + pwLen + 8, userKey, 48);
+  }
+  sha256(buf, pwLen + 8 + uLen, k);
+  kLen = 32;
+
+  if (encRevision == 6) {
+    for (i = 0; ; ++i) {
+
+      // 64 copies of password, key and U string
+      seqLen = pwLen + kLen + uLen;
+      p = buf;
+      if (pwLen > 0) {
+	memcpy(p, password->getCString(), pwLen);
+      }
+      memcpy(p + pwLen, k, kLen);
+      if (uLen) {
+	memcpy(p + pwLen + kLen, userKey, 48);
+      }
+      for (j = 1; j < 64; ++j) {
+	memcpy(p + j * seqLen, p, seqLen);
+      }
+      n = 64 * seqLen;
+
+      // encrypt them with AES-128 in CBC mode, keyed by the first half
+      // of the key, with the second half as IV
+      rounds = aesKeyExpansion(k, 16, rk);
+      for (j = 0; j < 16; ++j) {
+	buf[j] ^= k[16 + j];
+      }
+      aesEncryptBlock(rk, rounds, buf, buf);
+      for (p = buf + 16; p < buf + n; p += 16) {
+	for (j = 0; j < 16; ++j) {
+	  p[j] ^= p[j - 16];
+	}
+	aesEncryptBlock(rk, rounds, p, p);
+      }
+
+      // the next key is a hash of that, picked by the first 16 bytes
+      for (j = 0, sum = 0; j < 16; ++j) {
+	sum += buf[j];
+      }
+      switch (sum % 3) {
+      case 0:
+	sha256(buf, n, k);
+	kLen = 32;
+	break;
+      case 1:
+	sha512(buf, n, k, 48);
+	kLen = 48;
+	break;
+      case 2:
+	sha512(buf, n, k, 64);
+	kLen = 64;
+	break;
+      }
+
+      // at least 64 rounds, then until the last byte is small enough
+      if (i >= 63 && buf[n - 1] <= i - 31) {
+	break;
+      }
+    }
+  }
+
+  memcpy(hash, k, 32);
+  gfree(buf);
+}
+
+GBool Decrypt::makeFileKey256(int encRevision,
+			      GString *ownerKey, GString *userKey,
+			      GString *ownerEnc, GString *userEnc,
+			      GString *ownerPassword, GString *userPassword,
+			      Guchar *fileKey, GBool *ownerPasswordOk) {
+  Guchar hash[32];
+  Guchar *o, *u;
+
+  *ownerPasswordOk = gFalse;
+  if (ownerKey->getLength() < 48 || userKey->getLength() < 48 ||
+      !ownerEnc || ownerEnc->getLength() < 32 ||
+      !userEnc || userEnc->getLength() < 32) {
+    return gFalse;
+  }
+  o = (Guchar *)ownerKey->getCString();
+  u = (Guchar *)userKey->getCString();
+
+  // O = owner password hash (with the O validation salt and U), then
+  // validation salt and key salt; the key salt gives the key for OE
+  passwordHash256(encRevision, ownerPassword, o + 32, u, hash);
+  if (!memcmp(hash, o, 32)) {
+    passwordHash256(encRevision, ownerPassword, o + 40, u, hash);
+    aes256DecryptCBC(hash, (Guchar *)ownerEnc->getCString(), fileKey, 32);
+    *ownerPasswordOk = gTrue;
+    return gTrue;
+  }
+
+  // U and UE work the same way, without the U string
+  passwordHash256(encRevision, userPassword, u + 32, NULL, hash);
+  if (!memcmp(hash, u, 32)) {
+    passwordHash256(encRevision, userPassword, u + 40, NULL, hash);
+    aes256DecryptCBC(hash, (Guchar *)userEnc->getCString(), fileKey, 32);
+    return gTrue;
+  }
+  return gFalse;
+}
+
 //------------------------------------------------------------------------
 // RC4-compatible decryption
 //------------------------------------------------------------------------
 
-static void rc4InitKey(Guchar *key, int keyLen, Guchar *state) {
+static void rc4InitKey(Guchar *key, int keyLen, Guint *state) {
   Guchar index1, index2;
-  Guchar t;
+  Guint t;
   int i;
 
   for (i = 0; i < 256; ++i)
@@ -200,16 +453,309 @@ static void rc4InitKey(Guchar *key, int keyLen, Guchar *state) {
   }
 }
 
-static Guchar rc4DecryptByte(Guchar *state, Guchar *x, Guchar *y, Guchar c) {
-  Guchar x1, y1, tx, ty;
+// Decrypt <n> bytes (<in> and <out> may be the same buffer).  The
+// indexes stay in registers, and the loop does four bytes a turn.
+// The state is kept in ints: byte stores into it are slower, and
+// keep the compiler from holding values across the output stores.
+static void rc4Decrypt(Guint *state, Guchar *x, Guchar *y,
+		       Guchar *in, Guchar *out, int n) {
+  Guint x1, y1, tx, ty, k0, k1, k2, k3;
+  int i;
+
+  x1 = *x;
+  y1 = *y;
+
+#define rc4Step(k)				\
+  x1 = (x1 + 1) & 0xff;				\
+  tx = state[x1];				\
+  y1 = (y1 + tx) & 0xff;			\
+  ty = state[y1];				\
+  state[x1] = ty;				\
+  state[y1] = tx;				\
+  k = state[(tx + ty) & 0xff]
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    rc4Step(k0);
+    rc4Step(k1);
+    rc4Step(k2);
+    rc4Step(k3);
+    out[i] = (Guchar)(in[i] ^ k0);
+    out[i+1] = (Guchar)(in[i+1] ^ k1);
+    out[i+2] = (Guchar)(in[i+2] ^ k2);
+    out[i+3] = (Guchar)(in[i+3] ^ k3);
+  }
+  for (; i < n; ++i) {
+    rc4Step(k0);
+    out[i] = (Guchar)(in[i] ^ k0);
+  }
+
+#undef rc4Step
 
-  x1 = *x = (*x + 1) % 256;
-  y1 = *y = (state[*x] + *y) % 256;
-  tx = state[x1];
-  ty = state[y1];
-  state[x1] = ty;
-  state[y1] = tx;
-  return c ^ state[(tx + ty) % 256];
+  *x = (Guchar)x1;
+  *y = (Guchar)y1;
+}
+
+//------------------------------------------------------------------------
+// AES
+//------------------------------------------------------------------------
+
+// State and round key words hold four bytes, first byte highest.  The
+// round tables give the MixColumns (or InvMixColumns) column for an
+// S-box (or inverse S-box) output in the first row; the other rows
+// are the same column rotated.
+
+static Guchar aesSbox[256] = {
+  0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5,
+  0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+  0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0,
+  0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+  0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc,
+  0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+  0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a,
+  0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+  0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0,
+  0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+  0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b,
+  0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+  0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85,
+  0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+  0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5,
+  0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+  0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17,
+  0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+  0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88,
+  0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+  0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c,
+  0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+  0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9,
+  0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+  0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6,
+  0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+  0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e,
+  0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+  0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94,
+  0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+  0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68,
+  0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+static Guchar aesInvSbox[256];
+static Guint aesTe[256];
+static Guint aesTd[256];
+static GBool aesTablesInit = gFalse;
+
+static inline Guint aesRot(Guint w, int n) {
+  return (w >> n) | (w << (32 - n));
+}
+
+// multiplication in GF(2^8)
+static Guint aesMul(Guint a, Guint b) {
+  Guint r;
+
+  for (r = 0; b; b >>= 1) {
+    if (b & 1) {
+      r ^= a;
+    }
+    a = (a & 0x80) ? ((a << 1) ^ 0x11b) : (a << 1);
+  }
+  return r;
+}
+
+static void aesInitTables() {
+  Guint s, t;
+  int i;
+
+  for (i = 0; i < 256; ++i) {
+    aesInvSbox[aesSbox[i]] = (Guchar)i;
+  }
+  for (i = 0; i < 256; ++i) {
+    s = aesSbox[i];
+    aesTe[i] = (aesMul(s, 2) << 24) | (s << 16) | (s << 8) | aesMul(s, 3);
+    t = aesInvSbox[i];
+    aesTd[i] = (aesMul(t, 14) << 24) | (aesMul(t, 9) << 16) |
+               (aesMul(t, 13) << 8) | aesMul(t, 11);
+  }
+  aesTablesInit = gTrue;
+}
+
+static inline Guint aesGetWord(Guchar *p) {
+  return ((Guint)p[0] << 24) | ((Guint)p[1] << 16) |
+         ((Guint)p[2] << 8) | (Guint)p[3];
+}
+
+static inline void aesPutWord(Guchar *p, Guint w) {
+  p[0] = (Guchar)(w >> 24);
+  p[1] = (Guchar)(w >> 16);
+  p[2] = (Guchar)(w >> 8);
+  p[3] = (Guchar)w;
+}
+
+static inline Guint aesSubWord(Guint w) {
+  return ((Guint)aesSbox[w >> 24] << 24) |
+         ((Guint)aesSbox[(w >> 16) & 0xff] << 16) |
+         ((Guint)aesSbox[(w >> 8) & 0xff] << 8) |
+         (Guint)aesSbox[w & 0xff];
+}
+
+// Expand a 16- or 32-byte key into the encryption round keys <rk>
+// (room for 60 words).  Returns the number of rounds.
+static int aesKeyExpansion(Guchar *key, int keyLen, Guint *rk) {
+  Guint t, rcon;
+  int nk, rounds, i;
+
+  if (!aesTablesInit) {
+    aesInitTables();
+  }
+  nk = keyLen / 4;
+  rounds = nk + 6;
+  for (i = 0; i < nk; ++i) {
+    rk[i] = aesGetWord(key + 4 * i);
+  }
+  rcon = 1;
+  for (i = nk; i < 4 * (rounds + 1); ++i) {
+    t = rk[i - 1];
+    if (i % nk == 0) {
+      t = aesSubWord((t << 8) | (t >> 24)) ^ (rcon << 24);
+      rcon = aesMul(rcon, 2);
+    } else if (nk > 6 && i % nk == 4) {
+      t = aesSubWord(t);
+    }
+    rk[i] = rk[i - nk] ^ t;
+  }
+  return rounds;
+}
+
+// Turn encryption round keys into keys for the equivalent inverse
+// cipher: reversed, with InvMixColumns applied to the inner rounds.
+static void aesDecryptKeys(Guint *rk, int rounds) {
+  Guint t, w;
+  int i, j, k;
+
+  for (i = 0, j = 4 * rounds; i < j; i += 4, j -= 4) {
+    for (k = 0; k < 4; ++k) {
+      t = rk[i + k];
+      rk[i + k] = rk[j + k];
+      rk[j + k] = t;
+    }
+  }
+  for (i = 4; i < 4 * rounds; ++i) {
+    w = rk[i];
+    rk[i] = aesTd[aesSbox[w >> 24]] ^
+            aesRot(aesTd[aesSbox[(w >> 16) & 0xff]], 8) ^
+            aesRot(aesTd[aesSbox[(w >> 8) & 0xff]], 16) ^
+            aesRot(aesTd[aesSbox[w & 0xff]], 24);
+  }
+}
+
+static void aesEncryptBlock(Guint *rk, int rounds, Guchar *in, Guchar *out) {
+  Guint s0, s1, s2, s3, t0, t1, t2, t3;
+  int r;
+
+  s0 = aesGetWord(in) ^ rk[0];
+  s1 = aesGetWord(in + 4) ^ rk[1];
+  s2 = aesGetWord(in + 8) ^ rk[2];
+  s3 = aesGetWord(in + 12) ^ rk[3];
+  for (r = 1; r < rounds; ++r) {
+    rk += 4;
+    t0 = aesTe[s0 >> 24] ^ aesRot(aesTe[(s1 >> 16) & 0xff], 8) ^
+         aesRot(aesTe[(s2 >> 8) & 0xff], 16) ^
+         aesRot(aesTe[s3 & 0xff], 24) ^ rk[0];
+    t1 = aesTe[s1 >> 24] ^ aesRot(aesTe[(s2 >> 16) & 0xff], 8) ^
+         aesRot(aesTe[(s3 >> 8) & 0xff], 16) ^
+         aesRot(aesTe[s0 & 0xff], 24) ^ rk[1];
+    t2 = aesTe[s2 >> 24] ^ aesRot(aesTe[(s3 >> 16) & 0xff], 8) ^
+         aesRot(aesTe[(s0 >> 8) & 0xff], 16) ^
+         aesRot(aesTe[s1 & 0xff], 24) ^ rk[2];
+    t3 = aesTe[s3 >> 24] ^ aesRot(aesTe[(s0 >> 16) & 0xff], 8) ^
+         aesRot(aesTe[(s1 >> 8) & 0xff], 16) ^
+         aesRot(aesTe[s2 & 0xff], 24) ^ rk[3];
+    s0 = t0;
+    s1 = t1;
+    s2 = t2;
+    s3 = t3;
+  }
+  rk += 4;
+  aesPutWord(out, ((Guint)aesSbox[s0 >> 24] << 24) ^
+		  ((Guint)aesSbox[(s1 >> 16) & 0xff] << 16) ^
+		  ((Guint)aesSbox[(s2 >> 8) & 0xff] << 8) ^
+		  (Guint)aesSbox[s3 & 0xff] ^ rk[0]);
+  aesPutWord(out + 4, ((Guint)aesSbox[s1 >> 24] << 24) ^
+		      ((Guint)aesSbox[(s2 >> 16) & 0xff] << 16) ^
+		      ((Guint)aesSbox[(s3 >> 8) & 0xff] << 8) ^
+		      (Guint)aesSbox[s0 & 0xff] ^ rk[1]);
+  aesPutWord(out + 8, ((Guint)aesSbox[s2 >> 24] << 24) ^
+		      ((Guint)aesSbox[(s3 >> 16) & 0xff] << 16) ^
+		      ((Guint)aesSbox[(s0 >> 8) & 0xff] << 8) ^
+		      (Guint)aesSbox[s1 & 0xff] ^ rk[2]);
+  aesPutWord(out + 12, ((Guint)aesSbox[s3 >> 24] << 24) ^
+		       ((Guint)aesSbox[(s0 >> 16) & 0xff] << 16) ^
+		       ((Guint)aesSbox[(s1 >> 8) & 0xff] << 8) ^
+		       (Guint)aesSbox[s2 & 0xff] ^ rk[3]);
+}
+
+static void aesDecryptBlock(Guint *rk, int rounds, Guchar *in, Guchar *out) {
+  Guint s0, s1, s2, s3, t0, t1, t2, t3;
+  int r;
+
+  s0 = aesGetWord(in) ^ rk[0];
+  s1 = aesGetWord(in + 4) ^ rk[1];
+  s2 = aesGetWord(in + 8) ^ rk[2];
+  s3 = aesGetWord(in + 12) ^ rk[3];
+  for (r = 1; r < rounds; ++r) {
+    rk += 4;
+    t0 = aesTd[s0 >> 24] ^ aesRot(aesTd[(s3 >> 16) & 0xff], 8) ^
+         aesRot(aesTd[(s2 >> 8) & 0xff], 16) ^
+         aesRot(aesTd[s1 & 0xff], 24) ^ rk[0];
+    t1 = aesTd[s1 >> 24] ^ aesRot(aesTd[(s0 >> 16) & 0xff], 8) ^
+         aesRot(aesTd[(s3 >> 8) & 0xff], 16) ^
+         aesRot(aesTd[s2 & 0xff], 24) ^ rk[1];
+    t2 = aesTd[s2 >> 24] ^ aesRot(aesTd[(s1 >> 16) & 0xff], 8) ^
+         aesRot(aesTd[(s0 >> 8) & 0xff], 16) ^
+         aesRot(aesTd[s3 & 0xff], 24) ^ rk[2];
+    t3 = aesTd[s3 >> 24] ^ aesRot(aesTd[(s2 >> 16) & 0xff], 8) ^
+         aesRot(aesTd[(s1 >> 8) & 0xff], 16) ^
+         aesRot(aesTd[s0 & 0xff], 24) ^ rk[3];
+    s0 = t0;
+    s1 = t1;
+    s2 = t2;
+    s3 = t3;
+  }
+  rk += 4;
+  aesPutWord(out, ((Guint)aesInvSbox[s0 >> 24] << 24) ^
+		  ((Guint)aesInvSbox[(s3 >> 16) & 0xff] << 16) ^
+		  ((Guint)aesInvSbox[(s2 >> 8) & 0xff] << 8) ^
+		  (Guint)aesInvSbox[s1 & 0xff] ^ rk[0]);
+  aesPutWord(out + 4, ((Guint)aesInvSbox[s1 >> 24] << 24) ^
+		      ((Guint)aesInvSbox[(s0 >> 16) & 0xff] << 16) ^
+		      ((Guint)aesInvSbox[(s3 >> 8) & 0xff] << 8) ^
+		      (Guint)aesInvSbox[s2 & 0xff] ^ rk[1]);
+  aesPutWord(out + 8, ((Guint)aesInvSbox[s2 >> 24] << 24) ^
+		      ((Guint)aesInvSbox[(s1 >> 16) & 0xff] << 16) ^
+		      ((Guint)aesInvSbox[(s0 >> 8) & 0xff] << 8) ^
+		      (Guint)aesInvSbox[s3 & 0xff] ^ rk[2]);
+  aesPutWord(out + 12, ((Guint)aesInvSbox[s3 >> 24] << 24) ^
+		       ((Guint)aesInvSbox[(s2 >> 16) & 0xff] << 16) ^
+		       ((Guint)aesInvSbox[(s1 >> 8) & 0xff] << 8) ^
+		       (Guint)aesInvSbox[s0 & 0xff] ^ rk[3]);
+}
+
+// Decrypt <n> bytes (a multiple of 16) with AES-256 in CBC mode, with
+// a zero IV and no padding, as for the OE and UE strings.
+static void aes256DecryptCBC(Guchar *key, Guchar *in, Guchar *out, int n) {
+  Guint rk[60];
+  Guchar iv[16], block[16];
+  int rounds, i, j;
+
+  rounds = aesKeyExpansion(key, 32, rk);
+  aesDecryptKeys(rk, rounds);
+  memset(iv, 0, 16);
+  for (i = 0; i < n; i += 16) {
+    aesDecryptBlock(rk, rounds, in + i, block);
+    for (j = 0; j < 16; ++j) {
+      out[i + j] = block[j] ^ iv[j];
+    }
+    memcpy(iv, in + i, 16);
+  }
 }
 
 //------------------------------------------------------------------------
@@ -383,3 +929,220 @@ static void md5(Guchar *msg, int msgLen, Guchar *digest) {
   digest[14] = (d >>= 8) & 0xff;
   digest[15] = (d >>= 8) & 0xff;
 }
+
+//------------------------------------------------------------------------
+// SHA-256, SHA-384 and SHA-512 message digests
+//------------------------------------------------------------------------
+
+static Guint sha256K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+  0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+  0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+  0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+  0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+  0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline Guint sha256Rot(Guint x, int r) {
+  return (x >> r) | (x << (32 - r));
+}
+
+static void sha256Block(Guint *h, Guchar *blk) {
+  Guint w[64];
+  Guint a, b, c, d, e, f, g, hh, t1, t2;
+  int i;
+
+  for (i = 0; i < 16; ++i) {
+    w[i] = ((Guint)blk[4*i] << 24) | ((Guint)blk[4*i+1] << 16) |
+           ((Guint)blk[4*i+2] << 8) | (Guint)blk[4*i+3];
+  }
+  for (i = 16; i < 64; ++i) {
+    w[i] = (sha256Rot(w[i-2], 17) ^ sha256Rot(w[i-2], 19) ^ (w[i-2] >> 10)) +
+           w[i-7] +
+           (sha256Rot(w[i-15], 7) ^ sha256Rot(w[i-15], 18) ^ (w[i-15] >> 3)) +
+           w[i-16];
+  }
+  a = h[0]; b = h[1]; c = h[2]; d = h[3];
+  e = h[4]; f = h[5]; g = h[6]; hh = h[7];
+  for (i = 0; i < 64; ++i) {
+    t1 = hh + (sha256Rot(e, 6) ^ sha256Rot(e, 11) ^ sha256Rot(e, 25)) +
+         ((e & f) ^ (~e & g)) + sha256K[i] + w[i];
+    t2 = (sha256Rot(a, 2) ^ sha256Rot(a, 13) ^ sha256Rot(a, 22)) +
+         ((a & b) ^ (a & c) ^ (b & c));
+    hh = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+  h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+  h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+}
+
+static void sha256(Guchar *msg, int msgLen, Guchar *hash) {
+  Guint h[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+  };
+  Guchar blk[64];
+  int i, n;
+
+  for (i = 0; i + 64 <= msgLen; i += 64) {
+    sha256Block(h, msg + i);
+  }
+  n = msgLen - i;
+  memcpy(blk, msg + i, n);
+  blk[n++] = 0x80;
+  if (n > 56) {
+    memset(blk + n, 0, 64 - n);
+    sha256Block(h, blk);
+    n = 0;
+  }
+  memset(blk + n, 0, 56 - n);
+  blk[56] = 0;
+  blk[57] = 0;
+  blk[58] = 0;
+  blk[59] = (Guchar)(msgLen >> 29);
+  blk[60] = (Guchar)(msgLen >> 21);
+  blk[61] = (Guchar)(msgLen >> 13);
+  blk[62] = (Guchar)(msgLen >> 5);
+  blk[63] = (Guchar)(msgLen << 3);
+  sha256Block(h, blk);
+  for (i = 0; i < 8; ++i) {
+    hash[4*i] = (Guchar)(h[i] >> 24);
+    hash[4*i+1] = (Guchar)(h[i] >> 16);
+    hash[4*i+2] = (Guchar)(h[i] >> 8);
+    hash[4*i+3] = (Guchar)h[i];
+  }
+}
+
+typedef unsigned long long Sha512Word;
+
+static Sha512Word sha512K[80] = {
+  0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
+  0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+  0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+  0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+  0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
+  0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+  0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL,
+  0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+  0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+  0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+  0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL,
+  0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+  0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL,
+  0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+  0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+  0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+  0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL,
+  0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+  0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL,
+  0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+  0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+  0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+  0xd192e819d6ef5218ULL, 0xd69906245565a910ULL,
+  0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+  0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
+  0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+  0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+  0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+  0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL,
+  0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+  0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL,
+  0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+  0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+  0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+  0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
+  0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+  0x28db77f523047d84ULL, 0x32caab7b40c72493ULL,
+  0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+  0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+  0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+static inline Sha512Word sha512Rot(Sha512Word x, int r) {
+  return (x >> r) | (x << (64 - r));
+}
+
+static void sha512Block(Sha512Word *h, Guchar *blk) {
+  Sha512Word w[80];
+  Sha512Word a, b, c, d, e, f, g, hh, t1, t2;
+  int i, j;
+
+  for (i = 0; i < 16; ++i) {
+    w[i] = 0;
+    for (j = 0; j < 8; ++j) {
+      w[i] = (w[i] << 8) | blk[8*i+j];
+    }
+  }
+  for (i = 16; i < 80; ++i) {
+    w[i] = (sha512Rot(w[i-2], 19) ^ sha512Rot(w[i-2], 61) ^ (w[i-2] >> 6)) +
+           w[i-7] +
+           (sha512Rot(w[i-15], 1) ^ sha512Rot(w[i-15], 8) ^ (w[i-15] >> 7)) +
+           w[i-16];
+  }
+  a = h[0]; b = h[1]; c = h[2]; d = h[3];
+  e = h[4]; f = h[5]; g = h[6]; hh = h[7];
+  for (i = 0; i < 80; ++i) {
+    t1 = hh + (sha512Rot(e, 14) ^ sha512Rot(e, 18) ^ sha512Rot(e, 41)) +
+         ((e & f) ^ (~e & g)) + sha512K[i] + w[i];
+    t2 = (sha512Rot(a, 28) ^ sha512Rot(a, 34) ^ sha512Rot(a, 39)) +
+         ((a & b) ^ (a & c) ^ (b & c));
+    hh = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+  h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+  h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+}
+
+// Computes SHA-512 (<hashLen> = 64) or SHA-384 (<hashLen> = 48).
+static void sha512(Guchar *msg, int msgLen, Guchar *hash, int hashLen) {
+  Sha512Word h512[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+    0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+    0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+  };
+  Sha512Word h384[8] = {
+    0xcbbb9d5dc1059ed8ULL, 0x629a292a367cd507ULL,
+    0x9159015a3070dd17ULL, 0x152fecd8f70e5939ULL,
+    0x67332667ffc00b31ULL, 0x8eb44a8768581511ULL,
+    0xdb0c2e0d64f98fa7ULL, 0x47b5481dbefa4fa4ULL
+  };
+  Sha512Word h[8];
+  Guchar blk[128];
+  int i, j, n;
+
+  memcpy(h, hashLen == 48 ? h384 : h512, sizeof(h));
+  for (i = 0; i + 128 <= msgLen; i += 128) {
+    sha512Block(h, msg + i);
+  }
+  n = msgLen - i;
+  memcpy(blk, msg + i, n);
+  blk[n++] = 0x80;
+  if (n > 112) {
+    memset(blk + n, 0, 128 - n);
+    sha512Block(h, blk);
+    n = 0;
+  }
+  memset(blk + n, 0, 128 - n);
+  blk[123] = (Guchar)(msgLen >> 29);
+  blk[124] = (Guchar)(msgLen >> 21);
+  blk[125] = (Guchar)(msgLen >> 13);
+  blk[126] = (Guchar)(msgLen >> 5);
+  blk[127] = (Guchar)(msgLen << 3);
+  sha512Block(h, blk);
+  for (i = 0; i < hashLen / 8; ++i) {
+    for (j = 0; j < 8; ++j) {
+      hash[8*i+j] = (Guchar)(h[i] >> (56 - 8 * j));
+    }
+  }
+}
@@ -16,6 +16,20 @@
 #include "../goo/gtypes.h"
 class GString;
 
+//------------------------------------------------------------------------
+
+// Encryption applied to strings or streams, as chosen by the crypt
+// filters of the Standard security handler.
+enum CryptAlgorithm {
+  cryptNone,			// Identity crypt filter
+  cryptRC4,			// RC4 (V 1 and 2, or CFM V2)
+  cryptAES,			// AES-128, CBC mode (CFM AESV2)
+  cryptAES256			// AES-256, CBC mode (CFM AESV3)
+};
+
+// Largest file key, in bytes.
+#define maxFileKeyLength 32
+
 //------------------------------------------------------------------------
 // Decrypt
 //------------------------------------------------------------------------
@@ -24,22 +38,35 @@ class Decrypt {
 public:
 
   // Initialize the decryptor object.
-  Decrypt(Guchar *fileKey, int keyLength, int objNum, int objGen);
+  Decrypt(Guchar *fileKey, int keyLength, CryptAlgorithm algA,
+	  int objNum, int objGen);
 
   // Reset decryption.
   void reset();
 
-  // Decrypt one byte.
-  Guchar decryptByte(Guchar c);
+  // Decrypt <n> bytes from <in> to <out>; <last> is set on the final
+  // call for the string or stream.  Returns the number of bytes
+  // written.  RC4 writes exactly <n> bytes, and <in> and <out> may be
+  // the same.  AES uses the first 16 bytes as its IV, holds back the
+  // last block until <last> to strip its padding, and may write up
+  // to <n> + 32 bytes; <in> and <out> must not overlap.
+  int decryptBlock(Guchar *in, Guchar *out, int n, GBool last);
+
+  // Is this an RC4 decryptor (i.e., one that keeps the data length)?
+  GBool isRC4() { return alg == cryptRC4; }
 
   // Generate a file key.  The <fileKey> buffer must have space for at
-  // least 16 bytes.  Checks <ownerPassword> and then <userPassword>
-  // and returns true if either is correct.  Sets <ownerPasswordOk> if
-  // the owner password was correct.  Either or both of the passwords
-  // may be NULL, which is treated as an empty string.
+  // least maxFileKeyLength bytes.  Checks <ownerPassword> and then
+  // <userPassword> and returns true if either is correct.  Sets
+  // <ownerPasswordOk> if the owner password was correct.  Either or
+  // both of the passwords may be NULL, which is treated as an empty
+  // string.  <ownerEnc> and <userEnc> (the OE and UE entries) are only
+  // used for revisions 5 and 6.
   static GBool makeFileKey(int encVersion, int encRevision, int keyLength,
 			   GString *ownerKey, GString *userKey,
+			   GString *ownerEnc, GString *userEnc,
 			   int permissions, GString *fileID,
+			   GBool encryptMetadata,
 			   GString *ownerPassword, GString *userPassword,
 			   Guchar *fileKey, GBool *ownerPasswordOk);
 
@@ -48,12 +75,32 @@ private:
   static GBool makeFileKey2(int encVersion, int encRevision, int keyLength,
 			    GString *ownerKey, GString *userKey,
 			    int permissions, GString *fileID,
+			    GBool encryptMetadata,
 			    GString *userPassword, Guchar *fileKey);
+  static GBool makeFileKey256(int encRevision,
+			      GString *ownerKey, GString *userKey,
+			      GString *ownerEnc, GString *userEnc,
+			      GString *ownerPassword, GString *userPassword,
+			      Guchar *fileKey, GBool *ownerPasswordOk);
+  void aesBlock(Guchar *in, Guchar *out, int *nOut);
 
+  CryptAlgorithm alg;
   int objKeyLength;
-  Guchar objKey[21];
-  Guchar state[256];
+  Guchar objKey[maxFileKeyLength];
+
+  // RC4
+  Guint state[256];
   Guchar x, y;
+
+  // AES
+  Guint aesKey[60];		// decryption round keys
+  int aesRounds;		// 10 or 14
+  Guchar iv[16];		// previous cipher text block
+  GBool ivSet;			// set once the IV has been read
+  Guchar partial[16];		// incomplete block from the last call
+  int partialLen;		// bytes in <partial>
+  Guchar held[16];		// last decrypted block, not yet written
+  GBool haveHeld;		// set if <held> is valid
 };
 
 #endif
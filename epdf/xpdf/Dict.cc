@@ -17,6 +17,10 @@
 #include "Dict.h"
 #include "Object.h"
 
+// Dictionaries with more than this many entries get a hash index;
+// smaller ones are searched linearly.
+#define dictIndexThreshold 16
+
 //------------------------------------------------------------------------
 // Dict
 //------------------------------------------------------------------------
@@ -26,44 +30,127 @@ Dict::Dict(XRef *xrefA) {
   entries = NULL;
   size = length = 0;
   ref = 1;
+  index = NULL;
+  indexSize = 0;
 }
 
 Dict::~Dict() {
   int i;
 
   for (i = 0; i < length; ++i) {
-    gfree(entries[i].key);
     entries[i].val->free();
 	gfree(entries[i].val);
   }
   gfree(entries);
+  gfree(index);
 }
 
 void Dict::add(char *key, Object *val) {
+  add(NameTable::intern(key), val);
+  gfree(key);
+}
+
+void Dict::add(NameAtom key, Object *val) {
   if (length + 1 > size) {
-    size += 8;
+    size = size ? 2 * size : 8;
     entries = (DictEntry *)grealloc(entries, size * sizeof(DictEntry));
   }
   entries[length].key = key;
   entries[length].val = (Object *)gmalloc(sizeof(Object));
   entries[length].val[0] = *val;
   ++length;
+  if (index) {
+    if (2 * length > indexSize) {
+      buildIndex();
+    } else {
+      addToIndex(length - 1);
+    }
+  } else if (length > dictIndexThreshold) {
+    buildIndex();
+  }
 }
 
-inline DictEntry *Dict::find(char *key) {
+// (Re)build the hash index, sized to keep the load factor under 1/2.
+void Dict::buildIndex() {
   int i;
 
+  indexSize = 2 * dictIndexThreshold;
+  while (indexSize < 4 * length) {
+    indexSize *= 2;
+  }
+  gfree(index);
+  index = (int *)gmalloc(indexSize * sizeof(int));
+  for (i = 0; i < indexSize; ++i) {
+    index[i] = -1;
+  }
   for (i = 0; i < length; ++i) {
-    if (!strcmp(key, entries[i].key))
+    addToIndex(i);
+  }
+}
+
+// Insert entry <i> into the index.  If the key is already present,
+// the earlier entry is kept, matching the linear search.  Atoms are
+// assigned sequentially, so the atom itself is used as the hash.
+void Dict::addToIndex(int i) {
+  NameAtom key;
+  int h, j;
+
+  key = entries[i].key;
+  h = key & (indexSize - 1);
+  while ((j = index[h]) >= 0) {
+    if (entries[j].key == key) {
+      return;
+    }
+    h = (h + 1) & (indexSize - 1);
+  }
+  index[h] = i;
+}
+
+// Keys which failed to intern are atomNone; they match nothing.
+inline DictEntry *Dict::find(NameAtom key) {
+  int h, i;
+
+  if (key == atomNone) {
+    return NULL;
+  }
+  if (index) {
+    h = key & (indexSize - 1);
+    while ((i = index[h]) >= 0) {
+      if (entries[i].key == key) {
+	return &entries[i];
+      }
+      h = (h + 1) & (indexSize - 1);
+    }
+    return NULL;
+  }
+  for (i = 0; i < length; ++i) {
+    if (entries[i].key == key)
       return &entries[i];
   }
   return NULL;
 }
 
+// Small dictionaries are searched by string, which doesn't need the
+// name table's lock.
+DictEntry *Dict::find(char *key) {
+  int i;
+
+  if (index) {
+    return find(NameTable::find(key));
+  }
+  for (i = 0; i < length; ++i) {
+    if (entries[i].key != atomNone &&
+	!strcmp(NameTable::getString(entries[i].key), key)) {
+      return &entries[i];
+    }
+  }
+  return NULL;
+}
+
 GBool Dict::is(char *type) {
   DictEntry *e;
 
-  return (e = find("Type")) && e->val->isName(type);
+  return (e = find(atomType)) && e->val->isName(type);
 }
 
 Object *Dict::lookup(char *key, Object *obj) {
@@ -78,7 +165,23 @@ Object *Dict::lookupNF(char *key, Object *obj) {
   return (e = find(key)) ? e->val->copy(obj) : obj->initNull();
 }
 
+Object *Dict::lookup(NameAtom key, Object *obj) {
+  DictEntry *e;
+
+  return (e = find(key)) ? e->val->fetch(xref, obj) : obj->initNull();
+}
+
+Object *Dict::lookupNF(NameAtom key, Object *obj) {
+  DictEntry *e;
+
+  return (e = find(key)) ? e->val->copy(obj) : obj->initNull();
+}
+
 char *Dict::getKey(int i) {
+  return NameTable::getString(entries[i].key);
+}
+
+NameAtom Dict::getKeyAtom(int i) {
   return entries[i].key;
 }
 
@@ -14,6 +14,7 @@
 #endif
 
 #include "../goo/gtypes.h"
+#include "NameTable.h"
 class XRef;
 class Object;
 //------------------------------------------------------------------------
@@ -21,7 +22,7 @@ class Object;
 //------------------------------------------------------------------------
 
 struct DictEntry {
-  char *key;
+  NameAtom key;
   Object *val;
 };
 
@@ -41,8 +42,9 @@ public:
   // Get number of entries.
   int getLength() { return length; }
 
-  // Add an entry.  NB: does not copy key.
+  // Add an entry.  NB: <key> is interned and then freed.
   void add(char *key, Object *val);
+  void add(NameAtom key, Object *val);
 
   // Check if dictionary is of specified type.
   GBool is(char *type);
@@ -51,9 +53,12 @@ public:
   // if <key> is not in the dictionary.
   Object *lookup(char *key, Object *obj);
   Object *lookupNF(char *key, Object *obj);
+  Object *lookup(NameAtom key, Object *obj);
+  Object *lookupNF(NameAtom key, Object *obj);
 
   // Iterative accessors.
   char *getKey(int i);
+  NameAtom getKeyAtom(int i);
   Object *getVal(int i, Object *obj);
   Object *getValNF(int i, Object *obj);
 
@@ -69,8 +74,15 @@ private:
   int size;			// size of <entries> array
   int length;			// number of entries in dictionary
   int ref;			// reference count
+  int *index;			// open-addressing hash table of indexes
+				//   into <entries> (-1 = empty), built
+				//   once the dictionary gets large
+  int indexSize;		// size of <index> (power of 2)
 
+  DictEntry *find(NameAtom key);
   DictEntry *find(char *key);
+  void buildIndex();
+  void addToIndex(int i);
 };
 
 #endif
@@ -0,0 +1,497 @@
+//========================================================================
+//
+// DisplayList.cc
+//
+// Recorded content stream operators, and the cache that keeps them.
+//
+//========================================================================
+
+#ifdef __GNUC__
+#pragma implementation
+#endif
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "../goo/gmem.h"
+#include "../goo/GString.h"
+#include "Object.h"
+#include "NameTable.h"
+#include "DisplayList.h"
+
+//------------------------------------------------------------------------
+
+// Lists are saved with Gfx's operator numbers: change the magic
+// number when its operator table changes.
+#define displayListMagic 0x314c4445	// "EDL1"
+#define displayListMaxDepth 32	// max nesting of arrays and dicts in
+				//   a list read from a file
+
+static GBool writeInt(FILE *f, int x) {
+  return fwrite(&x, sizeof(int), 1, f) == 1;
+}
+
+static GBool readInt(FILE *f, int *x) {
+  return fread(x, sizeof(int), 1, f) == 1;
+}
+
+static GBool writeBytes(FILE *f, char *p, int n) {
+  return writeInt(f, n) && (n == 0 || fwrite(p, 1, n, f) == (size_t)n);
+}
+
+// Read a byte string written by writeBytes.  It is read in pieces,
+// so a bad length can't cause a huge allocation.
+static GString *readBytes(FILE *f) {
+  GString *s;
+  char buf[4096];
+  int n, k;
+
+  if (!readInt(f, &n) || n < 0) {
+    return NULL;
+  }
+  s = new GString();
+  while (n > 0) {
+    k = n < (int)sizeof(buf) ? n : (int)sizeof(buf);
+    if (fread(buf, 1, k, f) != (size_t)k) {
+      delete s;
+      return NULL;
+    }
+    s->append(buf, k);
+    n -= k;
+  }
+  return s;
+}
+
+// Write an operand: its type, then its value.
+static GBool writeObj(FILE *f, Object *obj) {
+  Object obj1;
+  double x;
+  char *key;
+  GBool ok;
+  int i;
+
+  if (!writeInt(f, (int)obj->getType())) {
+    return gFalse;
+  }
+  switch (obj->getType()) {
+  case objBool:
+    return writeInt(f, obj->getBool() ? 1 : 0);
+  case objInt:
+    return writeInt(f, obj->getInt());
+  case objReal:
+    x = static_cast<double>(obj->getReal());
+    return fwrite(&x, sizeof(double), 1, f) == 1;
+  case objString:
+    return writeBytes(f, obj->getString()->getCString(),
+		      obj->getString()->getLength());
+  case objName:
+    return writeBytes(f, obj->getName(), strlen(obj->getName()));
+  case objNull:
+    return gTrue;
+  case objArray:
+    if (!writeInt(f, obj->arrayGetLength())) {
+      return gFalse;
+    }
+    for (i = 0; i < obj->arrayGetLength(); ++i) {
+      ok = writeObj(f, obj->arrayGetNF(i, &obj1));
+      obj1.free();
+      if (!ok) {
+	return gFalse;
+      }
+    }
+    return gTrue;
+  case objDict:
+    if (!writeInt(f, obj->dictGetLength())) {
+      return gFalse;
+    }
+    for (i = 0; i < obj->dictGetLength(); ++i) {
+      key = obj->dictGetKey(i);
+      if (!writeBytes(f, key, strlen(key))) {
+	return gFalse;
+      }
+      ok = writeObj(f, obj->dictGetValNF(i, &obj1));
+      obj1.free();
+      if (!ok) {
+	return gFalse;
+      }
+    }
+    return gTrue;
+  case objRef:
+    return writeInt(f, obj->getRefNum()) && writeInt(f, obj->getRefGen());
+  default:
+    return gFalse;
+  }
+}
+
+// Read an operand written by writeObj.  On failure, <obj> is left as
+// a null object.
+static GBool readObj(FILE *f, XRef *xref, Object *obj, int depth) {
+  Object obj1;
+  GString *s;
+  double x;
+  int type, n, i, num, gen;
+
+  obj->initNull();
+  if (!readInt(f, &type)) {
+    return gFalse;
+  }
+  switch (type) {
+  case objBool:
+    if (!readInt(f, &n)) {
+      return gFalse;
+    }
+    obj->initBool(n != 0);
+    return gTrue;
+  case objInt:
+    if (!readInt(f, &n)) {
+      return gFalse;
+    }
+    obj->initInt(n);
+    return gTrue;
+  case objReal:
+    if (fread(&x, sizeof(double), 1, f) != 1) {
+      return gFalse;
+    }
+    obj->initReal(x);
+    return gTrue;
+  case objString:
+    if (!(s = readBytes(f))) {
+      return gFalse;
+    }
+    obj->initString(s);
+    return gTrue;
+  case objName:
+    if (!(s = readBytes(f))) {
+      return gFalse;
+    }
+    obj->initName(s->getCString());
+    delete s;
+    return gTrue;
+  case objNull:
+    return gTrue;
+  case objArray:
+    if (depth >= displayListMaxDepth || !readInt(f, &n) || n < 0) {
+      return gFalse;
+    }
+    obj->initArray(xref);
+    for (i = 0; i < n; ++i) {
+      if (!readObj(f, xref, &obj1, depth + 1)) {
+	obj->free();
+	obj->initNull();
+	return gFalse;
+      }
+      obj->arrayAdd(&obj1);
+    }
+    return gTrue;
+  case objDict:
+    if (depth >= displayListMaxDepth || !readInt(f, &n) || n < 0) {
+      return gFalse;
+    }
+    obj->initDict(xref);
+    for (i = 0; i < n; ++i) {
+      if (!(s = readBytes(f))) {
+	obj->free();
+	obj->initNull();
+	return gFalse;
+      }
+      if (!readObj(f, xref, &obj1, depth + 1)) {
+	delete s;
+	obj->free();
+	obj->initNull();
+	return gFalse;
+      }
+      obj->dictAdd(NameTable::intern(s->getCString()), &obj1);
+      delete s;
+    }
+    return gTrue;
+  case objRef:
+    if (!readInt(f, &num) || !readInt(f, &gen)) {
+      return gFalse;
+    }
+    obj->initRef(num, gen);
+    return gTrue;
+  default:
+    return gFalse;
+  }
+}
+
+//------------------------------------------------------------------------
+// DisplayList
+//------------------------------------------------------------------------
+
+DisplayList::DisplayList(int maxBytesA) {
+  ops = NULL;
+  nOps = opsSize = 0;
+  args = NULL;
+  nArgs = argsSize = 0;
+  bytes = sizeof(DisplayList);
+  maxBytes = maxBytesA;
+  complete = gTrue;
+  ref = 1;
+}
+
+DisplayList::~DisplayList() {
+  int i;
+
+  for (i = 0; i < nArgs; ++i) {
+    args[i].free();
+  }
+  gfree(args);
+  gfree(ops);
+}
+
+void DisplayList::addOp(int op, Object *argsA, int numArgsA) {
+  DisplayListOp *p;
+  int i;
+
+  if (!complete) {
+    return;
+  }
+  expandOps();
+  expandArgs(numArgsA);
+  p = &ops[nOps++];
+  p->op = op;
+  p->firstArg = nArgs;
+  p->numArgs = numArgsA;
+  bytes += sizeof(DisplayListOp);
+  for (i = 0; i < numArgsA; ++i) {
+    args[nArgs++] = argsA[i];
+    bytes += argsA[i].getSize();
+    argsA[i].initNull();
+  }
+  if (maxBytes > 0 && bytes > maxBytes) {
+    abandon();
+  }
+}
+
+// Make room for one more operator.
+void DisplayList::expandOps() {
+  if (nOps == opsSize) {
+    opsSize = opsSize ? 2 * opsSize : 64;
+    ops = (DisplayListOp *)grealloc(ops, opsSize * sizeof(DisplayListOp));
+  }
+}
+
+// Make room for <n> more operands.
+void DisplayList::expandArgs(int n) {
+  if (nArgs + n > argsSize) {
+    argsSize = argsSize ? 2 * argsSize : 128;
+    if (argsSize < nArgs + n) {
+      argsSize = nArgs + n;
+    }
+    args = (Object *)grealloc(args, argsSize * sizeof(Object));
+  }
+}
+
+void DisplayList::abandon() {
+  int i;
+
+  complete = gFalse;
+  for (i = 0; i < nArgs; ++i) {
+    args[i].free();
+  }
+  gfree(args);
+  args = NULL;
+  nArgs = argsSize = 0;
+  gfree(ops);
+  ops = NULL;
+  nOps = opsSize = 0;
+  bytes = sizeof(DisplayList);
+}
+
+// The file holds a header (magic number, number of operators, number
+// of operands), the operator number and operand count of each
+// operator, and then all the operands.
+GBool DisplayList::write(FILE *f) {
+  int i;
+
+  if (!complete) {
+    return gFalse;
+  }
+  if (!writeInt(f, displayListMagic) || !writeInt(f, nOps) ||
+      !writeInt(f, nArgs)) {
+    return gFalse;
+  }
+  for (i = 0; i < nOps; ++i) {
+    if (!writeInt(f, ops[i].op) || !writeInt(f, ops[i].numArgs)) {
+      return gFalse;
+    }
+  }
+  for (i = 0; i < nArgs; ++i) {
+    if (!writeObj(f, &args[i])) {
+      return gFalse;
+    }
+  }
+  return gTrue;
+}
+
+DisplayList *DisplayList::read(FILE *f, XRef *xref) {
+  DisplayList *list;
+  DisplayListOp *p;
+  Object obj;
+  int magic, nOpsA, nArgsA, op, n, first, i;
+
+  if (!readInt(f, &magic) || magic != displayListMagic ||
+      !readInt(f, &nOpsA) || !readInt(f, &nArgsA) ||
+      nOpsA < 0 || nArgsA < 0) {
+    return NULL;
+  }
+
+  // the arrays are grown as the data is read, so a bad count in the
+  // header can't cause a huge allocation
+  list = new DisplayList();
+  first = 0;
+  for (i = 0; i < nOpsA; ++i) {
+    if (!readInt(f, &op) || !readInt(f, &n) ||
+	n < 0 || n > nArgsA - first) {
+      goto err;
+    }
+    list->expandOps();
+    p = &list->ops[list->nOps++];
+    p->op = op;
+    p->firstArg = first;
+    p->numArgs = n;
+    first += n;
+    list->bytes += sizeof(DisplayListOp);
+  }
+  if (first != nArgsA) {
+    goto err;
+  }
+  for (i = 0; i < nArgsA; ++i) {
+    if (!readObj(f, xref, &obj, 0)) {
+      goto err;
+    }
+    list->expandArgs(1);
+    list->args[list->nArgs++] = obj;
+    list->bytes += obj.getSize();
+  }
+  return list;
+
+ err:
+  delete list;
+  return NULL;
+}
+
+//------------------------------------------------------------------------
+// DisplayListCache
+//------------------------------------------------------------------------
+
+struct DisplayListCacheEntry {
+  int num, gen;			// object ID
+  DisplayList *list;
+  DisplayListCacheEntry *hashNext;	// next entry in hash bucket
+  DisplayListCacheEntry *prev, *next;	// LRU list links
+};
+
+DisplayListCache::DisplayListCache(int maxBytesA) {
+  int i;
+
+  for (i = 0; i < displayListCacheHashSize; ++i) {
+    hash[i] = NULL;
+  }
+  head = tail = NULL;
+  bytes = 0;
+  maxBytes = maxBytesA;
+  hits = misses = 0;
+}
+
+DisplayListCache::~DisplayListCache() {
+  while (head) {
+    remove(head);
+  }
+}
+
+DisplayList *DisplayListCache::lookup(int num, int gen) {
+  DisplayListCacheEntry *e;
+
+  e = NULL;
+  if (num >= 0) {
+    for (e = hash[num % displayListCacheHashSize]; e; e = e->hashNext) {
+      if (e->num == num && e->gen == gen) {
+	break;
+      }
+    }
+  }
+  if (!e) {
+    ++misses;
+    return NULL;
+  }
+  ++hits;
+
+  // move it to the front of the LRU list
+  if (e != head) {
+    unlink(e);
+    e->prev = NULL;
+    e->next = head;
+    head->prev = e;
+    head = e;
+  }
+  e->list->incRef();
+  return e->list;
+}
+
+void DisplayListCache::add(int num, int gen, DisplayList *list) {
+  DisplayListCacheEntry *e;
+  int h;
+
+  if (num < 0 || list->getSize() > maxBytes) {
+    return;
+  }
+  h = num % displayListCacheHashSize;
+  for (e = hash[h]; e; e = e->hashNext) {
+    if (e->num == num && e->gen == gen) {
+      remove(e);
+      break;
+    }
+  }
+
+  e = new DisplayListCacheEntry;
+  e->num = num;
+  e->gen = gen;
+  e->list = list;
+  list->incRef();
+  e->hashNext = hash[h];
+  hash[h] = e;
+  e->prev = NULL;
+  e->next = head;
+  if (head) {
+    head->prev = e;
+  } else {
+    tail = e;
+  }
+  head = e;
+  bytes += list->getSize();
+
+  // lists that are being replayed have another reference, so they
+  // survive being dropped here
+  while (bytes > maxBytes) {
+    remove(tail);
+  }
+}
+
+void DisplayListCache::unlink(DisplayListCacheEntry *e) {
+  if (e->prev) {
+    e->prev->next = e->next;
+  } else {
+    head = e->next;
+  }
+  if (e->next) {
+    e->next->prev = e->prev;
+  } else {
+    tail = e->prev;
+  }
+}
+
+void DisplayListCache::remove(DisplayListCacheEntry *e) {
+  DisplayListCacheEntry **p;
+
+  unlink(e);
+  for (p = &hash[e->num % displayListCacheHashSize]; *p != e;
+       p = &(*p)->hashNext) ;
+  *p = e->hashNext;
+  bytes -= e->list->getSize();
+  if (!e->list->decRef()) {
+    delete e->list;
+  }
+  delete e;
+}
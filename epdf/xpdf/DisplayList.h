@@ -0,0 +1,157 @@
+//========================================================================
+//
+// DisplayList.h
+//
+// Recorded content stream operators, and the cache that keeps them.
+//
+//========================================================================
+
+#ifndef DISPLAYLIST_H
+#define DISPLAYLIST_H
+
+#ifdef __GNUC__
+#pragma interface
+#endif
+
+#include <stdio.h>
+#include "../goo/gtypes.h"
+#include "Object.h"
+
+class XRef;
+struct DisplayListCacheEntry;
+
+//------------------------------------------------------------------------
+// DisplayList
+//------------------------------------------------------------------------
+
+// One operator in a display list.
+struct DisplayListOp {
+  int op;			// operator (index into Gfx's table)
+  int firstArg;			// index of the first operand
+  int numArgs;			// number of operands
+};
+
+// A parsed content stream: its operators, each with its operands.
+// Gfx records one while interpreting a content stream (only operators
+// that passed the type checks are added), and can replay it without
+// lexing, parsing or checking the stream again.  Names in the operands
+// are kept as names: they are looked up in the resources each time the
+// list is replayed.  Nothing in the list depends on the output device
+// or the CTM, so a page's list can be replayed at any zoom or
+// rotation.
+
+class DisplayList {
+public:
+
+  // Constructor.  If <maxBytesA> is non-zero, the list is abandoned
+  // as soon as it gets bigger than that.
+  DisplayList(int maxBytesA = 0);
+
+  // Destructor.
+  ~DisplayList();
+
+  // Reference counting.
+  int incRef() { return ++ref; }
+  int decRef() { return --ref; }
+
+  // Append an operator.  The list takes over the operands, which are
+  // left as null objects.  Nothing is added (and the operands are
+  // left alone) once the list has been abandoned.
+  void addOp(int op, Object *argsA, int numArgsA);
+
+  // Mark the list as incomplete, and free what has been recorded:
+  // something in the content stream couldn't be recorded, or
+  // interpretation stopped before the end.
+  void abandon();
+  GBool isComplete() { return complete; }
+
+  // Accessors.
+  int getNumOps() { return nOps; }
+  DisplayListOp *getOp(int i) { return &ops[i]; }
+  Object *getArgs(DisplayListOp *op) { return &args[op->firstArg]; }
+
+  // Estimated number of bytes used by the list.
+  int getSize() { return bytes; }
+
+  // Write the list to <f>.  Returns false if the list is incomplete,
+  // contains an object that can't be written, or the write fails.
+  // The format uses the machine's byte order and Gfx's operator
+  // numbering, so it is only meant for a cache on the same machine.
+  GBool write(FILE *f);
+
+  // Read a list written by write().  Returns NULL if the data is
+  // invalid.  The operators and operands are not checked: the list
+  // must pass Gfx::checkList before it is replayed.
+  static DisplayList *read(FILE *f, XRef *xref);
+
+private:
+
+  void expandOps();
+  void expandArgs(int n);
+
+  DisplayListOp *ops;		// operators
+  int nOps;			// number of operators
+  int opsSize;			// size of <ops> array
+  Object *args;			// operands of all operators
+  int nArgs;			// number of operands
+  int argsSize;			// size of <args> array
+  int bytes;			// estimated size, not counting unused
+				//   space in the arrays
+  int maxBytes;			// limit on <bytes> (0 = none)
+  GBool complete;		// set unless abandon() has been called
+  int ref;			// reference count
+};
+
+//------------------------------------------------------------------------
+// DisplayListCache
+//------------------------------------------------------------------------
+
+#define displayListCacheHashSize 127
+
+// Display lists of content streams that are used more than once,
+// keyed by a pair of numbers: the object ID for form XObjects, or the
+// page number (and 0) for page contents.  The least recently used
+// lists are dropped to keep the total size within a limit.
+
+class DisplayListCache {
+public:
+
+  // Constructor.  <maxBytesA> is the limit on the total size of the
+  // cached lists.
+  DisplayListCache(int maxBytesA);
+
+  // Destructor.
+  ~DisplayListCache();
+
+  // Find the list for key <num>,<gen>.  Returns NULL if it isn't
+  // cached.  The caller gets a reference to the list, which it has to
+  // release with decRef.
+  DisplayList *lookup(int num, int gen);
+
+  // Add the list for key <num>,<gen> (the cache takes its own
+  // reference).  Lists bigger than the limit aren't added.
+  void add(int num, int gen, DisplayList *list);
+
+  // Statistics: lookups that found a list, and lookups that didn't.
+  int getHits() { return hits; }
+  int getMisses() { return misses; }
+
+  // Number of bytes used by the cached lists, and the limit.
+  int getBytes() { return bytes; }
+  int getMaxBytes() { return maxBytes; }
+
+private:
+
+  void unlink(DisplayListCacheEntry *e);
+  void remove(DisplayListCacheEntry *e);
+
+  DisplayListCacheEntry *	// hash table, by object number
+    hash[displayListCacheHashSize];
+  DisplayListCacheEntry *head;	// LRU list of entries, most recently
+  DisplayListCacheEntry *tail;	//   used first
+  int bytes;			// bytes used by the cached lists
+  int maxBytes;			// limit on <bytes>
+  int hits, misses;		// statistics
+};
+
+#endif
@@ -0,0 +1,283 @@
+//========================================================================
+//
+// DocCache.cc
+//
+// On-disk cache of the xref table and page list of each document.
+//
+//========================================================================
+
+#ifdef __GNUC__
+#pragma implementation
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "../goo/gmem.h"
+#include "../goo/gfile.h"
+#include "../goo/GString.h"
+#include "Stream.h"
+#include "GlobalParams.h"
+#include "DisplayList.h"
+#include "DocCache.h"
+
+//------------------------------------------------------------------------
+
+#define docCacheSampleSize 4096	// bytes hashed at each end of the file
+				//   for the cache key
+#define docCacheMagic 0x31434445	// "EDC1"
+#define docCacheHdrLen (docCacheKeyLen + 5)	// Guints in the header
+
+// FNV-1a hash.
+static Guint hashBytes(Guint h, char *p, int n) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    h = (h ^ (Guchar)p[i]) * 16777619;
+  }
+  return h;
+}
+
+//------------------------------------------------------------------------
+// DocCache
+//------------------------------------------------------------------------
+
+DocCache::DocCache(BaseStream *str, GString *fileName) {
+  loaded = gFalse;
+  entries = NULL;
+  xrefSize = 0;
+  trailerKind = 0;
+  trailerPos = lastXRefPos = 0;
+  pages = NULL;
+  numPages = 0;
+  cacheFile = makeKey(str, fileName, docCacheMagic,
+		      globalParams->getDocCacheDir(), "doc", key);
+  if (cacheFile) {
+    loaded = load();
+  }
+}
+
+DocCache::~DocCache() {
+  if (cacheFile) {
+    delete cacheFile;
+  }
+  gfree(entries);
+  gfree(pages);
+}
+
+GBool DocCache::load() {
+  FILE *f;
+  Guint hdr[docCacheHdrLen];
+  GBool ok;
+  int i;
+
+  if (!(f = fopen(cacheFile->getCString(), "rb"))) {
+    return gFalse;
+  }
+  ok = gFalse;
+  if (fread(hdr, sizeof(Guint), docCacheHdrLen, f) != docCacheHdrLen) {
+    goto done;
+  }
+  for (i = 0; i < docCacheKeyLen; ++i) {
+    if (hdr[i] != key[i]) {
+      goto done;
+    }
+  }
+  xrefSize = (int)hdr[docCacheKeyLen];
+  trailerKind = (int)hdr[docCacheKeyLen + 1];
+  trailerPos = hdr[docCacheKeyLen + 2];
+  lastXRefPos = hdr[docCacheKeyLen + 3];
+  numPages = (int)hdr[docCacheKeyLen + 4];
+  if (xrefSize <= 0 || xrefSize > INT_MAX / (int)sizeof(XRefEntry) ||
+      numPages <= 0 || numPages > INT_MAX / (int)sizeof(DocCachePage)) {
+    goto done;
+  }
+  entries = (XRefEntry *)gmalloc(xrefSize * sizeof(XRefEntry));
+  pages = (DocCachePage *)gmalloc(numPages * sizeof(DocCachePage));
+  if (fread(entries, sizeof(XRefEntry), xrefSize, f) != (size_t)xrefSize ||
+      fread(pages, sizeof(DocCachePage), numPages, f) != (size_t)numPages) {
+    goto done;
+  }
+  for (i = 0; i < xrefSize; ++i) {
+    if (entries[i].type != xrefEntryFree &&
+	entries[i].type != xrefEntryUncompressed &&
+	entries[i].type != xrefEntryCompressed) {
+      goto done;
+    }
+  }
+  for (i = 0; i < numPages; ++i) {
+    if (pages[i].ref.num < 0 || pages[i].ref.num >= xrefSize) {
+      goto done;
+    }
+  }
+  ok = gTrue;
+
+ done:
+  fclose(f);
+  if (!ok) {
+    gfree(entries);
+    entries = NULL;
+    xrefSize = 0;
+    gfree(pages);
+    pages = NULL;
+    numPages = 0;
+  }
+  return ok;
+}
+
+void DocCache::setXRef(XRefEntry *entriesA, int xrefSizeA, int trailerKindA,
+		       Guint trailerPosA, Guint lastXRefPosA) {
+  gfree(entries);
+  xrefSize = xrefSizeA;
+  entries = (XRefEntry *)gmalloc(xrefSize * sizeof(XRefEntry));
+  memcpy(entries, entriesA, xrefSize * sizeof(XRefEntry));
+  trailerKind = trailerKindA;
+  trailerPos = trailerPosA;
+  lastXRefPos = lastXRefPosA;
+}
+
+void DocCache::setPages(DocCachePage *pagesA, int numPagesA) {
+  gfree(pages);
+  numPages = numPagesA;
+  pages = (DocCachePage *)gmalloc(numPages * sizeof(DocCachePage));
+  memcpy(pages, pagesA, numPages * sizeof(DocCachePage));
+}
+
+// The file is written under a temporary name and then renamed, so a
+// reader never sees a partial file.
+void DocCache::save() {
+  FILE *f;
+  GString *tmpFile;
+  Guint hdr[docCacheHdrLen];
+  GBool ok;
+  int i;
+
+  if (!cacheFile || xrefSize <= 0 || numPages <= 0) {
+    return;
+  }
+  mkdir(globalParams->getDocCacheDir()->getCString(), 0700);
+  tmpFile = cacheFile->copy();
+  tmpFile->append(".tmp");
+  if (!(f = fopen(tmpFile->getCString(), "wb"))) {
+    delete tmpFile;
+    return;
+  }
+  for (i = 0; i < docCacheKeyLen; ++i) {
+    hdr[i] = key[i];
+  }
+  hdr[docCacheKeyLen] = (Guint)xrefSize;
+  hdr[docCacheKeyLen + 1] = (Guint)trailerKind;
+  hdr[docCacheKeyLen + 2] = trailerPos;
+  hdr[docCacheKeyLen + 3] = lastXRefPos;
+  hdr[docCacheKeyLen + 4] = (Guint)numPages;
+  ok = fwrite(hdr, sizeof(Guint), docCacheHdrLen, f) == docCacheHdrLen &&
+       fwrite(entries, sizeof(XRefEntry), xrefSize, f) ==
+         (size_t)xrefSize &&
+       fwrite(pages, sizeof(DocCachePage), numPages, f) ==
+         (size_t)numPages;
+  if (fclose(f) != 0) {
+    ok = gFalse;
+  }
+  if (!ok || rename(tmpFile->getCString(), cacheFile->getCString()) != 0) {
+    unlink(tmpFile->getCString());
+  }
+  delete tmpFile;
+}
+
+// Page list files are named after the cache entry: <hash>.p<page>,
+// next to <hash>.doc.
+GString *DocCache::getPageListFile(int pageNum) {
+  GString *name;
+  char ext[16];
+
+  name = cacheFile->copy();
+  name->del(name->getLength() - 3, 3);
+  sprintf(ext, "p%d", pageNum);
+  return name->append(ext);
+}
+
+// A page list file holds the key of the entry, then the list.
+DisplayList *DocCache::readPageList(int pageNum, XRef *xref) {
+  GString *name;
+  FILE *f;
+  Guint hdr[docCacheKeyLen];
+  DisplayList *list;
+  int i;
+
+  if (!cacheFile) {
+    return NULL;
+  }
+  name = getPageListFile(pageNum);
+  f = fopen(name->getCString(), "rb");
+  delete name;
+  if (!f) {
+    return NULL;
+  }
+  list = NULL;
+  if (fread(hdr, sizeof(Guint), docCacheKeyLen, f) == docCacheKeyLen) {
+    for (i = 0; i < docCacheKeyLen && hdr[i] == key[i]; ++i) ;
+    if (i == docCacheKeyLen) {
+      list = DisplayList::read(f, xref);
+    }
+  }
+  fclose(f);
+  return list;
+}
+
+void DocCache::writePageList(int pageNum, DisplayList *list) {
+  GString *name, *tmpFile;
+  FILE *f;
+  GBool ok;
+
+  if (!cacheFile) {
+    return;
+  }
+  mkdir(globalParams->getDocCacheDir()->getCString(), 0700);
+  name = getPageListFile(pageNum);
+  tmpFile = name->copy();
+  tmpFile->append(".tmp");
+  if ((f = fopen(tmpFile->getCString(), "wb"))) {
+    ok = fwrite(key, sizeof(Guint), docCacheKeyLen, f) == docCacheKeyLen &&
+         list->write(f);
+    if (fclose(f) != 0) {
+      ok = gFalse;
+    }
+    if (!ok || rename(tmpFile->getCString(), name->getCString()) != 0) {
+      unlink(tmpFile->getCString());
+    }
+  }
+  delete tmpFile;
+  delete name;
+}
+
+GString *DocCache::makeKey(BaseStream *str, GString *fileName, Guint magic,
+			   GString *dir, char *ext, Guint *key) {
+  struct stat st;
+  char buf[docCacheSampleSize];
+  char name[32];
+  Guint h;
+  int n, i;
+
+  if (stat(fileName->getCString(), &st) != 0) {
+    return NULL;
+  }
+  key[0] = magic;
+  key[1] = (Guint)st.st_size;
+  key[2] = (Guint)st.st_mtime;
+  str->setPos(0);
+  n = str->getBlock(buf, docCacheSampleSize);
+  key[3] = hashBytes(2166136261U, buf, n);
+  str->setPos(docCacheSampleSize, -1);
+  n = str->getBlock(buf, docCacheSampleSize);
+  key[4] = hashBytes(2166136261U, buf, n);
+
+  h = 2166136261U;
+  for (i = 1; i < docCacheKeyLen; ++i) {
+    h = hashBytes(h, (char *)&key[i], sizeof(Guint));
+  }
+  sprintf(name, "%08x%08x.%s", key[3] ^ key[4], h, ext);
+  return appendToPath(dir, name);
+}
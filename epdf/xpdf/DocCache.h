@@ -0,0 +1,112 @@
+//========================================================================
+//
+// DocCache.h
+//
+// On-disk cache of the xref table and page list of each document.
+//
+//========================================================================
+
+#ifndef DOCCACHE_H
+#define DOCCACHE_H
+
+#ifdef __GNUC__
+#pragma interface
+#endif
+
+#include "../goo/gtypes.h"
+#include "Object.h"
+#include "XRef.h"
+
+class GString;
+class BaseStream;
+class DisplayList;
+
+//------------------------------------------------------------------------
+
+// Number of Guints in a cache key (see DocCache::makeKey).
+#define docCacheKeyLen 5
+
+// What the document structure cache remembers about each page.
+struct DocCachePage {
+  Ref ref;			// page object ID
+  double x1, y1, x2, y2;	// page box (see Page::getBox)
+  int rotate;			// page rotation
+};
+
+//------------------------------------------------------------------------
+// DocCache
+//------------------------------------------------------------------------
+
+// The document structure cache saves the xref table and the page
+// list (object IDs, boxes, and rotation) of each file opened, so the
+// next time the file is opened, neither the xref table nor the page
+// tree has to be read.  Entries are keyed by the file's size,
+// modification time, and the contents of its first and last few KB.
+// The display lists of the pages drawn more than once are saved too,
+// each in a file of its own, next to the entry.
+
+class DocCache {
+public:
+
+  // Look up the cache entry for <fileName>, which is open as <str>.
+  DocCache(BaseStream *str, GString *fileName);
+
+  // Destructor.
+  ~DocCache();
+
+  // Was a valid cache entry found?
+  GBool isLoaded() { return loaded; }
+
+  // Get the cached xref table.
+  int getXRefSize() { return xrefSize; }
+  XRefEntry *getXRefEntries() { return entries; }
+  int getTrailerKind() { return trailerKind; }
+  Guint getTrailerPos() { return trailerPos; }
+  Guint getLastXRefPos() { return lastXRefPos; }
+
+  // Get the cached page list.
+  int getNumPages() { return numPages; }
+  DocCachePage *getPages() { return pages; }
+
+  // Set the xref table and page list.  The arrays are copied.
+  void setXRef(XRefEntry *entriesA, int xrefSizeA, int trailerKindA,
+	       Guint trailerPosA, Guint lastXRefPosA);
+  void setPages(DocCachePage *pagesA, int numPagesA);
+
+  // Write the cache entry, if both the xref table and the page list
+  // have been set.
+  void save();
+
+  // Read the display list saved for page <pageNum>.  Returns NULL if
+  // there is none, or it is for another version of the file.
+  DisplayList *readPageList(int pageNum, XRef *xref);
+
+  // Save the display list of page <pageNum>.
+  void writePageList(int pageNum, DisplayList *list);
+
+  // Build the key for a cache file: <magic>, then the file size,
+  // modification time, and hashes of the beginning and end of the
+  // file.  Returns the name of the cache file (in <dir>, with
+  // extension <ext>), or NULL if the file can't be checked.
+  static GString *makeKey(BaseStream *str, GString *fileName, Guint magic,
+			  GString *dir, char *ext, Guint *key);
+
+private:
+
+  GBool load();
+  GString *getPageListFile(int pageNum);
+
+  GString *cacheFile;		// cache file name (NULL if the file
+				//   can't be cached)
+  Guint key[docCacheKeyLen];	// key for this file
+  GBool loaded;			// set if a valid entry was found
+  XRefEntry *entries;		// xref entries
+  int xrefSize;			// number of xref entries
+  int trailerKind;		// where the trailer dictionary is
+  Guint trailerPos;		//   (see XRefTrailerKind)
+  Guint lastXRefPos;		// offset of last xref table
+  DocCachePage *pages;		// page list
+  int numPages;			// number of pages
+};
+
+#endif
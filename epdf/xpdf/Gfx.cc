@@ -21,11 +21,14 @@
 #include "Stream.h"
 #include "Lexer.h"
 #include "Parser.h"
+#include "XRef.h"
 #include "GfxFont.h"
 #include "GfxState.h"
 #include "OutputDev.h"
 #include "Page.h"
 #include "Error.h"
+#include "DisplayList.h"
+#include "GfxProfile.h"
 #include "Gfx.h"
 
 // the MSVC math.h doesn't define this
@@ -49,6 +52,9 @@
 // Max delta allowed in any color component for a radial shading fill.
 #define radialColorDelta (1 / 256.0)
 
+// Max size, in pixels, of a cached tiling pattern tile.
+#define maxPatternTilePixels (2048 * 2048)
+
 //------------------------------------------------------------------------
 // Operator table
 //------------------------------------------------------------------------
@@ -210,6 +216,17 @@ Operator Gfx::opTab[] = {
 
 #define numOps (sizeof(opTab) / sizeof(Operator))
 
+// Operator table indexed by command atom; built on first use.
+Operator **Gfx::opJumpTab = NULL;
+int Gfx::opJumpTabSize = 0;
+
+GfxProfile *Gfx::profile = NULL;
+
+// Profile rows: the operators (in table order), then the output
+// device's image drawing functions.
+#define profileImageRow ((int)numOps)
+static char **profileRows = NULL;
+
 //------------------------------------------------------------------------
 // GfxResources
 //------------------------------------------------------------------------
@@ -379,18 +396,27 @@ GBool GfxResources::lookupGState(char *name, Object *obj) {
 
 Gfx::Gfx(XRef *xrefA, OutputDev *outA, int pageNum, Dict *resDict, fouble dpi,
 	 PDFRectangle *box, GBool crop, PDFRectangle *cropBox, int rotate,
-	 GBool printCommandsA) {
+	 GBool printCommandsA,
+	 GBool (*abortCheckCbkA)(void *data),
+	 void *abortCheckCbkDataA) {
   int i;
 
+  if (profile) {
+    profile->startPage(pageNum);
+  }
   xref = xrefA;
   subPage = gFalse;
   printCommands = printCommandsA;
-
+  abortCheckCbk = abortCheckCbkA;
+  abortCheckCbkData = abortCheckCbkDataA;
   // start the resource stack
   res = new GfxResources(xref, resDict, NULL);
 
   // initialize
   out = outA;
+  parser = NULL;
+  recList = NULL;
+  formCache = xref->getFormCache();
   state = new GfxState(dpi, box, rotate, out->upsideDown());
   fontChanged = gFalse;
   clip = clipNone;
@@ -422,12 +448,16 @@ Gfx::Gfx(XRef *xrefA, OutputDev *outA, Dict *resDict,
   xref = xrefA;
   subPage = gTrue;
   printCommands = gFalse;
-
+  abortCheckCbk = NULL;
+  abortCheckCbkData = NULL;
   // start the resource stack
   res = new GfxResources(xref, resDict, NULL);
 
   // initialize
   out = outA;
+  parser = NULL;
+  recList = NULL;
+  formCache = xref->getFormCache();
   state = new GfxState(72, box, 0, gFalse);
   fontChanged = gFalse;
   clip = clipNone;
@@ -463,9 +493,13 @@ Gfx::~Gfx() {
   if (state) {
     delete state;
   }
+  if (profile && !subPage) {
+    profile->endPage();
+  }
 }
 
-void Gfx::display(Object *obj, GBool topLevel) {
+void Gfx::display(Object *obj, GBool topLevel, DisplayList *recListA) {
+  DisplayList *oldRecList;
   Object obj2;
   int i;
 
@@ -483,10 +517,59 @@ void Gfx::display(Object *obj, GBool topLevel) {
     error(-1, "Weird page contents");
     return;
   }
+  oldRecList = recList;
+  recList = recListA;
   parser = new Parser(xref, new Lexer(xref, obj));
   go(topLevel);
   delete parser;
   parser = NULL;
+  recList = oldRecList;
+}
+
+void Gfx::replay(DisplayList *list, GBool topLevel) {
+  DisplayList *oldRecList;
+  Parser *oldParser;
+  DisplayListOp *op;
+  Object *args;
+  int i, j;
+
+  // a form replayed while a page is being recorded is recorded as
+  // its 'Do' operator
+  oldRecList = recList;
+  recList = NULL;
+  oldParser = parser;
+  parser = NULL;
+
+  updateLevel = lastAbortCheck = 0;
+  for (i = 0; i < list->getNumOps(); ++i) {
+    op = list->getOp(i);
+    args = list->getArgs(op);
+    if (printCommands) {
+      printf("%s", opTab[op->op].name);
+      for (j = 0; j < op->numArgs; ++j) {
+	printf(" ");
+	args[j].print(stdout);
+      }
+      printf("\n");
+      fflush(stdout);
+    }
+    if (profile) {
+      execOpProfiled(&opTab[op->op], args, op->numArgs);
+    } else {
+      (this->*opTab[op->op].func)(args, op->numArgs);
+    }
+    if (checkUpdate()) {
+      break;
+    }
+  }
+
+  // update display
+  if (topLevel && updateLevel > 0) {
+    out->dump();
+  }
+
+  parser = oldParser;
+  recList = oldRecList;
 }
 
 void Gfx::go(GBool topLevel) {
@@ -496,7 +579,7 @@ void Gfx::go(GBool topLevel) {
   int i;
 
   // scan a sequence of objects
-  updateLevel = 0;
+  updateLevel = lastAbortCheck = 0;
   numArgs = 0;
   parser->getObj(&obj);
   while (!obj.isEOF()) {
@@ -518,10 +601,11 @@ void Gfx::go(GBool topLevel) {
 	args[i].free();
       numArgs = 0;
 
-      // periodically update display
-      if (++updateLevel >= 20000) {
-	out->dump();
-	updateLevel = 0;
+      if (checkUpdate()) {
+	if (recList) {
+	  recList->abandon();
+	}
+	break;
       }
 
     // got an argument - save it
@@ -569,12 +653,15 @@ void Gfx::go(GBool topLevel) {
 
 void Gfx::execOp(Object *cmd, Object args[], int numArgs) {
   Operator *op;
+  NameAtom atom;
   char *name;
   int i;
 
   // find operator
-  name = cmd->getName();
-  if (!(op = findOp(name))) {
+  atom = cmd->getCmdAtom();
+  name = cmd->getCmd();
+  op = atom < opJumpTabSize ? opJumpTab[atom] : (Operator *)NULL;
+  if (!op && !(op = findOp(name))) {
     if (ignoreUndef == 0)
       error(getPos(), "Unknown operator '%s'", name);
     return;
@@ -603,7 +690,114 @@ void Gfx::execOp(Object *cmd, Object args[], int numArgs) {
   }
 
   // do it
+  if (profile) {
+    execOpProfiled(op, args, numArgs);
+  } else {
+    (this->*op->func)(args, numArgs);
+  }
+
+  // record it (this takes the args)
+  if (recList) {
+    recList->addOp(op - opTab, args, numArgs);
+  }
+}
+
+void Gfx::execOpProfiled(Operator *op, Object args[], int numArgs) {
+  GfxProfileTimer t;
+
+  profile->startOp(&t);
   (this->*op->func)(args, numArgs);
+  profile->endOp(op - opTab, &t);
+}
+
+void Gfx::setProfile(GfxProfile *profileA) {
+  int i;
+
+  profile = profileA;
+  if (profile) {
+    if (!profileRows) {
+      profileRows = (char **)gmalloc((numOps + 1) * sizeof(char *));
+    }
+    for (i = 0; i < (int)numOps; ++i) {
+      profileRows[i] = opTab[i].name;
+    }
+    profileRows[profileImageRow] = "(image)";
+    profile->setRows(profileRows, numOps + 1);
+  }
+}
+
+// Apply the checks done by execOp to a list that was read from a
+// file.  Inline images can't be replayed at all.
+GBool Gfx::checkList(DisplayList *list) {
+  DisplayListOp *op;
+  Operator *o;
+  Object *args;
+  int i, j;
+
+  for (i = 0; i < list->getNumOps(); ++i) {
+    op = list->getOp(i);
+    if (op->op < 0 || op->op >= (int)numOps) {
+      return gFalse;
+    }
+    o = &opTab[op->op];
+    if (o->func == &Gfx::opBeginImage) {
+      return gFalse;
+    }
+    if (o->numArgs >= 0 ? op->numArgs != o->numArgs
+	                : op->numArgs > -o->numArgs) {
+      return gFalse;
+    }
+    args = list->getArgs(op);
+    for (j = 0; j < op->numArgs; ++j) {
+      if (!checkArg(&args[j], o->tchk[j])) {
+	return gFalse;
+      }
+    }
+  }
+  return gTrue;
+}
+
+// Called after each operator: periodically updates the display, and
+// checks for an abort.  Returns true if drawing should stop.
+GBool Gfx::checkUpdate() {
+  if (++updateLevel >= 20000) {
+    out->dump();
+    updateLevel = lastAbortCheck = 0;
+  }
+  if (abortCheckCbk) {
+    if (updateLevel - lastAbortCheck > 10) {
+      if ((*abortCheckCbk)(abortCheckCbkData)) {
+	return gTrue;
+      }
+      lastAbortCheck = updateLevel;
+    }
+  }
+  return gFalse;
+}
+
+// All operators are pre-registered in the name table, so their atoms
+// are small enough to index a flat table.
+void Gfx::initOpJumpTab() {
+  NameAtom atom;
+  int i;
+
+  opJumpTabSize = NameTable::getNumPreregistered();
+  opJumpTab = (Operator **)gmalloc(opJumpTabSize * sizeof(Operator *));
+  for (i = 0; i < opJumpTabSize; ++i) {
+    opJumpTab[i] = NULL;
+  }
+  for (i = 0; i < (int)numOps; ++i) {
+    atom = NameTable::intern(opTab[i].name);
+    if (atom < opJumpTabSize) {
+      opJumpTab[atom] = &opTab[i];
+    }
+  }
+}
+
+void Gfx::freeOpJumpTab() {
+  gfree(opJumpTab);
+  opJumpTab = NULL;
+  opJumpTabSize = 0;
 }
 
 Operator *Gfx::findOp(char *name) {
@@ -1188,8 +1382,9 @@ void Gfx::doPatternFill(GBool eoFill) {
 
   // this is a bit of a kludge -- patterns can be really slow, so we
   // skip them if we're only doing text extraction, since they almost
-  // certainly don't contain any text
-  if (!out->needNonText()) {
+  // certainly don't contain any text (unless the device draws them
+  // from a cached tile, which is cheap)
+  if (!out->needNonText() && !out->useTilingPatternCache()) {
     return;
   }
 
@@ -1254,6 +1449,15 @@ void Gfx::doPatternFill(GBool eoFill) {
   state->setFillPattern(NULL);
   out->updateFillColor(state);
 
+  // draw the cell once, and let the device repeat it
+  if (out->useTilingPatternCache() &&
+      doCachedPatternFill(tPat, m1, eoFill)) {
+    goto done;
+  }
+  if (!out->needNonText()) {
+    goto done;
+  }
+
   // clip to current path
   state->clip();
   if (eoFill) {
@@ -1328,10 +1532,117 @@ void Gfx::doPatternFill(GBool eoFill) {
   }
 
   // restore graphics state
+ done:
   state = state->restore();
   out->restoreState(state);
 }
 
+// Fill the current path with a tiling pattern by drawing one cell
+// into an output device tile at device resolution.  <m1> is the
+// (pattern space) -> (device space) transform.  Returns false, having
+// drawn nothing, if the pattern can't be drawn this way.
+GBool Gfx::doCachedPatternFill(GfxTilingPattern *tPat, fouble *m1,
+			       GBool eoFill) {
+  GfxPath *fillPath;
+  fouble *bbox, *ctm;
+  fouble t[6], ictm[6], m[6], mat[6];
+  fouble x0, y0, xstep, ystep, det;
+  double a, b;
+  int tw, th;
+
+  // the tile covers one step, starting at the bbox corner, so the
+  // bbox has to fit in a step
+  bbox = tPat->getBBox();
+  xstep = fabs(tPat->getXStep());
+  ystep = fabs(tPat->getYStep());
+  if (xstep == 0 || ystep == 0 ||
+      fabs(bbox[2] - bbox[0]) > xstep || fabs(bbox[3] - bbox[1]) > ystep) {
+    return gFalse;
+  }
+  x0 = bbox[0] < bbox[2] ? bbox[0] : bbox[2];
+  y0 = bbox[1] < bbox[3] ? bbox[1] : bbox[3];
+
+  // tile size: the device space length of each step (in double:
+  // squaring would overflow a fixed point fouble)
+  a = m1[0];
+  b = m1[1];
+  tw = (int)(xstep * sqrt(a * a + b * b) + 0.5);
+  a = m1[2];
+  b = m1[3];
+  th = (int)(ystep * sqrt(a * a + b * b) + 0.5);
+  if (tw < 1) {
+    tw = 1;
+  }
+  if (th < 1) {
+    th = 1;
+  }
+  if ((double)tw * (double)th > maxPatternTilePixels) {
+    return gFalse;
+  }
+
+  // t = (pattern space) -> (tile space), with the step scaled to the
+  // tile and, on upside-down devices, y flipped as on the page
+  t[0] = tw / xstep;
+  t[1] = 0;
+  t[2] = 0;
+  t[4] = -x0 * t[0];
+  if (out->upsideDown()) {
+    t[3] = -(th / ystep);
+    t[5] = (y0 + ystep) * (th / ystep);
+  } else {
+    t[3] = th / ystep;
+    t[5] = -y0 * t[3];
+  }
+
+  // m = t * iCTM, the form matrix for the cell
+  ctm = state->getCTM();
+  det = 1 / (ctm[0] * ctm[3] - ctm[1] * ctm[2]);
+  ictm[0] = ctm[3] * det;
+  ictm[1] = -ctm[1] * det;
+  ictm[2] = -ctm[2] * det;
+  ictm[3] = ctm[0] * det;
+  ictm[4] = (ctm[2] * ctm[5] - ctm[3] * ctm[4]) * det;
+  ictm[5] = (ctm[1] * ctm[4] - ctm[0] * ctm[5]) * det;
+  m[0] = t[0] * ictm[0];
+  m[1] = t[0] * ictm[1];
+  m[2] = t[3] * ictm[2];
+  m[3] = t[3] * ictm[3];
+  m[4] = t[4] * ictm[0] + t[5] * ictm[2] + ictm[4];
+  m[5] = t[4] * ictm[1] + t[5] * ictm[3] + ictm[5];
+
+  // mat = inverse(t) * m1 = (tile space) -> (device space)
+  mat[0] = m1[0] * xstep / tw;
+  mat[1] = m1[1] * xstep / tw;
+  if (out->upsideDown()) {
+    mat[2] = -(m1[2] * ystep / th);
+    mat[3] = -(m1[3] * ystep / th);
+    mat[4] = x0 * m1[0] + (y0 + ystep) * m1[2] + m1[4];
+    mat[5] = x0 * m1[1] + (y0 + ystep) * m1[3] + m1[5];
+  } else {
+    mat[2] = m1[2] * ystep / th;
+    mat[3] = m1[3] * ystep / th;
+    mat[4] = x0 * m1[0] + y0 * m1[2] + m1[4];
+    mat[5] = x0 * m1[1] + y0 * m1[3] + m1[5];
+  }
+
+  if (!out->beginPatternTile(state, tw, th)) {
+    return gFalse;
+  }
+
+  // draw the cell, with the tile as the whole device space; the path
+  // isn't saved by GfxState::save(), so keep a copy of it
+  fillPath = state->getPath()->copy();
+  state = state->save();
+  state->clearPath();
+  state->setClipBBox(0, 0, tw, th);
+  doForm1(tPat->getContentStream(), tPat->getResDict(), m, bbox);
+  state = state->restore();
+  state->setPath(fillPath);
+
+  out->endPatternTile(state, mat, eoFill);
+  return gTrue;
+}
+
 void Gfx::opShFill(Object args[], int numArgs) {
   GfxShading *shading;
   fouble xMin, yMin, xMax, yMax;
@@ -2213,7 +2524,9 @@ void Gfx::opXObject(Object args[], int numArgs) {
     doImage(&refObj, obj1.getStream(), gFalse);
     refObj.free();
   } else if (obj2.isName("Form")) {
-    doForm(&obj1);
+    res->lookupXObjectNF(args[0].getName(), &refObj);
+    doForm(&refObj, &obj1);
+    refObj.free();
   } else if (obj2.isName("PS")) {
     obj1.streamGetDict()->lookup("Level1", &obj3);
     out->psXObject(obj1.getStream(),
@@ -2244,6 +2557,8 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
   Object maskObj;
   GBool haveMask;
   int maskColors[2*gfxColorMaxComps];
+  int scale, targetWidth, targetHeight;
+  GfxProfileTimer t;
   Object obj1, obj2;
   int i;
 
@@ -2317,7 +2632,13 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
     obj1.free();
 
     // draw it
+    if (profile) {
+      profile->startOp(&t);
+    }
     out->drawImageMask(state, ref, str, width, height, invert, inlineImg);
+    if (profile) {
+      profile->endOp(profileImageRow, &t);
+    }
 
   } else {
 
@@ -2365,10 +2686,32 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
       haveMask = gTrue;
     }
 
+    // don't decode a JPEG image at more than twice the size it will
+    // be drawn at
+    scale = 1;
+    if (str->getKind() == strDCT && !inlineImg) {
+      out->getImageTargetSize(state, width, height,
+			      &targetWidth, &targetHeight);
+      while (scale < 8 && width / (2 * scale) >= targetWidth &&
+	     height / (2 * scale) >= targetHeight)
+	scale *= 2;
+      ((DCTStream *)str)->setScale(scale);
+      width = (width + scale - 1) / scale;
+      height = (height + scale - 1) / scale;
+    }
+
     // draw it
+    if (profile) {
+      profile->startOp(&t);
+    }
     out->drawImage(state, ref, str, width, height, colorMap,
 		   haveMask ? maskColors : (int *)NULL,  inlineImg);
+    if (profile) {
+      profile->endOp(profileImageRow, &t);
+    }
     delete colorMap;
+    if (scale > 1)
+      ((DCTStream *)str)->setScale(1);
 
     maskObj.free();
   }
@@ -2386,7 +2729,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
   error(getPos(), "Bad image parameters");
 }
 
-void Gfx::doForm(Object *str) {
+void Gfx::doForm(Object *ref, Object *str) {
   Dict *dict;
   Object matrixObj, bboxObj;
   fouble m[6], bbox[6];
@@ -2440,7 +2783,7 @@ void Gfx::doForm(Object *str) {
   resDict = resObj.isDict() ? resObj.getDict() : (Dict *)NULL;
 
   // draw it
-  doForm1(str, resDict, m, bbox);
+  doForm1(str, resDict, m, bbox, ref);
 
   resObj.free();
 }
@@ -2559,8 +2902,12 @@ void Gfx::doAnnot(Object *str, fouble xMin, fouble yMin,
   bboxObj.free();
 }
 
-void Gfx::doForm1(Object *str, Dict *resDict, fouble *matrix, fouble *bbox) {
+// Draw a form.  If <ref> is the form's object ID, its display list is
+// cached, and replayed the next time the form is drawn.
+void Gfx::doForm1(Object *str, Dict *resDict, fouble *matrix, fouble *bbox,
+		  Object *ref) {
   Parser *oldParser;
+  DisplayList *list;
   fouble oldBaseMatrix[6];
   int i;
 
@@ -2597,7 +2944,22 @@ void Gfx::doForm1(Object *str, Dict *resDict, fouble *matrix, fouble *bbox) {
   state->clearPath();
 
   // draw the form
-  display(str, gFalse);
+  if (formCache && ref && ref->isRef()) {
+    if ((list = formCache->lookup(ref->getRefNum(), ref->getRefGen()))) {
+      replay(list, gFalse);
+    } else {
+      list = new DisplayList(formCache->getMaxBytes());
+      display(str, gFalse, list);
+      if (list->isComplete()) {
+	formCache->add(ref->getRefNum(), ref->getRefGen(), list);
+      }
+    }
+    if (!list->decRef()) {
+      delete list;
+    }
+  } else {
+    display(str, gFalse);
+  }
 
   // restore base matrix
   for (i = 0; i < 6; ++i) {
@@ -2637,6 +2999,12 @@ void Gfx::opBeginImage(Object args[], int numArgs) {
   Stream *str;
   int c1, c2;
 
+  // the image data is read straight from the content stream, so it
+  // can't be replayed from a display list
+  if (recList) {
+    recList->abandon();
+  }
+
   // build dict/stream
   str = buildImageStream();
 
@@ -2658,7 +3026,7 @@ void Gfx::opBeginImage(Object args[], int numArgs) {
 Stream *Gfx::buildImageStream() {
   Object dict;
   Object obj;
-  char *key;
+  NameAtom key;
   Stream *str;
 
   // build dictionary
@@ -2669,11 +3037,10 @@ Stream *Gfx::buildImageStream() {
       error(getPos(), "Inline image dictionary key must be a name object");
       obj.free();
     } else {
-      key = copyString(obj.getName());
+      key = obj.getNameAtom();
       obj.free();
       parser->getObj(&obj);
       if (obj.isEOF() || obj.isError()) {
-	gfree(key);
 	break;
       }
       dict.dictAdd(key, &obj);
@@ -27,11 +27,15 @@ class OutputDev;
 class GfxFontDict;
 class GfxFont;
 class GfxPattern;
+class GfxTilingPattern;
 class GfxShading;
 class GfxAxialShading;
 class GfxRadialShading;
 class GfxState;
 class Gfx;
+class DisplayList;
+class DisplayListCache;
+class GfxProfile;
 struct PDFRectangle;
 
 //------------------------------------------------------------------------
@@ -98,7 +102,9 @@ public:
   // Constructor for regular output.
   Gfx(XRef *xrefA, OutputDev *outA, int pageNum, Dict *resDict, fouble dpi,
       PDFRectangle *box, GBool crop, PDFRectangle *cropBox, int rotate,
-      GBool printCommandsA);
+      GBool printCommandsA,
+      GBool (*abortCheckCbkA)(void *data) = NULL,
+      void *abortCheckCbkDataA = NULL);
 
   // Constructor for a sub-page object.
   Gfx(XRef *xrefA, OutputDev *outA, Dict *resDict,
@@ -106,8 +112,18 @@ public:
 
   ~Gfx();
 
-  // Interpret a stream or array of streams.
-  void display(Object *obj, GBool topLevel = gTrue);
+  // Interpret a stream or array of streams.  If <recListA> is given,
+  // the operators are also added to it.
+  void display(Object *obj, GBool topLevel = gTrue,
+	       DisplayList *recListA = NULL);
+
+  // Interpret a display list recorded by display(), or read from a
+  // file and accepted by checkList().
+  void replay(DisplayList *list, GBool topLevel = gTrue);
+
+  // Check that a list read from a file holds only operators that
+  // display() would have recorded, with operands of the right types.
+  static GBool checkList(DisplayList *list);
 
   // Display an annotation, given its appearance (a Form XObject) and
   // bounding box (in default user space).
@@ -117,6 +133,19 @@ public:
   void pushResources(Dict *resDict);
   void popResources();
 
+  // Install a profile (or NULL to stop profiling).  Each Gfx created
+  // for a page after this adds a page to the profile, with the count
+  // and time of each operator, and of the output device's image
+  // drawing functions (which decode the image streams).  With no
+  // profile, the only cost is a test per operator.
+  static void setProfile(GfxProfile *profileA);
+
+  // Build and free the operator table, which is indexed by command
+  // atom.  Called by the GlobalParams constructor (after the name
+  // table is set up) and destructor.
+  static void initOpJumpTab();
+  static void freeOpJumpTab();
+
 private:
 
   XRef *xref;			// the xref table for this PDF file
@@ -125,6 +154,9 @@ private:
   GBool printCommands;		// print the drawing commands (for debugging)
   GfxResources *res;		// resource stack
   int updateLevel;
+  GBool (*abortCheckCbk)(void *data);	// abort check callback
+  void *abortCheckCbkData;		// data for <abortCheckCbk>
+  int lastAbortCheck;		// <updateLevel> at the last abort check
 
   GfxState *state;		// current graphics state
   GBool fontChanged;		// set if font or text matrix has changed
@@ -134,13 +166,22 @@ private:
 				//   page/form/pattern
 
   Parser *parser;		// parser for page content stream(s)
+  DisplayList *recList;		// display list being recorded (NULL if
+				//   none)
+  DisplayListCache *formCache;	// display lists of form XObjects (NULL
+				//   if disabled)
 
   static Operator opTab[];	// table of operators
+  static GfxProfile *profile;	// operator profile (NULL if none)
+  static Operator **opJumpTab;	// operators indexed by command atom
+  static int opJumpTabSize;	// size of <opJumpTab>
 
   void go(GBool topLevel);
   void execOp(Object *cmd, Object args[], int numArgs);
+  void execOpProfiled(Operator *op, Object args[], int numArgs);
+  GBool checkUpdate();
   Operator *findOp(char *name);
-  GBool checkArg(Object *arg, TchkType type);
+  static GBool checkArg(Object *arg, TchkType type);
   int getPos();
 
   // graphics state operators
@@ -190,6 +231,7 @@ private:
   void opEOFillStroke(Object args[], int numArgs);
   void opCloseEOFillStroke(Object args[], int numArgs);
   void doPatternFill(GBool eoFill);
+  GBool doCachedPatternFill(GfxTilingPattern *tPat, fouble *m1, GBool eoFill);
   void opShFill(Object args[], int numArgs);
   void doAxialShFill(GfxAxialShading *shading);
   void doRadialShFill(GfxRadialShading *shading);
@@ -228,8 +270,9 @@ private:
   // XObject operators
   void opXObject(Object args[], int numArgs);
   void doImage(Object *ref, Stream *str, GBool inlineImg);
-  void doForm(Object *str);
-  void doForm1(Object *str, Dict *resDict, fouble *matrix, fouble *bbox);
+  void doForm(Object *ref, Object *str);
+  void doForm1(Object *str, Dict *resDict, fouble *matrix, fouble *bbox,
+	       Object *ref = NULL);
 
   // in-line image operators
   void opBeginImage(Object args[], int numArgs);
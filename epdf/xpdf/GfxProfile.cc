@@ -0,0 +1,246 @@
+//========================================================================
+//
+// GfxProfile.cc
+//
+// Per-page call counts and times of the content stream operators.
+//
+//========================================================================
+
+#ifdef __GNUC__
+#pragma implementation
+#endif
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include "../goo/gmem.h"
+#include "../goo/GString.h"
+#include "../goo/GList.h"
+#include "GfxProfile.h"
+
+//------------------------------------------------------------------------
+
+static void freePage(GfxProfilePage *p) {
+  if (p->doc) {
+    delete p->doc;
+  }
+  gfree(p->entries);
+  delete p;
+}
+
+// Write a string as a JSON string, or as a quoted CSV field.
+static void writeQuoted(FILE *f, char *s, int n, GBool json) {
+  int i, c;
+
+  fputc('"', f);
+  for (i = 0; i < n; ++i) {
+    c = s[i] & 0xff;
+    if (c == '"') {
+      fputs(json ? "\\\"" : "\"\"", f);
+    } else if (json && c == '\\') {
+      fputs("\\\\", f);
+    } else if (json && c < 0x20) {
+      fprintf(f, "\\u%04x", c);
+    } else {
+      fputc(c, f);
+    }
+  }
+  fputc('"', f);
+}
+
+static void writeDocName(FILE *f, GString *doc, GBool json) {
+  if (doc) {
+    writeQuoted(f, doc->getCString(), doc->getLength(), json);
+  } else {
+    writeQuoted(f, "", 0, json);
+  }
+}
+
+//------------------------------------------------------------------------
+// GfxProfile
+//------------------------------------------------------------------------
+
+GfxProfile::GfxProfile(GBool opCPUTimesA) {
+  opCPUTimes = opCPUTimesA;
+  names = NULL;
+  nRows = 0;
+  doc = NULL;
+  pages = new GList();
+  cur = NULL;
+  startWall = startCPU = 0;
+  nestedWall = nestedCPU = 0;
+}
+
+GfxProfile::~GfxProfile() {
+  clear();
+  if (cur) {
+    freePage(cur);
+  }
+  delete pages;
+  if (doc) {
+    delete doc;
+  }
+}
+
+void GfxProfile::setRows(char **namesA, int nRowsA) {
+  names = namesA;
+  nRows = nRowsA;
+}
+
+void GfxProfile::setDocName(GString *docA) {
+  if (doc) {
+    delete doc;
+  }
+  doc = docA ? docA->copy() : (GString *)NULL;
+}
+
+void GfxProfile::startPage(int page) {
+  int i;
+
+  if (cur) {
+    freePage(cur);
+  }
+  cur = new GfxProfilePage;
+  cur->doc = doc ? doc->copy() : (GString *)NULL;
+  cur->page = page;
+  cur->wall = cur->cpu = 0;
+  cur->entries = (GfxProfileEntry *)gmalloc(nRows * sizeof(GfxProfileEntry));
+  for (i = 0; i < nRows; ++i) {
+    cur->entries[i].count = 0;
+    cur->entries[i].wall = cur->entries[i].cpu = 0;
+    cur->entries[i].selfWall = cur->entries[i].selfCPU = 0;
+  }
+  nestedWall = nestedCPU = 0;
+  startWall = getWallTime();
+  startCPU = getCPUTime();
+}
+
+void GfxProfile::endPage() {
+  if (!cur) {
+    return;
+  }
+  cur->wall = getWallTime() - startWall;
+  cur->cpu = getCPUTime() - startCPU;
+  pages->append(cur);
+  cur = NULL;
+}
+
+void GfxProfile::startOp(GfxProfileTimer *t) {
+  t->nestedWall = nestedWall;
+  t->nestedCPU = nestedCPU;
+  nestedWall = nestedCPU = 0;
+  t->wall = getWallTime();
+  t->cpu = opCPUTimes ? getCPUTime() : 0;
+}
+
+void GfxProfile::endOp(int row, GfxProfileTimer *t) {
+  GfxProfileEntry *e;
+  double wall, cpu;
+
+  wall = getWallTime() - t->wall;
+  cpu = opCPUTimes ? getCPUTime() - t->cpu : 0;
+  if (cur && row >= 0 && row < nRows) {
+    e = &cur->entries[row];
+    ++e->count;
+    e->wall += wall;
+    e->cpu += cpu;
+    e->selfWall += wall - nestedWall;
+    e->selfCPU += cpu - nestedCPU;
+  }
+  nestedWall = t->nestedWall + wall;
+  nestedCPU = t->nestedCPU + cpu;
+}
+
+int GfxProfile::getNumPages() {
+  return pages->getLength();
+}
+
+GfxProfilePage *GfxProfile::getPage(int i) {
+  return (GfxProfilePage *)pages->get(i);
+}
+
+void GfxProfile::clear() {
+  int i;
+
+  for (i = 0; i < pages->getLength(); ++i) {
+    freePage((GfxProfilePage *)pages->get(i));
+  }
+  delete pages;
+  pages = new GList();
+}
+
+void GfxProfile::writeJSON(FILE *f) {
+  GfxProfilePage *p;
+  GfxProfileEntry *e;
+  GBool first;
+  int i, j;
+
+  fprintf(f, "{\"pages\": [");
+  for (i = 0; i < pages->getLength(); ++i) {
+    p = (GfxProfilePage *)pages->get(i);
+    fprintf(f, "%s\n  {\"doc\": ", i ? "," : "");
+    writeDocName(f, p->doc, gTrue);
+    fprintf(f, ", \"page\": %d, \"wall\": %.3f, \"cpu\": %.3f,\n"
+	    "   \"ops\": [",
+	    p->page, p->wall * 1000, p->cpu * 1000);
+    first = gTrue;
+    for (j = 0; j < nRows; ++j) {
+      e = &p->entries[j];
+      if (e->count == 0) {
+	continue;
+      }
+      fprintf(f, "%s\n    {\"op\": ", first ? "" : ",");
+      writeQuoted(f, names[j], strlen(names[j]), gTrue);
+      fprintf(f, ", \"count\": %d, \"wall\": %.3f, \"cpu\": %.3f,"
+	      " \"selfWall\": %.3f, \"selfCPU\": %.3f}",
+	      e->count, e->wall * 1000, e->cpu * 1000,
+	      e->selfWall * 1000, e->selfCPU * 1000);
+      first = gFalse;
+    }
+    fprintf(f, "]}");
+  }
+  fprintf(f, "\n]}\n");
+}
+
+// One line per page and row, plus a '(page)' line per page with the
+// page times.
+void GfxProfile::writeCSV(FILE *f) {
+  GfxProfilePage *p;
+  GfxProfileEntry *e;
+  int i, j;
+
+  fprintf(f, "doc,page,op,count,wall,cpu,selfWall,selfCPU\n");
+  for (i = 0; i < pages->getLength(); ++i) {
+    p = (GfxProfilePage *)pages->get(i);
+    writeDocName(f, p->doc, gFalse);
+    fprintf(f, ",%d,\"(page)\",1,%.3f,%.3f,,\n",
+	    p->page, p->wall * 1000, p->cpu * 1000);
+    for (j = 0; j < nRows; ++j) {
+      e = &p->entries[j];
+      if (e->count == 0) {
+	continue;
+      }
+      writeDocName(f, p->doc, gFalse);
+      fprintf(f, ",%d,", p->page);
+      writeQuoted(f, names[j], strlen(names[j]), gFalse);
+      fprintf(f, ",%d,%.3f,%.3f,%.3f,%.3f\n",
+	      e->count, e->wall * 1000, e->cpu * 1000,
+	      e->selfWall * 1000, e->selfCPU * 1000);
+    }
+  }
+}
+
+double GfxProfile::getWallTime() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+double GfxProfile::getCPUTime() {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
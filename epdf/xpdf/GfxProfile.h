@@ -0,0 +1,119 @@
+//========================================================================
+//
+// GfxProfile.h
+//
+// Per-page call counts and times of the content stream operators.
+//
+//========================================================================
+
+#ifndef GFXPROFILE_H
+#define GFXPROFILE_H
+
+#ifdef __GNUC__
+#pragma interface
+#endif
+
+#include <stdio.h>
+#include "../goo/gtypes.h"
+
+class GString;
+class GList;
+
+//------------------------------------------------------------------------
+
+// Times spent in one operator on one page.  Times are in seconds.
+// The total times include nested operators (e.g., the operators of a
+// form drawn by 'Do', so a form drawing another form is counted twice
+// in the total for 'Do'); the self times don't.
+struct GfxProfileEntry {
+  int count;			// number of calls
+  double wall, cpu;		// total wall clock and CPU time
+  double selfWall, selfCPU;	// same, minus nested operators
+};
+
+// Profile of one page.
+struct GfxProfilePage {
+  GString *doc;			// document name (may be NULL)
+  int page;			// page number
+  double wall, cpu;		// time from the start to the end of the
+				//   page; what isn't in any operator's
+				//   self time is mostly parsing
+  GfxProfileEntry *entries;	// one entry per row
+};
+
+// Start times of an operator being timed.
+struct GfxProfileTimer {
+  double wall, cpu;		// start times
+  double nestedWall, nestedCPU;	// time of nested operators, saved
+};
+
+//------------------------------------------------------------------------
+// GfxProfile
+//------------------------------------------------------------------------
+
+// Per-page call counts and times of the content stream operators,
+// collected by Gfx when a profile is installed with Gfx::setProfile.
+// Each call to Page::display (or any other top-level Gfx) adds a
+// page.
+
+class GfxProfile {
+public:
+
+  // Constructor.  If <opCPUTimesA> is false, only the wall clock
+  // time of each operator is measured (CPU time is still measured for
+  // each page): reading the CPU time is a system call on most systems,
+  // which slows down pages with many cheap operators a lot.
+  GfxProfile(GBool opCPUTimesA = gTrue);
+
+  // Destructor.
+  ~GfxProfile();
+
+  // Set the row names (one row per operator, plus any extra rows).
+  // This is done by Gfx::setProfile.  <namesA> is not copied.
+  void setRows(char **namesA, int nRowsA);
+
+  // Set the document name recorded with the following pages.
+  void setDocName(GString *docA);
+
+  // Start and end a page.  Operators outside a page aren't counted.
+  void startPage(int page);
+  void endPage();
+
+  // Time an operator (or other row).  Calls nest: the time of an
+  // inner call is subtracted from the self time of the outer one.
+  void startOp(GfxProfileTimer *t);
+  void endOp(int row, GfxProfileTimer *t);
+
+  // Get the collected pages.
+  int getNumPages();
+  GfxProfilePage *getPage(int i);
+  char *getRowName(int row) { return names[row]; }
+  int getNumRows() { return nRows; }
+
+  // Drop the collected pages.
+  void clear();
+
+  // Write the pages as JSON or CSV.  Times are in milliseconds, and
+  // only rows with calls are written.
+  void writeJSON(FILE *f);
+  void writeCSV(FILE *f);
+
+  // Clocks, in seconds: monotonic wall clock time, and CPU time of
+  // the calling thread.
+  static double getWallTime();
+  static double getCPUTime();
+
+private:
+
+  GBool opCPUTimes;		// measure the CPU time of each operator
+  char **names;			// row names
+  int nRows;			// number of rows
+  GString *doc;			// current document name
+  GList *pages;			// finished pages [GfxProfilePage]
+  GfxProfilePage *cur;		// page being collected (NULL if none)
+  double startWall, startCPU;	// start time of <cur>
+  double nestedWall, nestedCPU;	// time of the calls nested in the
+				//   current call, so far
+};
+
+#endif
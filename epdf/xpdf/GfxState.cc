@@ -1613,10 +1613,17 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
   int i, j, k;
 
   ok = gTrue;
-
-  // bits per component and color space
+  lookup = NULL;
+  lineMode = imgLineSlow;
+  byteLookup = NULL;
+  rgbLookup = NULL;
+  gridPos = NULL;
+  rgbGrid = NULL;
+
+  // bits per component and color space; ImageStream cuts 16-bit
+  // components down to 8 bits
   bits = bitsA;
-  maxPixel = (1 << bits) - 1;
+  maxPixel = (1 << (bits > 8 ? 8 : bits)) - 1;
   colorSpace = colorSpaceA;
 
   // get decode map
@@ -1693,6 +1700,7 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
       }
     }
   }
+  initRGBLine();
 
   return;
 
@@ -1705,6 +1713,10 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
 GfxImageColorMap::~GfxImageColorMap() {
   delete colorSpace;
   gfree(lookup);
+  gfree(byteLookup);
+  gfree(rgbLookup);
+  gfree(gridPos);
+  gfree(rgbGrid);
 }
 
 void GfxImageColorMap::getGray(Guchar *x, fouble *gray) {
@@ -1764,6 +1776,285 @@ void GfxImageColorMap::getCMYK(Guchar *x, GfxCMYK *cmyk) {
   }
 }
 
+static inline Guint rgbToARGB(GfxRGB *rgb) {
+  return 0xff000000 |
+         ((Guint)(int)(clip01(rgb->r) * 255 + 0.5) << 16) |
+         ((Guint)(int)(clip01(rgb->g) * 255 + 0.5) << 8) |
+         (Guint)(int)(clip01(rgb->b) * 255 + 0.5);
+}
+
+// The DeviceCMYK weights in getRGBLine add up to 255^3; with ink
+// colors in 1/256ths, this is a full 255 level.
+#define cmykOne (255 * 255 * 256)
+#define cmykHalf (cmykOne / 2)
+
+// Interpolation grids built for a color map have this many nodes
+// along each axis, evenly spaced over the pixel values.
+#define gridSize3 33
+#define gridSize4 17
+
+// Interpolate between two 0xffRRGGBB colors, <f> in 0..256.  The red
+// and blue lanes are done together, as there is room for the products.
+static inline Guint lerpRGB(Guint a, Guint b, int f) {
+  Guint rb, g;
+
+  rb = ((a & 0xff00ff) * (256 - f) + (b & 0xff00ff) * f + 0x800080) >> 8;
+  g = ((a & 0xff00) * (256 - f) + (b & 0xff00) * f + 0x8000) >> 8;
+  return 0xff000000 | (rb & 0xff00ff) | (g & 0xff00);
+}
+
+// Trilinear interpolation in a grid at <p>, with strides <s0>, <s1>
+// and 1 along the three axes.
+static inline Guint gridInterp3(Guint *p, int s0, int s1,
+				int f0, int f1, int f2) {
+  Guint c00, c01, c10, c11;
+
+  c00 = lerpRGB(p[0], p[1], f2);
+  c01 = lerpRGB(p[s1], p[s1 + 1], f2);
+  c10 = lerpRGB(p[s0], p[s0 + 1], f2);
+  c11 = lerpRGB(p[s0 + s1], p[s0 + s1 + 1], f2);
+  return lerpRGB(lerpRGB(c00, c01, f1), lerpRGB(c10, c11, f1), f0);
+}
+
+// Pick the getRGBLine method for this color map, and build its tables.
+void GfxImageColorMap::initRGBLine() {
+  GfxColorSpace *cs;
+  GfxColorSpaceMode mode;
+  GfxRGB rgb;
+  Guchar x[gfxColorMaxComps];
+  int maxPixel, pixBits, indexHigh, n, idx, i, k;
+  int size, stride, pos, node;
+
+  pixBits = bits > 8 ? 8 : bits;
+  maxPixel = (1 << pixBits) - 1;
+
+  // ICCBased spaces are converted by their alternate space
+  cs = colorSpace;
+  while (cs->getMode() == csICCBased) {
+    cs = ((GfxICCBasedColorSpace *)cs)->getAlt();
+  }
+  mode = cs->getMode();
+
+  // small input domain (always the case for one component): a table
+  // with every pixel value; an Indexed table may be shorter than that
+  n = 1;
+  for (k = 0; k < nComps && n <= 4096; ++k) {
+    n <<= pixBits;
+  }
+  if (n <= 4096) {
+    indexHigh = maxPixel;
+    if (colorSpace->getMode() == csIndexed) {
+      indexHigh = ((GfxIndexedColorSpace *)colorSpace)->getIndexHigh();
+    }
+    rgbLookup = (Guint *)gmalloc(n * sizeof(Guint));
+    for (idx = 0; idx < n; ++idx) {
+      for (k = nComps - 1, i = idx; k >= 0; --k, i >>= pixBits) {
+	x[k] = (Guchar)(i & maxPixel);
+      }
+      if (x[0] > indexHigh) {
+	x[0] = (Guchar)indexHigh;
+      }
+      getRGB(x, &rgb);
+      rgbLookup[idx] = rgbToARGB(&rgb);
+    }
+    lineMode = imgLineLookup;
+    return;
+  }
+
+  // RGB components map straight to levels
+  if (mode == csDeviceRGB || mode == csCalRGB) {
+    byteLookup = (Guchar *)gmalloc(3 * 256 * sizeof(Guchar));
+    memset(byteLookup, 0, 3 * 256 * sizeof(Guchar));
+    for (k = 0; k < 3; ++k) {
+      for (i = 0; i <= maxPixel; ++i) {
+	byteLookup[k*256 + i] =
+	    (Guchar)(int)(clip01(lookup[i*3 + k]) * 255 + 0.5);
+      }
+    }
+    lineMode = imgLineRGB;
+    return;
+  }
+
+  // DeviceCMYK is done in integers from the decoded components;
+  // everything else with 3 or 4 components goes through a grid indexed
+  // by pixel values (built only once enough pixels have been converted
+  // to pay for it) -- except Lab, whose gamma curve is too steep near
+  // black to interpolate
+  if ((nComps == 3 || nComps == 4) && pixBits == 8 && mode != csLab) {
+    if (mode == csDeviceCMYK) {
+      byteLookup = (Guchar *)gmalloc(4 * 256 * sizeof(Guchar));
+      for (k = 0; k < 4; ++k) {
+	for (i = 0; i < 256; ++i) {
+	  byteLookup[k*256 + i] =
+	      (Guchar)(int)(clip01(lookup[i*4 + k]) * 255 + 0.5);
+	}
+      }
+      lineMode = imgLineCMYK;
+    } else {
+      // grid position of each component value: the offset of the node
+      // below it, times 512, plus the distance past it in 1/256ths
+      size = nComps == 3 ? gridSize3 : gridSize4;
+      gridPos = (int *)gmalloc(nComps * 256 * sizeof(int));
+      for (k = nComps - 1, stride = 1; k >= 0; --k, stride *= size) {
+	for (i = 0; i < 256; ++i) {
+	  pos = (i * (size - 1) * 256) / 255;
+	  node = pos >> 8;
+	  if (node > size - 2) {
+	    node = size - 2;
+	  }
+	  gridPos[k*256 + i] = ((node * stride) << 9) + (pos - node * 256);
+	}
+      }
+      gridCountdown = stride;
+      lineMode = imgLineGrid;
+    }
+    return;
+  }
+
+  lineMode = imgLineSlow;
+}
+
+// Build a grid for this color map's color space, with nodes evenly
+// spaced over the pixel values.
+void GfxImageColorMap::buildRGBGrid() {
+  GfxColor color;
+  GfxRGB rgb;
+  int size, n, idx, i, k;
+
+  size = nComps == 3 ? gridSize3 : gridSize4;
+  n = nComps == 3 ? size * size * size : size * size * size * size;
+  rgbGrid = (Guint *)gmalloc(n * sizeof(Guint));
+  for (idx = 0; idx < n; ++idx) {
+    for (k = nComps - 1, i = idx; k >= 0; --k, i /= size) {
+      color.c[k] = decodeLow[k] + ((i % size) * decodeRange[k]) / (size - 1);
+    }
+    colorSpace->getRGB(&color, &rgb);
+    rgbGrid[idx] = rgbToARGB(&rgb);
+  }
+}
+
+void GfxImageColorMap::getRGBLine(Guchar *in, Guint *out, int n) {
+  GfxRGB rgb;
+  Guchar *rl, *gl, *bl, *c0, *c1, *c2, *c3;
+  Guint *grid;
+  Guint c, m, y, kk, cm, cM, Cm, CM, aw, ac, am, ab, ay, ar, ag, r, g, b;
+  int *p0, *p1, *p2, *p3;
+  int shift, idx, f0, f1, f2, f3, i, k;
+
+  switch (lineMode) {
+
+  case imgLineLookup:
+    if (nComps == 1) {
+      for (i = 0; i < n; ++i) {
+	out[i] = rgbLookup[in[i]];
+      }
+    } else {
+      shift = bits > 8 ? 8 : bits;
+      for (i = 0; i < n; ++i) {
+	idx = 0;
+	for (k = 0; k < nComps; ++k) {
+	  idx = (idx << shift) | *in++;
+	}
+	out[i] = rgbLookup[idx];
+      }
+    }
+    break;
+
+  case imgLineRGB:
+    rl = byteLookup;
+    gl = byteLookup + 256;
+    bl = byteLookup + 512;
+    for (i = 0; i < n; ++i, in += 3) {
+      out[i] = 0xff000000 | ((Guint)rl[in[0]] << 16) |
+	       ((Guint)gl[in[1]] << 8) | (Guint)bl[in[2]];
+    }
+    break;
+
+  case imgLineCMYK:
+    // GfxDeviceCMYKColorSpace::getRGB, with the weights in 0..255^3
+    // and the ink colors in 1/256ths
+    c0 = byteLookup;
+    c1 = byteLookup + 256;
+    c2 = byteLookup + 512;
+    c3 = byteLookup + 768;
+    for (i = 0; i < n; ++i, in += 4) {
+      kk = c3[in[3]];
+      c = c0[in[0]] + kk;
+      m = c1[in[1]] + kk;
+      y = c2[in[2]] + kk;
+      c = c > 255 ? 255 : c;
+      m = m > 255 ? 255 : m;
+      y = y > 255 ? 255 : y;
+      cm = (255 - c) * (255 - m);
+      cM = (255 - c) * m;
+      Cm = c * (255 - m);
+      CM = c * m;
+      aw = cm * (255 - y);
+      ac = Cm * (255 - y);
+      am = cM * (255 - y);
+      ab = CM * (255 - y);
+      ay = cm * y;
+      ar = cM * y;
+      ag = Cm * y;
+      r = 256 * aw + 234 * am + 255 * ay + 253 * ar;
+      g = 256 * aw + 159 * ac + 256 * ay + 133 * ag;
+      b = 256 * aw + 200 * ac + 139 * am + 17 * ar + 54 * ag + 124 * ab;
+      out[i] = 0xff000000 | (((r + cmykHalf) / cmykOne) << 16) |
+	       (((g + cmykHalf) / cmykOne) << 8) | ((b + cmykHalf) / cmykOne);
+    }
+    break;
+
+  case imgLineGrid:
+    if (!rgbGrid) {
+      if (gridCountdown > 0) {
+	gridCountdown -= n;
+	for (i = 0; i < n; ++i, in += nComps) {
+	  getRGB(in, &rgb);
+	  out[i] = rgbToARGB(&rgb);
+	}
+	break;
+      }
+      buildRGBGrid();
+    }
+    p0 = gridPos;
+    p1 = gridPos + 256;
+    p2 = gridPos + 512;
+    if (nComps == 3) {
+      for (i = 0; i < n; ++i, in += 3) {
+	f0 = p0[in[0]];
+	f1 = p1[in[1]];
+	f2 = p2[in[2]];
+	out[i] = gridInterp3(rgbGrid + (f0 >> 9) + (f1 >> 9) + (f2 >> 9),
+			     gridSize3 * gridSize3, gridSize3,
+			     f0 & 511, f1 & 511, f2 & 511);
+      }
+    } else {
+      p3 = gridPos + 768;
+      for (i = 0; i < n; ++i, in += 4) {
+	f0 = p0[in[0]];
+	f1 = p1[in[1]];
+	f2 = p2[in[2]];
+	f3 = p3[in[3]];
+	grid = rgbGrid + (f0 >> 9) + (f1 >> 9) + (f2 >> 9) + (f3 >> 9);
+	out[i] = lerpRGB(gridInterp3(grid, gridSize4 * gridSize4, gridSize4,
+				     f1 & 511, f2 & 511, f3 & 511),
+			 gridInterp3(grid + gridSize4 * gridSize4 * gridSize4,
+				     gridSize4 * gridSize4, gridSize4,
+				     f1 & 511, f2 & 511, f3 & 511),
+			 f0 & 511);
+      }
+    }
+    break;
+
+  case imgLineSlow:
+    for (i = 0; i < n; ++i, in += nComps) {
+      getRGB(in, &rgb);
+      out[i] = rgbToARGB(&rgb);
+    }
+    break;
+  }
+}
+
 //------------------------------------------------------------------------
 // GfxSubpath and GfxPath
 //------------------------------------------------------------------------
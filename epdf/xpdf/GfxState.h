@@ -606,6 +606,17 @@ private:
 // GfxImageColorMap
 //------------------------------------------------------------------------
 
+// How GfxImageColorMap::getRGBLine converts pixels.
+enum GfxImageLineMode {
+  imgLineLookup,		// rgbLookup, indexed by the packed pixel
+  imgLineRGB,			// byteLookup gives R, G and B
+  imgLineCMYK,			// byteLookup gives C, M, Y and K, then
+				//   DeviceCMYK in integers
+  imgLineGrid,			// interpolated in rgbGrid, at the
+				//   positions given by gridPos
+  imgLineSlow			// getRGB, pixel by pixel
+};
+
 class GfxImageColorMap {
 public:
 
@@ -634,14 +645,33 @@ public:
   void getRGB(Guchar *x, GfxRGB *rgb);
   void getCMYK(Guchar *x, GfxCMYK *cmyk);
 
+  // Convert <n> image pixels (as returned by ImageStream::getLine) to
+  // 0xffRRGGBB values.  Depending on the color space this uses exact
+  // tables, DeviceCMYK in integers (within 2 levels of getRGB) or (for
+  // other 3- and 4-component spaces with 8-bit components) an
+  // interpolated grid, within a few levels.
+  void getRGBLine(Guchar *in, Guint *out, int n);
+
 private:
 
+  void initRGBLine();
+  void buildRGBGrid();
+
   GfxColorSpace *colorSpace;	// the image color space
   int bits;			// bits per component
   int nComps;			// number of components in a pixel
   GfxColorSpace *colorSpace2;	// secondary color space
   int nComps2;			// number of components in colorSpace2
   fouble *lookup;		// lookup table
+  GfxImageLineMode lineMode;	// how getRGBLine works
+  Guchar *byteLookup;		// per component, 256 entries each: RGB
+				//   or CMYK levels
+  Guint *rgbLookup;		// pixel to 0xffRRGGBB
+  int *gridPos;			// per component, 256 entries each:
+				//   position in rgbGrid
+  Guint *rgbGrid;		// grid of colors, 33^3 or 17^4 nodes
+  int gridCountdown;		// pixels to convert with getRGB before
+				//   building rgbGrid
   fouble			// minimum values for each component
     decodeLow[gfxColorMaxComps];
   fouble			// max - min value for each component
@@ -894,9 +924,12 @@ public:
   void closePath()
     { path->close(); curX = path->getLastX(); curY = path->getLastY(); }
   void clearPath();
+  void setPath(GfxPath *pathA) { delete path; path = pathA; }
 
   // Update clip region.
   void clip();
+  void setClipBBox(fouble xMin, fouble yMin, fouble xMax, fouble yMax)
+    { clipXMin = xMin; clipYMin = yMin; clipXMax = xMax; clipYMax = yMax; }
 
   // Text position.
   void textMoveTo(fouble tx, fouble ty)
@@ -10,6 +10,7 @@
 #pragma implementation
 #endif
 
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #if HAVE_PAPER_H
@@ -26,6 +27,8 @@
 #include "CharCodeToUnicode.h"
 #include "UnicodeMap.h"
 #include "CMap.h"
+#include "NameTable.h"
+#include "Gfx.h"
 #include "BuiltinFontTables.h"
 #include "FontEncodingTables.h"
 #include "GlobalParams.h"
@@ -119,10 +122,12 @@ PSFontParam::~PSFontParam() {
 GlobalParams::GlobalParams(char *cfgFileName) {
   UnicodeMap *map;
   DisplayFontParam *dfp;
-  GString *fileName;
+  GString *fileName, *homeDir;
   FILE *f;
   int i;
 
+  NameTable::init();
+  Gfx::initOpJumpTab();
   initBuiltinFontTables();
 
   // scan the encoding in reverse because we want the lowest-numbered
@@ -181,6 +186,15 @@ GlobalParams::GlobalParams(char *cfgFileName) {
   urlCommand = NULL;
   mapNumericCharNames = gTrue;
   errQuiet = gFalse;
+  objectCacheSize = defObjectCacheSize;
+  formCacheSize = defFormCacheSize;
+  pageListCacheSize = defPageListCacheSize;
+  xrefCacheDir = NULL;
+  docCache = gFalse;
+  homeDir = getHomeDir();
+  docCacheDir = appendToPath(homeDir, xpdfDocCacheDir);
+  delete homeDir;
+  dctCoefLimit = defDCTCoefLimit;
 
   cidToUnicodeCache = new CIDToUnicodeCache();
   unicodeMapCache = new UnicodeMapCache();
@@ -371,6 +385,23 @@ void GlobalParams::parseFile(GString *fileName, FILE *f) {
 		   tokens, fileName, line);
       } else if (!cmd->cmp("errQuiet")) {
 	parseYesNo("errQuiet", &errQuiet, tokens, fileName, line);
+      } else if (!cmd->cmp("objectCacheSize")) {
+	parseInteger("objectCacheSize", &objectCacheSize,
+		     tokens, fileName, line);
+      } else if (!cmd->cmp("formCacheSize")) {
+	parseInteger("formCacheSize", &formCacheSize,
+		     tokens, fileName, line);
+      } else if (!cmd->cmp("pageListCacheSize")) {
+	parseInteger("pageListCacheSize", &pageListCacheSize,
+		     tokens, fileName, line);
+      } else if (!cmd->cmp("xrefCacheDir")) {
+	parseXRefCacheDir(tokens, fileName, line);
+      } else if (!cmd->cmp("docCache")) {
+	parseYesNo("docCache", &docCache, tokens, fileName, line);
+      } else if (!cmd->cmp("docCacheDir")) {
+	parseDocCacheDir(tokens, fileName, line);
+      } else if (!cmd->cmp("dctCoefLimit")) {
+	parseInteger("dctCoefLimit", &dctCoefLimit, tokens, fileName, line);
       } else if (!cmd->cmp("fontpath") || !cmd->cmp("fontmap")) {
 	error(-1, "Unknown config file command");
 	error(-1, "-- the config file format has changed since Xpdf 0.9x");
@@ -710,6 +741,30 @@ void GlobalParams::parseURLCommand(GList *tokens, GString *fileName,
   urlCommand = ((GString *)tokens->get(1))->copy();
 }
 
+void GlobalParams::parseXRefCacheDir(GList *tokens, GString *fileName,
+				     int line) {
+  if (tokens->getLength() != 2) {
+    error(-1, "Bad 'xrefCacheDir' config file command (%s:%d)",
+	  fileName->getCString(), line);
+    return;
+  }
+  if (xrefCacheDir) {
+    delete xrefCacheDir;
+  }
+  xrefCacheDir = ((GString *)tokens->get(1))->copy();
+}
+
+void GlobalParams::parseDocCacheDir(GList *tokens, GString *fileName,
+				    int line) {
+  if (tokens->getLength() != 2) {
+    error(-1, "Bad 'docCacheDir' config file command (%s:%d)",
+	  fileName->getCString(), line);
+    return;
+  }
+  delete docCacheDir;
+  docCacheDir = ((GString *)tokens->get(1))->copy();
+}
+
 void GlobalParams::parseYesNo(char *cmdName, GBool *flag,
 			      GList *tokens, GString *fileName, int line) {
   GString *tok;
@@ -730,6 +785,32 @@ void GlobalParams::parseYesNo(char *cmdName, GBool *flag,
   }
 }
 
+void GlobalParams::parseInteger(char *cmdName, int *val,
+				GList *tokens, GString *fileName, int line) {
+  GString *tok;
+  int i;
+
+  if (tokens->getLength() != 2) {
+    error(-1, "Bad '%s' config file command (%s:%d)",
+	  cmdName, fileName->getCString(), line);
+    return;
+  }
+  tok = (GString *)tokens->get(1);
+  if (tok->getLength() == 0) {
+    error(-1, "Bad '%s' config file command (%s:%d)",
+	  cmdName, fileName->getCString(), line);
+    return;
+  }
+  for (i = 0; i < tok->getLength(); ++i) {
+    if (tok->getChar(i) < '0' || tok->getChar(i) > '9') {
+      error(-1, "Bad '%s' config file command (%s:%d)",
+	    cmdName, fileName->getCString(), line);
+      return;
+    }
+  }
+  *val = atoi(tok->getCString());
+}
+
 GlobalParams::~GlobalParams() {
   GHashIter *iter;
   GString *key;
@@ -759,6 +840,10 @@ GlobalParams::~GlobalParams() {
   if (urlCommand) {
     delete urlCommand;
   }
+  if (xrefCacheDir) {
+    delete xrefCacheDir;
+  }
+  delete docCacheDir;
 
   cMapDirs->startIter(&iter);
   while (cMapDirs->getNext(&iter, &key, (void **)&list)) {
@@ -769,6 +854,9 @@ GlobalParams::~GlobalParams() {
   delete cidToUnicodeCache;
   delete unicodeMapCache;
   delete cMapCache;
+
+  Gfx::freeOpJumpTab();
+  NameTable::cleanup();
 }
 
 //------------------------------------------------------------------------
@@ -1063,3 +1151,35 @@ GBool GlobalParams::setFontRastControl(FontRastControl *val, char *s) {
 void GlobalParams::setErrQuiet(GBool errQuietA) {
   errQuiet = errQuietA;
 }
+
+void GlobalParams::setObjectCacheSize(int size) {
+  objectCacheSize = size;
+}
+
+void GlobalParams::setFormCacheSize(int size) {
+  formCacheSize = size;
+}
+
+void GlobalParams::setPageListCacheSize(int size) {
+  pageListCacheSize = size;
+}
+
+void GlobalParams::setXRefCacheDir(char *dir) {
+  if (xrefCacheDir) {
+    delete xrefCacheDir;
+  }
+  xrefCacheDir = dir ? new GString(dir) : (GString *)NULL;
+}
+
+void GlobalParams::setDocCache(GBool docCacheA) {
+  docCache = docCacheA;
+}
+
+void GlobalParams::setDocCacheDir(char *dir) {
+  delete docCacheDir;
+  docCacheDir = new GString(dir);
+}
+
+void GlobalParams::setDCTCoefLimit(int limit) {
+  dctCoefLimit = limit;
+}
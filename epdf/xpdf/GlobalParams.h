@@ -157,6 +157,13 @@ public:
   GString *getURLCommand() { return urlCommand; }
   GBool getMapNumericCharNames() { return mapNumericCharNames; }
   GBool getErrQuiet() { return errQuiet; }
+  int getObjectCacheSize() { return objectCacheSize; }
+  int getFormCacheSize() { return formCacheSize; }
+  int getPageListCacheSize() { return pageListCacheSize; }
+  GString *getXRefCacheDir() { return xrefCacheDir; }
+  GBool getDocCache() { return docCache; }
+  GString *getDocCacheDir() { return docCacheDir; }
+  int getDCTCoefLimit() { return dctCoefLimit; }
 
   CharCodeToUnicode *getCIDToUnicode(GString *collection);
   UnicodeMap *getUnicodeMap(GString *encodingName);
@@ -183,6 +190,13 @@ public:
   GBool setT1libControl(char *s);
   GBool setFreeTypeControl(char *s);
   void setErrQuiet(GBool errQuietA);
+  void setObjectCacheSize(int size);
+  void setFormCacheSize(int size);
+  void setPageListCacheSize(int size);
+  void setXRefCacheDir(char *dir);
+  void setDocCache(GBool docCacheA);
+  void setDocCacheDir(char *dir);
+  void setDCTCoefLimit(int limit);
 
 private:
 
@@ -208,8 +222,12 @@ private:
   void parseFontRastControl(char *cmdName, FontRastControl *val,
 			    GList *tokens, GString *fileName, int line);
   void parseURLCommand(GList *tokens, GString *fileName, int line);
+  void parseXRefCacheDir(GList *tokens, GString *fileName, int line);
+  void parseDocCacheDir(GList *tokens, GString *fileName, int line);
   void parseYesNo(char *cmdName, GBool *flag,
 		  GList *tokens, GString *fileName, int line);
+  void parseInteger(char *cmdName, int *val,
+		    GList *tokens, GString *fileName, int line);
   GBool setFontRastControl(FontRastControl *val, char *s);
 
   //----- static tables
@@ -264,6 +282,20 @@ private:
   GString *urlCommand;		// command executed for URL links
   GBool mapNumericCharNames;	// map numeric char names (from font subsets)?
   GBool errQuiet;		// suppress error messages?
+  int objectCacheSize;		// max bytes of parsed objects cached by
+				//   each XRef (0 = no cache)
+  int formCacheSize;		// max bytes of form XObject display lists
+				//   cached for each document (0 = no cache)
+  int pageListCacheSize;	// max bytes of page display lists cached
+				//   for each document (0 = no cache)
+  GString *xrefCacheDir;	// dir for reconstructed xref tables of
+				//   damaged files (NULL = don't save)
+  GBool docCache;		// save the document structure (and page
+				//   display lists) of each file opened,
+				//   for fast reopening?
+  GString *docCacheDir;		// dir for the document structure cache
+  int dctCoefLimit;		// max bytes of coefficients buffered for
+				//   one progressive JPEG image
 
   CIDToUnicodeCache *cidToUnicodeCache;
   UnicodeMapCache *unicodeMapCache;
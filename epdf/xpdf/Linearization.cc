@@ -0,0 +1,345 @@
+//========================================================================
+//
+// Linearization.cc
+//
+// Linearization dictionary and page offset hint table.
+//
+//========================================================================
+
+#ifdef __GNUC__
+#pragma implementation
+#endif
+
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include "../goo/gmem.h"
+#include "Object.h"
+#include "Stream.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "Dict.h"
+#include "XRef.h"
+#include "Error.h"
+#include "Linearization.h"
+
+//------------------------------------------------------------------------
+
+#define pageOffsetHdrItems 13	// number of items in the page offset
+				//   hint table header
+#define objHeaderSize 32	// bytes checked for an object header
+
+// Look up a non-negative integer in the linearization dictionary.
+static GBool lookupUInt(Dict *dict, char *key, Guint *val) {
+  Object obj;
+  GBool ok;
+
+  if ((ok = dict->lookup(key, &obj)->isInt() && obj.getInt() >= 0)) {
+    *val = (Guint)obj.getInt();
+  }
+  obj.free();
+  return ok;
+}
+
+//------------------------------------------------------------------------
+// HintBitReader
+//------------------------------------------------------------------------
+
+// Reads the bit fields of a hint table, most significant bit first.
+struct HintBitReader {
+  Stream *str;
+  Guint buf;			// bits not used yet are the low <bits>
+  int bits;			//   bits of <buf>
+};
+
+static GBool readHintBits(HintBitReader *r, int n, Guint *val) {
+  Guint x;
+  int c, k;
+
+  x = 0;
+  while (n > 0) {
+    if (r->bits == 0) {
+      if ((c = r->str->getChar()) == EOF) {
+	return gFalse;
+      }
+      r->buf = (Guint)c;
+      r->bits = 8;
+    }
+    k = n < r->bits ? n : r->bits;
+    x = (x << k) | ((r->buf >> (r->bits - k)) & ((1 << k) - 1));
+    r->bits -= k;
+    n -= k;
+  }
+  *val = x;
+  return gTrue;
+}
+
+// Skip to the next byte boundary.
+static void alignHintBits(HintBitReader *r) {
+  r->bits = 0;
+}
+
+//------------------------------------------------------------------------
+// Linearization
+//------------------------------------------------------------------------
+
+Linearization::Linearization(BaseStream *strA) {
+  Parser *parser;
+  Object obj1, obj2, obj3, obj4, obj5;
+  Guint objNum, pageEnd, nPages, first, fileSize;
+
+  str = strA;
+  ok = gFalse;
+  fileLength = 0;
+  hintOffset = hintLength = 0;
+  firstPageObjNum = 0;
+  firstPageEnd = 0;
+  numPages = 0;
+  hintTableRead = gFalse;
+  pageOffsets = NULL;
+
+  // the linearization dictionary has to be the first object in the
+  // file
+  obj1.initNull();
+  parser = new Parser(NULL,
+	     new Lexer(NULL,
+	       str->makeSubStream(str->getStart(), gFalse, 0, &obj1)));
+  parser->getObj(&obj1);
+  parser->getObj(&obj2);
+  parser->getObj(&obj3);
+  parser->getObj(&obj4);
+  if (!obj1.isInt() || !obj2.isInt() || !obj3.isCmd("obj") ||
+      !obj4.isDict()) {
+    goto err1;
+  }
+  if (!obj4.dictLookup("Linearized", &obj5)->isNum() ||
+      obj5.getNum() <= 0) {
+    goto err2;
+  }
+  obj5.free();
+  if (!lookupUInt(obj4.getDict(), "L", &fileLength) ||
+      !lookupUInt(obj4.getDict(), "O", &objNum) ||
+      !lookupUInt(obj4.getDict(), "E", &pageEnd) ||
+      !lookupUInt(obj4.getDict(), "N", &nPages) ||
+      objNum == 0 || objNum > INT_MAX ||
+      nPages == 0 || nPages > INT_MAX / sizeof(Guint)) {
+    goto err1;
+  }
+
+  // the first page has to be page 1
+  if (lookupUInt(obj4.getDict(), "P", &first) && first != 0) {
+    goto err1;
+  }
+
+  // primary hint stream
+  if (!obj4.dictLookup("H", &obj5)->isArray() ||
+      obj5.arrayGetLength() < 2) {
+    goto err2;
+  }
+  obj1.free();
+  obj2.free();
+  obj5.arrayGet(0, &obj1);
+  obj5.arrayGet(1, &obj2);
+  if (!obj1.isInt() || !obj2.isInt() ||
+      obj1.getInt() < 0 || obj2.getInt() < 0) {
+    goto err2;
+  }
+  hintOffset = (Guint)obj1.getInt();
+  hintLength = (Guint)obj2.getInt();
+  obj5.free();
+
+  // /L doesn't match the file if it has been updated since it was
+  // linearized: the first-page xref table is no longer the last one,
+  // and the hint table may be out of date
+  str->setPos(0, -1);
+  fileSize = (Guint)str->getPos() - str->getStart();
+  if (fileLength != fileSize ||
+      pageEnd > fileLength || hintOffset > fileLength ||
+      hintLength > fileLength - hintOffset) {
+    goto err1;
+  }
+
+  firstPageObjNum = (int)objNum;
+  firstPageEnd = pageEnd;
+  numPages = (int)nPages;
+  ok = gTrue;
+
+ err2:
+  obj5.free();
+ err1:
+  obj1.free();
+  obj2.free();
+  obj3.free();
+  obj4.free();
+  delete parser;
+}
+
+Linearization::~Linearization() {
+  gfree(pageOffsets);
+}
+
+GBool Linearization::getPageRef(int page, XRef *xref, Ref *ref) {
+  Guint offset;
+
+  if (!hintTableRead) {
+    hintTableRead = gTrue;
+    if (!readHintTable(xref)) {
+      error(-1, "Bad page offset hint table in linearized file");
+      gfree(pageOffsets);
+      pageOffsets = NULL;
+    }
+  }
+  if (!pageOffsets || page < 1 || page > numPages) {
+    return gFalse;
+  }
+
+  // the offsets are computed as if the hint stream weren't there;
+  // some writers don't do that, so try both
+  offset = pageOffsets[page - 1];
+  if (offset >= hintOffset &&
+      readPageObjHeader(offset + hintLength, ref)) {
+    return gTrue;
+  }
+  return readPageObjHeader(offset, ref);
+}
+
+// Read the page offset hint table (at the start of the primary hint
+// stream).  Only the parts needed to find each page object are used:
+// the header, the number of objects in each page (which has to be
+// skipped), and the length of each page.
+GBool Linearization::readHintTable(XRef *xref) {
+  Parser *parser;
+  Object obj1, obj2, obj3, obj4;
+  HintBitReader r;
+  Guint hdr[pageOffsetHdrItems];
+  Guint leastLength, objBits, lengthBits, x, end;
+  int i;
+  static int hdrBits[pageOffsetHdrItems] = {
+    32, 32, 16, 32, 16, 32, 16, 32, 16, 16, 16, 16, 16
+  };
+  GBool ok1;
+
+  ok1 = gFalse;
+  obj1.initNull();
+  parser = new Parser(xref,
+	     new Lexer(xref,
+	       str->makeSubStream(str->getStart() + hintOffset, gFalse, 0,
+				  &obj1)));
+  parser->getObj(&obj1);
+  parser->getObj(&obj2);
+  parser->getObj(&obj3);
+  parser->getObj(&obj4);
+  if (!obj1.isInt() || !obj2.isInt() || !obj3.isCmd("obj") ||
+      !obj4.isStream()) {
+    goto err;
+  }
+
+  r.str = obj4.getStream();
+  r.buf = 0;
+  r.bits = 0;
+  r.str->reset();
+  for (i = 0; i < pageOffsetHdrItems; ++i) {
+    if (!readHintBits(&r, hdrBits[i], &hdr[i])) {
+      goto err;
+    }
+  }
+  objBits = hdr[2];
+  leastLength = hdr[3];
+  lengthBits = hdr[4];
+  if (objBits > 32 || lengthBits > 32) {
+    goto err;
+  }
+
+  // item 1 (number of objects) for each page
+  for (i = 0; i < numPages; ++i) {
+    if (!readHintBits(&r, objBits, &x)) {
+      goto err;
+    }
+  }
+  alignHintBits(&r);
+
+  // item 2 (page length) for each page
+  pageOffsets = (Guint *)gmalloc(numPages * sizeof(Guint));
+  end = hdr[1];
+  for (i = 0; i < numPages; ++i) {
+    if (!readHintBits(&r, lengthBits, &x) ||
+	end >= fileLength || leastLength > fileLength - end ||
+	x > fileLength - end - leastLength) {
+      goto err;
+    }
+    pageOffsets[i] = end;
+    end += leastLength + x;
+  }
+  ok1 = gTrue;
+
+ err:
+  if (obj4.isStream()) {
+    obj4.streamClose();
+  }
+  obj1.free();
+  obj2.free();
+  obj3.free();
+  obj4.free();
+  delete parser;
+  return ok1;
+}
+
+// Check that there is a page object at <offset>, and get its ID.
+GBool Linearization::readPageObjHeader(Guint offset, Ref *ref) {
+  Stream *hdrStr;
+  Parser *parser;
+  Object obj1, obj2, obj3, obj4;
+  char buf[objHeaderSize + 1];
+  char *p;
+  GBool found;
+  int n;
+
+  if (offset >= fileLength) {
+    return gFalse;
+  }
+
+  // check for 'n g obj' before parsing anything, so a wrong offset
+  // doesn't produce a stream of syntax errors
+  obj1.initNull();
+  hdrStr = str->makeSubStream(str->getStart() + offset, gFalse, 0, &obj1);
+  hdrStr->reset();
+  n = hdrStr->getBlock(buf, objHeaderSize);
+  hdrStr->close();
+  delete hdrStr;
+  buf[n] = '\0';
+  for (p = buf; isdigit(*p); ++p) ;
+  if (p == buf || !isspace(*p)) {
+    return gFalse;
+  }
+  while (isspace(*p)) ++p;
+  if (!isdigit(*p)) {
+    return gFalse;
+  }
+  while (isdigit(*p)) ++p;
+  while (isspace(*p)) ++p;
+  if (strncmp(p, "obj", 3)) {
+    return gFalse;
+  }
+
+  obj1.initNull();
+  parser = new Parser(NULL,
+	     new Lexer(NULL,
+	       str->makeSubStream(str->getStart() + offset, gFalse, 0,
+				  &obj1)));
+  parser->getObj(&obj1);
+  parser->getObj(&obj2);
+  parser->getObj(&obj3);
+  parser->getObj(&obj4);
+  if ((found = obj1.isInt() && obj2.isInt() && obj3.isCmd("obj") &&
+	       obj4.isDict("Page"))) {
+    ref->num = obj1.getInt();
+    ref->gen = obj2.getInt();
+  }
+  obj1.free();
+  obj2.free();
+  obj3.free();
+  obj4.free();
+  delete parser;
+  return found;
+}
@@ -0,0 +1,81 @@
+//========================================================================
+//
+// Linearization.h
+//
+// Linearization dictionary and page offset hint table.
+//
+//========================================================================
+
+#ifndef LINEARIZATION_H
+#define LINEARIZATION_H
+
+#ifdef __GNUC__
+#pragma interface
+#endif
+
+#include "../goo/gtypes.h"
+#include "Object.h"
+
+class BaseStream;
+class XRef;
+
+//------------------------------------------------------------------------
+// Linearization
+//------------------------------------------------------------------------
+
+// The linearization dictionary and page offset hint table of a
+// linearized ("fast web view") file.  A linearized file starts with
+// everything needed to display the first page, followed by the other
+// pages in order; the xref table and page tree covering the other
+// pages are at the end of the file.  The hint table gives the offset
+// of each page.
+
+class Linearization {
+public:
+
+  // Read the linearization dictionary at the start of <strA>.
+  Linearization(BaseStream *strA);
+
+  // Destructor.
+  ~Linearization();
+
+  // Is this a linearized file whose linearization dictionary matches
+  // the file?  (A file that has been updated since it was linearized
+  // doesn't.)
+  GBool isOk() { return ok; }
+
+  // Get the number of pages (/N).
+  int getNumPages() { return numPages; }
+
+  // Get the object number of the first page's page object (/O).
+  int getFirstPageObjNum() { return firstPageObjNum; }
+
+  // Get the offset of the end of the first page (/E).
+  Guint getFirstPageEnd() { return firstPageEnd; }
+
+  // Get the object ID of page <page> (1-based) from the page offset
+  // hint table.  The table is read on first use; <xref> is used to
+  // read the hint stream.  Returns false if the table is missing or
+  // bad, or doesn't lead to a page object.
+  GBool getPageRef(int page, XRef *xref, Ref *ref);
+
+private:
+
+  GBool readHintTable(XRef *xref);
+  GBool readPageObjHeader(Guint offset, Ref *ref);
+
+  BaseStream *str;		// the file
+  GBool ok;			// set if the file is linearized
+  Guint fileLength;		// file length (/L)
+  Guint hintOffset;		// primary hint stream offset and
+  Guint hintLength;		//   length (/H)
+  int firstPageObjNum;		// first page object number (/O)
+  Guint firstPageEnd;		// end of first page (/E)
+  int numPages;			// number of pages (/N)
+  GBool hintTableRead;		// set once the hint table has been read
+  Guint *pageOffsets;		// offset of each page object, as if the
+				//   hint stream weren't there (NULL if
+				//   the hint table is missing or bad)
+};
+
+#endif
@@ -0,0 +1,276 @@
+//========================================================================
+//
+// NameTable.cc
+//
+// Interned names and commands (atoms).
+//
+//========================================================================
+
+#ifdef __GNUC__
+#pragma implementation
+#endif
+
+#include <stddef.h>
+#include <string.h>
+#include "../goo/gmem.h"
+#include "Error.h"
+#include "NameTable.h"
+
+//------------------------------------------------------------------------
+
+// Pre-registered names: the well-known names (in NameAtom enum order,
+// starting at atom 1), followed by the content stream operators and
+// the parser keywords.
+static char *preregisteredNames[] = {
+  // well-known names
+  "BaseFont",
+  "BBox",
+  "BitsPerComponent",
+  "ColorSpace",
+  "Contents",
+  "Count",
+  "CropBox",
+  "Decode",
+  "DecodeParms",
+  "Encoding",
+  "Encrypt",
+  "ExtGState",
+  "Filter",
+  "FirstChar",
+  "Font",
+  "FontDescriptor",
+  "Height",
+  "ID",
+  "ImageMask",
+  "Info",
+  "Kids",
+  "LastChar",
+  "Length",
+  "Matrix",
+  "MediaBox",
+  "N",
+  "Page",
+  "Pages",
+  "Parent",
+  "Pattern",
+  "Prev",
+  "ProcSet",
+  "Resources",
+  "Root",
+  "Rotate",
+  "Shading",
+  "Size",
+  "Subtype",
+  "Type",
+  "Width",
+  "Widths",
+  "XObject",
+
+  // content stream operators
+  "\"",  "'",   "B",   "B*",  "BDC", "BI",  "BMC", "BT",  "BX",  "CS",
+  "DP",  "Do",  "EI",  "EMC", "ET",  "EX",  "F",   "G",   "ID",  "J",
+  "K",   "M",   "MP",  "Q",   "RG",  "S",   "SC",  "SCN", "T*",  "TD",
+  "TJ",  "TL",  "Tc",  "Td",  "Tf",  "Tj",  "Tm",  "Tr",  "Ts",  "Tw",
+  "Tz",  "W",   "W*",  "b",   "b*",  "c",   "cm",  "cs",  "d",   "d0",
+  "d1",  "f",   "f*",  "g",   "gs",  "h",   "i",   "j",   "k",   "l",
+  "m",   "n",   "q",   "re",  "rg",  "ri",  "s",   "sc",  "scn", "sh",
+  "v",   "w",   "y",
+
+  // parser keywords and punctuation
+  "[",   "]",   "<<",  ">>",  "{",   "}",   "R",   "obj", "endobj",
+  "stream", "endstream", "xref", "trailer", "startxref"
+};
+
+#define numPreregisteredNames \
+  ((int)(sizeof(preregisteredNames) / sizeof(char *)))
+
+//------------------------------------------------------------------------
+// NameTable
+//------------------------------------------------------------------------
+
+NameTableEntry *NameTable::blocks[nameAtomMaxBlocks];
+int NameTable::numAtoms = 0;
+int NameTable::atomsSize = 0;
+NameAtom *NameTable::table = NULL;
+int NameTable::tableSize = 0;
+int NameTable::numPreregistered = 0;
+int NameTable::numDocs = 0;
+int NameTable::docMark = 0;
+GMutex NameTable::mutex;
+
+static inline Guint hashName(char *name) {
+  char *p;
+  Guint h;
+
+  h = 0;
+  for (p = name; *p; ++p) {
+    h = 17 * h + (Guint)(*p & 0xff);
+  }
+  return h;
+}
+
+void NameTable::init() {
+  int i;
+
+  if (table) {
+    return;
+  }
+  gInitMutex(&mutex);
+  atomsSize = nameAtomBlockSize;
+  blocks[0] = (NameTableEntry *)gmalloc(nameAtomBlockSize *
+					 sizeof(NameTableEntry));
+  blocks[0][atomNone].name = "";
+  blocks[0][atomNone].hash = 0;
+  numAtoms = 1;
+  tableSize = 2 * atomsSize;
+  table = (NameAtom *)gmalloc(tableSize * sizeof(NameAtom));
+  for (i = 0; i < tableSize; ++i) {
+    table[i] = atomNone;
+  }
+  for (i = 0; i < numPreregisteredNames; ++i) {
+    intern(preregisteredNames[i]);
+  }
+  numPreregistered = numAtoms;
+}
+
+void NameTable::cleanup() {
+  int i;
+
+  if (!table) {
+    return;
+  }
+  for (i = 1; i < numAtoms; ++i) {
+    gfree(getString(i));
+  }
+  for (i = 0; i < atomsSize / nameAtomBlockSize; ++i) {
+    gfree(blocks[i]);
+    blocks[i] = NULL;
+  }
+  gfree(table);
+  table = NULL;
+  numAtoms = atomsSize = tableSize = numPreregistered = 0;
+  numDocs = docMark = 0;
+  gDestroyMutex(&mutex);
+}
+
+// Add a block of atoms, double the hash table and rehash.  Returns
+// false if the table is full.
+GBool NameTable::grow() {
+
+  if (atomsSize / nameAtomBlockSize == nameAtomMaxBlocks) {
+    return gFalse;
+  }
+  blocks[atomsSize / nameAtomBlockSize] =
+      (NameTableEntry *)gmalloc(nameAtomBlockSize * sizeof(NameTableEntry));
+  atomsSize += nameAtomBlockSize;
+  if (2 * atomsSize > tableSize) {
+    gfree(table);
+    tableSize *= 2;
+    table = (NameAtom *)gmalloc(tableSize * sizeof(NameAtom));
+    rehash();
+  }
+  return gTrue;
+}
+
+// Clear the hash table and enter atoms 1 .. <numAtoms>-1.
+void NameTable::rehash() {
+  int slot, i;
+
+  for (i = 0; i < tableSize; ++i) {
+    table[i] = atomNone;
+  }
+  for (i = 1; i < numAtoms; ++i) {
+    lookup(getString(i), getEntry(i)->hash, &slot);
+    table[slot] = i;
+  }
+}
+
+// Look up <name> (with hash <h>).  Returns its atom, or atomNone, in
+// which case *<slot> is set to the empty table slot where it belongs.
+NameAtom NameTable::lookup(char *name, Guint h, int *slot) {
+  NameAtom atom;
+  int i;
+
+  i = (int)(h & (tableSize - 1));
+  while ((atom = table[i]) != atomNone) {
+    if (getEntry(atom)->hash == h && !strcmp(getString(atom), name)) {
+      return atom;
+    }
+    i = (i + 1) & (tableSize - 1);
+  }
+  *slot = i;
+  return atomNone;
+}
+
+NameAtom NameTable::intern(char *name) {
+  NameTableEntry *e;
+  NameAtom atom;
+  Guint h;
+  int slot;
+
+  h = hashName(name);
+  gLockMutex(&mutex);
+  if ((atom = lookup(name, h, &slot)) == atomNone) {
+    if (numAtoms == atomsSize) {
+      if (!grow()) {
+	gUnlockMutex(&mutex);
+	error(-1, "Too many different names");
+	return atomNone;
+      }
+      lookup(name, h, &slot);
+    }
+    atom = numAtoms++;
+    e = getEntry(atom);
+    e->name = copyString(name);
+    e->hash = h;
+    table[slot] = atom;
+  }
+  gUnlockMutex(&mutex);
+  return atom;
+}
+
+NameAtom NameTable::find(char *name) {
+  NameAtom atom;
+  Guint h;
+  int slot;
+
+  h = hashName(name);
+  gLockMutex(&mutex);
+  atom = lookup(name, h, &slot);
+  gUnlockMutex(&mutex);
+  return atom;
+}
+
+int NameTable::getNumPreregistered() {
+  return numPreregistered;
+}
+
+void NameTable::docOpened() {
+  gLockMutex(&mutex);
+  if (numDocs++ == 0) {
+    docMark = numAtoms;
+  }
+  gUnlockMutex(&mutex);
+}
+
+// The blocks holding only removed atoms are freed; the hash table
+// keeps its size.
+void NameTable::docClosed() {
+  int nBlocks, i;
+
+  gLockMutex(&mutex);
+  if (--numDocs == 0 && numAtoms > docMark) {
+    for (i = docMark; i < numAtoms; ++i) {
+      gfree(getString(i));
+    }
+    numAtoms = docMark;
+    nBlocks = (numAtoms + nameAtomBlockSize - 1) / nameAtomBlockSize;
+    for (i = nBlocks; i < atomsSize / nameAtomBlockSize; ++i) {
+      gfree(blocks[i]);
+      blocks[i] = NULL;
+    }
+    atomsSize = nBlocks * nameAtomBlockSize;
+    rehash();
+  }
+  gUnlockMutex(&mutex);
+}
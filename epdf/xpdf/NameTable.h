@@ -0,0 +1,162 @@
+//========================================================================
+//
+// NameTable.h
+//
+// Interned names and commands (atoms).
+//
+//========================================================================
+
+#ifndef NAMETABLE_H
+#define NAMETABLE_H
+
+#ifdef __GNUC__
+#pragma interface
+#endif
+
+#include "../goo/gtypes.h"
+#include "../goo/GMutex.h"
+
+//------------------------------------------------------------------------
+// NameAtom
+//------------------------------------------------------------------------
+
+// Names and commands are interned in a single process-wide table and
+// referred to by small integer atoms.  Atom 0 is never assigned, so it
+// can be used for "no such name"; nothing is ever looked up by it.
+// Names interned while documents are open are removed when the last
+// one is closed (see NameTable::docClosed()); the others are kept until
+// NameTable::cleanup() (called when the GlobalParams are deleted).
+typedef int NameAtom;
+
+// Well-known names, pre-registered in this order.  The content stream
+// operators and parser keywords are registered right after these (see
+// NameTable.cc), so they also get small, fixed atoms.
+enum {
+  atomNone = 0,
+  atomBaseFont,
+  atomBBox,
+  atomBitsPerComponent,
+  atomColorSpace,
+  atomContents,
+  atomCount,
+  atomCropBox,
+  atomDecode,
+  atomDecodeParms,
+  atomEncoding,
+  atomEncrypt,
+  atomExtGState,
+  atomFilter,
+  atomFirstChar,
+  atomFont,
+  atomFontDescriptor,
+  atomHeight,
+  atomID,
+  atomImageMask,
+  atomInfo,
+  atomKids,
+  atomLastChar,
+  atomLength,
+  atomMatrix,
+  atomMediaBox,
+  atomN,
+  atomPage,
+  atomPages,
+  atomParent,
+  atomPattern,
+  atomPrev,
+  atomProcSet,
+  atomResources,
+  atomRoot,
+  atomRotate,
+  atomShading,
+  atomSize,
+  atomSubtype,
+  atomType,
+  atomWidth,
+  atomWidths,
+  atomXObject,
+  numNameAtoms			// first atom after the well-known names
+};
+
+//------------------------------------------------------------------------
+// NameTable
+//------------------------------------------------------------------------
+
+// The atoms' strings are stored in blocks which never move, so
+// getString() doesn't need the lock.
+struct NameTableEntry {
+  char *name;
+  Guint hash;
+};
+
+#define nameAtomBlockBits 10
+#define nameAtomBlockSize (1 << nameAtomBlockBits)
+#define nameAtomMaxBlocks 65536
+
+// intern(), find(), docOpened() and docClosed() may be called from
+// several threads at once.  init() and cleanup() may not: GlobalParams
+// calls them, before any other thread uses the core and after they are
+// all done.
+
+class NameTable {
+public:
+
+  // Set up the table.  Does nothing if it is already set up.  This is
+  // called by the GlobalParams constructor, and must be done before
+  // any other function is used.
+  static void init();
+
+  // Free the table and every interned string.  Atoms held by
+  // remaining objects become invalid.
+  static void cleanup();
+
+  // Return the atom for <name>, adding it to the table if needed.
+  // Returns atomNone if the table is full.
+  static NameAtom intern(char *name);
+
+  // Return the atom for <name>, or atomNone if it has never been
+  // interned (in which case no object can contain it).
+  static NameAtom find(char *name);
+
+  // Count the open documents (PDFDoc calls these).  When the last one
+  // is closed, the names interned since the first was opened are
+  // removed.  Their atoms must not be held past that point, so objects
+  // which outlive the documents must not be created while one is open.
+  static void docOpened();
+  static void docClosed();
+
+  // Return the string for an atom.
+  static char *getString(NameAtom atom) {
+    return getEntry(atom)->name;
+  }
+
+  // Number of atoms assigned at startup (well-known names plus
+  // operators and keywords).  Atoms below this are stable for the
+  // life of the process and small enough to index a table.
+  static int getNumPreregistered();
+
+private:
+
+  static NameTableEntry *getEntry(NameAtom atom) {
+    return &blocks[atom >> nameAtomBlockBits][atom & (nameAtomBlockSize - 1)];
+  }
+  static GBool grow();
+  static void rehash();
+  static NameAtom lookup(char *name, Guint h, int *slot);
+
+  static NameTableEntry *	// atom -> entry, in blocks of
+    blocks[nameAtomMaxBlocks];	//   nameAtomBlockSize
+  static int numAtoms;		// number of assigned atoms
+  static int atomsSize;		// number of atoms in allocated blocks
+  static NameAtom *table;	// open-addressing hash table of atoms
+				//   (0 = empty)
+  static int tableSize;		// size of <table> (power of 2)
+  static int numPreregistered;	// atoms assigned by init()
+  static int numDocs;		// number of open documents
+  static int docMark;		// <numAtoms> when the first open
+				//   document was opened
+  static GMutex mutex;		// protects everything but <blocks>
+				//   entries for assigned atoms
+};
+
+#endif
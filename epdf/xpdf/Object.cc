@@ -56,6 +56,13 @@ Object *Object::initDict(XRef *xref) {
   return this;
 }
 
+Object *Object::initDict(Dict *dictA) {
+  initObj(objDict);
+  dict = dictA;
+  dict->incRef();
+  return this;
+}
+
 Object *Object::initStream(Stream *streamA) {
   initObj(objStream);
   stream = streamA;
@@ -68,9 +75,6 @@ Object *Object::copy(Object *obj) {
   case objString:
     obj->string = string->copy();
     break;
-  case objName:
-    obj->name = copyString(name);
-    break;
   case objArray:
     array->incRef();
     break;
@@ -80,9 +84,6 @@ Object *Object::copy(Object *obj) {
   case objStream:
     stream->incRef();
     break;
-  case objCmd:
-    obj->cmd = copyString(cmd);
-    break;
   default:
     break;
   }
@@ -102,9 +103,6 @@ void Object::free() {
   case objString:
     delete string;
     break;
-  case objName:
-    gfree(name);
-    break;
   case objArray:
     if (!array->decRef()) {
       delete array;
@@ -120,9 +118,6 @@ void Object::free() {
       delete stream;
     }
     break;
-  case objCmd:
-    gfree(cmd);
-    break;
   default:
     break;
   }
@@ -132,6 +127,39 @@ void Object::free() {
   type = objNone;
 }
 
+int Object::getSize() {
+  Object obj1;
+  int n, i;
+
+  n = sizeof(Object);
+  switch (type) {
+  case objString:
+    n += sizeof(GString) + string->getLength();
+    break;
+  case objName:
+    n += strlen(getName()) + 1;
+    break;
+  case objArray:
+    n += sizeof(Array);
+    for (i = 0; i < arrayGetLength(); ++i) {
+      n += arrayGetNF(i, &obj1)->getSize();
+      obj1.free();
+    }
+    break;
+  case objDict:
+    n += sizeof(Dict);
+    for (i = 0; i < dictGetLength(); ++i) {
+      n += sizeof(DictEntry) + strlen(dictGetKey(i)) + 1;
+      n += dictGetValNF(i, &obj1)->getSize();
+      obj1.free();
+    }
+    break;
+  default:
+    break;
+  }
+  return n;
+}
+
 char *Object::getTypeName() {
   return objTypeNames[type];
 }
@@ -156,7 +184,7 @@ void Object::print(FILE *f) {
     fprintf(f, ")");
     break;
   case objName:
-    fprintf(f, "/%s", name);
+    fprintf(f, "/%s", getName());
     break;
   case objNull:
     fprintf(f, "null");
@@ -189,7 +217,7 @@ void Object::print(FILE *f) {
     fprintf(f, "%d %d R", ref.num, ref.gen);
     break;
   case objCmd:
-    fprintf(f, "%s", cmd);
+    fprintf(f, "%s", getCmd());
     break;
   case objError:
     fprintf(f, "<error>");
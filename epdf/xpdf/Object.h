@@ -20,6 +20,7 @@
 #include "../goo/gmem.h"
 #include "../goo/GString.h"
 
+#include "NameTable.h"
 #include "Dict.h"
 #include "Stream.h"
 
@@ -92,16 +93,19 @@ public:
   Object *initString(GString *stringA)
     { initObj(objString); string = stringA; return this; }
   Object *initName(char *nameA)
-    { initObj(objName); name = copyString(nameA); return this; }
+    { initObj(objName); atom = NameTable::intern(nameA); return this; }
+  Object *initName(NameAtom atomA)
+    { initObj(objName); atom = atomA; return this; }
   Object *initNull()
     { initObj(objNull); return this; }
   Object *initArray(XRef *xref);
   Object *initDict(XRef *xref);
+  Object *initDict(Dict *dictA);
   Object *initStream(Stream *streamA);
   Object *initRef(int numA, int genA)
     { initObj(objRef); ref.num = numA; ref.gen = genA; return this; }
   Object *initCmd(char *cmdA)
-    { initObj(objCmd); cmd = copyString(cmdA); return this; }
+    { initObj(objCmd); atom = NameTable::intern(cmdA); return this; }
   Object *initError()
     { initObj(objError); return this; }
   Object *initEOF()
@@ -117,6 +121,10 @@ public:
   // Free object contents.
   void free();
 
+  // Estimate the number of bytes used by the object, not counting
+  // indirectly referenced objects.
+  int getSize();
+
   // Type checking.
   ObjType getType() { return type; }
   GBool isBool() { return type == objBool; }
@@ -137,11 +145,13 @@ public:
 
   // Special type checking.
   GBool isName(char *nameA)
-    { return type == objName && !strcmp(name, nameA); }
+    { return type == objName && !strcmp(getName(), nameA); }
+  GBool isName(NameAtom atomA)
+    { return type == objName && atom == atomA; }
   GBool isDict(char *dictType);
   GBool isStream(char *dictType);
   GBool isCmd(char *cmdA)
-    { return type == objCmd && !strcmp(cmd, cmdA); }
+    { return type == objCmd && !strcmp(getCmd(), cmdA); }
 
   // Accessors.  NB: these assume object is of correct type.
   GBool getBool() { return booln; }
@@ -149,13 +159,16 @@ public:
   fouble getReal() { return real; }
   fouble getNum() { return type == objInt ? (fouble)intg : real; }
   GString *getString() { return string; }
-  char *getName() { return name; }
+  char *getName() { return NameTable::getString(atom); }
+  NameAtom getNameAtom() { return atom; }
   Array *getArray() { return array; }
   Dict *getDict() { return dict; }
   Stream *getStream() { return stream; }
   Ref getRef() { return ref; }
   int getRefNum() { return ref.num; }
   int getRefGen() { return ref.gen; }
+  char *getCmd() { return NameTable::getString(atom); }
+  NameAtom getCmdAtom() { return atom; }
 
   // Array accessors.
   int arrayGetLength();
@@ -166,9 +179,12 @@ public:
   // Dict accessors.
   int dictGetLength();
   void dictAdd(char *key, Object *val);
+  void dictAdd(NameAtom key, Object *val);
   GBool dictIs(char *dictType);
   Object *dictLookup(char *key, Object *obj);
+  Object *dictLookup(NameAtom key, Object *obj);
   Object *dictLookupNF(char *key, Object *obj);
+  Object *dictLookupNF(NameAtom key, Object *obj);
   char *dictGetKey(int i);
   Object *dictGetVal(int i, Object *obj);
   Object *dictGetValNF(int i, Object *obj);
@@ -199,12 +215,11 @@ private:
     GBool booln;		//   boolean
     int intg;			//   integer
     GString *string;		//   string
-    char *name;			//   name
+    NameAtom atom;		//   name or command
     Array *array;		//   array
     Dict *dict;			//   dictionary
     Stream *stream;		//   stream
     struct Ref ref;			//   indirect reference
-    char *cmd;			//   command
   };
 
 #ifdef DEBUG_MEM
@@ -242,6 +257,9 @@ inline int Object::dictGetLength()
 inline void Object::dictAdd(char *key, Object *val)
   { dict->add(key, val); }
 
+inline void Object::dictAdd(NameAtom key, Object *val)
+  { dict->add(key, val); }
+
 inline GBool Object::dictIs(char *dictType)
   { return dict->is(dictType); }
 
@@ -251,9 +269,15 @@ inline GBool Object::isDict(char *dictType)
 inline Object *Object::dictLookup(char *key, Object *obj)
   { return dict->lookup(key, obj); }
 
+inline Object *Object::dictLookup(NameAtom key, Object *obj)
+  { return dict->lookup(key, obj); }
+
 inline Object *Object::dictLookupNF(char *key, Object *obj)
   { return dict->lookupNF(key, obj); }
 
+inline Object *Object::dictLookupNF(NameAtom key, Object *obj)
+  { return dict->lookupNF(key, obj); }
+
 inline char *Object::dictGetKey(int i)
   { return dict->getKey(i); }
 
@@ -54,6 +54,14 @@ public:
   // Does this device need non-text content?
   virtual GBool needNonText() { return gTrue; }
 
+  // Get the size, in device pixels, at which a <width> x <height>
+  // image will be drawn with the current CTM.  Image decoders may use
+  // this to skip detail that would be lost anyway; the default asks for
+  // the full size.
+  virtual void getImageTargetSize(GfxState *state, int width, int height,
+				  int *targetWidth, int *targetHeight)
+    { *targetWidth = width; *targetHeight = height; }
+
   //----- initialization and control
 
   // Set default transform matrix.
@@ -147,6 +155,26 @@ public:
   virtual void type3D1(GfxState *state, fouble wx, fouble wy,
 		       fouble llx, fouble lly, fouble urx, fouble ury) {}
 
+  //----- tiling patterns
+
+  // Does this device draw tiling patterns from a cached tile?  If so,
+  // a pattern fill draws one pattern cell between beginPatternTile and
+  // endPatternTile, instead of drawing the cell once for each step.
+  virtual GBool useTilingPatternCache() { return gFalse; }
+
+  // Start drawing a <tileW> x <tileH> pixel tile.  Until the matching
+  // endPatternTile, drawing goes into the tile, with the tile's
+  // top-left pixel at device (0,0).  Returns false if the device can't
+  // use a tile here; the pattern is then drawn a cell at a time.
+  virtual GBool beginPatternTile(GfxState *state, int tileW, int tileH)
+    { return gFalse; }
+
+  // Finish the tile, and fill the current path (using the even-odd
+  // rule if <eoFill> is set) with copies of it.  <mat> maps tile
+  // pixels to device space; the tile repeats every <tileW> and
+  // <tileH> pixels in tile space.
+  virtual void endPatternTile(GfxState *state, fouble *mat, GBool eoFill) {}
+
   //----- PostScript XObjects
   virtual void psXObject(Stream *psStream, Stream *level1Stream) {}
 
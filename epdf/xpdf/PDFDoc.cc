@@ -14,6 +14,12 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <string.h>
+#include "../aconf.h"
+#if HAVE_MMAP
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
 #include "../goo/GString.h"
 #include "config.h"
 #include "Page.h"
@@ -26,6 +32,9 @@
 #include "ErrorCodes.h"
 #include "Lexer.h"
 #include "Parser.h"
+#include "GlobalParams.h"
+#include "DocCache.h"
+#include "Linearization.h"
 #include "PDFDoc.h"
 
 //------------------------------------------------------------------------
@@ -38,16 +47,26 @@
 //------------------------------------------------------------------------
 
 PDFDoc::PDFDoc(GString *fileNameA, GString *ownerPassword,
-	       GString *userPassword, GBool printCommandsA) {
+	       GString *userPassword, GBool printCommandsA,
+	       GBool mapFile) {
   Object obj;
   GString *fileName2;
+#if HAVE_MMAP
+  struct stat st;
+  void *p;
+#endif
 
+  NameTable::docOpened();
   ok = gFalse;
   errCode = errNone;
 
   file = NULL;
+  map = NULL;
+  mapLen = 0;
   str = NULL;
   xref = NULL;
+  lin = NULL;
+  docCache = NULL;
   catalog = NULL;
   links = NULL;
   printCommands = printCommandsA;
@@ -78,21 +97,45 @@ PDFDoc::PDFDoc(GString *fileNameA, GString *ownerPassword,
   }
 #endif
 
+  // map the file, if possible
+#if HAVE_MMAP
+  if (mapFile &&
+      fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode) &&
+      st.st_size > 0 && (Guint)st.st_size == st.st_size) {
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (p != MAP_FAILED) {
+      map = (char *)p;
+      mapLen = (Guint)st.st_size;
+      fclose(file);
+      file = NULL;
+    }
+  }
+#endif
+
   // create stream
   obj.initNull();
-  str = new FileStream(file, 0, gFalse, 0, &obj);
+  if (map) {
+    str = new MmapStream(map, mapLen, 0, gFalse, 0, &obj);
+  } else {
+    str = new FileStream(file, 0, gFalse, 0, &obj);
+  }
 
   ok = setup(ownerPassword, userPassword);
 }
 
 PDFDoc::PDFDoc(BaseStream *strA, GString *ownerPassword,
 	       GString *userPassword, GBool printCommandsA) {
+  NameTable::docOpened();
   ok = gFalse;
   errCode = errNone;
   fileName = NULL;
   file = NULL;
+  map = NULL;
+  mapLen = 0;
   str = strA;
   xref = NULL;
+  lin = NULL;
+  docCache = NULL;
   catalog = NULL;
   links = NULL;
   printCommands = printCommandsA;
@@ -103,45 +146,102 @@ GBool PDFDoc::setup(GString *ownerPassword, GString *userPassword) {
   // check header
   checkHeader();
 
+  // look up the document structure cache, which saves reading the
+  // xref table and page tree of a file that has been opened before
+  docCache = NULL;
+  if (fileName && globalParams->getDocCache()) {
+    docCache = new DocCache(str, fileName);
+  }
+
+  // otherwise, if the file is linearized, the first page can be
+  // displayed without reading the rest of the xref table or the page
+  // tree
+  if (!docCache || !docCache->isLoaded()) {
+    lin = new Linearization(str);
+    if (!lin->isOk()) {
+      delete lin;
+      lin = NULL;
+    }
+  }
+
   // read xref table
-  xref = new XRef(str, ownerPassword, userPassword);
+  xref = new XRef(str, ownerPassword, userPassword, fileName, docCache,
+		  lin != NULL);
   if (!xref->isOk()) {
     error(-1, "Couldn't read xref table");
     errCode = xref->getErrorCode();
-    return gFalse;
+    goto err;
+  }
+
+  // a reconstructed xref table means the linearization data can't be
+  // trusted either
+  if (lin && xref->isReconstructed()) {
+    delete lin;
+    lin = NULL;
   }
 
   // read catalog
-  catalog = new Catalog(xref, printCommands);
+  catalog = new Catalog(xref, printCommands, docCache, lin);
   if (!catalog->isOk()) {
     error(-1, "Couldn't read page catalog");
     errCode = errBadCatalog;
-    return gFalse;
+    goto err;
+  }
+
+  // save the document structure for next time; the cache is kept
+  // if the page display lists are saved in it too
+  if (docCache) {
+    if (!docCache->isLoaded()) {
+      docCache->save();
+    }
+    if (!xref->getDocCache()) {
+      delete docCache;
+      docCache = NULL;
+    }
   }
 
   // done
   return gTrue;
+
+ err:
+  if (docCache) {
+    delete docCache;
+    docCache = NULL;
+  }
+  return gFalse;
 }
 
 PDFDoc::~PDFDoc() {
   if (catalog) {
     delete catalog;
   }
+  if (lin) {
+    delete lin;
+  }
   if (xref) {
     delete xref;
   }
+  if (docCache) {
+    delete docCache;
+  }
   if (str) {
     delete str;
   }
   if (file) {
     fclose(file);
   }
+#if HAVE_MMAP
+  if (map) {
+    munmap(map, mapLen);
+  }
+#endif
   if (fileName) {
     delete fileName;
   }
   if (links) {
     delete links;
   }
+  NameTable::docClosed();
 }
 
 // Check for a PDF header on this stream.  Skip past some garbage
@@ -176,7 +276,9 @@ void PDFDoc::checkHeader() {
 }
 
 void PDFDoc::displayPage(OutputDev *out, int page, fouble zoom,
-			 int rotate, GBool doLinks) {
+			 int rotate, GBool doLinks,
+			 GBool (*abortCheckCbk)(void *data),
+			 void *abortCheckCbkData) {
   Page *p;
 
   if (printCommands) {
@@ -188,18 +290,23 @@ void PDFDoc::displayPage(OutputDev *out, int page, fouble zoom,
       delete links;
     }
     getLinks(p);
-    p->display(out, zoom, rotate, links, catalog);
+    p->display(out, zoom, rotate, links, catalog,
+	       abortCheckCbk, abortCheckCbkData);
   } else {
-    p->display(out, zoom, rotate, NULL, catalog);
+    p->display(out, zoom, rotate, NULL, catalog,
+	       abortCheckCbk, abortCheckCbkData);
   }
 }
 
 void PDFDoc::displayPages(OutputDev *out, int firstPage, int lastPage,
-			  int zoom, int rotate, GBool doLinks) {
+			  int zoom, int rotate, GBool doLinks,
+			  GBool (*abortCheckCbk)(void *data),
+			  void *abortCheckCbkData) {
   int page;
 
   for (page = firstPage; page <= lastPage; ++page) {
-    displayPage(out, page, zoom, rotate, doLinks);
+    displayPage(out, page, zoom, rotate, doLinks,
+		abortCheckCbk, abortCheckCbkData);
   }
 }
 
@@ -27,6 +27,8 @@ class OutputDev;
 class Links;
 class LinkAction;
 class LinkDest;
+class Linearization;
+class DocCache;
 
 //------------------------------------------------------------------------
 // PDFDoc
@@ -35,8 +37,13 @@ class LinkDest;
 class PDFDoc {
 public:
 
+  // Open the file <fileNameA>.  If <mapFile> is set, the file is
+  // mapped into memory and read through an MmapStream; if mapping
+  // isn't possible (or <mapFile> is false), it is read through a
+  // FileStream.
   PDFDoc(GString *fileNameA, GString *ownerPassword = NULL,
-	 GString *userPassword = NULL, GBool printCommandsA = gFalse);
+	 GString *userPassword = NULL, GBool printCommandsA = gFalse,
+	 GBool mapFile = gTrue);
   PDFDoc(BaseStream *strA, GString *ownerPassword = NULL,
 	 GString *userPassword = NULL, GBool printCommandsA = gFalse);
   ~PDFDoc();
@@ -61,11 +68,11 @@ public:
 
   // Get page parameters.
   fouble getPageWidth(int page)
-    { return catalog->getPage(page)->getWidth(); }
+    { return catalog->getPageBox(page)->x2 - catalog->getPageBox(page)->x1; }
   fouble getPageHeight(int page)
-    { return catalog->getPage(page)->getHeight(); }
+    { return catalog->getPageBox(page)->y2 - catalog->getPageBox(page)->y1; }
   int getPageRotate(int page)
-    { return catalog->getPage(page)->getRotate(); }
+    { return catalog->getPageRotate(page); }
 
   // Get number of pages.
   int getNumPages() { return catalog->getNumPages(); }
@@ -77,13 +84,17 @@ public:
   // Return the structure tree root object.
   Object *getStructTreeRoot() { return catalog->getStructTreeRoot(); }
 
-  // Display a page.
+  // Display a page.  See Page::display for <abortCheckCbk>.
   void displayPage(OutputDev *out, int page, fouble zoom,
-		   int rotate, GBool doLinks);
+		   int rotate, GBool doLinks,
+		   GBool (*abortCheckCbk)(void *data) = NULL,
+		   void *abortCheckCbkData = NULL);
 
   // Display a range of pages.
   void displayPages(OutputDev *out, int firstPage, int lastPage,
-		    int zoom, int rotate, GBool doLinks);
+		    int zoom, int rotate, GBool doLinks,
+		    GBool (*abortCheckCbk)(void *data) = NULL,
+		    void *abortCheckCbkData = NULL);
 
   // Find a page, given its object ID.  Returns page number, or 0 if
   // not found.
@@ -134,9 +145,15 @@ private:
 
   GString *fileName;
   FILE *file;
+  char *map;			// mapped file (if the file was mapped)
+  Guint mapLen;			// length of <map>
   BaseStream *str;
   fouble pdfVersion;
   XRef *xref;
+  Linearization *lin;		// linearization data (NULL if the file
+				//   isn't linearized, or it isn't used)
+  DocCache *docCache;		// document structure cache, kept while
+				//   page display lists are saved in it
   Catalog *catalog;
   Links *links;
   GBool printCommands;
@@ -21,6 +21,8 @@
 #include "OutputDev.h"
 #ifndef PDF_PARSER_ONLY
 #include "Gfx.h"
+#include "DisplayList.h"
+#include "DocCache.h"
 #include "Annot.h"
 #endif
 #include "Error.h"
@@ -178,6 +180,7 @@ Page::Page(XRef *xrefA, int numA, Dict *pageDict, PageAttrs *attrsA,
   xref = xrefA;
   num = numA;
   printCommands = printCommandsA;
+  displayed = gFalse;
 
   // get attributes
   attrs = attrsA;
@@ -217,10 +220,15 @@ Page::~Page() {
 }
 
 void Page::display(OutputDev *out, fouble dpi, int rotate,
-		   Links *links, Catalog *catalog) {
+		   Links *links, Catalog *catalog,
+		   GBool (*abortCheckCbk)(void *data),
+		   void *abortCheckCbkData) {
 #ifndef PDF_PARSER_ONLY
   PDFRectangle *box, *cropBox;
   Gfx *gfx;
+  DisplayListCache *listCache;
+  DocCache *docCache;
+  DisplayList *list;
   Object obj;
   Link *link;
   int i;
@@ -246,12 +254,47 @@ void Page::display(OutputDev *out, fouble dpi, int rotate,
     rotate += 360;
   }
   gfx = new Gfx(xref, out, num, attrs->getResourceDict(),
-		dpi, box, isCropped(), cropBox, rotate, printCommands);
-  contents.fetch(xref, &obj);
-  if (!obj.isNull()) {
-    gfx->display(&obj);
+		dpi, box, isCropped(), cropBox, rotate, printCommands,
+		abortCheckCbk, abortCheckCbkData);
+
+  // the second time the page is drawn (e.g., at a new zoom), its
+  // contents are recorded in a display list, which is replayed after
+  // that instead of parsing the content stream again; recording slows
+  // down the first drawing of pages that may never be drawn again
+  listCache = xref->getPageListCache();
+  docCache = listCache ? xref->getDocCache() : (DocCache *)NULL;
+  list = listCache ? listCache->lookup(num, 0) : (DisplayList *)NULL;
+  if (!list && docCache && (list = docCache->readPageList(num, xref))) {
+    if (Gfx::checkList(list)) {
+      listCache->add(num, 0, list);
+    } else {
+      error(-1, "Bad display list for page %d in the document cache", num);
+      delete list;
+      list = NULL;
+    }
   }
-  obj.free();
+  if (list) {
+    gfx->replay(list);
+  } else {
+    contents.fetch(xref, &obj);
+    if (!obj.isNull()) {
+      if (listCache && displayed) {
+	list = new DisplayList(listCache->getMaxBytes());
+      }
+      gfx->display(&obj, gTrue, list);
+      if (list && list->isComplete()) {
+	listCache->add(num, 0, list);
+	if (docCache) {
+	  docCache->writePageList(num, list);
+	}
+      }
+    }
+    obj.free();
+  }
+  if (list && !list->decRef()) {
+    delete list;
+  }
+  displayed = gTrue;
 
   // draw links
   if (links) {
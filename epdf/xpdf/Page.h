@@ -136,9 +136,13 @@ public:
   // Get contents.
   Object *getContents(Object *obj) { return contents.fetch(xref, obj); }
 
-  // Display a page.
+  // Display a page.  If <abortCheckCbk> is non-NULL, it is called
+  // periodically while the content stream is being drawn; drawing
+  // stops as soon as it returns true.
   void display(OutputDev *out, fouble dpi, int rotate,
-	       Links *links, Catalog *catalog);
+	       Links *links, Catalog *catalog,
+	       GBool (*abortCheckCbk)(void *data) = NULL,
+	       void *abortCheckCbkData = NULL);
 
 private:
 
@@ -148,6 +152,7 @@ private:
   Object annots;		// annotations array
   Object contents;		// page contents
   GBool printCommands;		// print the drawing commands (for debugging)
+  GBool displayed;		// set once the page has been drawn
   GBool ok;			// true if page is valid
 };
 
@@ -11,6 +11,7 @@
 #endif
 
 #include <stddef.h>
+#include "../goo/gmem.h"
 #include "Object.h"
 #include "Lexer.h"
 #include "Stream.h"
@@ -21,12 +22,15 @@
 #include "Error.h"
 #ifndef NO_DECRYPTION
 #include "Decrypt.h"
+
+static GBool hasIdentityCrypt(Object *dict);
 #endif
 
 Parser::Parser(XRef *xrefA, Lexer *lexerA) {
   xref = xrefA;
   lexer = lexerA;
   inlineImg = 0;
+  streamStart = streamLength = 0;
   lexer->getObj(&buf1);
   lexer->getObj(&buf2);
 }
@@ -40,19 +44,20 @@ Parser::~Parser() {
 #ifndef NO_DECRYPTION
 Object *Parser::getObj(Object *obj,
 		       Guchar *fileKey, int keyLength,
-		       int objNum, int objGen) {
+		       int objNum, int objGen,
+		       CryptAlgorithm strAlg, CryptAlgorithm stmAlg) {
 #else
 Object *Parser::getObj(Object *obj) {
 #endif
-  char *key;
+  NameAtom key;
   Stream *str;
   Object obj2;
   int num;
 #ifndef NO_DECRYPTION
   Decrypt *decrypt;
   GString *s;
-  char *p;
-  int i;
+  Guchar *p;
+  int n;
 #endif
 
   // refill buffer after inline image data
@@ -70,7 +75,8 @@ Object *Parser::getObj(Object *obj) {
     obj->initArray(xref);
     while (!buf1.isCmd("]") && !buf1.isEOF())
 #ifndef NO_DECRYPTION
-      obj->arrayAdd(getObj(&obj2, fileKey, keyLength, objNum, objGen));
+      obj->arrayAdd(getObj(&obj2, fileKey, keyLength, objNum, objGen,
+			   strAlg, stmAlg));
 #else
       obj->arrayAdd(getObj(&obj2));
 #endif
@@ -87,12 +93,13 @@ Object *Parser::getObj(Object *obj) {
 	error(getPos(), "Dictionary key must be a name object");
 	shift();
       } else {
-	key = copyString(buf1.getName());
+	key = buf1.getNameAtom();
 	shift();
 	if (buf1.isEOF() || buf1.isError())
 	  break;
 #ifndef NO_DECRYPTION
-	obj->dictAdd(key, getObj(&obj2, fileKey, keyLength, objNum, objGen));
+	obj->dictAdd(key, getObj(&obj2, fileKey, keyLength, objNum, objGen,
+				 strAlg, stmAlg));
 #else
 	obj->dictAdd(key, getObj(&obj2));
 #endif
@@ -101,14 +108,13 @@ Object *Parser::getObj(Object *obj) {
     if (buf1.isEOF())
       error(getPos(), "End of file inside dictionary");
     if (buf2.isCmd("stream")) {
-      if ((str = makeStream(obj))) {
-	obj->initStream(str);
 #ifndef NO_DECRYPTION
-	if (fileKey) {
-	  str->getBaseStream()->doDecryption(fileKey, keyLength,
-					     objNum, objGen);
-	}
+      if ((str = makeStream(obj, fileKey, keyLength, objNum, objGen,
+			      stmAlg))) {
+#else
+      if ((str = makeStream(obj))) {
 #endif
+	obj->initStream(str);
       } else {
 	obj->free();
 	obj->initError();
@@ -131,14 +137,21 @@ Object *Parser::getObj(Object *obj) {
 
 #ifndef NO_DECRYPTION
   // string
-  } else if (buf1.isString() && fileKey) {
-    buf1.copy(obj);
-    s = obj->getString();
-    decrypt = new Decrypt(fileKey, keyLength, objNum, objGen);
-    for (i = 0, p = obj->getString()->getCString();
-	 i < s->getLength();
-	 ++i, ++p) {
-      *p = decrypt->decryptByte(*p);
+  } else if (buf1.isString() && fileKey && strAlg != cryptNone) {
+    decrypt = new Decrypt(fileKey, keyLength, strAlg, objNum, objGen);
+    if (decrypt->isRC4()) {
+      buf1.copy(obj);
+      s = obj->getString();
+      decrypt->decryptBlock((Guchar *)s->getCString(),
+			    (Guchar *)s->getCString(), s->getLength(), gTrue);
+    } else {
+      // AES strings shrink by the IV and padding
+      s = buf1.getString();
+      p = (Guchar *)gmalloc(s->getLength() + 32);
+      n = decrypt->decryptBlock((Guchar *)s->getCString(), p,
+				s->getLength(), gTrue);
+      obj->initString(new GString((char *)p, n));
+      gfree(p);
     }
     delete decrypt;
     shift();
@@ -153,7 +166,12 @@ Object *Parser::getObj(Object *obj) {
   return obj;
 }
 
+#ifndef NO_DECRYPTION
+Stream *Parser::makeStream(Object *dict, Guchar *fileKey, int keyLength,
+			   int objNum, int objGen, CryptAlgorithm stmAlg) {
+#else
 Stream *Parser::makeStream(Object *dict) {
+#endif
   Object obj;
   Stream *str;
   Guint pos, endPos, length;
@@ -174,14 +192,25 @@ Stream *Parser::makeStream(Object *dict) {
   }
 
   // check for length in damaged file
-  if (xref->getStreamEnd(pos, &endPos)) {
+  if (xref && xref->getStreamEnd(pos, &endPos)) {
     length = endPos - pos;
   }
 
+  streamStart = pos;
+  streamLength = length;
+
   // make base stream
   str = lexer->getStream()->getBaseStream()->makeSubStream(pos, gTrue,
 							   length, dict);
 
+#ifndef NO_DECRYPTION
+  // decryption goes under the filters
+  if (fileKey && stmAlg != cryptNone && !hasIdentityCrypt(dict)) {
+    str->getBaseStream()->doDecryption(fileKey, keyLength, stmAlg,
+				       objNum, objGen);
+  }
+#endif
+
   // get filters
   str = str->addFilters(dict);
 
@@ -213,3 +242,41 @@ void Parser::shift() {
   else
     lexer->getObj(&buf2);
 }
+
+#ifndef NO_DECRYPTION
+// Check for a Crypt filter that selects the Identity crypt filter,
+// which leaves the stream unencrypted.  The Crypt filter has to come
+// first, and Identity is the default when it has no Name.
+static GBool hasIdentityCrypt(Object *dict) {
+  Object filter, parms, filter1, parms1, name;
+  GBool identity;
+
+  identity = gFalse;
+  dict->dictLookup("Filter", &filter);
+  dict->dictLookup("DecodeParms", &parms);
+  if (filter.isArray() && filter.arrayGetLength() > 0) {
+    filter.arrayGet(0, &filter1);
+    if (parms.isArray() && parms.arrayGetLength() > 0) {
+      parms.arrayGet(0, &parms1);
+    } else {
+      parms1.initNull();
+    }
+  } else {
+    filter.copy(&filter1);
+    parms.copy(&parms1);
+  }
+  if (filter1.isName("Crypt")) {
+    identity = gTrue;
+    if (parms1.isDict()) {
+      parms1.dictLookup("Name", &name);
+      identity = !name.isName() || name.isName("Identity");
+      name.free();
+    }
+  }
+  parms1.free();
+  filter1.free();
+  parms.free();
+  filter.free();
+  return identity;
+}
+#endif
@@ -14,6 +14,9 @@
 #endif
 
 #include "../goo/gtypes.h"
+#ifndef NO_DECRYPTION
+#include "Decrypt.h"
+#endif
 
 class XRef;
 class Lexer;
@@ -32,11 +35,15 @@ public:
   // Destructor.
   ~Parser();
 
-  // Get the next object from the input stream.
+  // Get the next object from the input stream.  Strings are
+  // decrypted with <strAlg> and streams with <stmAlg>; cryptNone
+  // leaves them alone.
 #ifndef NO_DECRYPTION
   Object *getObj(Object *obj,
 		 Guchar *fileKey = NULL, int keyLength = 0,
-		 int objNum = 0, int objGen = 0);
+		 int objNum = 0, int objGen = 0,
+		 CryptAlgorithm strAlg = cryptRC4,
+		 CryptAlgorithm stmAlg = cryptRC4);
 #else
   Object *getObj(Object *obj);
 #endif
@@ -47,14 +54,26 @@ public:
   // Get current position in file.
   int getPos() { return lexer->getPos(); }
 
+  // Get the file offset and length of the data of the last stream
+  // object returned by getObj.
+  Guint getStreamStart() { return streamStart; }
+  Guint getStreamLength() { return streamLength; }
+
 private:
 
   XRef *xref;			// the xref table for this PDF file
   Lexer *lexer;			// input stream
   Object buf1, buf2;		// next two tokens
   int inlineImg;		// set when inline image data is encountered
+  Guint streamStart;		// data offset of the last stream
+  Guint streamLength;		// data length of the last stream
 
+#ifndef NO_DECRYPTION
+  Stream *makeStream(Object *dict, Guchar *fileKey, int keyLength,
+		     int objNum, int objGen, CryptAlgorithm stmAlg);
+#else
   Stream *makeStream(Object *dict);
+#endif
   void shift();
 };
 
@@ -29,6 +29,7 @@
 #endif
 #include "Stream.h"
 #include "Error.h"
+#include "GlobalParams.h"
 #include "Stream-CCITT.h"
 
 #ifdef __DJGPP__
@@ -50,6 +51,19 @@ extern "C" int unlink(char *filename);
 #include "StuffItEngineLib.h"
 #endif
 
+// SSE2/AVX2 versions of the DCT decoder's inner loops, chosen at run
+// time (define NO_DCT_SIMD to build without them).  They need a
+// compiler that accepts intrinsics in per-function target attributes.
+#if !defined(NO_DCT_SIMD) && !defined(FP_IDCT) && \
+    (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || \
+     (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define DCT_SIMD 1
+#include <immintrin.h>
+#define DCT_SSE2 __attribute__((target("sse2")))
+#define DCT_AVX2 __attribute__((target("avx2")))
+#endif
+
 //------------------------------------------------------------------------
 // Stream (base class)
 //------------------------------------------------------------------------
@@ -69,6 +83,18 @@ int Stream::getRawChar() {
   return EOF;
 }
 
+int Stream::getBlock(char *blk, int size) {
+  int n, c;
+
+  for (n = 0; n < size; ++n) {
+    if ((c = getChar()) == EOF) {
+      break;
+    }
+    blk[n] = (char)c;
+  }
+  return n;
+}
+
 char *Stream::getLine(char *buf, int size) {
   int i;
   int c;
@@ -98,9 +124,17 @@ Stream *Stream::addFilters(Object *dict) {
   Object obj, obj2;
   Object params, params2;
   Stream *str;
+#ifndef NO_DECRYPTION
+  Decrypt *decrypt;
+#endif
   int i;
 
   str = this;
+#ifndef NO_DECRYPTION
+  if ((decrypt = getBaseStream()->getDecrypt())) {
+    str = new DecryptStream(str, decrypt);
+  }
+#endif
   dict->dictLookup("Filter", &obj);
   if (obj.isNull()) {
     obj.free();
@@ -256,6 +290,8 @@ Stream *Stream::makeFilter(char *name, Stream *str, Object *params) {
       obj.free();
     }
     str = new FlateStream(str, pred, columns, colors, bits);
+  } else if (!strcmp(name, "Crypt")) {
+    // the crypt filter was handled when decryption was set up
   } else {
     error(getPos(), "Unknown filter '%s'", name);
     str = new EOFStream(str);
@@ -290,8 +326,8 @@ Dict * BaseStream::getDict() {
 
 #ifndef NO_DECRYPTION
 void BaseStream::doDecryption(Guchar *fileKey, int keyLength,
-			      int objNum, int objGen) {
-  decrypt = new Decrypt(fileKey, keyLength, objNum, objGen);
+			      CryptAlgorithm alg, int objNum, int objGen) {
+  decrypt = new Decrypt(fileKey, keyLength, alg, objNum, objGen);
 }
 #endif
 
@@ -327,17 +363,36 @@ ImageStream::ImageStream(Stream *strA, int widthA, int nCompsA, int nBitsA) {
   nBits = nBitsA;
 
   nVals = width * nComps;
-  if (nBits == 1) {
+  lineSize = (nVals * nBits + 7) >> 3;
+  // the unpackers below fill whole input bytes
+  if (nBits < 8) {
     imgLineSize = (nVals + 7) & ~7;
   } else {
     imgLineSize = nVals;
   }
   imgLine = (Guchar *)gmalloc(imgLineSize * sizeof(Guchar));
+  lineBuf = (Guchar *)gmalloc(lineSize * sizeof(Guchar));
   imgIdx = nVals;
 }
 
 ImageStream::~ImageStream() {
   gfree(imgLine);
+  gfree(lineBuf);
+}
+
+// Read <n> bytes of image data.  Data missing at the end of the
+// stream reads as 0xff (what a truncated EOF from getChar() gave).
+static void readImageData(Stream *str, Guchar *p, int n) {
+  int k;
+
+  while (n > 0) {
+    if ((k = str->getBlock((char *)p, n)) <= 0) {
+      memset(p, 0xff, n);
+      break;
+    }
+    p += k;
+    n -= k;
+  }
 }
 
 void ImageStream::reset() {
@@ -345,60 +400,85 @@ void ImageStream::reset() {
 }
 
 GBool ImageStream::getPixel(Guchar *pix) {
-  Gulong buf, bitMask;
-  int bits;
-  int c;
   int i;
 
   if (imgIdx >= nVals) {
-
-    // read one line of image pixels
-    if (nBits == 1) {
-      for (i = 0; i < nVals; i += 8) {
-	c = str->getChar();
-	imgLine[i+0] = (Guchar)((c >> 7) & 1);
-	imgLine[i+1] = (Guchar)((c >> 6) & 1);
-	imgLine[i+2] = (Guchar)((c >> 5) & 1);
-	imgLine[i+3] = (Guchar)((c >> 4) & 1);
-	imgLine[i+4] = (Guchar)((c >> 3) & 1);
-	imgLine[i+5] = (Guchar)((c >> 2) & 1);
-	imgLine[i+6] = (Guchar)((c >> 1) & 1);
-	imgLine[i+7] = (Guchar)(c & 1);
-      }
-    } else if (nBits == 8) {
-      for (i = 0; i < nVals; ++i) {
-	imgLine[i] = str->getChar();
-      }
-    } else {
-      bitMask = (1 << nBits) - 1;
-      buf = 0;
-      bits = 0;
-      for (i = 0; i < nVals; ++i) {
-	if (bits < nBits) {
-	  buf = (buf << 8) | (str->getChar() & 0xff);
-	  bits += 8;
-	}
-	imgLine[i] = (Guchar)((buf >> (bits - nBits)) & bitMask);
-	bits -= nBits;
-      }
-    }
-
-    // reset to start of line
+    getLine();
     imgIdx = 0;
   }
-
   for (i = 0; i < nComps; ++i)
     pix[i] = imgLine[imgIdx++];
   return gTrue;
 }
 
-void ImageStream::skipLine() {
-  int n, i;
+Guchar *ImageStream::getLine() {
+  Gulong buf, bitMask;
+  int bits;
+  int c;
+  int i, j;
 
-  n = (nVals * nBits + 7) >> 3;
-  for (i = 0; i < n; ++i) {
-    str->getChar();
+  switch (nBits) {
+  case 1:
+    readImageData(str, lineBuf, lineSize);
+    for (i = 0, j = 0; i < nVals; i += 8, ++j) {
+      c = lineBuf[j];
+      imgLine[i+0] = (Guchar)((c >> 7) & 1);
+      imgLine[i+1] = (Guchar)((c >> 6) & 1);
+      imgLine[i+2] = (Guchar)((c >> 5) & 1);
+      imgLine[i+3] = (Guchar)((c >> 4) & 1);
+      imgLine[i+4] = (Guchar)((c >> 3) & 1);
+      imgLine[i+5] = (Guchar)((c >> 2) & 1);
+      imgLine[i+6] = (Guchar)((c >> 1) & 1);
+      imgLine[i+7] = (Guchar)(c & 1);
+    }
+    break;
+  case 2:
+    readImageData(str, lineBuf, lineSize);
+    for (i = 0, j = 0; i < nVals; i += 4, ++j) {
+      c = lineBuf[j];
+      imgLine[i+0] = (Guchar)((c >> 6) & 3);
+      imgLine[i+1] = (Guchar)((c >> 4) & 3);
+      imgLine[i+2] = (Guchar)((c >> 2) & 3);
+      imgLine[i+3] = (Guchar)(c & 3);
+    }
+    break;
+  case 4:
+    readImageData(str, lineBuf, lineSize);
+    for (i = 0, j = 0; i < nVals; i += 2, ++j) {
+      c = lineBuf[j];
+      imgLine[i+0] = (Guchar)(c >> 4);
+      imgLine[i+1] = (Guchar)(c & 15);
+    }
+    break;
+  case 8:
+    readImageData(str, imgLine, nVals);
+    break;
+  case 16:
+    readImageData(str, lineBuf, lineSize);
+    for (i = 0, j = 0; i < nVals; ++i, j += 2)
+      imgLine[i] = lineBuf[j];
+    break;
+  default:
+    readImageData(str, lineBuf, lineSize);
+    bitMask = (1 << nBits) - 1;
+    buf = 0;
+    bits = 0;
+    for (i = 0, j = 0; i < nVals; ++i) {
+      if (bits < nBits) {
+	buf = (buf << 8) | lineBuf[j++];
+	bits += 8;
+      }
+      imgLine[i] = (Guchar)((buf >> (bits - nBits)) & bitMask);
+      bits -= nBits;
+    }
+    break;
   }
+  imgIdx = nVals;
+  return imgLine;
+}
+
+void ImageStream::skipLine() {
+  readImageData(str, lineBuf, lineSize);
 }
 
 //------------------------------------------------------------------------
@@ -594,10 +674,6 @@ void FileStream::reset() {
   saved = gTrue;
   bufPtr = bufEnd = buf;
   bufPos = start;
-#ifndef NO_DECRYPTION
-  if (decrypt)
-    decrypt->reset();
-#endif
 }
 
 void FileStream::close() {
@@ -613,9 +689,6 @@ void FileStream::close() {
 
 GBool FileStream::fillBuf() {
   int n;
-#ifndef NO_DECRYPTION
-  char *p;
-#endif
 
   bufPos += bufEnd - buf;
   bufPtr = bufEnd = buf;
@@ -632,14 +705,47 @@ GBool FileStream::fillBuf() {
   if (bufPtr >= bufEnd) {
     return gFalse;
   }
-#ifndef NO_DECRYPTION
-  if (decrypt) {
-    for (p = buf; p < bufEnd; ++p) {
-      *p = (char)decrypt->decryptByte((Guchar)*p);
+  return gTrue;
+}
+
+// Reads of at least a buffer's worth go straight into <blk>.
+int FileStream::getBlock(char *blk, int size) {
+  Guint pos;
+  int n, k;
+
+  n = 0;
+  while (n < size) {
+    if (bufPtr >= bufEnd && size - n >= fileStreamBufSize) {
+      pos = bufPos + (bufEnd - buf);
+      k = size - n;
+      if (limited) {
+	if (pos >= start + length) {
+	  break;
+	}
+	if ((Guint)k > start + length - pos) {
+	  k = start + length - pos;
+	}
+      }
+      if ((k = fread(blk + n, 1, k, f)) <= 0) {
+	break;
+      }
+      bufPos = pos + k;
+      bufPtr = bufEnd = buf;
+      n += k;
+      continue;
+    }
+    if (bufPtr >= bufEnd && !fillBuf()) {
+      break;
+    }
+    k = bufEnd - bufPtr;
+    if (k > size - n) {
+      k = size - n;
     }
+    memcpy(blk + n, bufPtr, k);
+    bufPtr += k;
+    n += k;
   }
-#endif
-  return gTrue;
+  return n;
 }
 
 void FileStream::setPos(Guint pos, int dir) {
@@ -690,16 +796,12 @@ void FileStream::moveStart(int delta) {
 MemStream::MemStream(char *bufA, Guint lengthA, Object *dictA):
     BaseStream(dictA) {
   buf = bufA;
-  needFree = gFalse;
   length = lengthA;
   bufEnd = buf + length;
   bufPtr = buf;
 }
 
 MemStream::~MemStream() {
-  if (needFree) {
-    gfree(buf);
-  }
 }
 
 Stream *MemStream::makeSubStream(Guint start, GBool limited,
@@ -716,16 +818,23 @@ Stream *MemStream::makeSubStream(Guint start, GBool limited,
 
 void MemStream::reset() {
   bufPtr = buf;
-#ifndef NO_DECRYPTION
-  if (decrypt) {
-    decrypt->reset();
-  }
-#endif
 }
 
 void MemStream::close() {
 }
 
+int MemStream::getBlock(char *blk, int size) {
+  int n;
+
+  n = bufEnd - bufPtr;
+  if (n > size) {
+    n = size;
+  }
+  memcpy(blk, bufPtr, n);
+  bufPtr += n;
+  return n;
+}
+
 void MemStream::setPos(Guint pos, int dir) {
   if (dir >= 0) {
     if (pos > length) {
@@ -747,25 +856,93 @@ void MemStream::moveStart(int delta) {
   bufPtr = buf;
 }
 
-#ifndef NO_DECRYPTION
-void MemStream::doDecryption(Guchar *fileKey, int keyLength,
-			     int objNum, int objGen) {
-  char *newBuf;
-  char *p, *q;
 
-  this->BaseStream::doDecryption(fileKey, keyLength, objNum, objGen);
-  if (decrypt) {
-    newBuf = (char *)gmalloc(bufEnd - buf);
-    for (p = buf, q = newBuf; p < bufEnd; ++p, ++q) {
-      *q = (char)decrypt->decryptByte((Guchar)*p);
+//------------------------------------------------------------------------
+// MmapStream
+//------------------------------------------------------------------------
+
+MmapStream::MmapStream(char *mapA, Guint mapLenA, Guint startA,
+		       GBool limitedA, Guint lengthA, Object *dictA):
+    BaseStream(dictA) {
+  map = mapA;
+  mapLen = mapLenA;
+  start = startA;
+  limited = limitedA;
+  length = lengthA;
+  setBuf();
+  bufPtr = buf + (start - bufPos);
+}
+
+MmapStream::~MmapStream() {
+}
+
+Stream *MmapStream::makeSubStream(Guint startA, GBool limitedA,
+				  Guint lengthA, Object *dictA) {
+  return new MmapStream(map, mapLen, startA, limitedA, lengthA, dictA);
+}
+
+// Set up the readable range [buf, bufEnd): the whole mapping, cut off at the end of a limited stream.
+void MmapStream::setBuf() {
+  if (start > mapLen) {
+    start = mapLen;
+  }
+  buf = map;
+  bufPos = 0;
+  if (limited && length < mapLen - start) {
+    bufEnd = map + start + length;
+  } else {
+    bufEnd = map + mapLen;
+  }
+}
+
+void MmapStream::reset() {
+  bufPtr = buf + (start - bufPos);
+}
+
+void MmapStream::close() {
+}
+
+int MmapStream::getBlock(char *blk, int size) {
+  int n;
+
+  n = bufEnd - bufPtr;
+  if (n > size) {
+    n = size;
+  }
+  memcpy(blk, bufPtr, n);
+  bufPtr += n;
+  return n;
+}
+
+void MmapStream::setPos(Guint pos, int dir) {
+  Guint end;
+
+  end = bufPos + (bufEnd - buf);
+  if (dir >= 0) {
+    if (pos > end) {
+      pos = end;
+    }
+  } else {
+    if (pos > mapLen) {
+      pos = mapLen;
     }
-    bufEnd = newBuf + (bufEnd - buf);
-    bufPtr = newBuf + (bufPtr - buf);
-    buf = newBuf;
-    needFree = gTrue;
+    pos = mapLen - pos;
+    if (pos > end) {
+      pos = end;
+    }
+  }
+  if (pos < bufPos) {
+    pos = bufPos;
   }
+  bufPtr = buf + (pos - bufPos);
+}
+
+void MmapStream::moveStart(int delta) {
+  start += delta;
+  setBuf();
+  bufPtr = buf + (start - bufPos);
 }
-#endif
+
 
 //------------------------------------------------------------------------
 // EmbedStream
@@ -785,6 +962,19 @@ Stream *EmbedStream::makeSubStream(Guint start, GBool limited,
   return NULL;
 }
 
+// The content stream goes on after the inline image data, and the
+// filters on top of this stream can't tell where that ends -- so
+// never read ahead: hand out one char at a time.
+int EmbedStream::getBlock(char *blk, int size) {
+  int c;
+
+  if (size <= 0 || (c = str->getChar()) == EOF) {
+    return 0;
+  }
+  blk[0] = (char)c;
+  return 1;
+}
+
 void EmbedStream::setPos(Guint pos, int dir) {
   error(-1, "Internal: called setPos() on EmbedStream");
 }
@@ -798,6 +988,90 @@ void EmbedStream::moveStart(int delta) {
   error(-1, "Internal: called moveStart() on EmbedStream");
 }
 
+#ifndef NO_DECRYPTION
+//------------------------------------------------------------------------
+// DecryptStream
+//------------------------------------------------------------------------
+
+DecryptStream::DecryptStream(Stream *strA, Decrypt *decryptA):
+    FilterStream(strA) {
+  decrypt = decryptA;
+  bufPtr = bufEnd = buf;
+  eof = gFalse;
+}
+
+DecryptStream::~DecryptStream() {
+  delete str;
+}
+
+void DecryptStream::reset() {
+  str->reset();
+  decrypt->reset();
+  bufPtr = bufEnd = buf;
+  eof = gFalse;
+}
+
+GBool DecryptStream::fillBuf() {
+  int n;
+
+  bufPtr = bufEnd = buf;
+  if (decrypt->isRC4()) {
+    if ((n = str->getBlock(buf, decryptStreamBufSize)) <= 0) {
+      return gFalse;
+    }
+    decrypt->decryptBlock((Guchar *)buf, (Guchar *)buf, n, gFalse);
+    bufEnd = buf + n;
+    return gTrue;
+  }
+
+  // AES can give nothing back for a short read, so keep going until
+  // there is some output or the last block has been flushed
+  while (bufEnd == buf && !eof) {
+    if ((n = str->getBlock(rawBuf, decryptStreamBufSize)) <= 0) {
+      eof = gTrue;
+      n = decrypt->decryptBlock((Guchar *)rawBuf, (Guchar *)buf, 0, gTrue);
+    } else {
+      n = decrypt->decryptBlock((Guchar *)rawBuf, (Guchar *)buf, n, gFalse);
+    }
+    bufEnd = buf + n;
+  }
+  return bufPtr < bufEnd;
+}
+
+// Whatever is left in the buffer goes first; with RC4, bigger reads
+// then bypass it and are decrypted in place.
+int DecryptStream::getBlock(char *blk, int size) {
+  int n, k;
+
+  n = bufEnd - bufPtr;
+  if (n > size) {
+    n = size;
+  }
+  memcpy(blk, bufPtr, n);
+  bufPtr += n;
+  while (n < size) {
+    if (size - n < decryptStreamBufSize || !decrypt->isRC4()) {
+      if (!fillBuf()) {
+	break;
+      }
+      k = bufEnd - bufPtr;
+      if (k > size - n) {
+	k = size - n;
+      }
+      memcpy(blk + n, bufPtr, k);
+      bufPtr += k;
+    } else {
+      if ((k = str->getBlock(blk + n, size - n)) <= 0) {
+	break;
+      }
+      decrypt->decryptBlock((Guchar *)blk + n, (Guchar *)blk + n, k, gFalse);
+    }
+    n += k;
+  }
+  return n;
+}
+#endif
+
 //------------------------------------------------------------------------
 // ASCIIHexStream
 //------------------------------------------------------------------------
@@ -1942,143 +2216,1164 @@ static int dctZigZag[64] = {
   63
 };
 
-DCTStream::DCTStream(Stream *strA):
-    FilterStream(strA) {
-  int i, j;
-
-  width = height = 0;
-  mcuWidth = mcuHeight = 0;
-  numComps = 0;
-  comp = 0;
-  x = y = dy = 0;
-  for (i = 0; i < 4; ++i)
-    for (j = 0; j < 32; ++j)
-      rowBuf[i][j] = NULL;
+// This IDCT algorithm is taken from:
+//   Christoph Loeffler, Adriaan Ligtenberg, George S. Moschytz,
+//   "Practical Fast 1-D DCT Algorithms with 11 Multiplications",
+//   IEEE Intl. Conf. on Acoustics, Speech & Signal Processing, 1989,
+//   988-991.
+// The stage numbers mentioned in the comments refer to Figure 1 in this
+// paper.
+//
+// The dctTransform* functions dequantize and inverse transform <n>
+// consecutive data units of 64 coefficients each (in natural order)
+// into 8x8 blocks of pixels.  The SIMD versions give exactly the same
+// results as the scalar one.
 
-  if (!dctClipInit) {
-    for (i = -256; i < 0; ++i)
-      dctClip[dctClipOffset + i] = 0;
-    for (i = 0; i < 256; ++i)
-      dctClip[dctClipOffset + i] = i;
-    for (i = 256; i < 512; ++i)
-      dctClip[dctClipOffset + i] = 255;
-    dctClipInit = 1;
-  }
+// Clip to [0,255].  Corrupt data can take the transform's output well
+// outside the range of dctClip.
+static inline int dctClamp(int v) {
+  return v < 0 ? 0 : v > 255 ? 255 : v;
 }
 
-DCTStream::~DCTStream() {
-  int i, j;
+#ifndef FP_IDCT
 
-  delete str;
-  for (i = 0; i < numComps; ++i)
-    for (j = 0; j < mcuHeight; ++j)
-      gfree(rowBuf[i][j]);
-}
+// Value of all 64 pixels of a data unit whose AC coefficients are all
+// zero (<dc> is the dequantized DC coefficient): the transform below
+// reduces to this.
+static inline int dctDCOnly(int dc) {
+  int v;
 
-void DCTStream::reset() {
-  str->reset();
-  if (!readHeader()) {
-    y = height;
-    return;
-  }
-  restartMarker = 0xd0;
-  restart();
+  v = (dctSqrt2 * dc + 128) >> 8;
+  v = (((v + 1) >> 1) + 1) >> 1;
+  v = (dctSqrt2 * v + 2048) >> 12;
+  v = (((v + 1) >> 1) + 1) >> 1;
+  return dctClamp(128 + ((v + 8) >> 4));
 }
 
-int DCTStream::getChar() {
-  int c;
+static void dctTransformScalar(int *coefs, int *quant, Guchar *data,
+			       int n) {
+  int tmp1[64];
+  int v0, v1, v2, v3, v4, v5, v6, v7, t;
+  int i;
 
-  c = lookChar();
-  if (c == EOF)
-    return EOF;
-  if (++comp == numComps) {
-    comp = 0;
-    if (++x == width) {
-      x = 0;
-      ++y;
-      ++dy;
+  for (; n > 0; --n, coefs += 64, data += 64) {
+
+    // dequantize
+    t = 0;
+    for (i = 1; i < 64; ++i) {
+      tmp1[i] = coefs[i] * quant[i];
+      t |= coefs[i];
+    }
+    tmp1[0] = coefs[0] * quant[0];
+    if (t == 0) {
+      memset(data, dctDCOnly(tmp1[0]), 64);
+      continue;
     }
-  }
-  if (y == height)
-    readTrailer();
-  return c;
-}
 
-int DCTStream::lookChar() {
-  if (y >= height)
-    return EOF;
-  if (dy >= mcuHeight) {
-    if (!readMCURow()) {
-      y = height;
-      return EOF;
+    // inverse DCT on rows
+    for (i = 0; i < 64; i += 8) {
+
+      // stage 4
+      v0 = (dctSqrt2 * tmp1[i+0] + 128) >> 8;
+      v1 = (dctSqrt2 * tmp1[i+4] + 128) >> 8;
+      v2 = tmp1[i+2];
+      v3 = tmp1[i+6];
+      v4 = (dctSqrt1d2 * (tmp1[i+1] - tmp1[i+7]) + 128) >> 8;
+      v7 = (dctSqrt1d2 * (tmp1[i+1] + tmp1[i+7]) + 128) >> 8;
+      v5 = tmp1[i+3] << 4;
+      v6 = tmp1[i+5] << 4;
+
+      // stage 3
+      t = (v0 - v1+ 1) >> 1;
+      v0 = (v0 + v1 + 1) >> 1;
+      v1 = t;
+      t = (v2 * dctSin6 + v3 * dctCos6 + 128) >> 8;
+      v2 = (v2 * dctCos6 - v3 * dctSin6 + 128) >> 8;
+      v3 = t;
+      t = (v4 - v6 + 1) >> 1;
+      v4 = (v4 + v6 + 1) >> 1;
+      v6 = t;
+      t = (v7 + v5 + 1) >> 1;
+      v5 = (v7 - v5 + 1) >> 1;
+      v7 = t;
+
+      // stage 2
+      t = (v0 - v3 + 1) >> 1;
+      v0 = (v0 + v3 + 1) >> 1;
+      v3 = t;
+      t = (v1 - v2 + 1) >> 1;
+      v1 = (v1 + v2 + 1) >> 1;
+      v2 = t;
+      t = (v4 * dctSin3 + v7 * dctCos3 + 2048) >> 12;
+      v4 = (v4 * dctCos3 - v7 * dctSin3 + 2048) >> 12;
+      v7 = t;
+      t = (v5 * dctSin1 + v6 * dctCos1 + 2048) >> 12;
+      v5 = (v5 * dctCos1 - v6 * dctSin1 + 2048) >> 12;
+      v6 = t;
+
+      // stage 1
+      tmp1[i+0] = v0 + v7;
+      tmp1[i+7] = v0 - v7;
+      tmp1[i+1] = v1 + v6;
+      tmp1[i+6] = v1 - v6;
+      tmp1[i+2] = v2 + v5;
+      tmp1[i+5] = v2 - v5;
+      tmp1[i+3] = v3 + v4;
+      tmp1[i+4] = v3 - v4;
     }
-    comp = 0;
-    x = 0;
-    dy = 0;
+
+    // inverse DCT on columns
+    for (i = 0; i < 8; ++i) {
+
+      // stage 4
+      v0 = (dctSqrt2 * tmp1[0*8+i] + 2048) >> 12;
+      v1 = (dctSqrt2 * tmp1[4*8+i] + 2048) >> 12;
+      v2 = tmp1[2*8+i];
+      v3 = tmp1[6*8+i];
+      v4 = (dctSqrt1d2 * (tmp1[1*8+i] - tmp1[7*8+i]) + 2048) >> 12;
+      v7 = (dctSqrt1d2 * (tmp1[1*8+i] + tmp1[7*8+i]) + 2048) >> 12;
+      v5 = tmp1[3*8+i];
+      v6 = tmp1[5*8+i];
+
+      // stage 3
+      t = (v0 - v1 + 1) >> 1;
+      v0 = (v0 + v1 + 1) >> 1;
+      v1 = t;
+      t = (v2 * dctSin6 + v3 * dctCos6 + 2048) >> 12;
+      v2 = (v2 * dctCos6 - v3 * dctSin6 + 2048) >> 12;
+      v3 = t;
+      t = (v4 - v6 + 1) >> 1;
+      v4 = (v4 + v6 + 1) >> 1;
+      v6 = t;
+      t = (v7 + v5 + 1) >> 1;
+      v5 = (v7 - v5 + 1) >> 1;
+      v7 = t;
+
+      // stage 2
+      t = (v0 - v3 + 1) >> 1;
+      v0 = (v0 + v3 + 1) >> 1;
+      v3 = t;
+      t = (v1 - v2 + 1) >> 1;
+      v1 = (v1 + v2 + 1) >> 1;
+      v2 = t;
+      t = (v4 * dctSin3 + v7 * dctCos3 + 2048) >> 12;
+      v4 = (v4 * dctCos3 - v7 * dctSin3 + 2048) >> 12;
+      v7 = t;
+      t = (v5 * dctSin1 + v6 * dctCos1 + 2048) >> 12;
+      v5 = (v5 * dctCos1 - v6 * dctSin1 + 2048) >> 12;
+      v6 = t;
+
+      // stage 1
+      tmp1[0*8+i] = v0 + v7;
+      tmp1[7*8+i] = v0 - v7;
+      tmp1[1*8+i] = v1 + v6;
+      tmp1[6*8+i] = v1 - v6;
+      tmp1[2*8+i] = v2 + v5;
+      tmp1[5*8+i] = v2 - v5;
+      tmp1[3*8+i] = v3 + v4;
+      tmp1[4*8+i] = v3 - v4;
+    }
+
+    // convert to 8-bit integers
+    for (i = 0; i < 64; ++i)
+      data[i] = dctClamp(128 + ((tmp1[i] + 8) >> 4));
   }
-  return rowBuf[comp][dy][x];
 }
+#endif
 
-void DCTStream::restart() {
+#ifdef FP_IDCT
+static void dctTransformScalar(int *coefs, int *quant, Guchar *data,
+			       int n) {
+  fouble tmp1[64];
+  fouble v0, v1, v2, v3, v4, v5, v6, v7, t;
   int i;
 
-  inputBits = 0;
-  restartCtr = restartInterval;
-  for (i = 0; i < numComps; ++i)
-    compInfo[i].prevDC = 0;
+  for (; n > 0; --n, coefs += 64, data += 64) {
+
+    // dequantize
+    for (i = 0; i < 64; ++i)
+      tmp1[i] = coefs[i] * quant[i];
+
+    // inverse DCT on rows
+    for (i = 0; i < 64; i += 8) {
+
+      // stage 4
+      v0 = dctSqrt2 * tmp1[i+0];
+      v1 = dctSqrt2 * tmp1[i+4];
+      v2 = tmp1[i+2];
+      v3 = tmp1[i+6];
+      v4 = dctSqrt1d2 * (tmp1[i+1] - tmp1[i+7]);
+      v7 = dctSqrt1d2 * (tmp1[i+1] + tmp1[i+7]);
+      v5 = tmp1[i+3];
+      v6 = tmp1[i+5];
+
+      // stage 3
+      t = 0.5 * (v0 - v1);
+      v0 = 0.5 * (v0 + v1);
+      v1 = t;
+      t = v2 * dctSin6 + v3 * dctCos6;
+      v2 = v2 * dctCos6 - v3 * dctSin6;
+      v3 = t;
+      t = 0.5 * (v4 - v6);
+      v4 = 0.5 * (v4 + v6);
+      v6 = t;
+      t = 0.5 * (v7 + v5);
+      v5 = 0.5 * (v7 - v5);
+      v7 = t;
+
+      // stage 2
+      t = 0.5 * (v0 - v3);
+      v0 = 0.5 * (v0 + v3);
+      v3 = t;
+      t = 0.5 * (v1 - v2);
+      v1 = 0.5 * (v1 + v2);
+      v2 = t;
+      t = v4 * dctSin3 + v7 * dctCos3;
+      v4 = v4 * dctCos3 - v7 * dctSin3;
+      v7 = t;
+      t = v5 * dctSin1 + v6 * dctCos1;
+      v5 = v5 * dctCos1 - v6 * dctSin1;
+      v6 = t;
+
+      // stage 1
+      tmp1[i+0] = v0 + v7;
+      tmp1[i+7] = v0 - v7;
+      tmp1[i+1] = v1 + v6;
+      tmp1[i+6] = v1 - v6;
+      tmp1[i+2] = v2 + v5;
+      tmp1[i+5] = v2 - v5;
+      tmp1[i+3] = v3 + v4;
+      tmp1[i+4] = v3 - v4;
+    }
+
+    // inverse DCT on columns
+    for (i = 0; i < 8; ++i) {
+
+      // stage 4
+      v0 = dctSqrt2 * tmp1[0*8+i];
+      v1 = dctSqrt2 * tmp1[4*8+i];
+      v2 = tmp1[2*8+i];
+      v3 = tmp1[6*8+i];
+      v4 = dctSqrt1d2 * (tmp1[1*8+i] - tmp1[7*8+i]);
+      v7 = dctSqrt1d2 * (tmp1[1*8+i] + tmp1[7*8+i]);
+      v5 = tmp1[3*8+i];
+      v6 = tmp1[5*8+i];
+
+      // stage 3
+      t = 0.5 * (v0 - v1);
+      v0 = 0.5 * (v0 + v1);
+      v1 = t;
+      t = v2 * dctSin6 + v3 * dctCos6;
+      v2 = v2 * dctCos6 - v3 * dctSin6;
+      v3 = t;
+      t = 0.5 * (v4 - v6);
+      v4 = 0.5 * (v4 + v6);
+      v6 = t;
+      t = 0.5 * (v7 + v5);
+      v5 = 0.5 * (v7 - v5);
+      v7 = t;
+
+      // stage 2
+      t = 0.5 * (v0 - v3);
+      v0 = 0.5 * (v0 + v3);
+      v3 = t;
+      t = 0.5 * (v1 - v2);
+      v1 = 0.5 * (v1 + v2);
+      v2 = t;
+      t = v4 * dctSin3 + v7 * dctCos3;
+      v4 = v4 * dctCos3 - v7 * dctSin3;
+      v7 = t;
+      t = v5 * dctSin1 + v6 * dctCos1;
+      v5 = v5 * dctCos1 - v6 * dctSin1;
+      v6 = t;
+
+      // stage 1
+      tmp1[0*8+i] = v0 + v7;
+      tmp1[7*8+i] = v0 - v7;
+      tmp1[1*8+i] = v1 + v6;
+      tmp1[6*8+i] = v1 - v6;
+      tmp1[2*8+i] = v2 + v5;
+      tmp1[5*8+i] = v2 - v5;
+      tmp1[3*8+i] = v3 + v4;
+      tmp1[4*8+i] = v3 - v4;
+    }
+
+    // convert to 8-bit integers
+    for (i = 0; i < 64; ++i)
+      data[i] = dctClamp((int)(tmp1[i] + 128.5));
+  }
 }
+#endif
 
-GBool DCTStream::readMCURow() {
-  Guchar data[64];
-  Guchar *p1, *p2;
+// Transform for images decoded at reduced size: each data unit gives a
+// <sizeX> x <sizeY> block of pixels (sizes are 1, 2, 4 or 8), each the
+// average of the full-size pixels it covers, computed straight from the
+// coefficients.  dctReducedCos<n>[x * 8 + u] is 4096 * C(u) / 2 times
+// the average of cos((2i+1) * u * pi / 16) over the 8 / n full-size
+// pixels i covered by pixel x.  High frequencies mostly average out,
+// and not at all for n = 1.
+static int dctReducedCos1[8] = {
+  1448,     0,     0,     0,     0,     0,     0,     0
+};
+static int dctReducedCos2[16] = {
+  1448,  1312,     0,  -461,     0,   308,     0,  -261,
+  1448, -1312,     0,   461,     0,  -308,     0,   261
+};
+static int dctReducedCos4[32] = {
+  1448,  1856,  1338,   652,     0,  -435,  -554,  -369,
+  1448,   769, -1338, -1573,     0,  1051,   554,  -153,
+  1448,  -769, -1338,  1573,     0, -1051,   554,   153,
+  1448, -1856,  1338,  -652,     0,   435,  -554,   369
+};
+static int dctReducedCos8[64] = {
+  1448,  2009,  1892,  1703,  1448,  1138,   784,   400,
+  1448,  1703,   784,  -400, -1448, -2009, -1892, -1138,
+  1448,  1138,  -784, -2009, -1448,   400,  1892,  1703,
+  1448,   400, -1892, -1138,  1448,  1703,  -784, -2009,
+  1448,  -400, -1892,  1138,  1448, -1703,  -784,  2009,
+  1448, -1138,  -784,  2009, -1448,  -400,  1892, -1703,
+  1448, -1703,   784,   400, -1448,  2009, -1892,  1138,
+  1448, -2009,  1892, -1703,  1448, -1138,   784,  -400
+};
+
+static int *dctReducedCos(int size) {
+  return size == 1 ? dctReducedCos1 : size == 2 ? dctReducedCos2 :
+         size == 4 ? dctReducedCos4 : dctReducedCos8;
+}
+
+static void dctTransformReduced(int *coefs, int *quant, Guchar *data,
+				int n, int sizeX, int sizeY) {
+  int tmp1[64], tmp2[64];
+  int *cosX, *cosY;
+  int x, y, u, v, t, nz, i;
+
+  cosX = dctReducedCos(sizeX);
+  cosY = dctReducedCos(sizeY);
+  for (; n > 0; --n, coefs += 64, data += sizeX * sizeY) {
+
+    // dequantize
+    for (i = 0; i < 64; ++i)
+      tmp1[i] = coefs[i] * quant[i];
+
+    // rows (most of them are usually zero)
+    for (v = 0; v < 8; ++v) {
+      nz = 0;
+      for (u = 0; u < 8; ++u)
+	nz |= tmp1[v * 8 + u];
+      for (x = 0; x < sizeX; ++x) {
+	t = 0;
+	if (nz) {
+	  for (u = 0; u < 8; ++u)
+	    t += cosX[x * 8 + u] * tmp1[v * 8 + u];
+	}
+	tmp2[v * sizeX + x] = (t + 128) >> 8;
+      }
+    }
+
+    // columns
+    for (y = 0; y < sizeY; ++y) {
+      for (x = 0; x < sizeX; ++x) {
+	t = 0;
+	for (v = 0; v < 8; ++v)
+	  t += cosY[y * 8 + v] * tmp2[v * sizeX + x];
+	data[y * sizeX + x] = (Guchar)dctClamp(128 + ((t + 32768) >> 16));
+      }
+    }
+  }
+}
+
+// Convert <n> pixels from YCbCr to RGB in place.  With <invert> set,
+// the result is complemented, which turns YCCK into CMYK (K is passed
+// through unchanged by the caller).
+static void dctYCbCrToRGBScalar(Guchar *p0, Guchar *p1, Guchar *p2, int n,
+				GBool invert) {
   int pY, pCb, pCr, pR, pG, pB;
-  int h, v, horiz, vert, hSub, vSub;
-  int x1, x2, y2, x3, y3, x4, y4, x5, y5, cc, i;
+  int inv, i;
+
+  inv = invert ? 0xff : 0;
+  for (i = 0; i < n; ++i) {
+    pY = p0[i];
+    pCb = p1[i] - 128;
+    pCr = p2[i] - 128;
+    pR = ((pY << 16) + dctCrToR * pCr + 32768) >> 16;
+    p0[i] = dctClip[dctClipOffset + pR] ^ inv;
+    pG = ((pY << 16) + dctCbToG * pCb + dctCrToG * pCr + 32768) >> 16;
+    p1[i] = dctClip[dctClipOffset + pG] ^ inv;
+    pB = ((pY << 16) + dctCbToB * pCb + 32768) >> 16;
+    p2[i] = dctClip[dctClipOffset + pB] ^ inv;
+  }
+}
+
+#ifdef DCT_SIMD
+
+// The vector IDCT follows the scalar one operation for operation, on
+// 32-bit lanes.  A 1-D pass works on eight vectors, one per coefficient
+// index, each holding that coefficient from four (SSE2) or eight (AVX2)
+// rows or columns; the row pass is done on the transposed block.
+//
+// The color conversion splits each 16.16 factor into an integer part
+// and a remainder that fits in 16 bits, eg. 1.402 * 65536 = 65536 +
+// 26345, so that pmaddwd gives the exact scalar sums:
+//   R = Y + Cr        + ((          26345 * Cr + 32768) >> 16)
+//   G = Y - Cr        + ((-22553 * Cb + 18734 * Cr + 32768) >> 16)
+//   B = Y + 2 * Cb    + ((-14942 * Cb              + 32768) >> 16)
+#define dctCrToRLo   26345
+#define dctCbToGLo  -22553
+#define dctCrToGLo   18734
+#define dctCbToBLo  -14942
+
+// 32-bit multiply (low half), which SSE2 lacks.
+static inline DCT_SSE2 __m128i dctMulSSE2(__m128i a, __m128i b) {
+  __m128i lo, hi;
+
+  lo = _mm_mul_epu32(a, b);
+  hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(lo, _MM_SHUFFLE(0, 0, 2, 0)),
+			    _mm_shuffle_epi32(hi, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline DCT_SSE2 void dctTranspose4SSE2(__m128i *dst, __m128i a,
+					       __m128i b, __m128i c,
+					       __m128i d) {
+  __m128i t0, t1, t2, t3;
+
+  t0 = _mm_unpacklo_epi32(a, b);
+  t1 = _mm_unpacklo_epi32(c, d);
+  t2 = _mm_unpackhi_epi32(a, b);
+  t3 = _mm_unpackhi_epi32(c, d);
+  dst[0] = _mm_unpacklo_epi64(t0, t1);
+  dst[1] = _mm_unpackhi_epi64(t0, t1);
+  dst[2] = _mm_unpacklo_epi64(t2, t3);
+  dst[3] = _mm_unpackhi_epi64(t2, t3);
+}
+
+// One 1-D IDCT pass; <rows> selects the rounding used on rows.
+static DCT_SSE2 void dctIdct1DSSE2(__m128i *v, GBool rows) {
+  __m128i v0, v1, v2, v3, v4, v5, v6, v7, t;
+  __m128i one, rnd, sh, rnd12, sh12;
+  __m128i sqrt2, sqrt1d2, cos1, sin1, cos3, sin3, cos6, sin6;
+
+  one = _mm_set1_epi32(1);
+  rnd = _mm_set1_epi32(rows ? 128 : 2048);
+  sh = _mm_cvtsi32_si128(rows ? 8 : 12);
+  rnd12 = _mm_set1_epi32(2048);
+  sh12 = _mm_cvtsi32_si128(12);
+  sqrt2 = _mm_set1_epi32(dctSqrt2);
+  sqrt1d2 = _mm_set1_epi32(dctSqrt1d2);
+  cos1 = _mm_set1_epi32(dctCos1);
+  sin1 = _mm_set1_epi32(dctSin1);
+  cos3 = _mm_set1_epi32(dctCos3);
+  sin3 = _mm_set1_epi32(dctSin3);
+  cos6 = _mm_set1_epi32(dctCos6);
+  sin6 = _mm_set1_epi32(dctSin6);
+
+  // stage 4
+  v0 = _mm_sra_epi32(_mm_add_epi32(dctMulSSE2(sqrt2, v[0]), rnd), sh);
+  v1 = _mm_sra_epi32(_mm_add_epi32(dctMulSSE2(sqrt2, v[4]), rnd), sh);
+  v2 = v[2];
+  v3 = v[6];
+  v4 = _mm_sra_epi32(_mm_add_epi32(dctMulSSE2(sqrt1d2,
+					      _mm_sub_epi32(v[1], v[7])),
+				   rnd), sh);
+  v7 = _mm_sra_epi32(_mm_add_epi32(dctMulSSE2(sqrt1d2,
+					      _mm_add_epi32(v[1], v[7])),
+				   rnd), sh);
+  v5 = rows ? _mm_slli_epi32(v[3], 4) : v[3];
+  v6 = rows ? _mm_slli_epi32(v[5], 4) : v[5];
+
+  // stage 3
+  t = _mm_srai_epi32(_mm_add_epi32(_mm_sub_epi32(v0, v1), one), 1);
+  v0 = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(v0, v1), one), 1);
+  v1 = t;
+  t = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(dctMulSSE2(v2, sin6),
+						dctMulSSE2(v3, cos6)),
+				  rnd), sh);
+  v2 = _mm_sra_epi32(_mm_add_epi32(_mm_sub_epi32(dctMulSSE2(v2, cos6),
+						 dctMulSSE2(v3, sin6)),
+				   rnd), sh);
+  v3 = t;
+  t = _mm_srai_epi32(_mm_add_epi32(_mm_sub_epi32(v4, v6), one), 1);
+  v4 = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(v4, v6), one), 1);
+  v6 = t;
+  t = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(v7, v5), one), 1);
+  v5 = _mm_srai_epi32(_mm_add_epi32(_mm_sub_epi32(v7, v5), one), 1);
+  v7 = t;
+
+  // stage 2
+  t = _mm_srai_epi32(_mm_add_epi32(_mm_sub_epi32(v0, v3), one), 1);
+  v0 = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(v0, v3), one), 1);
+  v3 = t;
+  t = _mm_srai_epi32(_mm_add_epi32(_mm_sub_epi32(v1, v2), one), 1);
+  v1 = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(v1, v2), one), 1);
+  v2 = t;
+  t = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(dctMulSSE2(v4, sin3),
+						dctMulSSE2(v7, cos3)),
+				  rnd12), sh12);
+  v4 = _mm_sra_epi32(_mm_add_epi32(_mm_sub_epi32(dctMulSSE2(v4, cos3),
+						 dctMulSSE2(v7, sin3)),
+				   rnd12), sh12);
+  v7 = t;
+  t = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(dctMulSSE2(v5, sin1),
+						dctMulSSE2(v6, cos1)),
+				  rnd12), sh12);
+  v5 = _mm_sra_epi32(_mm_add_epi32(_mm_sub_epi32(dctMulSSE2(v5, cos1),
+						 dctMulSSE2(v6, sin1)),
+				   rnd12), sh12);
+  v6 = t;
+
+  // stage 1
+  v[0] = _mm_add_epi32(v0, v7);
+  v[7] = _mm_sub_epi32(v0, v7);
+  v[1] = _mm_add_epi32(v1, v6);
+  v[6] = _mm_sub_epi32(v1, v6);
+  v[2] = _mm_add_epi32(v2, v5);
+  v[5] = _mm_sub_epi32(v2, v5);
+  v[3] = _mm_add_epi32(v3, v4);
+  v[4] = _mm_sub_epi32(v3, v4);
+}
+
+static DCT_SSE2 void dctTransformSSE2(int *coefs, int *quant, Guchar *data,
+				      int n) {
+  __m128i q[16], v[16], a[8], b[8], c[8], d[8];
+  __m128i acMask, m, zero, rnd, c128;
+  int i;
+
+  for (i = 0; i < 16; ++i)
+    q[i] = _mm_loadu_si128((__m128i *)(quant + 4 * i));
+  acMask = _mm_set_epi32(-1, -1, -1, 0);
+  zero = _mm_setzero_si128();
+  rnd = _mm_set1_epi32(8);
+  c128 = _mm_set1_epi32(128);
+
+  for (; n > 0; --n, coefs += 64, data += 64) {
+
+    // dequantize; v[2*i] and v[2*i+1] are the two halves of row i
+    m = zero;
+    for (i = 0; i < 16; ++i) {
+      v[i] = _mm_loadu_si128((__m128i *)(coefs + 4 * i));
+      m = _mm_or_si128(m, i ? v[i] : _mm_and_si128(v[i], acMask));
+      v[i] = dctMulSSE2(v[i], q[i]);
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(m, zero)) == 0xffff) {
+      memset(data, dctDCOnly(coefs[0] * quant[0]), 64);
+      continue;
+    }
+
+    // inverse DCT on rows: a[k] = coefficient k of rows 0-3, b[k] of
+    // rows 4-7
+    dctTranspose4SSE2(a, v[0], v[2], v[4], v[6]);
+    dctTranspose4SSE2(a + 4, v[1], v[3], v[5], v[7]);
+    dctTranspose4SSE2(b, v[8], v[10], v[12], v[14]);
+    dctTranspose4SSE2(b + 4, v[9], v[11], v[13], v[15]);
+    dctIdct1DSSE2(a, gTrue);
+    dctIdct1DSSE2(b, gTrue);
+
+    // inverse DCT on columns: c[k] = row k of columns 0-3, d[k] of
+    // columns 4-7
+    dctTranspose4SSE2(c, a[0], a[1], a[2], a[3]);
+    dctTranspose4SSE2(c + 4, b[0], b[1], b[2], b[3]);
+    dctTranspose4SSE2(d, a[4], a[5], a[6], a[7]);
+    dctTranspose4SSE2(d + 4, b[4], b[5], b[6], b[7]);
+    dctIdct1DSSE2(c, gFalse);
+    dctIdct1DSSE2(d, gFalse);
+
+    // convert to 8-bit integers
+    for (i = 0; i < 8; ++i) {
+      c[i] = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(c[i], rnd), 4), c128);
+      d[i] = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(d[i], rnd), 4), c128);
+    }
+    for (i = 0; i < 8; i += 2) {
+      _mm_storeu_si128((__m128i *)(data + 8 * i),
+		       _mm_packus_epi16(_mm_packs_epi32(c[i], d[i]),
+					_mm_packs_epi32(c[i+1], d[i+1])));
+    }
+  }
+}
+
+static inline DCT_AVX2 void dctTranspose8AVX2(__m256i *v) {
+  __m256i t0, t1, t2, t3, t4, t5, t6, t7;
+  __m256i u0, u1, u2, u3, u4, u5, u6, u7;
+
+  t0 = _mm256_unpacklo_epi32(v[0], v[1]);
+  t1 = _mm256_unpackhi_epi32(v[0], v[1]);
+  t2 = _mm256_unpacklo_epi32(v[2], v[3]);
+  t3 = _mm256_unpackhi_epi32(v[2], v[3]);
+  t4 = _mm256_unpacklo_epi32(v[4], v[5]);
+  t5 = _mm256_unpackhi_epi32(v[4], v[5]);
+  t6 = _mm256_unpacklo_epi32(v[6], v[7]);
+  t7 = _mm256_unpackhi_epi32(v[6], v[7]);
+  u0 = _mm256_unpacklo_epi64(t0, t2);
+  u1 = _mm256_unpackhi_epi64(t0, t2);
+  u2 = _mm256_unpacklo_epi64(t1, t3);
+  u3 = _mm256_unpackhi_epi64(t1, t3);
+  u4 = _mm256_unpacklo_epi64(t4, t6);
+  u5 = _mm256_unpackhi_epi64(t4, t6);
+  u6 = _mm256_unpacklo_epi64(t5, t7);
+  u7 = _mm256_unpackhi_epi64(t5, t7);
+  v[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+  v[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+  v[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+  v[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+  v[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+  v[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+  v[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+  v[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+// One 1-D IDCT pass; <rows> selects the rounding used on rows.
+static DCT_AVX2 void dctIdct1DAVX2(__m256i *v, GBool rows) {
+  __m256i v0, v1, v2, v3, v4, v5, v6, v7, t;
+  __m256i one, rnd, rnd12;
+  __m256i sqrt2, sqrt1d2, cos1, sin1, cos3, sin3, cos6, sin6;
+  __m128i sh, sh12;
+
+  one = _mm256_set1_epi32(1);
+  rnd = _mm256_set1_epi32(rows ? 128 : 2048);
+  sh = _mm_cvtsi32_si128(rows ? 8 : 12);
+  rnd12 = _mm256_set1_epi32(2048);
+  sh12 = _mm_cvtsi32_si128(12);
+  sqrt2 = _mm256_set1_epi32(dctSqrt2);
+  sqrt1d2 = _mm256_set1_epi32(dctSqrt1d2);
+  cos1 = _mm256_set1_epi32(dctCos1);
+  sin1 = _mm256_set1_epi32(dctSin1);
+  cos3 = _mm256_set1_epi32(dctCos3);
+  sin3 = _mm256_set1_epi32(dctSin3);
+  cos6 = _mm256_set1_epi32(dctCos6);
+  sin6 = _mm256_set1_epi32(dctSin6);
+
+  // stage 4
+  v0 = _mm256_sra_epi32(_mm256_add_epi32(_mm256_mullo_epi32(sqrt2, v[0]),
+					 rnd), sh);
+  v1 = _mm256_sra_epi32(_mm256_add_epi32(_mm256_mullo_epi32(sqrt2, v[4]),
+					 rnd), sh);
+  v2 = v[2];
+  v3 = v[6];
+  v4 = _mm256_sra_epi32(_mm256_add_epi32(
+	 _mm256_mullo_epi32(sqrt1d2, _mm256_sub_epi32(v[1], v[7])),
+	 rnd), sh);
+  v7 = _mm256_sra_epi32(_mm256_add_epi32(
+	 _mm256_mullo_epi32(sqrt1d2, _mm256_add_epi32(v[1], v[7])),
+	 rnd), sh);
+  v5 = rows ? _mm256_slli_epi32(v[3], 4) : v[3];
+  v6 = rows ? _mm256_slli_epi32(v[5], 4) : v[5];
+
+  // stage 3
+  t = _mm256_srai_epi32(_mm256_add_epi32(_mm256_sub_epi32(v0, v1), one), 1);
+  v0 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(v0, v1), one), 1);
+  v1 = t;
+  t = _mm256_sra_epi32(_mm256_add_epi32(
+	_mm256_add_epi32(_mm256_mullo_epi32(v2, sin6),
+			 _mm256_mullo_epi32(v3, cos6)), rnd), sh);
+  v2 = _mm256_sra_epi32(_mm256_add_epi32(
+	 _mm256_sub_epi32(_mm256_mullo_epi32(v2, cos6),
+			  _mm256_mullo_epi32(v3, sin6)), rnd), sh);
+  v3 = t;
+  t = _mm256_srai_epi32(_mm256_add_epi32(_mm256_sub_epi32(v4, v6), one), 1);
+  v4 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(v4, v6), one), 1);
+  v6 = t;
+  t = _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(v7, v5), one), 1);
+  v5 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_sub_epi32(v7, v5), one), 1);
+  v7 = t;
+
+  // stage 2
+  t = _mm256_srai_epi32(_mm256_add_epi32(_mm256_sub_epi32(v0, v3), one), 1);
+  v0 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(v0, v3), one), 1);
+  v3 = t;
+  t = _mm256_srai_epi32(_mm256_add_epi32(_mm256_sub_epi32(v1, v2), one), 1);
+  v1 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(v1, v2), one), 1);
+  v2 = t;
+  t = _mm256_sra_epi32(_mm256_add_epi32(
+	_mm256_add_epi32(_mm256_mullo_epi32(v4, sin3),
+			 _mm256_mullo_epi32(v7, cos3)), rnd12), sh12);
+  v4 = _mm256_sra_epi32(_mm256_add_epi32(
+	 _mm256_sub_epi32(_mm256_mullo_epi32(v4, cos3),
+			  _mm256_mullo_epi32(v7, sin3)), rnd12), sh12);
+  v7 = t;
+  t = _mm256_sra_epi32(_mm256_add_epi32(
+	_mm256_add_epi32(_mm256_mullo_epi32(v5, sin1),
+			 _mm256_mullo_epi32(v6, cos1)), rnd12), sh12);
+  v5 = _mm256_sra_epi32(_mm256_add_epi32(
+	 _mm256_sub_epi32(_mm256_mullo_epi32(v5, cos1),
+			  _mm256_mullo_epi32(v6, sin1)), rnd12), sh12);
+  v6 = t;
+
+  // stage 1
+  v[0] = _mm256_add_epi32(v0, v7);
+  v[7] = _mm256_sub_epi32(v0, v7);
+  v[1] = _mm256_add_epi32(v1, v6);
+  v[6] = _mm256_sub_epi32(v1, v6);
+  v[2] = _mm256_add_epi32(v2, v5);
+  v[5] = _mm256_sub_epi32(v2, v5);
+  v[3] = _mm256_add_epi32(v3, v4);
+  v[4] = _mm256_sub_epi32(v3, v4);
+}
+
+static DCT_AVX2 void dctTransformAVX2(int *coefs, int *quant, Guchar *data,
+				      int n) {
+  __m256i q[8], v[8];
+  __m256i acMask, m, rnd, c128, w0, w1;
+  int i;
+
+  for (i = 0; i < 8; ++i)
+    q[i] = _mm256_loadu_si256((__m256i *)(quant + 8 * i));
+  acMask = _mm256_set_epi32(-1, -1, -1, -1, -1, -1, -1, 0);
+  rnd = _mm256_set1_epi32(8);
+  c128 = _mm256_set1_epi32(128);
+
+  for (; n > 0; --n, coefs += 64, data += 64) {
+
+    // dequantize; v[i] is row i
+    m = _mm256_setzero_si256();
+    for (i = 0; i < 8; ++i) {
+      v[i] = _mm256_loadu_si256((__m256i *)(coefs + 8 * i));
+      m = _mm256_or_si256(m, i ? v[i] : _mm256_and_si256(v[i], acMask));
+      v[i] = _mm256_mullo_epi32(v[i], q[i]);
+    }
+    if (_mm256_testz_si256(m, m)) {
+      memset(data, dctDCOnly(coefs[0] * quant[0]), 64);
+      continue;
+    }
+
+    // inverse DCT on rows (v[k] = coefficient k of each row)
+    dctTranspose8AVX2(v);
+    dctIdct1DAVX2(v, gTrue);
+
+    // inverse DCT on columns (v[k] = row k)
+    dctTranspose8AVX2(v);
+    dctIdct1DAVX2(v, gFalse);
+
+    // convert to 8-bit integers
+    for (i = 0; i < 8; i += 2) {
+      w0 = _mm256_add_epi32(
+	     _mm256_srai_epi32(_mm256_add_epi32(v[i], rnd), 4), c128);
+      w1 = _mm256_add_epi32(
+	     _mm256_srai_epi32(_mm256_add_epi32(v[i+1], rnd), 4), c128);
+      _mm_storeu_si128((__m128i *)(data + 8 * i),
+	_mm_packus_epi16(
+	  _mm_packs_epi32(_mm256_castsi256_si128(w0),
+			  _mm256_extracti128_si256(w0, 1)),
+	  _mm_packs_epi32(_mm256_castsi256_si128(w1),
+			  _mm256_extracti128_si256(w1, 1))));
+    }
+  }
+}
+
+static DCT_SSE2 void dctYCbCrToRGBSSE2(Guchar *p0, Guchar *p1, Guchar *p2,
+				       int n, GBool invert) {
+  __m128i zero, c128, rnd, kR, kG, kB, inv;
+  __m128i y, cb, cr, lo, hi, r, g, b;
+  int i;
+
+  zero = _mm_setzero_si128();
+  c128 = _mm_set1_epi16(128);
+  rnd = _mm_set1_epi32(32768);
+  kR = _mm_set1_epi32(dctCrToRLo << 16);
+  kG = _mm_set1_epi32((dctCrToGLo << 16) | (dctCbToGLo & 0xffff));
+  kB = _mm_set1_epi32(dctCbToBLo & 0xffff);
+  inv = invert ? _mm_set1_epi8((char)0xff) : zero;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    y = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *)(p0 + i)), zero);
+    cb = _mm_sub_epi16(
+	   _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *)(p1 + i)), zero),
+	   c128);
+    cr = _mm_sub_epi16(
+	   _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *)(p2 + i)), zero),
+	   c128);
+    lo = _mm_unpacklo_epi16(cb, cr);
+    hi = _mm_unpackhi_epi16(cb, cr);
+    r = _mm_packs_epi32(
+	  _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(lo, kR), rnd), 16),
+	  _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(hi, kR), rnd), 16));
+    g = _mm_packs_epi32(
+	  _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(lo, kG), rnd), 16),
+	  _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(hi, kG), rnd), 16));
+    b = _mm_packs_epi32(
+	  _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(lo, kB), rnd), 16),
+	  _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(hi, kB), rnd), 16));
+    r = _mm_add_epi16(_mm_add_epi16(y, cr), r);
+    g = _mm_add_epi16(_mm_sub_epi16(y, cr), g);
+    b = _mm_add_epi16(_mm_add_epi16(y, _mm_add_epi16(cb, cb)), b);
+    _mm_storel_epi64((__m128i *)(p0 + i),
+		     _mm_xor_si128(_mm_packus_epi16(r, r), inv));
+    _mm_storel_epi64((__m128i *)(p1 + i),
+		     _mm_xor_si128(_mm_packus_epi16(g, g), inv));
+    _mm_storel_epi64((__m128i *)(p2 + i),
+		     _mm_xor_si128(_mm_packus_epi16(b, b), inv));
+  }
+  dctYCbCrToRGBScalar(p0 + i, p1 + i, p2 + i, n - i, invert);
+}
+
+static DCT_AVX2 void dctYCbCrToRGBAVX2(Guchar *p0, Guchar *p1, Guchar *p2,
+				       int n, GBool invert) {
+  __m256i c128, rnd, kR, kG, kB;
+  __m256i y, cb, cr, lo, hi, r, g, b;
+  __m128i inv;
+  int i;
+
+  c128 = _mm256_set1_epi16(128);
+  rnd = _mm256_set1_epi32(32768);
+  kR = _mm256_set1_epi32(dctCrToRLo << 16);
+  kG = _mm256_set1_epi32((dctCrToGLo << 16) | (dctCbToGLo & 0xffff));
+  kB = _mm256_set1_epi32(dctCbToBLo & 0xffff);
+  inv = invert ? _mm_set1_epi8((char)0xff) : _mm_setzero_si128();
+
+  // unpack and pack both work within 128-bit lanes, so the pixels come
+  // out of the 32-bit stage in their original order
+  for (i = 0; i + 16 <= n; i += 16) {
+    y = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *)(p0 + i)));
+    cb = _mm256_sub_epi16(
+	   _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *)(p1 + i))), c128);
+    cr = _mm256_sub_epi16(
+	   _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *)(p2 + i))), c128);
+    lo = _mm256_unpacklo_epi16(cb, cr);
+    hi = _mm256_unpackhi_epi16(cb, cr);
+    r = _mm256_packs_epi32(
+	  _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(lo, kR), rnd),
+			    16),
+	  _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(hi, kR), rnd),
+			    16));
+    g = _mm256_packs_epi32(
+	  _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(lo, kG), rnd),
+			    16),
+	  _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(hi, kG), rnd),
+			    16));
+    b = _mm256_packs_epi32(
+	  _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(lo, kB), rnd),
+			    16),
+	  _mm256_srai_epi32(_mm256_add_epi32(_mm256_madd_epi16(hi, kB), rnd),
+			    16));
+    r = _mm256_add_epi16(_mm256_add_epi16(y, cr), r);
+    g = _mm256_add_epi16(_mm256_sub_epi16(y, cr), g);
+    b = _mm256_add_epi16(_mm256_add_epi16(y, _mm256_add_epi16(cb, cb)), b);
+    _mm_storeu_si128((__m128i *)(p0 + i),
+      _mm_xor_si128(_mm_packus_epi16(_mm256_castsi256_si128(r),
+				     _mm256_extracti128_si256(r, 1)), inv));
+    _mm_storeu_si128((__m128i *)(p1 + i),
+      _mm_xor_si128(_mm_packus_epi16(_mm256_castsi256_si128(g),
+				     _mm256_extracti128_si256(g, 1)), inv));
+    _mm_storeu_si128((__m128i *)(p2 + i),
+      _mm_xor_si128(_mm_packus_epi16(_mm256_castsi256_si128(b),
+				     _mm256_extracti128_si256(b, 1)), inv));
+  }
+  dctYCbCrToRGBSSE2(p0 + i, p1 + i, p2 + i, n - i, invert);
+}
+
+#endif // DCT_SIMD
+
+// implementations picked for this CPU (or by DCTStream::setKernel)
+static void (*dctTransform)(int *coefs, int *quant, Guchar *data, int n);
+static void (*dctYCbCrToRGB)(Guchar *p0, Guchar *p1, Guchar *p2, int n,
+			     GBool invert);
+static DCTKernel dctKernel = dctKernelAuto;
+
+GBool DCTStream::setKernel(DCTKernel kernel) {
+#ifdef DCT_SIMD
+  __builtin_cpu_init();
+  if (kernel == dctKernelAuto) {
+    if (__builtin_cpu_supports("avx2")) {
+      kernel = dctKernelAVX2;
+    } else if (__builtin_cpu_supports("sse2")) {
+      kernel = dctKernelSSE2;
+    } else {
+      kernel = dctKernelScalar;
+    }
+  }
+  switch (kernel) {
+  case dctKernelAVX2:
+    if (!__builtin_cpu_supports("avx2")) {
+      return gFalse;
+    }
+    dctTransform = &dctTransformAVX2;
+    dctYCbCrToRGB = &dctYCbCrToRGBAVX2;
+    break;
+  case dctKernelSSE2:
+    if (!__builtin_cpu_supports("sse2")) {
+      return gFalse;
+    }
+    dctTransform = &dctTransformSSE2;
+    dctYCbCrToRGB = &dctYCbCrToRGBSSE2;
+    break;
+  default:
+    dctTransform = &dctTransformScalar;
+    dctYCbCrToRGB = &dctYCbCrToRGBScalar;
+    break;
+  }
+#else
+  if (kernel != dctKernelAuto && kernel != dctKernelScalar) {
+    return gFalse;
+  }
+  kernel = dctKernelScalar;
+  dctTransform = &dctTransformScalar;
+  dctYCbCrToRGB = &dctYCbCrToRGBScalar;
+#endif
+  dctKernel = kernel;
+  return gTrue;
+}
+
+DCTKernel DCTStream::getKernel() {
+  if (dctKernel == dctKernelAuto) {
+    setKernel(dctKernelAuto);
+  }
+  return dctKernel;
+}
+
+DCTStream::DCTStream(Stream *strA):
+    FilterStream(strA) {
+  int i, j;
+
+  progressive = multiScan = gFalse;
+  width = height = 0;
+  mcuWidth = mcuHeight = 0;
+  scale = 1;
+  scaledWidth = scaledHeight = scaledMcuHeight = 0;
+  numComps = 0;
+  eobRun = 0;
+  comp = 0;
+  x = y = dy = 0;
+  for (i = 0; i < 4; ++i) {
+    for (j = 0; j < 32; ++j)
+      rowBuf[i][j] = NULL;
+    coefBuf[i] = NULL;
+    coefImage[i] = NULL;
+    blockBuf[i] = NULL;
+  }
+
+  if (!dctClipInit) {
+    for (i = -256; i < 0; ++i)
+      dctClip[dctClipOffset + i] = 0;
+    for (i = 0; i < 256; ++i)
+      dctClip[dctClipOffset + i] = i;
+    for (i = 256; i < 512; ++i)
+      dctClip[dctClipOffset + i] = 255;
+    if (dctKernel == dctKernelAuto) {
+      setKernel(dctKernelAuto);
+    }
+    dctClipInit = 1;
+  }
+}
+
+DCTStream::~DCTStream() {
+  int i, j;
+
+  delete str;
+  for (i = 0; i < 4; ++i) {
+    for (j = 0; j < 32; ++j)
+      gfree(rowBuf[i][j]);
+    gfree(coefBuf[i]);
+    gfree(coefImage[i]);
+    gfree(blockBuf[i]);
+  }
+}
+
+void DCTStream::reset() {
+  str->reset();
+  if (!readHeader()) {
+    y = scaledHeight;
+    return;
+  }
+  if (multiScan) {
+    readScans();
+  } else {
+    restartMarker = 0xd0;
+    restart();
+  }
+}
+
+int DCTStream::getChar() {
   int c;
 
-  for (x1 = 0; x1 < width; x1 += mcuWidth) {
+  c = lookChar();
+  if (c == EOF)
+    return EOF;
+  if (++comp == numComps) {
+    comp = 0;
+    if (++x == scaledWidth) {
+      x = 0;
+      ++y;
+      ++dy;
+    }
+  }
+  if (y == scaledHeight && !multiScan)
+    readTrailer();
+  return c;
+}
 
-    // deal with restart marker
-    if (restartInterval > 0 && restartCtr == 0) {
-      c = readMarker();
-      if (c != restartMarker) {
-	error(getPos(), "Bad DCT data: incorrect restart marker");
-	return gFalse;
+int DCTStream::lookChar() {
+  if (y >= scaledHeight)
+    return EOF;
+  if (dy >= scaledMcuHeight) {
+    if (!readMCURow()) {
+      y = scaledHeight;
+      return EOF;
+    }
+    comp = 0;
+    x = 0;
+    dy = 0;
+  }
+  return rowBuf[comp][dy][x];
+}
+
+int DCTStream::getBlock(char *blk, int size) {
+  Guchar *p, *p0, *p1, *p2;
+  int n, m, cc, i;
+
+  n = 0;
+  while (n < size && lookChar() != EOF) {
+    if (numComps == 1) {
+      m = scaledWidth - x;
+      if (m > size - n)
+	m = size - n;
+      memcpy(blk + n, &rowBuf[0][dy][x], m);
+      n += m;
+      x += m;
+    } else {
+      m = (size - n) / numComps;
+      if (m > scaledWidth - x)
+	m = scaledWidth - x;
+      if (comp == 0 && m > 0) {
+	// interleave whole pixels
+	p = (Guchar *)blk + n;
+	if (numComps == 3) {
+	  p0 = &rowBuf[0][dy][x];
+	  p1 = &rowBuf[1][dy][x];
+	  p2 = &rowBuf[2][dy][x];
+	  for (i = 0; i < m; ++i) {
+	    *p++ = p0[i];
+	    *p++ = p1[i];
+	    *p++ = p2[i];
+	  }
+	} else {
+	  for (i = 0; i < m; ++i)
+	    for (cc = 0; cc < numComps; ++cc)
+	      *p++ = rowBuf[cc][dy][x+i];
+	}
+	n += m * numComps;
+	x += m;
+      } else {
+	// finish (or start) a pixel split across calls
+	do {
+	  blk[n++] = rowBuf[comp][dy][x];
+	  if (++comp == numComps) {
+	    comp = 0;
+	    ++x;
+	  }
+	} while (n < size && comp != 0);
       }
-      if (++restartMarker == 0xd8)
-	restartMarker = 0xd0;
-      restart();
     }
+    if (x == scaledWidth) {
+      x = 0;
+      ++y;
+      ++dy;
+      if (y == scaledHeight && !multiScan)
+	readTrailer();
+    }
+  }
+  return n;
+}
 
-    // read one MCU
+void DCTStream::restart() {
+  int i;
+
+  inputBits = 0;
+  restartCtr = restartInterval;
+  for (i = 0; i < numComps; ++i)
+    compInfo[i].prevDC = 0;
+  eobRun = 0;
+}
+
+// Reads one row of MCUs: first all of its data units are Huffman
+// decoded (or, for multi-scan images, fetched from coefImage), then
+// each component's are dequantized and transformed in one go, and
+// finally the color conversion is done a whole pixel row at a time.
+GBool DCTStream::readMCURow() {
+  int *coefs[4];
+  int quant[64];
+  short *src;
+  Guchar *data;
+  Guchar *p1, *p2;
+  int sizeX, sizeY, scaledMcuWidth;
+  int h, v, horiz, vert, hSub, vSub;
+  int x1, x2, y2, x3, y3, x4, y4, x5, y5, cc, i, n;
+  int c;
+
+  // Huffman decode
+  for (cc = 0; cc < numComps; ++cc)
+    coefs[cc] = coefBuf[cc];
+  if (multiScan) {
     for (cc = 0; cc < numComps; ++cc) {
-      h = compInfo[cc].hSample;
-      v = compInfo[cc].vSample;
-      horiz = mcuWidth / h;
-      vert = mcuHeight / v;
-      hSub = horiz / 8;
-      vSub = vert / 8;
-      for (y2 = 0; y2 < mcuHeight; y2 += vert) {
-	for (x2 = 0; x2 < mcuWidth; x2 += horiz) {
+      n = ((width + mcuWidth - 1) / mcuWidth) *
+	  compInfo[cc].hSample * compInfo[cc].vSample * 64;
+      src = coefImage[cc] + (y / scaledMcuHeight) * n;
+      for (i = 0; i < n; ++i)
+	coefs[cc][i] = src[i];
+      coefs[cc] += n;
+    }
+  } else {
+    for (x1 = 0; x1 < width; x1 += mcuWidth) {
+
+      // deal with restart marker
+      if (restartInterval > 0 && restartCtr == 0) {
+	c = readMarker();
+	if (c != restartMarker) {
+	  error(getPos(), "Bad DCT data: incorrect restart marker");
+	  return gFalse;
+	}
+	if (++restartMarker == 0xd8)
+	  restartMarker = 0xd0;
+	restart();
+      }
+
+      // read one MCU
+      for (cc = 0; cc < numComps; ++cc) {
+	n = compInfo[cc].hSample * compInfo[cc].vSample;
+	for (i = 0; i < n; ++i) {
 	  if (!readDataUnit(&dcHuffTables[compInfo[cc].dcHuffTable],
 			    &acHuffTables[compInfo[cc].acHuffTable],
-			    quantTables[compInfo[cc].quantTable],
 			    &compInfo[cc].prevDC,
-			    data))
+			    coefs[cc]))
 	    return gFalse;
+	  coefs[cc] += 64;
+	}
+      }
+      --restartCtr;
+    }
+  }
+
+  // dequantize and inverse DCT, then copy the data units into the row
+  // buffers, upsampling as needed; at reduced scale, subsampled
+  // components are transformed to more than 8 / scale pixels a side,
+  // up to 8, rather than upsampled
+  scaledMcuWidth = mcuWidth / scale;
+  for (cc = 0; cc < numComps; ++cc) {
+    h = compInfo[cc].hSample;
+    v = compInfo[cc].vSample;
+    horiz = scaledMcuWidth / h;
+    vert = scaledMcuHeight / v;
+    for (sizeX = 8 / scale; sizeX < 8 && horiz % (2 * sizeX) == 0;
+	 sizeX *= 2) ;
+    for (sizeY = 8 / scale; sizeY < 8 && vert % (2 * sizeY) == 0;
+	 sizeY *= 2) ;
+    hSub = horiz / sizeX;
+    vSub = vert / sizeY;
+
+    for (i = 0; i < 64; ++i)
+      quant[i] = quantTables[compInfo[cc].quantTable][i];
+    if (sizeX == 8 && sizeY == 8)
+      (*dctTransform)(coefBuf[cc], quant, blockBuf[cc],
+		      (coefs[cc] - coefBuf[cc]) / 64);
+    else
+      dctTransformReduced(coefBuf[cc], quant, blockBuf[cc],
+			  (coefs[cc] - coefBuf[cc]) / 64, sizeX, sizeY);
+
+    data = blockBuf[cc];
+    for (x1 = 0; x1 < scaledWidth; x1 += scaledMcuWidth) {
+      for (y2 = 0; y2 < scaledMcuHeight; y2 += vert) {
+	for (x2 = 0; x2 < scaledMcuWidth; x2 += horiz) {
 	  if (hSub == 1 && vSub == 1) {
-	    for (y3 = 0, i = 0; y3 < 8; ++y3, i += 8) {
-	      p1 = &rowBuf[cc][y2+y3][x1+x2];
-	      p1[0] = data[i];
-	      p1[1] = data[i+1];
-	      p1[2] = data[i+2];
-	      p1[3] = data[i+3];
-	      p1[4] = data[i+4];
-	      p1[5] = data[i+5];
-	      p1[6] = data[i+6];
-	      p1[7] = data[i+7];
-	    }
-	  } else if (hSub == 2 && vSub == 2) {
+	    for (y3 = 0, i = 0; y3 < sizeY; ++y3, i += sizeX)
+	      memcpy(&rowBuf[cc][y2+y3][x1+x2], data + i, sizeX);
+	  } else if (hSub == 2 && vSub == 2 && sizeX == 8 && sizeY == 8) {
 	    for (y3 = 0, i = 0; y3 < 16; y3 += 2, i += 8) {
 	      p1 = &rowBuf[cc][y2+y3][x1+x2];
 	      p2 = &rowBuf[cc][y2+y3+1][x1+x2];
@@ -2093,8 +3388,8 @@ GBool DCTStream::readMCURow() {
 	    }
 	  } else {
 	    i = 0;
-	    for (y3 = 0, y4 = 0; y3 < 8; ++y3, y4 += vSub) {
-	      for (x3 = 0, x4 = 0; x3 < 8; ++x3, x4 += hSub) {
+	    for (y3 = 0, y4 = 0; y3 < sizeY; ++y3, y4 += vSub) {
+	      for (x3 = 0, x4 = 0; x3 < sizeX; ++x3, x4 += hSub) {
 		for (y5 = 0; y5 < vSub; ++y5)
 		  for (x5 = 0; x5 < hSub; ++x5)
 		    rowBuf[cc][y2+y4+y5][x1+x2+x4+x5] = data[i];
@@ -2102,68 +3397,30 @@ GBool DCTStream::readMCURow() {
 	      }
 	    }
 	  }
+	  data += sizeX * sizeY;
 	}
       }
     }
-    --restartCtr;
-
-    // color space conversion
-    if (colorXform) {
-      // convert YCbCr to RGB
-      if (numComps == 3) {
-	for (y2 = 0; y2 < mcuHeight; ++y2) {
-	  for (x2 = 0; x2 < mcuWidth; ++x2) {
-	    pY = rowBuf[0][y2][x1+x2];
-	    pCb = rowBuf[1][y2][x1+x2] - 128;
-	    pCr = rowBuf[2][y2][x1+x2] - 128;
-	    pR = ((pY << 16) + dctCrToR * pCr + 32768) >> 16;
-	    rowBuf[0][y2][x1+x2] = dctClip[dctClipOffset + pR];
-	    pG = ((pY << 16) + dctCbToG * pCb + dctCrToG * pCr + 32768) >> 16;
-	    rowBuf[1][y2][x1+x2] = dctClip[dctClipOffset + pG];
-	    pB = ((pY << 16) + dctCbToB * pCb + 32768) >> 16;
-	    rowBuf[2][y2][x1+x2] = dctClip[dctClipOffset + pB];
-	  }
-	}
-      // convert YCbCrK to CMYK (K is passed through unchanged)
-      } else if (numComps == 4) {
-	for (y2 = 0; y2 < mcuHeight; ++y2) {
-	  for (x2 = 0; x2 < mcuWidth; ++x2) {
-	    pY = rowBuf[0][y2][x1+x2];
-	    pCb = rowBuf[1][y2][x1+x2] - 128;
-	    pCr = rowBuf[2][y2][x1+x2] - 128;
-	    pR = ((pY << 16) + dctCrToR * pCr + 32768) >> 16;
-	    rowBuf[0][y2][x1+x2] = 255 - dctClip[dctClipOffset + pR];
-	    pG = ((pY << 16) + dctCbToG * pCb + dctCrToG * pCr + 32768) >> 16;
-	    rowBuf[1][y2][x1+x2] = 255 - dctClip[dctClipOffset + pG];
-	    pB = ((pY << 16) + dctCbToB * pCb + 32768) >> 16;
-	    rowBuf[2][y2][x1+x2] = 255 - dctClip[dctClipOffset + pB];
-	  }
-	}
-      }
-    }
+  }
+
+  // color space conversion: YCbCr to RGB, or YCbCrK to CMYK (K is
+  // passed through unchanged)
+  if (colorXform && (numComps == 3 || numComps == 4)) {
+    for (y2 = 0; y2 < scaledMcuHeight; ++y2)
+      (*dctYCbCrToRGB)(rowBuf[0][y2], rowBuf[1][y2], rowBuf[2][y2],
+		       scaledWidth, numComps == 4);
   }
   return gTrue;
 }
 
-// This IDCT algorithm is taken from:
-//   Christoph Loeffler, Adriaan Ligtenberg, George S. Moschytz,
-//   "Practical Fast 1-D DCT Algorithms with 11 Multiplications",
-//   IEEE Intl. Conf. on Acoustics, Speech & Signal Processing, 1989,
-//   988-991.
-// The stage numbers mentioned in the comments refer to Figure 1 in this
-// paper.
-#ifndef FP_IDCT
+// Huffman decode one data unit into <coefs>, in natural order.
 GBool DCTStream::readDataUnit(DCTHuffTable *dcHuffTable,
 			      DCTHuffTable *acHuffTable,
-			      Guchar quantTable[64], int *prevDC,
-			      Guchar data[64]) {
-  int tmp1[64];
-  int v0, v1, v2, v3, v4, v5, v6, v7, t;
+			      int *prevDC, int coefs[64]) {
   int run, size, amp;
   int c;
-  int i, j;
+  int i;
 
-  // Huffman decode and dequantize
   size = readHuffSym(dcHuffTable);
   if (size == 9999)
     return gFalse;
@@ -2174,9 +3431,9 @@ GBool DCTStream::readDataUnit(DCTHuffTable *dcHuffTable,
   } else {
     amp = 0;
   }
-  tmp1[0] = (*prevDC += amp) * quantTable[0];
+  coefs[0] = (*prevDC += amp);
   for (i = 1; i < 64; ++i)
-    tmp1[i] = 0;
+    coefs[i] = 0;
   i = 1;
   while (i < 64) {
     run = 0;
@@ -2193,280 +3450,303 @@ GBool DCTStream::readDataUnit(DCTHuffTable *dcHuffTable,
       if (amp == 9999)
 	return gFalse;
       i += run;
-      j = dctZigZag[i++];
-      tmp1[j] = amp * quantTable[j];
-    }
-  }
-
-  // inverse DCT on rows
-  for (i = 0; i < 64; i += 8) {
-
-    // stage 4
-    v0 = (dctSqrt2 * tmp1[i+0] + 128) >> 8;
-    v1 = (dctSqrt2 * tmp1[i+4] + 128) >> 8;
-    v2 = tmp1[i+2];
-    v3 = tmp1[i+6];
-    v4 = (dctSqrt1d2 * (tmp1[i+1] - tmp1[i+7]) + 128) >> 8;
-    v7 = (dctSqrt1d2 * (tmp1[i+1] + tmp1[i+7]) + 128) >> 8;
-    v5 = tmp1[i+3] << 4;
-    v6 = tmp1[i+5] << 4;
-
-    // stage 3
-    t = (v0 - v1+ 1) >> 1;
-    v0 = (v0 + v1 + 1) >> 1;
-    v1 = t;
-    t = (v2 * dctSin6 + v3 * dctCos6 + 128) >> 8;
-    v2 = (v2 * dctCos6 - v3 * dctSin6 + 128) >> 8;
-    v3 = t;
-    t = (v4 - v6 + 1) >> 1;
-    v4 = (v4 + v6 + 1) >> 1;
-    v6 = t;
-    t = (v7 + v5 + 1) >> 1;
-    v5 = (v7 - v5 + 1) >> 1;
-    v7 = t;
-
-    // stage 2
-    t = (v0 - v3 + 1) >> 1;
-    v0 = (v0 + v3 + 1) >> 1;
-    v3 = t;
-    t = (v1 - v2 + 1) >> 1;
-    v1 = (v1 + v2 + 1) >> 1;
-    v2 = t;
-    t = (v4 * dctSin3 + v7 * dctCos3 + 2048) >> 12;
-    v4 = (v4 * dctCos3 - v7 * dctSin3 + 2048) >> 12;
-    v7 = t;
-    t = (v5 * dctSin1 + v6 * dctCos1 + 2048) >> 12;
-    v5 = (v5 * dctCos1 - v6 * dctSin1 + 2048) >> 12;
-    v6 = t;
-
-    // stage 1
-    tmp1[i+0] = v0 + v7;
-    tmp1[i+7] = v0 - v7;
-    tmp1[i+1] = v1 + v6;
-    tmp1[i+6] = v1 - v6;
-    tmp1[i+2] = v2 + v5;
-    tmp1[i+5] = v2 - v5;
-    tmp1[i+3] = v3 + v4;
-    tmp1[i+4] = v3 - v4;
-  }
-
-  // inverse DCT on columns
-  for (i = 0; i < 8; ++i) {
-
-    // stage 4
-    v0 = (dctSqrt2 * tmp1[0*8+i] + 2048) >> 12;
-    v1 = (dctSqrt2 * tmp1[4*8+i] + 2048) >> 12;
-    v2 = tmp1[2*8+i];
-    v3 = tmp1[6*8+i];
-    v4 = (dctSqrt1d2 * (tmp1[1*8+i] - tmp1[7*8+i]) + 2048) >> 12;
-    v7 = (dctSqrt1d2 * (tmp1[1*8+i] + tmp1[7*8+i]) + 2048) >> 12;
-    v5 = tmp1[3*8+i];
-    v6 = tmp1[5*8+i];
-
-    // stage 3
-    t = (v0 - v1 + 1) >> 1;
-    v0 = (v0 + v1 + 1) >> 1;
-    v1 = t;
-    t = (v2 * dctSin6 + v3 * dctCos6 + 2048) >> 12;
-    v2 = (v2 * dctCos6 - v3 * dctSin6 + 2048) >> 12;
-    v3 = t;
-    t = (v4 - v6 + 1) >> 1;
-    v4 = (v4 + v6 + 1) >> 1;
-    v6 = t;
-    t = (v7 + v5 + 1) >> 1;
-    v5 = (v7 - v5 + 1) >> 1;
-    v7 = t;
-
-    // stage 2
-    t = (v0 - v3 + 1) >> 1;
-    v0 = (v0 + v3 + 1) >> 1;
-    v3 = t;
-    t = (v1 - v2 + 1) >> 1;
-    v1 = (v1 + v2 + 1) >> 1;
-    v2 = t;
-    t = (v4 * dctSin3 + v7 * dctCos3 + 2048) >> 12;
-    v4 = (v4 * dctCos3 - v7 * dctSin3 + 2048) >> 12;
-    v7 = t;
-    t = (v5 * dctSin1 + v6 * dctCos1 + 2048) >> 12;
-    v5 = (v5 * dctCos1 - v6 * dctSin1 + 2048) >> 12;
-    v6 = t;
-
-    // stage 1
-    tmp1[0*8+i] = v0 + v7;
-    tmp1[7*8+i] = v0 - v7;
-    tmp1[1*8+i] = v1 + v6;
-    tmp1[6*8+i] = v1 - v6;
-    tmp1[2*8+i] = v2 + v5;
-    tmp1[5*8+i] = v2 - v5;
-    tmp1[3*8+i] = v3 + v4;
-    tmp1[4*8+i] = v3 - v4;
-  }
-
-  // convert to 8-bit integers
-  for (i = 0; i < 64; ++i)
-    data[i] = dctClip[dctClipOffset + 128 + ((tmp1[i] + 8) >> 4)];
-
+      if (i > 63) {
+	error(getPos(), "Bad DCT data: too many coefficients");
+	return gFalse;
+      }
+      coefs[dctZigZag[i++]] = amp;
+    }
+  }
   return gTrue;
 }
-#endif
 
-#ifdef FP_IDCT
-GBool DCTStream::readDataUnit(DCTHuffTable *dcHuffTable,
-			      DCTHuffTable *acHuffTable,
-			      Guchar quantTable[64], int *prevDC,
-			      Guchar data[64]) {
-  fouble tmp1[64];
-  fouble v0, v1, v2, v3, v4, v5, v6, v7, t;
-  int run, size, amp;
+// Decode all the scans of a multi-scan image into coefImage.  The
+// first scan's header has already been read.  A bad or truncated scan
+// ends decoding, but whatever was decoded so far is still output.
+void DCTStream::readScans() {
+  GBool doScan;
+  int n, i;
   int c;
-  int i, j;
 
-  // Huffman decode and dequantize
-  size = readHuffSym(dcHuffTable);
-  if (size == 9999)
-    return gFalse;
-  if (size > 0) {
-    amp = readAmp(size);
-    if (amp == 9999)
-      return gFalse;
-  } else {
-    amp = 0;
+  while (1) {
+    if (!readScan())
+      return;
+
+    // look for the next scan
+    doScan = gFalse;
+    while (!doScan) {
+      c = readMarker();
+      switch (c) {
+      case 0xc4:		// DHT
+	if (!readHuffmanTables())
+	  return;
+	break;
+      case 0xda:		// SOS
+	if (!readScanInfo())
+	  return;
+	doScan = gTrue;
+	break;
+      case 0xdb:		// DQT
+	if (!readQuantTables())
+	  return;
+	break;
+      case 0xdd:		// DRI
+	if (!readRestartInterval())
+	  return;
+	break;
+      case 0xd9:		// EOI
+      case EOF:
+	return;
+      default:
+	// skip APPn / COM / etc.
+	if (c >= 0xe0) {
+	  n = read16() - 2;
+	  for (i = 0; i < n; ++i)
+	    str->getChar();
+	} else {
+	  error(getPos(), "Unknown DCT marker <%02x>", c);
+	  return;
+	}
+	break;
+      }
+    }
   }
-  tmp1[0] = (*prevDC += amp) * quantTable[0];
-  for (i = 1; i < 64; ++i)
-    tmp1[i] = 0;
-  i = 1;
-  while (i < 64) {
-    run = 0;
-    while ((c = readHuffSym(acHuffTable)) == 0xf0 && run < 0x30)
-      run += 0x10;
-    if (c == 9999)
-      return gFalse;
-    if (c == 0x00) {
-      break;
+}
+
+// Decode one scan into coefImage.  coefImage is laid out like coefBuf,
+// one MCU row after another.
+GBool DCTStream::readScan() {
+  short *p;
+  int scanComps, mcusX, mcusY, bw, bh;
+  int h, v, bx, by, mx, my, x2, y2, cc;
+  int c;
+
+  scanComps = 0;
+  cc = 0;
+  for (c = 0; c < numComps; ++c) {
+    if (compInfo[c].inScan) {
+      ++scanComps;
+      cc = c;
+    }
+  }
+  mcusX = (width + mcuWidth - 1) / mcuWidth;
+  mcusY = (height + mcuHeight - 1) / mcuHeight;
+  restartMarker = 0xd0;
+  restart();
+
+  // a scan with one component is non-interleaved: its MCUs are single
+  // data units, covering just the component's own (subsampled) size
+  if (scanComps == 1) {
+    h = compInfo[cc].hSample;
+    v = compInfo[cc].vSample;
+    bw = ((width * h + mcuWidth / 8 - 1) / (mcuWidth / 8) + 7) / 8;
+    bh = ((height * v + mcuHeight / 8 - 1) / (mcuHeight / 8) + 7) / 8;
+    for (by = 0; by < bh; ++by) {
+      for (bx = 0; bx < bw; ++bx) {
+	if (restartInterval > 0 && restartCtr == 0) {
+	  c = readMarker();
+	  if (c != restartMarker) {
+	    error(getPos(), "Bad DCT data: incorrect restart marker");
+	    return gFalse;
+	  }
+	  if (++restartMarker == 0xd8)
+	    restartMarker = 0xd0;
+	  restart();
+	}
+	p = coefImage[cc] + ((((by / v) * mcusX + bx / h) * v + by % v) * h +
+			     bx % h) * 64;
+	if (!readScanDataUnit(cc, p))
+	  return gFalse;
+	--restartCtr;
+      }
+    }
+    return gTrue;
+  }
+
+  for (my = 0; my < mcusY; ++my) {
+    for (mx = 0; mx < mcusX; ++mx) {
+      if (restartInterval > 0 && restartCtr == 0) {
+	c = readMarker();
+	if (c != restartMarker) {
+	  error(getPos(), "Bad DCT data: incorrect restart marker");
+	  return gFalse;
+	}
+	if (++restartMarker == 0xd8)
+	  restartMarker = 0xd0;
+	restart();
+      }
+      for (cc = 0; cc < numComps; ++cc) {
+	if (!compInfo[cc].inScan)
+	  continue;
+	h = compInfo[cc].hSample;
+	v = compInfo[cc].vSample;
+	p = coefImage[cc] + (my * mcusX + mx) * h * v * 64;
+	for (y2 = 0; y2 < v; ++y2) {
+	  for (x2 = 0; x2 < h; ++x2) {
+	    if (!readScanDataUnit(cc, p))
+	      return gFalse;
+	    p += 64;
+	  }
+	}
+      }
+      --restartCtr;
+    }
+  }
+  return gTrue;
+}
+
+GBool DCTStream::readScanDataUnit(int cc, short coefs[64]) {
+  int tmp[64];
+  int i;
+
+  if (progressive) {
+    return readProgressiveDataUnit(&dcHuffTables[compInfo[cc].dcHuffTable],
+				   &acHuffTables[compInfo[cc].acHuffTable],
+				   &compInfo[cc].prevDC, coefs);
+  }
+  if (!readDataUnit(&dcHuffTables[compInfo[cc].dcHuffTable],
+		    &acHuffTables[compInfo[cc].acHuffTable],
+		    &compInfo[cc].prevDC, tmp))
+    return gFalse;
+  for (i = 0; i < 64; ++i)
+    coefs[i] = (short)tmp[i];
+  return gTrue;
+}
+
+// Huffman decode one data unit's share of a progressive scan: the first
+// pass at, or a refinement of, either the DC coefficient or the AC
+// coefficients firstCoeff..lastCoeff (ITU T.81, G.1.2).
+GBool DCTStream::readProgressiveDataUnit(DCTHuffTable *dcHuffTable,
+					 DCTHuffTable *acHuffTable,
+					 int *prevDC, short coefs[64]) {
+  int run, size, amp, bit, p1, m1;
+  int c;
+  int j, k;
+
+  // DC coefficient
+  if (firstCoeff == 0) {
+    if (ah == 0) {
+      size = readHuffSym(dcHuffTable);
+      if (size == 9999)
+	return gFalse;
+      if (size > 0) {
+	amp = readAmp(size);
+	if (amp == 9999)
+	  return gFalse;
+      } else {
+	amp = 0;
+      }
+      coefs[0] = (short)((*prevDC += amp) * (1 << al));
     } else {
-      run += (c >> 4) & 0x0f;
-      size = c & 0x0f;
-      amp = readAmp(size);
-      if (amp == 9999)
+      if ((bit = readBit()) == EOF)
 	return gFalse;
-      i += run;
-      j = dctZigZag[i++];
-      tmp1[j] = amp * quantTable[j];
-    }
-  }
-
-  // inverse DCT on rows
-  for (i = 0; i < 64; i += 8) {
-
-    // stage 4
-    v0 = dctSqrt2 * tmp1[i+0];
-    v1 = dctSqrt2 * tmp1[i+4];
-    v2 = tmp1[i+2];
-    v3 = tmp1[i+6];
-    v4 = dctSqrt1d2 * (tmp1[i+1] - tmp1[i+7]);
-    v7 = dctSqrt1d2 * (tmp1[i+1] + tmp1[i+7]);
-    v5 = tmp1[i+3];
-    v6 = tmp1[i+5];
-
-    // stage 3
-    t = 0.5 * (v0 - v1);
-    v0 = 0.5 * (v0 + v1);
-    v1 = t;
-    t = v2 * dctSin6 + v3 * dctCos6;
-    v2 = v2 * dctCos6 - v3 * dctSin6;
-    v3 = t;
-    t = 0.5 * (v4 - v6);
-    v4 = 0.5 * (v4 + v6);
-    v6 = t;
-    t = 0.5 * (v7 + v5);
-    v5 = 0.5 * (v7 - v5);
-    v7 = t;
-
-    // stage 2
-    t = 0.5 * (v0 - v3);
-    v0 = 0.5 * (v0 + v3);
-    v3 = t;
-    t = 0.5 * (v1 - v2);
-    v1 = 0.5 * (v1 + v2);
-    v2 = t;
-    t = v4 * dctSin3 + v7 * dctCos3;
-    v4 = v4 * dctCos3 - v7 * dctSin3;
-    v7 = t;
-    t = v5 * dctSin1 + v6 * dctCos1;
-    v5 = v5 * dctCos1 - v6 * dctSin1;
-    v6 = t;
-
-    // stage 1
-    tmp1[i+0] = v0 + v7;
-    tmp1[i+7] = v0 - v7;
-    tmp1[i+1] = v1 + v6;
-    tmp1[i+6] = v1 - v6;
-    tmp1[i+2] = v2 + v5;
-    tmp1[i+5] = v2 - v5;
-    tmp1[i+3] = v3 + v4;
-    tmp1[i+4] = v3 - v4;
-  }
-
-  // inverse DCT on columns
-  for (i = 0; i < 8; ++i) {
-
-    // stage 4
-    v0 = dctSqrt2 * tmp1[0*8+i];
-    v1 = dctSqrt2 * tmp1[4*8+i];
-    v2 = tmp1[2*8+i];
-    v3 = tmp1[6*8+i];
-    v4 = dctSqrt1d2 * (tmp1[1*8+i] - tmp1[7*8+i]);
-    v7 = dctSqrt1d2 * (tmp1[1*8+i] + tmp1[7*8+i]);
-    v5 = tmp1[3*8+i];
-    v6 = tmp1[5*8+i];
-
-    // stage 3
-    t = 0.5 * (v0 - v1);
-    v0 = 0.5 * (v0 + v1);
-    v1 = t;
-    t = v2 * dctSin6 + v3 * dctCos6;
-    v2 = v2 * dctCos6 - v3 * dctSin6;
-    v3 = t;
-    t = 0.5 * (v4 - v6);
-    v4 = 0.5 * (v4 + v6);
-    v6 = t;
-    t = 0.5 * (v7 + v5);
-    v5 = 0.5 * (v7 - v5);
-    v7 = t;
-
-    // stage 2
-    t = 0.5 * (v0 - v3);
-    v0 = 0.5 * (v0 + v3);
-    v3 = t;
-    t = 0.5 * (v1 - v2);
-    v1 = 0.5 * (v1 + v2);
-    v2 = t;
-    t = v4 * dctSin3 + v7 * dctCos3;
-    v4 = v4 * dctCos3 - v7 * dctSin3;
-    v7 = t;
-    t = v5 * dctSin1 + v6 * dctCos1;
-    v5 = v5 * dctCos1 - v6 * dctSin1;
-    v6 = t;
-
-    // stage 1
-    tmp1[0*8+i] = v0 + v7;
-    tmp1[7*8+i] = v0 - v7;
-    tmp1[1*8+i] = v1 + v6;
-    tmp1[6*8+i] = v1 - v6;
-    tmp1[2*8+i] = v2 + v5;
-    tmp1[5*8+i] = v2 - v5;
-    tmp1[3*8+i] = v3 + v4;
-    tmp1[4*8+i] = v3 - v4;
-  }
-
-  // convert to 8-bit integers
-  for (i = 0; i < 64; ++i)
-    data[i] = dctClip[dctClipOffset + (int)(tmp1[i] + 128.5)];
+      if (bit)
+	coefs[0] |= 1 << al;
+    }
+    return gTrue;
+  }
 
+  // first pass at AC coefficients
+  if (ah == 0) {
+    if (eobRun > 0) {
+      --eobRun;
+      return gTrue;
+    }
+    k = firstCoeff;
+    while (k <= lastCoeff) {
+      if ((c = readHuffSym(acHuffTable)) == 9999)
+	return gFalse;
+      run = (c >> 4) & 0x0f;
+      size = c & 0x0f;
+      if (size == 0) {
+	if (run < 15) {
+	  eobRun = (1 << run) - 1;
+	  if (run > 0) {
+	    if ((bit = readBits(run)) == EOF)
+	      return gFalse;
+	    eobRun += bit;
+	  }
+	  break;
+	}
+	k += 16;
+      } else {
+	k += run;
+	if (k > 63) {
+	  error(getPos(), "Bad DCT data: too many coefficients");
+	  return gFalse;
+	}
+	amp = readAmp(size);
+	if (amp == 9999)
+	  return gFalse;
+	coefs[dctZigZag[k++]] = (short)(amp * (1 << al));
+      }
+    }
+    return gTrue;
+  }
+
+  // refinement of AC coefficients: one more bit for each one that is
+  // already nonzero, and new coefficients of +/-1 (at this bit
+  // position) in between
+  p1 = 1 << al;
+  m1 = -p1;
+  k = firstCoeff;
+  if (eobRun == 0) {
+    while (k <= lastCoeff) {
+      if ((c = readHuffSym(acHuffTable)) == 9999)
+	return gFalse;
+      run = (c >> 4) & 0x0f;
+      size = c & 0x0f;
+      amp = 0;
+      if (size == 0) {
+	if (run < 15) {
+	  eobRun = 1 << run;
+	  if (run > 0) {
+	    if ((bit = readBits(run)) == EOF)
+	      return gFalse;
+	    eobRun += bit;
+	  }
+	  break;
+	}
+      } else {
+	if ((bit = readBit()) == EOF)
+	  return gFalse;
+	amp = bit ? p1 : m1;
+      }
+      // skip <run> zero coefficients, refining the nonzero ones on the
+      // way, and put the new one (if any) in the next zero position
+      while (k <= lastCoeff) {
+	j = dctZigZag[k];
+	if (coefs[j] != 0) {
+	  if ((bit = readBit()) == EOF)
+	    return gFalse;
+	  if (bit && (coefs[j] & p1) == 0)
+	    coefs[j] += coefs[j] >= 0 ? p1 : m1;
+	} else {
+	  if (run == 0)
+	    break;
+	  --run;
+	}
+	++k;
+      }
+      if (amp != 0 && k <= lastCoeff)
+	coefs[dctZigZag[k]] = (short)amp;
+      ++k;
+    }
+  }
+  if (eobRun > 0) {
+    for (; k <= lastCoeff; ++k) {
+      j = dctZigZag[k];
+      if (coefs[j] != 0) {
+	if ((bit = readBit()) == EOF)
+	  return gFalse;
+	if (bit && (coefs[j] & p1) == 0)
+	  coefs[j] += coefs[j] >= 0 ? p1 : m1;
+      }
+    }
+    --eobRun;
+  }
   return gTrue;
 }
-#endif
 
 int DCTStream::readHuffSym(DCTHuffTable *table) {
   Gushort code;
@@ -2482,8 +3762,9 @@ int DCTStream::readHuffSym(DCTHuffTable *table) {
     code = (code << 1) + bit;
     ++codeBits;
 
-    // look up code
-    if (code - table->firstCode[codeBits] < table->numCodes[codeBits]) {
+    // look up code (code < firstCode only happens with a bad table)
+    if (code >= table->firstCode[codeBits] &&
+	code - table->firstCode[codeBits] < table->numCodes[codeBits]) {
       code -= table->firstCode[codeBits];
       return table->sym[table->firstSym[codeBits] + code];
     }
@@ -2508,6 +3789,19 @@ int DCTStream::readAmp(int size) {
   return amp;
 }
 
+// Read <n> bits as an unsigned number (EOF on error).
+int DCTStream::readBits(int n) {
+  int bits, bit;
+
+  bits = 0;
+  while (n-- > 0) {
+    if ((bit = readBit()) == EOF)
+      return EOF;
+    bits = (bits << 1) + bit;
+  }
+  return bits;
+}
+
 int DCTStream::readBit() {
   int bit;
   int c, c2;
@@ -2534,17 +3828,23 @@ int DCTStream::readBit() {
 
 GBool DCTStream::readHeader() {
   GBool doScan;
-  int minHSample, minVSample;
-  int bufWidth;
+  int bufWidth, mcusX, mcusY;
+  double coefSize;
   int n;
   int c = 0;
   int i, j;
 
+  progressive = gFalse;
   width = height = 0;
+  scaledWidth = scaledHeight = 0;
   numComps = 0;
   numQuantTables = 0;
   numDCHuffTables = 0;
   numACHuffTables = 0;
+  // a scan may name a table that was never defined: make it one with
+  // no codes
+  memset(dcHuffTables, 0, sizeof(dcHuffTables));
+  memset(acHuffTables, 0, sizeof(acHuffTables));
   colorXform = 0;
   gotAdobeMarker = gFalse;
   restartInterval = 0;
@@ -2554,9 +3854,15 @@ GBool DCTStream::readHeader() {
   while (!doScan) {
     c = readMarker();
     switch (c) {
-    case 0xc0:			// SOF0
+    case 0xc0:			// SOF0 (baseline)
+    case 0xc1:			// SOF1 (extended sequential)
+      if (!readFrameInfo())
+	return gFalse;
+      break;
+    case 0xc2:			// SOF2 (progressive)
       if (!readFrameInfo())
 	return gFalse;
+      progressive = gTrue;
       break;
     case 0xc4:			// DHT
       if (!readHuffmanTables())
@@ -2598,31 +3904,88 @@ GBool DCTStream::readHeader() {
     }
   }
 
-  // compute MCU size
-  mcuWidth = minHSample = compInfo[0].hSample;
-  mcuHeight = minVSample = compInfo[0].vSample;
-  for (i = 1; i < numComps; ++i) {
-    if (compInfo[i].hSample < minHSample)
-      minHSample = compInfo[i].hSample;
-    if (compInfo[i].vSample < minVSample)
-      minVSample = compInfo[i].vSample;
+  // compute MCU size; with one component, an MCU is always one data
+  // unit, whatever the sampling factors say
+  if (numComps == 1)
+    compInfo[0].hSample = compInfo[0].vSample = 1;
+  mcuWidth = mcuHeight = 0;
+  for (i = 0; i < numComps; ++i) {
+    if (compInfo[i].hSample < 1 || compInfo[i].hSample > 4 ||
+	compInfo[i].vSample < 1 || compInfo[i].vSample > 4) {
+      error(getPos(), "Bad DCT sampling factors");
+      return gFalse;
+    }
     if (compInfo[i].hSample > mcuWidth)
       mcuWidth = compInfo[i].hSample;
     if (compInfo[i].vSample > mcuHeight)
       mcuHeight = compInfo[i].vSample;
   }
   for (i = 0; i < numComps; ++i) {
-    compInfo[i].hSample /= minHSample;
-    compInfo[i].vSample /= minVSample;
+    if (mcuWidth % compInfo[i].hSample || mcuHeight % compInfo[i].vSample) {
+      error(getPos(), "Unsupported DCT sampling factors");
+      return gFalse;
+    }
+  }
+  mcuWidth *= 8;
+  mcuHeight *= 8;
+  if (width <= 0 || height <= 0) {
+    error(getPos(), "Bad DCT image size");
+    return gFalse;
   }
-  mcuWidth = (mcuWidth / minHSample) * 8;
-  mcuHeight = (mcuHeight / minVSample) * 8;
+
+  // a progressive image, or one whose components come in separate
+  // scans, has to be decoded whole before the first row can be output
+  multiScan = progressive;
+  for (i = 0; i < numComps; ++i) {
+    if (!compInfo[i].inScan)
+      multiScan = gTrue;
+  }
+
+  // size of the decoded image
+  if (scale != 2 && scale != 4 && scale != 8)
+    scale = 1;
+  scaledWidth = (width + scale - 1) / scale;
+  scaledHeight = (height + scale - 1) / scale;
+  scaledMcuHeight = mcuHeight / scale;
 
   // allocate buffers
-  bufWidth = ((width + mcuWidth - 1) / mcuWidth) * mcuWidth;
+  mcusX = (width + mcuWidth - 1) / mcuWidth;
+  mcusY = (height + mcuHeight - 1) / mcuHeight;
+  bufWidth = mcusX * (mcuWidth / scale);
+  if (multiScan) {
+    coefSize = 0;
+    for (i = 0; i < numComps; ++i)
+      coefSize += (double)mcusX * mcusY *
+		  compInfo[i].hSample * compInfo[i].vSample * 64 * sizeof(short);
+    if (coefSize > globalParams->getDCTCoefLimit()) {
+      error(getPos(), "DCT image needs %.0f bytes of coefficients, "
+	    "over the %d byte limit", coefSize,
+	    globalParams->getDCTCoefLimit());
+      return gFalse;
+    }
+    for (i = 0; i < numComps; ++i) {
+      n = mcusX * mcusY * compInfo[i].hSample * compInfo[i].vSample * 64;
+      gfree(coefImage[i]);
+      coefImage[i] = (short *)gmalloc(n * sizeof(short));
+      memset(coefImage[i], 0, n * sizeof(short));
+    }
+  }
+  for (i = 0; i < 4; ++i) {
+    for (j = 0; j < 32; ++j) {
+      gfree(rowBuf[i][j]);
+      rowBuf[i][j] = NULL;
+    }
+  }
   for (i = 0; i < numComps; ++i)
-    for (j = 0; j < mcuHeight; ++j)
+    for (j = 0; j < scaledMcuHeight; ++j)
       rowBuf[i][j] = (Guchar *)gmalloc(bufWidth * sizeof(Guchar));
+  for (i = 0; i < numComps; ++i) {
+    n = mcusX * compInfo[i].hSample * compInfo[i].vSample;
+    gfree(coefBuf[i]);
+    gfree(blockBuf[i]);
+    coefBuf[i] = (int *)gmalloc(n * 64 * sizeof(int));
+    blockBuf[i] = (Guchar *)gmalloc(n * 64 * sizeof(Guchar));
+  }
 
   // figure out color transform
   if (!gotAdobeMarker && numComps == 3) {
@@ -2635,7 +3998,7 @@ GBool DCTStream::readHeader() {
   comp = 0;
   x = 0;
   y = 0;
-  dy = mcuHeight;
+  dy = scaledMcuHeight;
 
   return gTrue;
 }
@@ -2656,6 +4019,11 @@ GBool DCTStream::readFrameInfo() {
     error(getPos(), "Bad DCT precision %d", prec);
     return gFalse;
   }
+  if (numComps <= 0 || numComps > 4) {
+    error(getPos(), "Bad number of components in DCT stream");
+    numComps = 0;
+    return gFalse;
+  }
   for (i = 0; i < numComps; ++i) {
     compInfo[i].id = str->getChar();
     compInfo[i].inScan = gFalse;
@@ -2665,6 +4033,15 @@ GBool DCTStream::readFrameInfo() {
     compInfo[i].quantTable = str->getChar();
     compInfo[i].dcHuffTable = 0;
     compInfo[i].acHuffTable = 0;
+    if (compInfo[i].hSample < 1 || compInfo[i].hSample > 4 ||
+	compInfo[i].vSample < 1 || compInfo[i].vSample > 4) {
+      error(getPos(), "Bad DCT sampling factor");
+      return gFalse;
+    }
+    if (compInfo[i].quantTable < 0 || compInfo[i].quantTable > 3) {
+      error(getPos(), "Bad DCT quant table selector");
+      return gFalse;
+    }
   }
   return gTrue;
 }
@@ -2681,6 +4058,8 @@ GBool DCTStream::readScanInfo() {
     error(getPos(), "Bad DCT scan info block");
     return gFalse;
   }
+  for (j = 0; j < numComps; ++j)
+    compInfo[j].inScan = gFalse;
   for (i = 0; i < scanComps; ++i) {
     id = str->getChar();
     for (j = 0; j < numComps; ++j) {
@@ -2695,10 +4074,28 @@ GBool DCTStream::readScanInfo() {
     c = str->getChar();
     compInfo[j].dcHuffTable = (c >> 4) & 0x0f;
     compInfo[j].acHuffTable = c & 0x0f;
+    if (compInfo[j].dcHuffTable >= 4 || compInfo[j].acHuffTable >= 4) {
+      error(getPos(), "Bad DCT Huffman table number in scan info block");
+      return gFalse;
+    }
+  }
+  firstCoeff = str->getChar();
+  lastCoeff = str->getChar();
+  c = str->getChar();
+  ah = (c >> 4) & 0x0f;
+  al = c & 0x0f;
+  if (progressive) {
+    if (firstCoeff < 0 || lastCoeff > 63 || firstCoeff > lastCoeff ||
+	(firstCoeff == 0 && lastCoeff != 0) ||
+	(firstCoeff > 0 && scanComps != 1) || c < 0 || al > 13) {
+      error(getPos(), "Bad DCT progressive scan parameters");
+      return gFalse;
+    }
+  } else {
+    firstCoeff = 0;
+    lastCoeff = 63;
+    ah = al = 0;
   }
-  str->getChar();
-  str->getChar();
-  str->getChar();
   return gTrue;
 }
 
@@ -2729,6 +4126,7 @@ GBool DCTStream::readHuffmanTables() {
   int index;
   Gushort code;
   Guchar sym;
+  int nSyms;
   int i;
   int c;
 
@@ -2736,7 +4134,7 @@ GBool DCTStream::readHuffmanTables() {
   while (length > 0) {
     index = str->getChar();
     --length;
-    if ((index & 0x0f) >= 4) {
+    if ((index & 0xe0) || (index & 0x0f) >= 4) {
       error(getPos(), "Bad DCT Huffman table");
       return gFalse;
     }
@@ -2752,18 +4150,25 @@ GBool DCTStream::readHuffmanTables() {
     }
     sym = 0;
     code = 0;
+    nSyms = 0;
     for (i = 1; i <= 16; ++i) {
       c = str->getChar();
       tbl->firstSym[i] = sym;
       tbl->firstCode[i] = code;
       tbl->numCodes[i] = c;
       sym += c;
+      nSyms += c;
       code = (code + c) << 1;
     }
+    // more than 256 symbols would index past <sym>
+    if (nSyms < 0 || nSyms > 256) {
+      error(getPos(), "Bad DCT Huffman table");
+      return gFalse;
+    }
     length -= 16;
-    for (i = 0; i < sym; ++i)
+    for (i = 0; i < nSyms; ++i)
       tbl->sym[i] = str->getChar();
-    length -= sym;
+    length -= nSyms;
   }
   return gTrue;
 }
@@ -2821,7 +4226,7 @@ int DCTStream::readMarker() {
   do {
     do {
       c = str->getChar();
-    } while (c != 0xff);
+    } while (c != 0xff && c != EOF);
     do {
       c = str->getChar();
     } while (c == 0xff);
@@ -2934,9 +4339,18 @@ FlateStream::FlateStream(Stream *strA, int predictor, int columns,
   } else {
     pred = NULL;
   }
+  litCodeTab.codes = NULL;
+  litCodeTab.size = 0;
+  distCodeTab.codes = NULL;
+  distCodeTab.size = 0;
+  codeLenCodeTab.codes = NULL;
+  codeLenCodeTab.size = 0;
 }
 
 FlateStream::~FlateStream() {
+  gfree(litCodeTab.codes);
+  gfree(distCodeTab.codes);
+  gfree(codeLenCodeTab.codes);
   if (pred) {
     delete pred;
   }
@@ -2948,6 +4362,7 @@ void FlateStream::reset() {
 
   index = 0;
   remain = 0;
+  inPtr = inEnd = inBuf;
   codeBuf = 0;
   codeSize = 0;
   compressedBlock = gFalse;
@@ -2959,8 +4374,8 @@ void FlateStream::reset() {
   // read header
   //~ need to look at window size?
   endOfBlock = eof = gTrue;
-  cmf = str->getChar();
-  flg = str->getChar();
+  cmf = getInputByte();
+  flg = getInputByte();
   if (cmf == EOF || flg == EOF)
     return;
   if ((cmf & 0x0f) != 0x08) {
@@ -3025,6 +4440,33 @@ int FlateStream::getRawChar() {
   return c;
 }
 
+int FlateStream::getBlock(char *blk, int size) {
+  int n, k;
+
+  if (pred) {
+    return Stream::getBlock(blk, size);
+  }
+  n = 0;
+  while (n < size) {
+    if (remain == 0) {
+      if (endOfBlock && eof)
+	break;
+      readSome();
+      continue;
+    }
+    k = flateWindow - index;
+    if (k > remain)
+      k = remain;
+    if (k > size - n)
+      k = size - n;
+    memcpy(blk + n, buf + index, k);
+    index = (index + k) & flateMask;
+    remain -= k;
+    n += k;
+  }
+  return n;
+}
+
 GString *FlateStream::getPSFilter(char *indent) {
   return NULL;
 }
@@ -3033,28 +4475,57 @@ GBool FlateStream::isBinary(GBool last) {
   return str->isBinary(gTrue);
 }
 
+// Copy a <len> byte match from <dist> bytes back.  Both the source and
+// the destination must be contiguous.  If they overlap, the pattern
+// repeats every <dist> bytes, and each copy doubles the part that can
+// be copied without overlap.
+static inline void flateCopyMatch(Guchar *dst, int dist, int len) {
+  int n;
+
+  if (dist == 1) {
+    memset(dst, dst[-1], len);
+    return;
+  }
+  while (len > 0) {
+    n = (len < dist) ? len : dist;
+    memcpy(dst, dst - dist, n);
+    dst += n;
+    len -= n;
+    dist += n;
+  }
+}
+
+// Decode until the end of the block, or until the output buffer can't
+// take a maximum length match.
 void FlateStream::readSome() {
   int code1, code2;
   int len, dist;
-  int i, j, k;
-  int c;
+  int wr, i, j, k, n;
 
   if (endOfBlock) {
     if (!startBlock())
       return;
   }
 
+  wr = (index + remain) & flateMask;
+
   if (compressedBlock) {
-    if ((code1 = getHuffmanCodeWord(&litCodeTab)) == EOF)
-      goto err;
-    if (code1 < 256) {
-      buf[index] = code1;
-      remain = 1;
-    } else if (code1 == 256) {
-      endOfBlock = gTrue;
-      remain = 0;
-    } else {
+    while (remain <= flateWindow - flateMaxMatch) {
+      if ((code1 = getHuffmanCodeWord(&litCodeTab)) == EOF)
+	goto err;
+      if (code1 < 256) {
+	buf[wr] = (Guchar)code1;
+	wr = (wr + 1) & flateMask;
+	++remain;
+	continue;
+      }
+      if (code1 == 256) {
+	endOfBlock = gTrue;
+	break;
+      }
       code1 -= 257;
+      if (code1 >= flateMaxLitCodes - 259)
+	goto err;
       code2 = lengthDecode[code1].bits;
       if (code2 > 0 && (code2 = getCodeWord(code2)) == EOF)
 	goto err;
@@ -3065,27 +4536,40 @@ void FlateStream::readSome() {
       if (code2 > 0 && (code2 = getCodeWord(code2)) == EOF)
 	goto err;
       dist = distDecode[code1].first + code2;
-      i = index;
-      j = (index - dist) & flateMask;
-      for (k = 0; k < len; ++k) {
-	buf[i] = buf[j];
-	i = (i + 1) & flateMask;
-	j = (j + 1) & flateMask;
+      j = wr - dist;
+      if (j >= 0 && wr + len <= flateWindow) {
+	flateCopyMatch(buf + wr, dist, len);
+      } else if (j < 0 && j + len <= 0 && j + flateWindow >= wr + len) {
+	// source wrapped around, but doesn't touch the destination
+	memcpy(buf + wr, buf + j + flateWindow, len);
+      } else {
+	j &= flateMask;
+	for (k = 0, i = wr; k < len; ++k) {
+	  buf[i] = buf[j];
+	  i = (i + 1) & flateMask;
+	  j = (j + 1) & flateMask;
+	}
       }
-      remain = len;
+      wr = (wr + len) & flateMask;
+      remain += len;
     }
 
   } else {
-    len = (blockLen < flateWindow) ? blockLen : flateWindow;
-    for (i = 0, j = index; i < len; ++i, j = (j + 1) & flateMask) {
-      if ((c = str->getChar()) == EOF) {
+    len = flateWindow - remain;
+    if (len > blockLen)
+      len = blockLen;
+    for (k = 0; k < len; k += n) {
+      n = flateWindow - wr;
+      if (n > len - k)
+	n = len - k;
+      if ((n = getInputBlock(buf + wr, n)) == 0) {
 	endOfBlock = eof = gTrue;
 	break;
       }
-      buf[j] = c & 0xff;
+      wr = (wr + n) & flateMask;
     }
-    remain = i;
-    blockLen -= len;
+    remain += k;
+    blockLen -= k;
     if (blockLen == 0)
       endOfBlock = gTrue;
   }
@@ -3095,7 +4579,6 @@ void FlateStream::readSome() {
 err:
   error(getPos(), "Unexpected end of file in flate stream");
   endOfBlock = eof = gTrue;
-  remain = 0;
 }
 
 GBool FlateStream::startBlock() {
@@ -3112,22 +4595,17 @@ GBool FlateStream::startBlock() {
   // uncompressed block
   if (blockHdr == 0) {
     compressedBlock = gFalse;
-    if ((c = str->getChar()) == EOF)
-      goto err;
-    blockLen = c & 0xff;
-    if ((c = str->getChar()) == EOF)
+    // skip to a byte boundary
+    codeBuf >>= codeSize & 7;
+    codeSize &= ~7;
+    if ((c = getCodeWord(16)) == EOF)
       goto err;
-    blockLen |= (c & 0xff) << 8;
-    if ((c = str->getChar()) == EOF)
-      goto err;
-    check = c & 0xff;
-    if ((c = str->getChar()) == EOF)
+    blockLen = c;
+    if ((c = getCodeWord(16)) == EOF)
       goto err;
-    check |= (c & 0xff) << 8;
+    check = c;
     if (check != (~blockLen & 0xffff))
       error(getPos(), "Bad uncompressed block length in flate stream");
-    codeBuf = 0;
-    codeSize = 0;
 
   // compressed block with fixed codes
   } else if (blockHdr == 1) {
@@ -3155,43 +4633,33 @@ err:
 }
 
 void FlateStream::loadFixedCodes() {
+  int lengths[flateMaxLitCodes];
   int i;
 
-  // set up code arrays
-  litCodeTab.codes = allCodes;
-  distCodeTab.codes = allCodes + flateMaxLitCodes;
-
-  // initialize literal code table
+  // literal code table
   for (i = 0; i <= 143; ++i)
-    litCodeTab.codes[i].len = 8;
+    lengths[i] = 8;
   for (i = 144; i <= 255; ++i)
-    litCodeTab.codes[i].len = 9;
+    lengths[i] = 9;
   for (i = 256; i <= 279; ++i)
-    litCodeTab.codes[i].len = 7;
+    lengths[i] = 7;
   for (i = 280; i <= 287; ++i)
-    litCodeTab.codes[i].len = 8;
-  compHuffmanCodes(&litCodeTab, flateMaxLitCodes);
+    lengths[i] = 8;
+  compHuffmanCodes(lengths, flateMaxLitCodes, &litCodeTab, flateLitTabBits);
 
-  // initialize distance code table
-  for (i = 0; i <= 5; ++i) {
-    distCodeTab.start[i] = 0;
-  }
-  for (i = 6; i <= flateMaxHuffman+1; ++i) {
-    distCodeTab.start[i] = flateMaxDistCodes;
-  }
-  for (i = 0; i < flateMaxDistCodes; ++i) {
-    distCodeTab.codes[i].len = 5;
-    distCodeTab.codes[i].code = i;
-    distCodeTab.codes[i].val = i;
-  }
+  // distance code table
+  for (i = 0; i < flateMaxDistCodes; ++i)
+    lengths[i] = 5;
+  compHuffmanCodes(lengths, flateMaxDistCodes, &distCodeTab,
+		   flateDistTabBits);
 }
 
 GBool FlateStream::readDynamicCodes() {
   int numCodeLenCodes;
   int numLitCodes;
   int numDistCodes;
-  FlateCode codeLenCodes[flateMaxCodeLenCodes];
-  FlateHuffmanTab codeLenCodeTab;
+  int codeLenCodeLengths[flateMaxCodeLenCodes];
+  int lengths[flateMaxLitCodes + flateMaxDistCodes];
   int len, repeat, code;
   int i;
 
@@ -3211,18 +4679,15 @@ GBool FlateStream::readDynamicCodes() {
     goto err;
 
   // read code length code table
-  codeLenCodeTab.codes = codeLenCodes;
   for (i = 0; i < flateMaxCodeLenCodes; ++i)
-    codeLenCodes[i].len = 0;
+    codeLenCodeLengths[i] = 0;
   for (i = 0; i < numCodeLenCodes; ++i) {
-    if ((codeLenCodes[codeLenCodeMap[i]].len = getCodeWord(3)) == -1)
+    if ((codeLenCodeLengths[codeLenCodeMap[i]] = getCodeWord(3)) == -1)
       goto err;
   }
-  compHuffmanCodes(&codeLenCodeTab, flateMaxCodeLenCodes);
-
-  // set up code arrays
-  litCodeTab.codes = allCodes;
-  distCodeTab.codes = allCodes + numLitCodes;
+  if (!compHuffmanCodes(codeLenCodeLengths, flateMaxCodeLenCodes,
+			&codeLenCodeTab, flateCodeLenTabBits))
+    goto err;
 
   // read literal and distance code tables
   len = 0;
@@ -3234,26 +4699,30 @@ GBool FlateStream::readDynamicCodes() {
     if (code == 16) {
       if ((repeat = getCodeWord(2)) == EOF)
 	goto err;
-      for (repeat += 3; repeat > 0; --repeat)
-	allCodes[i++].len = len;
+      repeat += 3;
     } else if (code == 17) {
       if ((repeat = getCodeWord(3)) == EOF)
 	goto err;
+      repeat += 3;
       len = 0;
-      for (repeat += 3; repeat > 0; --repeat)
-	allCodes[i++].len = 0;
     } else if (code == 18) {
       if ((repeat = getCodeWord(7)) == EOF)
 	goto err;
+      repeat += 11;
       len = 0;
-      for (repeat += 11; repeat > 0; --repeat)
-	allCodes[i++].len = 0;
     } else {
-      allCodes[i++].len = len = code;
+      repeat = 1;
+      len = code;
     }
+    if (i + repeat > numLitCodes + numDistCodes)
+      goto err;
+    for (; repeat > 0; --repeat)
+      lengths[i++] = len;
   }
-  compHuffmanCodes(&litCodeTab, numLitCodes);
-  compHuffmanCodes(&distCodeTab, numDistCodes);
+  if (!compHuffmanCodes(lengths, numLitCodes, &litCodeTab, flateLitTabBits) ||
+      !compHuffmanCodes(lengths + numLitCodes, numDistCodes, &distCodeTab,
+			flateDistTabBits))
+    goto err;
 
   return gTrue;
 
@@ -3262,28 +4731,33 @@ err:
   return gFalse;
 }
 
-// On entry, the <tab->codes> array contains the lengths of each code,
-// stored in code value order.  This function computes the code words.
-// The result is sorted in order of (1) code length and (2) code word.
-// The length values are no longer valid.  The <tab->start> array is
-// filled with the indexes of the first code of each length.
-void FlateStream::compHuffmanCodes(FlateHuffmanTab *tab, int n) {
+// Build the decoding table for the code with the code lengths in
+// <lengths>[0 .. <n>-1] (code length 0 = value not used), with a
+// primary table of (at most) <tabBits> bits.  Returns false if the
+// lengths are over-subscribed.  An incomplete code is fine -- the
+// missing codes come out as invalid (len 0) entries.
+GBool FlateStream::compHuffmanCodes(int *lengths, int n,
+				    FlateHuffmanTab *tab, int tabBits) {
   int numLengths[flateMaxHuffman+1];
   int nextCode[flateMaxHuffman+1];
-  int nextIndex[flateMaxHuffman+2];
-  int code;
+  int subBits[1 << flateLitTabBits];
+  int subStart[1 << flateLitTabBits];
+  int codes[flateMaxLitCodes];
+  int maxLen, bits, size, len, code, rev, prefix;
   int i, j;
 
   // count number of codes for each code length
   for (i = 0; i <= flateMaxHuffman; ++i)
     numLengths[i] = 0;
-  for (i = 0; i < n; ++i)
-    ++numLengths[tab->codes[i].len];
-
-  // compute first index for each length
-  tab->start[0] = nextIndex[0] = 0;
-  for (i = 1; i <= flateMaxHuffman + 1; ++i)
-    tab->start[i] = nextIndex[i] = tab->start[i-1] + numLengths[i-1];
+  maxLen = 0;
+  for (i = 0; i < n; ++i) {
+    ++numLengths[lengths[i]];
+    if (lengths[i] > maxLen)
+      maxLen = lengths[i];
+  }
+  bits = (maxLen < tabBits) ? maxLen : tabBits;
+  if (bits == 0)
+    bits = 1;
 
   // compute first code for each length
   code = 0;
@@ -3291,69 +4765,156 @@ void FlateStream::compHuffmanCodes(FlateHuffmanTab *tab, int n) {
   for (i = 1; i <= flateMaxHuffman; ++i) {
     code = (code + numLengths[i-1]) << 1;
     nextCode[i] = code;
+    if (code + numLengths[i] > (1 << i))
+      return gFalse;
   }
 
-  // compute the codes -- this permutes the codes array from value
-  // order to length/code order
+  // assign the codes (bit-reversed, since Huffman codes are packed
+  // starting with their most significant bit), and size the sub
+  // tables: each one is indexed by the bits after the primary table
+  // bits, as many as the longest code that goes through it needs
+  for (i = 0; i < (1 << bits); ++i)
+    subBits[i] = 0;
   for (i = 0; i < n; ++i) {
-    j = nextIndex[tab->codes[i].len]++;
-    if (tab->codes[i].len == 0)
-      tab->codes[j].code = 0;
-    else
-      tab->codes[j].code = nextCode[tab->codes[i].len]++;
-    tab->codes[j].val = i;
+    if ((len = lengths[i]) == 0)
+      continue;
+    code = nextCode[len]++;
+    for (rev = 0, j = 0; j < len; ++j) {
+      rev = (rev << 1) | (code & 1);
+      code >>= 1;
+    }
+    codes[i] = rev;
+    if (len > bits) {
+      prefix = rev & ((1 << bits) - 1);
+      if (len - bits > subBits[prefix])
+	subBits[prefix] = len - bits;
+    }
+  }
+  size = 1 << bits;
+  for (i = 0; i < (1 << bits); ++i) {
+    subStart[i] = size;
+    if (subBits[i])
+      size += 1 << subBits[i];
+  }
+
+  // allocate and clear the table
+  if (size > tab->size) {
+    tab->codes = (FlateCode *)grealloc(tab->codes, size * sizeof(FlateCode));
+    tab->size = size;
+  }
+  memset(tab->codes, 0, size * sizeof(FlateCode));
+  tab->bits = bits;
+
+  // fill in the entries: a code shorter than the table index shows up
+  // at every index that starts with it
+  for (i = 0; i < (1 << bits); ++i) {
+    if (subBits[i]) {
+      tab->codes[i].len = (Guchar)subBits[i];
+      tab->codes[i].link = 1;
+      tab->codes[i].val = (Gushort)subStart[i];
+    }
   }
+  for (i = 0; i < n; ++i) {
+    if ((len = lengths[i]) == 0)
+      continue;
+    rev = codes[i];
+    if (len <= bits) {
+      for (j = rev; j < (1 << bits); j += 1 << len) {
+	tab->codes[j].len = (Guchar)len;
+	tab->codes[j].val = (Gushort)i;
+      }
+    } else {
+      prefix = rev & ((1 << bits) - 1);
+      for (j = rev >> bits; j < (1 << subBits[prefix]);
+	   j += 1 << (len - bits)) {
+	tab->codes[subStart[prefix] + j].len = (Guchar)len;
+	tab->codes[subStart[prefix] + j].val = (Gushort)i;
+      }
+    }
+  }
+  return gTrue;
 }
 
 int FlateStream::getHuffmanCodeWord(FlateHuffmanTab *tab) {
-  int len;
-  int code;
+  FlateCode *code;
   int c;
-  int i, j;
-
-  code = 0;
-  for (len = 1; len <= flateMaxHuffman; ++len) {
-
-    // add a bit to the code
-    if (codeSize == 0) {
-      if ((c = str->getChar()) == EOF)
-	return EOF;
-      codeBuf = c & 0xff;
-      codeSize = 8;
-    }
-    code = (code << 1) | (codeBuf & 1);
-    codeBuf >>= 1;
-    --codeSize;
 
-    // look for code
-    i = tab->start[len];
-    j = tab->start[len + 1];
-    if (i < j && code >= tab->codes[i].code && code <= tab->codes[j-1].code) {
-      i += code - tab->codes[i].code;
-      return tab->codes[i].val;
-    }
+  // load enough bits for the longest code (or whatever is left)
+  while (codeSize < flateMaxHuffman) {
+    if ((c = getInputByte()) == EOF)
+      break;
+    codeBuf |= (Gulong)c << codeSize;
+    codeSize += 8;
   }
 
-  // not found
-  error(getPos(), "Bad code (%04x) in flate stream", code);
-  return EOF;
+  code = &tab->codes[codeBuf & ((1 << tab->bits) - 1)];
+  if (code->link) {
+    code = &tab->codes[code->val +
+		       ((codeBuf >> tab->bits) & ((1 << code->len) - 1))];
+  }
+  if (code->len == 0 || code->len > codeSize) {
+    if (codeSize == 0)
+      return EOF;
+    error(getPos(), "Bad code (%04x) in flate stream",
+	  (int)(codeBuf & 0x7fff));
+    return EOF;
+  }
+  codeBuf >>= code->len;
+  codeSize -= code->len;
+  return code->val;
 }
 
 int FlateStream::getCodeWord(int bits) {
   int c;
 
   while (codeSize < bits) {
-    if ((c = str->getChar()) == EOF)
+    if ((c = getInputByte()) == EOF)
       return EOF;
-    codeBuf |= (c & 0xff) << codeSize;
+    codeBuf |= (Gulong)c << codeSize;
     codeSize += 8;
   }
-  c = codeBuf & ((1 << bits) - 1);
+  c = (int)(codeBuf & ((1 << bits) - 1));
   codeBuf >>= bits;
   codeSize -= bits;
   return c;
 }
 
+GBool FlateStream::fillInput() {
+  int n;
+
+  if ((n = str->getBlock((char *)inBuf, flateInBufSize)) <= 0) {
+    inPtr = inEnd = inBuf;
+    return gFalse;
+  }
+  inPtr = inBuf;
+  inEnd = inBuf + n;
+  return gTrue;
+}
+
+// Read up to <size> bytes of a stored block (which starts on a byte
+// boundary).  Returns 0 only at end of input.
+int FlateStream::getInputBlock(Guchar *blk, int size) {
+  int n;
+
+  // bytes already in the bit buffer come first
+  n = 0;
+  while (codeSize >= 8 && n < size) {
+    blk[n++] = (Guchar)(codeBuf & 0xff);
+    codeBuf >>= 8;
+    codeSize -= 8;
+  }
+  if (n == size)
+    return n;
+  if (inPtr >= inEnd && !fillInput())
+    return n;
+  if (inEnd - inPtr < size - n) {
+    size = n + (inEnd - inPtr);
+  }
+  memcpy(blk + n, inPtr, size - n);
+  inPtr += size - n;
+  return size;
+}
+
 //------------------------------------------------------------------------
 // EOFStream
 //------------------------------------------------------------------------
@@ -17,7 +17,7 @@
 #include "../goo/gtypes.h"
 
 #ifndef NO_DECRYPTION
-class Decrypt;
+#include "Decrypt.h"
 #endif
 class GString;
 class Dict;
@@ -73,6 +73,11 @@ public:
   // This is only used by StreamPredictor.
   virtual int getRawChar();
 
+  // Read up to <size> chars into <blk>.  Returns the number of chars
+  // read, which may be less than <size> (but not 0) before the end of
+  // the stream.
+  virtual int getBlock(char *blk, int size);
+
   // Get next line from stream.
   virtual char *getLine(char *buf, int size);
 
@@ -133,20 +138,22 @@ public:
   virtual void moveStart(int delta) = 0;
 
 #ifndef NO_DECRYPTION
-  // Set decryption for this stream.
-  virtual void doDecryption(Guchar *fileKey, int keyLength,
-			    int objNum, int objGen);
-#endif
-
-#ifndef NO_DECRYPTION
-protected:
-
-  Decrypt *decrypt;
+  // Set decryption for this stream.  This must be done before
+  // addFilters, which puts a DecryptStream at the bottom of the
+  // filter chain.
+  void doDecryption(Guchar *fileKey, int keyLength, CryptAlgorithm alg,
+		    int objNum, int objGen);
+
+  // Get the decryptor set by doDecryption, or NULL.
+  Decrypt *getDecrypt() { return decrypt; }
 #endif
 
 private:
 
   Object *dict;
+#ifndef NO_DECRYPTION
+  Decrypt *decrypt;
+#endif
 };
 
 //------------------------------------------------------------------------
@@ -192,6 +199,12 @@ public:
   // at least nComps elements.  Returns false at end of file.
   GBool getPixel(Guchar *pix);
 
+  // Gets the next line from the stream: width * nComps components,
+  // unpacked to one byte each (16-bit components are cut to their
+  // high byte).  The buffer belongs to the ImageStream and is reused
+  // for the next line.
+  Guchar *getLine();
+
   // Skip an entire line from the image.
   void skipLine();
 
@@ -202,7 +215,9 @@ private:
   int nComps;			// components per pixel
   int nBits;			// bits per component
   int nVals;			// components per line
+  int lineSize;			// bytes per line
   Guchar *imgLine;		// line buffer
+  Guchar *lineBuf;		// raw (packed) line buffer
   int imgIdx;			// current index in imgLine
 };
 
@@ -260,6 +275,7 @@ public:
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
   virtual int lookChar()
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  virtual int getBlock(char *blk, int size);
   virtual int getPos() { return bufPos + (bufPtr - buf); }
   virtual void setPos(Guint pos, int dir = 0);
   virtual GBool isBinary(GBool last = gTrue) { return last; }
@@ -300,25 +316,67 @@ public:
     { return (bufPtr < bufEnd) ? (*bufPtr++ & 0xff) : EOF; }
   virtual int lookChar()
     { return (bufPtr < bufEnd) ? (*bufPtr & 0xff) : EOF; }
+  virtual int getBlock(char *blk, int size);
   virtual int getPos() { return bufPtr - buf; }
   virtual void setPos(Guint pos, int dir = 0);
   virtual GBool isBinary(GBool last = gTrue) { return last; }
   virtual Guint getStart() { return 0; }
   virtual void moveStart(int delta);
-#ifndef NO_DECRYPTION
-  virtual void doDecryption(Guchar *fileKey, int keyLength,
-			    int objNum, int objGen);
-#endif
 
 private:
 
   char *buf;
   Guint length;
-  GBool needFree;
   char *bufEnd;
   char *bufPtr;
 };
 
+//------------------------------------------------------------------------
+// MmapStream
+//
+// This reads from a file which has been mapped into memory (the
+// mapping is owned by the creator, e.g., PDFDoc).  Unlike MemStream,
+// positions are file offsets, so it can stand in for a FileStream;
+// sub-streams share the mapping and are just pointer ranges into it.
+//------------------------------------------------------------------------
+
+class MmapStream: public BaseStream {
+public:
+
+  MmapStream(char *mapA, Guint mapLenA, Guint startA, GBool limitedA,
+	     Guint lengthA, Object *dictA);
+  virtual ~MmapStream();
+  virtual Stream *makeSubStream(Guint startA, GBool limitedA,
+				Guint lengthA, Object *dictA);
+  virtual StreamKind getKind() { return strFile; }
+  virtual void reset();
+  virtual void close();
+  virtual int getChar()
+    { return (bufPtr < bufEnd) ? (*bufPtr++ & 0xff) : EOF; }
+  virtual int lookChar()
+    { return (bufPtr < bufEnd) ? (*bufPtr & 0xff) : EOF; }
+  virtual int getBlock(char *blk, int size);
+  virtual int getPos() { return bufPos + (bufPtr - buf); }
+  virtual void setPos(Guint pos, int dir = 0);
+  virtual GBool isBinary(GBool last = gTrue) { return last; }
+  virtual Guint getStart() { return start; }
+  virtual void moveStart(int delta);
+
+private:
+
+  void setBuf();
+
+  char *map;			// start of the mapped file
+  Guint mapLen;			// length of the mapped file
+  Guint start;
+  GBool limited;
+  Guint length;
+  char *buf;			// start of the readable range
+  char *bufEnd;			// end of the readable range
+  char *bufPtr;			// next char to read
+  Guint bufPos;			// file offset of <buf>
+};
+
 //------------------------------------------------------------------------
 // EmbedStream
 //
@@ -340,6 +398,7 @@ public:
   virtual void reset() {}
   virtual int getChar() { return str->getChar(); }
   virtual int lookChar() { return str->lookChar(); }
+  virtual int getBlock(char *blk, int size);
   virtual int getPos() { return str->getPos(); }
   virtual void setPos(Guint pos, int dir = 0);
   virtual GBool isBinary(GBool last = gTrue) { return last; }
@@ -351,6 +410,47 @@ private:
   Stream *str;
 };
 
+#ifndef NO_DECRYPTION
+//------------------------------------------------------------------------
+// DecryptStream
+//
+// This decrypts the data of an encrypted stream, a buffer at a time.
+// Stream::addFilters puts it between the base stream and the first
+// filter.  RC4 is decrypted in place; AES reads into a separate
+// buffer, since it holds back the last block and strips the padding.
+//------------------------------------------------------------------------
+
+#define decryptStreamBufSize 1024
+
+class DecryptStream: public FilterStream {
+public:
+
+  DecryptStream(Stream *strA, Decrypt *decryptA);
+  virtual ~DecryptStream();
+  virtual StreamKind getKind() { return strWeird; }
+  virtual void reset();
+  virtual int getChar()
+    { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
+  virtual int lookChar()
+    { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  virtual int getBlock(char *blk, int size);
+  virtual int getPos() { return str->getPos() - (bufEnd - bufPtr); }
+  virtual GString *getPSFilter(char *indent) { return NULL; }
+  virtual GBool isBinary(GBool last = gTrue) { return str->isBinary(last); }
+
+private:
+
+  GBool fillBuf();
+
+  Decrypt *decrypt;		// the base stream's decryptor
+  char buf[decryptStreamBufSize + 32];	// decrypted data
+  char *bufPtr;
+  char *bufEnd;
+  char rawBuf[decryptStreamBufSize];	// AES cipher text
+  GBool eof;			// set once the base stream is used up
+};
+#endif
+
 //------------------------------------------------------------------------
 // ASCIIHexStream
 //------------------------------------------------------------------------
@@ -534,6 +634,15 @@ struct DCTHuffTable {
   Guchar sym[256];		// symbols
 };
 
+// Implementations of the DCT decoder's inner loops (inverse DCT and
+// YCbCr to RGB conversion).
+enum DCTKernel {
+  dctKernelAuto,		// the fastest one this CPU supports
+  dctKernelScalar,
+  dctKernelSSE2,
+  dctKernelAVX2
+};
+
 class DCTStream: public FilterStream {
 public:
 
@@ -543,16 +652,38 @@ public:
   virtual void reset();
   virtual int getChar();
   virtual int lookChar();
+  virtual int getBlock(char *blk, int size);
   virtual GString *getPSFilter(char *indent);
   virtual GBool isBinary(GBool last = gTrue);
   Stream *getRawStream() { return str; }
 
+  // Decode the image at 1/<scaleA> of its size (<scaleA> = 1, 2, 4 or
+  // 8), with a reduced inverse DCT.  Takes effect at the next reset().
+  void setScale(int scaleA) { scale = scaleA; }
+
+  // Select the inner loops used by all DCTStreams.  They all give the
+  // same output; this is for benchmarks and tests, and must not be
+  // called while a DCTStream is being read.  Returns false, and
+  // changes nothing, if this build or CPU doesn't support <kernel>.
+  static GBool setKernel(DCTKernel kernel);
+
+  // Return the inner loops in use (never dctKernelAuto).
+  static DCTKernel getKernel();
+
 private:
 
+  GBool progressive;		// set if in progressive mode
+  GBool multiScan;		// set if the image comes in several scans
   int width, height;		// image size
   int mcuWidth, mcuHeight;	// size of min coding unit, in data units
+  int scale;			// image is decoded at 1/scale of its size
+  int scaledWidth, scaledHeight; // size of the decoded image
+  int scaledMcuHeight;		// height of an MCU in the decoded image
   DCTCompInfo compInfo[4];	// info for each component
   int numComps;			// number of components in image
+  int firstCoeff, lastCoeff;	// spectral selection of the current scan
+  int ah, al;			// successive approximation of the current scan
+  int eobRun;			// number of EOBs left in the current run
   int colorXform;		// need YCbCr-to-RGB transform?
   GBool gotAdobeMarker;		// set if APP14 Adobe marker was present
   int restartInterval;		// restart interval, in MCUs
@@ -563,6 +694,10 @@ private:
   int numDCHuffTables;		// number of DC Huffman tables
   int numACHuffTables;		// number of AC Huffman tables
   Guchar *rowBuf[4][32];	// buffer for one MCU
+  int *coefBuf[4];		// coefficients for one MCU row
+  short *coefImage[4];		// coefficients for the whole image, laid
+				//   out like coefBuf (multiScan only)
+  Guchar *blockBuf[4];		// transformed data units for one MCU row
   int comp, x, y, dy;		// current position within image/MCU
   int restartCtr;		// MCUs left until restart
   int restartMarker;		// next restart marker
@@ -572,9 +707,16 @@ private:
   void restart();
   GBool readMCURow();
   GBool readDataUnit(DCTHuffTable *dcHuffTable, DCTHuffTable *acHuffTable,
-		     Guchar quantTable[64], int *prevDC, Guchar data[64]);
+		     int *prevDC, int coefs[64]);
+  void readScans();
+  GBool readScan();
+  GBool readScanDataUnit(int cc, short coefs[64]);
+  GBool readProgressiveDataUnit(DCTHuffTable *dcHuffTable,
+				DCTHuffTable *acHuffTable,
+				int *prevDC, short coefs[64]);
   int readHuffSym(DCTHuffTable *table);
   int readAmp(int size);
+  int readBits(int n);
   int readBit();
   GBool readHeader();
   GBool readFrameInfo();
@@ -598,18 +740,28 @@ private:
 #define flateMaxCodeLenCodes    19    // max # code length codes
 #define flateMaxLitCodes       288    // max # literal codes
 #define flateMaxDistCodes       30    // max # distance codes
+#define flateMaxMatch          258    // max match length
+#define flateLitTabBits          9    // primary table sizes (in bits of
+#define flateDistTabBits         6    //   input) for literal/length,
+#define flateCodeLenTabBits      7    //   distance and code length codes
+#define flateInBufSize        4096    // compressed input buffer size
 
-// Huffman code table entry
+// Huffman decoding table entry
 struct FlateCode {
-  int len;			// code length in bits
-  int code;			// code word
-  int val;			// value represented by this code
+  Guchar len;			// code length in bits (0 = invalid code),
+				//   or, for a link, bits of sub table index
+  Guchar link;			// set if this entry links to a sub table
+  Gushort val;			// value represented by this code, or
+				//   index of the sub table
 };
 
-// Huffman code table
+// Huffman decoding table.  The primary table is indexed by the next
+// <bits> bits of input; codes longer than that go through a link to
+// a sub table indexed by the bits after those.
 struct FlateHuffmanTab {
-  int start[flateMaxHuffman+2];	// indexes of first code of each length
-  FlateCode *codes;		// codes, sorted by length and code word
+  FlateCode *codes;		// primary table, followed by sub tables
+  int size;			// allocated size of <codes>
+  int bits;			// primary table index bits
 };
 
 // Decoding info for length and distance code words
@@ -629,6 +781,7 @@ public:
   virtual int getChar();
   virtual int lookChar();
   virtual int getRawChar();
+  virtual int getBlock(char *blk, int size);
   virtual GString *getPSFilter(char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -638,12 +791,14 @@ private:
   Guchar buf[flateWindow];	// output data buffer
   int index;			// current index into output buffer
   int remain;			// number valid bytes in output buffer
-  int codeBuf;			// input buffer
-  int codeSize;			// number of bits in input buffer
-  FlateCode			// literal and distance codes
-    allCodes[flateMaxLitCodes + flateMaxDistCodes];
+  Guchar inBuf[flateInBufSize];	// compressed input buffer
+  Guchar *inPtr;		// next byte in <inBuf>
+  Guchar *inEnd;		// end of valid data in <inBuf>
+  Gulong codeBuf;		// bit buffer
+  int codeSize;			// number of bits in bit buffer
   FlateHuffmanTab litCodeTab;	// literal code table
   FlateHuffmanTab distCodeTab;	// distance code table
+  FlateHuffmanTab codeLenCodeTab; // code length code table
   GBool compressedBlock;	// set if reading a compressed block
   int blockLen;			// remaining length of uncompressed block
   GBool endOfBlock;		// set when end of block is reached
@@ -660,9 +815,14 @@ private:
   GBool startBlock();
   void loadFixedCodes();
   GBool readDynamicCodes();
-  void compHuffmanCodes(FlateHuffmanTab *tab, int n);
+  GBool compHuffmanCodes(int *lengths, int n, FlateHuffmanTab *tab,
+			 int tabBits);
   int getHuffmanCodeWord(FlateHuffmanTab *tab);
   int getCodeWord(int bits);
+  int getInputByte()
+    { return (inPtr < inEnd || fillInput()) ? *inPtr++ : EOF; }
+  GBool fillInput();
+  int getInputBlock(Guchar *blk, int size);
 };
 
 //------------------------------------------------------------------------
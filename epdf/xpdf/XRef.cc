@@ -14,7 +14,12 @@
 #include <stddef.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 #include "../goo/gmem.h"
+#include "../goo/gfile.h"
 #include "../goo/GString.h"
 #include "Object.h"
 #include "Stream.h"
@@ -26,12 +31,19 @@
 #endif
 #include "Error.h"
 #include "ErrorCodes.h"
+#include "GlobalParams.h"
+#include "DocCache.h"
+#include "DisplayList.h"
 #include "XRef.h"
 
 //------------------------------------------------------------------------
 
 #define xrefSearchSize 1024	// read this many bytes at end of file
+#define maxXRefSections 1000	// max length of a /Prev chain
 				//   to look for 'startxref'
+#define xrefScanBufSize 65536	// block size for reconstructing a
+				//   damaged xref table
+#define xrefCacheMagic 0x31525845	// "EXR1"
 
 #ifndef NO_DECRYPTION
 //------------------------------------------------------------------------
@@ -45,13 +57,189 @@
 #define defPermFlags 0xfffc
 #endif
 
+//------------------------------------------------------------------------
+// XRefCacheEntry
+//------------------------------------------------------------------------
+
+struct XRefCacheEntry {
+  int num, gen;			// object ID
+  Object obj;			// dictionary or array (for a stream, the
+				//   stream dictionary)
+  GBool isStream;		// set for stream objects
+  Guint streamStart;		// stream data offset
+  Guint streamLength;		// stream data length
+  GBool decrypt;		// set if the stream data is encrypted
+  int bytes;			// estimated size of this entry
+  XRefCacheEntry *prev, *next;	// LRU list links
+};
+
+//------------------------------------------------------------------------
+// ObjectStream
+//------------------------------------------------------------------------
+
+class ObjectStream {
+public:
+
+  // Decode object stream <objStrNumA> and read its header.  The
+  // objects themselves are parsed on first use.
+  ObjectStream(XRef *xrefA, int objStrNumA);
+
+  ~ObjectStream();
+
+  GBool isOk() { return ok; }
+
+  int getObjStrNum() { return objStrNum; }
+  int getNumObjects() { return nObjects; }
+  int getObjNum(int objIdx) { return objNums[objIdx]; }
+
+  // Return a copy of object <objIdx> in the stream, checking that
+  // its object number is <objNum>.
+  Object *getObject(int objIdx, int objNum, Object *obj);
+
+private:
+
+  XRef *xref;
+  int objStrNum;		// object number of the object stream
+  char *buf;			// decoded stream data
+  int len;			// length of <buf>
+  int first;			// offset of the first object in <buf>
+  int nObjects;			// number of objects in the stream
+  Object *objs;			// the objects (objNone if not parsed yet)
+  int *objNums;			// the object numbers
+  int *offsets;			// offset of each object, relative to
+				//   <first>
+  GBool ok;
+};
+
+ObjectStream::ObjectStream(XRef *xrefA, int objStrNumA) {
+  Object objStr, obj1, obj2;
+  Parser *parser;
+  int bufSize, n, i, c;
+
+  xref = xrefA;
+  objStrNum = objStrNumA;
+  buf = NULL;
+  len = first = 0;
+  nObjects = 0;
+  objs = NULL;
+  objNums = NULL;
+  offsets = NULL;
+  ok = gFalse;
+
+  if (!xref->fetch(objStrNum, 0, &objStr)->isStream("ObjStm")) {
+    error(-1, "Object stream %d is wrong type (%s)",
+	  objStrNum, objStr.getTypeName());
+    objStr.free();
+    return;
+  }
+  objStr.streamGetDict()->lookup(atomN, &obj1);
+  objStr.streamGetDict()->lookup("First", &obj2);
+  // each header entry takes at least four bytes ("1 0 "), so the
+  // header length limits the object count
+  if (!obj1.isInt() || !obj2.isInt() ||
+      obj1.getInt() < 0 || obj2.getInt() < 0 ||
+      obj1.getInt() > obj2.getInt() / 4) {
+    error(-1, "Invalid /N or /First in object stream %d", objStrNum);
+    obj1.free();
+    obj2.free();
+    objStr.free();
+    return;
+  }
+  n = obj1.getInt();
+  first = obj2.getInt();
+  obj1.free();
+  obj2.free();
+
+  // decode the whole stream
+  bufSize = 4096;
+  buf = (char *)gmalloc(bufSize);
+  len = 0;
+  objStr.streamReset();
+  while ((c = objStr.streamGetChar()) != EOF) {
+    if (len == bufSize) {
+      bufSize *= 2;
+      buf = (char *)grealloc(buf, bufSize);
+    }
+    buf[len++] = (char)c;
+  }
+  objStr.streamClose();
+  objStr.free();
+  if (first > len) {
+    error(-1, "Invalid /First in object stream %d", objStrNum);
+    return;
+  }
+
+  // read the object numbers and offsets
+  offsets = (int *)gmalloc(n * sizeof(int));
+  objNums = (int *)gmalloc(n * sizeof(int));
+  obj1.initNull();
+  parser = new Parser(NULL, new Lexer(NULL, new MemStream(buf, first, &obj1)));
+  for (i = 0; i < n; ++i) {
+    parser->getObj(&obj1);
+    parser->getObj(&obj2);
+    if (!obj1.isInt() || !obj2.isInt() ||
+	obj1.getInt() < 0 || obj2.getInt() < 0 ||
+	obj2.getInt() > len - first) {
+      error(-1, "Invalid object stream header (object stream %d)",
+	    objStrNum);
+      obj1.free();
+      obj2.free();
+      delete parser;
+      return;
+    }
+    objNums[i] = obj1.getInt();
+    offsets[i] = obj2.getInt();
+    obj1.free();
+    obj2.free();
+  }
+  delete parser;
+
+  objs = new Object[n];
+  nObjects = n;
+  ok = gTrue;
+}
+
+ObjectStream::~ObjectStream() {
+  int i;
+
+  for (i = 0; i < nObjects; ++i) {
+    if (!objs[i].isNone()) {
+      objs[i].free();
+    }
+  }
+  delete[] objs;
+  gfree(objNums);
+  gfree(offsets);
+  gfree(buf);
+}
+
+Object *ObjectStream::getObject(int objIdx, int objNum, Object *obj) {
+  Object obj1;
+  Parser *parser;
+
+  if (objIdx < 0 || objIdx >= nObjects || objNum != objNums[objIdx]) {
+    return obj->initNull();
+  }
+  if (objs[objIdx].isNone()) {
+    obj1.initNull();
+    parser = new Parser(xref,
+	       new Lexer(xref,
+		 new MemStream(buf + first + offsets[objIdx],
+			       len - first - offsets[objIdx], &obj1)));
+    parser->getObj(&objs[objIdx]);
+    delete parser;
+  }
+  return objs[objIdx].copy(obj);
+}
+
 //------------------------------------------------------------------------
 // XRef
 //------------------------------------------------------------------------
 
-XRef::XRef(BaseStream *strA, GString *ownerPassword, GString *userPassword) {
+XRef::XRef(BaseStream *strA, GString *ownerPassword, GString *userPassword,
+	   GString *fileName, DocCache *docCacheA, GBool linearized) {
   Guint pos;
-  int i;
+  int nVisited, i;
 
   ok = gTrue;
   errCode = errNone;
@@ -59,40 +247,85 @@ XRef::XRef(BaseStream *strA, GString *ownerPassword, GString *userPassword) {
   entries = NULL;
   streamEnds = NULL;
   streamEndsLen = 0;
-
-  // read the trailer
+  cache = NULL;
+  cacheSize = 0;
+  cacheHead = cacheTail = NULL;
+  cacheBytes = 0;
+  cacheMaxBytes = 0;
+  cacheHits = cacheMisses = 0;
+  formCache = NULL;
+  pageListCache = NULL;
+  docCache = NULL;
+  for (i = 0; i < xrefObjStrCacheSize; ++i) {
+    objStrs[i] = NULL;
+  }
+  objStrLoading = gFalse;
+  objStmNums = NULL;
+  objStmNumsLen = 0;
+  reconstructed = gFalse;
+  reconstructedFromCache = gFalse;
+  reconstructTime = 0;
+  trailerKind = xrefTrailerNone;
+  trailerPos = 0;
+  mainXRefPending = gFalse;
+  mainXRefPos = 0;
   str = strA;
   start = str->getStart();
-  pos = readTrailer();
 
-  // if there was a problem with the trailer,
+  // the document structure cache may have the xref table
+  if (docCacheA && loadDocCache(docCacheA)) {
+    // nothing else to read
+
+  // read the trailer; if there was a problem with it,
   // try to reconstruct the xref table
-  if (pos == 0) {
-    if (!(ok = constructXRef())) {
+  } else if ((pos = readTrailer()) == 0) {
+    if (!(ok = constructXRef(fileName))) {
       errCode = errDamaged;
       return;
     }
 
   // trailer is ok - read the xref table
   } else {
-    entries = (XRefEntry *)gmalloc(size * sizeof(XRefEntry));
-    for (i = 0; i < size; ++i) {
-      entries[i].offset = 0xffffffff;
-      entries[i].used = gFalse;
+    i = size;
+    size = 0;
+    if (!growEntries(i)) {
+      ok = gFalse;
+    }
+    for (nVisited = 0; ok && readXRef(&pos); ++nVisited) {
+      // the first section of a linearized file covers the objects
+      // needed for the first page; the rest of the table is at the
+      // end of the file
+      if (linearized) {
+	mainXRefPending = gTrue;
+	mainXRefPos = pos;
+	break;
+      }
+      // guard against /Prev loops
+      if (nVisited == maxXRefSections) {
+	error(-1, "Too many xref sections (loop in /Prev chain?)");
+	break;
+      }
     }
-    while (readXRef(&pos)) ;
 
     // if there was a problem with the xref table,
     // try to reconstruct it
     if (!ok) {
+      mainXRefPending = gFalse;
       gfree(entries);
       size = 0;
       entries = NULL;
-      if (!(ok = constructXRef())) {
+      if (!(ok = constructXRef(fileName))) {
 	errCode = errDamaged;
 	return;
       }
     }
+
+    // save the table for next time (a reconstructed table is saved
+    // in the xrefCacheDir instead)
+    if (ok && docCacheA && !reconstructed && !mainXRefPending) {
+      docCacheA->setXRef(entries, size, trailerKind, trailerPos,
+			 lastXRefPos);
+    }
   }
 
   // now set the trailer dictionary's xref pointer so we can fetch
@@ -108,9 +341,47 @@ XRef::XRef(BaseStream *strA, GString *ownerPassword, GString *userPassword) {
     errCode = errEncrypted;
     return;
   }
+
+  // a reconstructed xref table only knows where the object streams
+  // are; add the objects they contain (this has to wait until
+  // decryption is set up)
+  if (objStmNums) {
+    constructObjStmEntries();
+  }
+
+  // enable the object cache (this is done last so nothing fetched
+  // before the encryption parameters are known gets cached)
+  cacheMaxBytes = globalParams->getObjectCacheSize();
+  if (globalParams->getFormCacheSize() > 0) {
+    formCache = new DisplayListCache(globalParams->getFormCacheSize());
+  }
+  if (globalParams->getPageListCacheSize() > 0) {
+    pageListCache = new DisplayListCache(globalParams->getPageListCacheSize());
+
+    // page lists are saved with the document structure, except those
+    // of encrypted files: they hold the decrypted text
+    if (!isEncrypted()) {
+      docCache = docCacheA;
+    }
+  }
 }
 
 XRef::~XRef() {
+  int i;
+
+  if (formCache) {
+    delete formCache;
+  }
+  if (pageListCache) {
+    delete pageListCache;
+  }
+  cacheFree();
+  for (i = 0; i < xrefObjStrCacheSize; ++i) {
+    if (objStrs[i]) {
+      delete objStrs[i];
+    }
+  }
+  gfree(objStmNums);
   gfree(entries);
   trailerDict.free();
   if (streamEnds) {
@@ -155,45 +426,77 @@ Guint XRef::readTrailer() {
   str->setPos(start + pos);
   for (i = 0; i < 4; ++i)
     buf[i] = str->getChar();
-  if (strncmp(buf, "xref", 4))
-    return 0;
-  pos1 = pos + 4;
-  while (1) {
-    str->setPos(start + pos1);
-    for (i = 0; i < 35; ++i) {
-      if ((c = str->getChar()) == EOF)
-	return 0;
-      buf[i] = c;
+  if (strncmp(buf, "xref", 4)) {
+
+    // not an xref table -- it may be a cross-reference stream, whose
+    // dictionary doubles as the trailer dictionary
+    obj.initNull();
+    parser = new Parser(NULL,
+	       new Lexer(NULL,
+		 str->makeSubStream(start + pos, gFalse, 0, &obj)));
+    if (parser->getObj(&obj)->isInt()) {
+      obj.free();
+      if (parser->getObj(&obj)->isInt()) {
+	obj.free();
+	if (parser->getObj(&obj)->isCmd("obj")) {
+	  obj.free();
+	  if (parser->getObj(&obj)->isStream("XRef")) {
+	    trailerDict.initDict(obj.streamGetDict());
+	    trailerKind = xrefTrailerStream;
+	    trailerPos = pos;
+	  }
+	}
+      }
     }
-    if (!strncmp(buf, "trailer", 7))
-      break;
-    p = buf;
-    while (isspace(*p)) ++p;
-    while ('0' <= *p && *p <= '9') ++p;
-    while (isspace(*p)) ++p;
-    n = atoi(p);
-    while ('0' <= *p && *p <= '9') ++p;
-    while (isspace(*p)) ++p;
-    if (p == buf)
+    obj.free();
+    delete parser;
+    if (!trailerDict.isDict()) {
       return 0;
-    pos1 += (p - buf) + n * 20;
+    }
+
+  } else {
+    pos1 = pos + 4;
+    while (1) {
+      str->setPos(start + pos1);
+      for (i = 0; i < 35; ++i) {
+	if ((c = str->getChar()) == EOF)
+	  return 0;
+	buf[i] = c;
+      }
+      if (!strncmp(buf, "trailer", 7))
+	break;
+      p = buf;
+      while (isspace(*p)) ++p;
+      while ('0' <= *p && *p <= '9') ++p;
+      while (isspace(*p)) ++p;
+      n = atoi(p);
+      while ('0' <= *p && *p <= '9') ++p;
+      while (isspace(*p)) ++p;
+      if (p == buf)
+	return 0;
+      pos1 += (p - buf) + n * 20;
+    }
+    trailerKind = xrefTrailerDict;
+    trailerPos = pos1;
+    pos1 += 7;
+
+    // read trailer dict
+    obj.initNull();
+    parser = new Parser(NULL,
+	       new Lexer(NULL,
+		 str->makeSubStream(start + pos1, gFalse, 0, &obj)));
+    parser->getObj(&trailerDict);
+    delete parser;
   }
-  pos1 += 7;
 
-  // read trailer dict
-  obj.initNull();
-  parser = new Parser(NULL,
-	     new Lexer(NULL,
-	       str->makeSubStream(start + pos1, gFalse, 0, &obj)));
-  parser->getObj(&trailerDict);
   if (trailerDict.isDict()) {
-    trailerDict.dictLookupNF("Size", &obj);
+    trailerDict.dictLookupNF(atomSize, &obj);
     if (obj.isInt())
       size = obj.getInt();
     else
       pos = 0;
     obj.free();
-    trailerDict.dictLookupNF("Root", &obj);
+    trailerDict.dictLookupNF(atomRoot, &obj);
     if (obj.isRef()) {
       rootNum = obj.getRefNum();
       rootGen = obj.getRefGen();
@@ -204,34 +507,79 @@ Guint XRef::readTrailer() {
   } else {
     pos = 0;
   }
-  delete parser;
 
   // return first xref position
   return pos;
 }
 
-// Read an xref table and the prev pointer from the trailer.
-GBool XRef::readXRef(Guint *pos) {
+// Read an xref section (either a table or a cross-reference stream).
+// Sets *<pos> to the /Prev pointer, and returns true if there is one.
+// If <xrefStm> is set, this is the /XRefStm cross-reference stream of
+// a hybrid-reference file.
+GBool XRef::readXRef(Guint *pos, GBool xrefStm) {
   Parser *parser;
-  Object obj, obj2;
-  char s[20];
+  Object obj;
   GBool more;
-  int first, newSize, n, i, j;
+  char s[4];
   int c;
 
   // seek to xref in stream
   str->setPos(start + *pos);
 
-  // make sure it's an xref table
+  // check for an xref table
   while ((c = str->getChar()) != EOF && isspace(c)) ;
   s[0] = (char)c;
   s[1] = (char)str->getChar();
   s[2] = (char)str->getChar();
   s[3] = (char)str->getChar();
-  if (!(s[0] == 'x' && s[1] == 'r' && s[2] == 'e' && s[3] == 'f')) {
-    goto err2;
+  if (!xrefStm &&
+      s[0] == 'x' && s[1] == 'r' && s[2] == 'e' && s[3] == 'f') {
+    return readXRefTable(pos);
   }
 
+  // otherwise it has to be a cross-reference stream
+  obj.initNull();
+  parser = new Parser(NULL,
+	     new Lexer(NULL,
+	       str->makeSubStream(start + *pos, gFalse, 0, &obj)));
+  if (!parser->getObj(&obj)->isInt()) {
+    goto err1;
+  }
+  obj.free();
+  if (!parser->getObj(&obj)->isInt()) {
+    goto err1;
+  }
+  obj.free();
+  if (!parser->getObj(&obj)->isCmd("obj")) {
+    goto err1;
+  }
+  obj.free();
+  if (!parser->getObj(&obj)->isStream("XRef")) {
+    goto err1;
+  }
+  more = readXRefStream(obj.getStream(), pos, xrefStm);
+  obj.free();
+  delete parser;
+  return more;
+
+ err1:
+  obj.free();
+  delete parser;
+  ok = gFalse;
+  return gFalse;
+}
+
+// Read a classic xref table (the stream is positioned just after the
+// 'xref' keyword) and the trailer that follows it.
+GBool XRef::readXRefTable(Guint *pos) {
+  Parser *parser;
+  Object obj, obj2;
+  char s[20];
+  GBool more;
+  Guint pos2;
+  int first, n, i, j;
+  int c;
+
   // read xref
   while (1) {
     while ((c = str->lookChar()) != EOF && isspace(c)) {
@@ -262,16 +610,15 @@ GBool XRef::readXRef(Guint *pos) {
     while ((c = str->lookChar()) != EOF && isspace(c)) {
       str->getChar();
     }
+    if (first < 0 || n < 0 || first + n < 0) {
+      goto err2;
+    }
     // check for buggy PDF files with an incorrect (too small) xref
     // table size
     if (first + n > size) {
-      newSize = size + 256;
-      entries = (XRefEntry *)grealloc(entries, newSize * sizeof(XRefEntry));
-      for (i = size; i < newSize; ++i) {
-	entries[i].offset = 0xffffffff;
-	entries[i].used = gFalse;
+      if (!growEntries((first + n + 255) & ~255)) {
+	goto err2;
       }
-      size = newSize;
     }
     for (i = first; i < first + n; ++i) {
       for (j = 0; j < 20; ++j) {
@@ -286,9 +633,9 @@ GBool XRef::readXRef(Guint *pos) {
 	s[16] = '\0';
 	entries[i].gen = atoi(&s[11]);
 	if (s[17] == 'n') {
-	  entries[i].used = gTrue;
+	  entries[i].type = xrefEntryUncompressed;
 	} else if (s[17] == 'f') {
-	  entries[i].used = gFalse;
+	  entries[i].type = xrefEntryFree;
 	} else {
 	  goto err2;
 	}
@@ -297,7 +644,7 @@ GBool XRef::readXRef(Guint *pos) {
 	// instead of 0.
 	if (i == 1 && first == 1 &&
 	    entries[1].offset == 0 && entries[1].gen == 65535 &&
-	    !entries[1].used) {
+	    entries[1].type == xrefEntryFree) {
 	  i = first = 0;
 	  entries[0] = entries[1];
 	  entries[1].offset = 0xffffffff;
@@ -320,114 +667,400 @@ GBool XRef::readXRef(Guint *pos) {
   if (!obj.isDict()) {
     goto err1;
   }
-  obj.getDict()->lookupNF("Prev", &obj2);
+  obj.getDict()->lookupNF(atomPrev, &obj2);
   if (obj2.isInt()) {
     *pos = (Guint)obj2.getInt();
     more = gTrue;
   } else {
     more = gFalse;
   }
-  obj.free();
   obj2.free();
 
+  // in a hybrid-reference file, the entries for compressed objects
+  // are in the cross-reference stream pointed to by /XRefStm (the
+  // table lists them as free); they take precedence over the previous
+  // sections
+  obj.getDict()->lookupNF("XRefStm", &obj2);
+  if (obj2.isInt()) {
+    pos2 = (Guint)obj2.getInt();
+    readXRef(&pos2, gTrue);
+    if (!ok) {
+      obj2.free();
+      goto err1;
+    }
+  }
+  obj2.free();
+  obj.free();
+
   delete parser;
   return more;
 
  err1:
   obj.free();
+  delete parser;
  err2:
   ok = gFalse;
   return gFalse;
 }
 
-// Attempt to construct an xref table for a damaged file.
-GBool XRef::constructXRef() {
-  Parser *parser;
+// Read a cross-reference stream.
+GBool XRef::readXRefStream(Stream *xrefStr, Guint *pos, GBool xrefStm) {
+  Dict *dict;
+  Object obj, obj2, idx;
+  GBool more;
+  int w[3];
+  int newSize, first, n, i;
+
+  dict = xrefStr->getDict();
+
+  if (!dict->lookupNF(atomSize, &obj)->isInt()) {
+    goto err1;
+  }
+  newSize = obj.getInt();
+  obj.free();
+  if (!growEntries(newSize)) {
+    goto err0;
+  }
+
+  if (!dict->lookupNF("W", &obj)->isArray() || obj.arrayGetLength() < 3) {
+    goto err1;
+  }
+  for (i = 0; i < 3; ++i) {
+    if (!obj.arrayGet(i, &obj2)->isInt()) {
+      obj2.free();
+      goto err1;
+    }
+    w[i] = obj2.getInt();
+    obj2.free();
+    if (w[i] < 0 || w[i] > 4) {
+      goto err1;
+    }
+  }
+  obj.free();
+
+  xrefStr->reset();
+  if (dict->lookupNF("Index", &idx)->isArray()) {
+    for (i = 0; i + 1 < idx.arrayGetLength(); i += 2) {
+      if (!idx.arrayGet(i, &obj)->isInt()) {
+	idx.free();
+	goto err1;
+      }
+      first = obj.getInt();
+      obj.free();
+      if (!idx.arrayGet(i + 1, &obj)->isInt()) {
+	idx.free();
+	goto err1;
+      }
+      n = obj.getInt();
+      obj.free();
+      if (!readXRefStreamSection(xrefStr, w, first, n, xrefStm)) {
+	idx.free();
+	goto err0;
+      }
+    }
+  } else {
+    if (!readXRefStreamSection(xrefStr, w, 0, newSize, xrefStm)) {
+      idx.free();
+      goto err0;
+    }
+  }
+  idx.free();
+
+  dict->lookupNF(atomPrev, &obj);
+  if (obj.isInt()) {
+    *pos = (Guint)obj.getInt();
+    more = gTrue;
+  } else {
+    more = gFalse;
+  }
+  obj.free();
+  return more;
+
+ err1:
+  obj.free();
+ err0:
+  ok = gFalse;
+  return gFalse;
+}
+
+// Read <n> entries, starting with object number <first>, from a
+// cross-reference stream with field widths <w>.  If <xrefStm> is set,
+// entries also replace free entries from the corresponding table.
+GBool XRef::readXRefStreamSection(Stream *xrefStr, int *w,
+				  int first, int n, GBool xrefStm) {
+  Guint offset;
+  int type, gen, c, i, j;
+
+  if (first < 0 || n < 0 || first + n < 0) {
+    return gFalse;
+  }
+  if (first + n > size) {
+    if (!growEntries((first + n + 255) & ~255)) {
+      return gFalse;
+    }
+  }
+  for (i = first; i < first + n; ++i) {
+    if (w[0] == 0) {
+      type = 1;
+    } else {
+      for (type = 0, j = 0; j < w[0]; ++j) {
+	if ((c = xrefStr->getChar()) == EOF) {
+	  return gFalse;
+	}
+	type = (type << 8) + c;
+      }
+    }
+    for (offset = 0, j = 0; j < w[1]; ++j) {
+      if ((c = xrefStr->getChar()) == EOF) {
+	return gFalse;
+      }
+      offset = (offset << 8) + c;
+    }
+    for (gen = 0, j = 0; j < w[2]; ++j) {
+      if ((c = xrefStr->getChar()) == EOF) {
+	return gFalse;
+      }
+      gen = (gen << 8) + c;
+    }
+    if (entries[i].offset == 0xffffffff ||
+	(xrefStm && type != 0 && entries[i].type == xrefEntryFree)) {
+      entries[i].offset = offset;
+      entries[i].gen = gen;
+      switch (type) {
+      case 1:
+	entries[i].type = xrefEntryUncompressed;
+	break;
+      case 2:
+	entries[i].type = xrefEntryCompressed;
+	break;
+      default:
+	// type 0, and unknown types (which are to be treated as
+	// references to the null object)
+	entries[i].type = xrefEntryFree;
+	break;
+      }
+    }
+  }
+  return gTrue;
+}
+
+// Grow the entries array to <newSize> entries.
+GBool XRef::growEntries(int newSize) {
+  int i;
+
+  if (newSize < 0 || newSize >= INT_MAX / (int)sizeof(XRefEntry)) {
+    error(-1, "Invalid xref table size (%d)", newSize);
+    return gFalse;
+  }
+  if (newSize <= size) {
+    return gTrue;
+  }
+  entries = (XRefEntry *)grealloc(entries, newSize * sizeof(XRefEntry));
+  for (i = size; i < newSize; ++i) {
+    entries[i].offset = 0xffffffff;
+    entries[i].gen = 0;
+    entries[i].type = xrefEntryFree;
+  }
+  size = newSize;
+  return gTrue;
+}
+
+// Read the rest of a linearized file's xref table, starting with the
+// section after the first-page section.  This can happen in the
+// middle of reading another object from the file, so the file
+// position is saved (by resetting a substream) and restored
+// afterwards.
+void XRef::readMainXRef() {
+  Stream *saveStr;
   Object obj;
-  char buf[256];
   Guint pos;
-  int num, gen;
+  int nVisited;
+
+  mainXRefPending = gFalse;
+  obj.initNull();
+  saveStr = str->makeSubStream(start, gFalse, 0, &obj);
+  saveStr->reset();
+
+  pos = mainXRefPos;
+  for (nVisited = 0; ok && readXRef(&pos); ++nVisited) {
+    if (nVisited == maxXRefSections) {
+      error(-1, "Too many xref sections (loop in /Prev chain?)");
+      break;
+    }
+  }
+
+  // if there was a problem with it, try to reconstruct the table
+  // (the document stays open either way)
+  if (!ok) {
+    ok = gTrue;
+    if (constructXRef(NULL) && objStmNums) {
+      constructObjStmEntries();
+    }
+    if (trailerDict.isDict()) {
+      trailerDict.getDict()->setXRef(this);
+    }
+  }
+
+  saveStr->close();
+  delete saveStr;
+}
+
+// Attempt to construct an xref table for a damaged file.
+// Return a pointer to the first '\r' or '\n' in [<p>, <end>), or <end>
+// if there is none.  This checks a word at a time.
+static inline char *findEOL(char *p, char *end) {
+  unsigned long w, x, y;
+  const unsigned long ones = ~0UL / 255;
+  const unsigned long highs = ones * 0x80;
+
+  while (p + sizeof(unsigned long) <= end) {
+    memcpy(&w, p, sizeof(unsigned long));
+    x = w ^ (ones * '\n');
+    y = w ^ (ones * '\r');
+    if (((x - ones) & ~x & highs) | ((y - ones) & ~y & highs)) {
+      break;
+    }
+    p += sizeof(unsigned long);
+  }
+  while (p < end && *p != '\n' && *p != '\r') {
+    ++p;
+  }
+  return p;
+}
+
+// Wall clock time, in milliseconds.
+static double getTime() {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+GBool XRef::constructXRef(GString *fileName) {
+  char *buf, *line, *p, *q, *eol;
+  Guint bufPos, pos, lastPos;
+  Guint key[docCacheKeyLen];
+  GString *cacheFile;
+  GBool eof;
+  int num, gen, lastNum;
   int newSize;
-  int streamEndsSize;
-  char *p;
+  int streamEndsSize, objStmNumsSize;
+  int len, n;
   int i;
   GBool gotRoot;
 
   error(0, "PDF file is damaged - attempting to reconstruct xref table...");
+  reconstructed = gTrue;
+  reconstructTime = getTime();
+
+  // reopening a damaged file can use the table saved last time
+  cacheFile = NULL;
+  if (fileName && globalParams->getXRefCacheDir()) {
+    cacheFile = DocCache::makeKey(str, fileName, xrefCacheMagic,
+				  globalParams->getXRefCacheDir(), "xref",
+				  key);
+  }
+  if (cacheFile && loadXRefCache(cacheFile, key)) {
+    delete cacheFile;
+    reconstructedFromCache = gTrue;
+    reconstructTime = getTime() - reconstructTime;
+    return gTrue;
+  }
+
   gotRoot = gFalse;
   streamEndsLen = streamEndsSize = 0;
+  objStmNumsLen = objStmNumsSize = 0;
+  lastNum = -1;
+  lastPos = 0;
+  trailerKind = xrefTrailerNone;
+  trailerPos = 0;
 
+  // go through the file a line at a time, reading it in big blocks
+  // and looking for the line ends a word at a time; each line is
+  // null-terminated in place (the buffer has a spare byte at the end)
+  buf = (char *)gmalloc(xrefScanBufSize + 1);
   str->reset();
+  bufPos = str->getPos();
+  len = 0;
+  eof = gFalse;
+  p = buf;
   while (1) {
-    pos = str->getPos();
-    if (!str->getLine(buf, 256)) {
-      break;
+    eol = findEOL(p, buf + len);
+    if (eol == buf + len) {
+      if (!eof && (n = len - (p - buf)) < xrefScanBufSize) {
+	memmove(buf, p, n);
+	bufPos += p - buf;
+	p = buf;
+	len = n;
+	if ((n = str->getBlock(buf + len, xrefScanBufSize - len)) > 0) {
+	  len += n;
+	} else {
+	  eof = gTrue;
+	}
+	continue;
+      }
+      // end of file, or a line that fills the whole buffer
+      if (p == eol) {
+	break;
+      }
     }
-    p = buf;
+    *eol = '\0';
+    line = q = p;
+    pos = bufPos + (line - buf);
+    p = eol < buf + len ? eol + 1 : eol;
 
     // got trailer dictionary
-    if (!strncmp(p, "trailer", 7)) {
-      obj.initNull();
-      parser = new Parser(NULL,
-		 new Lexer(NULL,
-		   str->makeSubStream(start + pos + 7, gFalse, 0, &obj)));
-      if (!trailerDict.isNone())
-	trailerDict.free();
-      parser->getObj(&trailerDict);
-      if (trailerDict.isDict()) {
-	trailerDict.dictLookupNF("Root", &obj);
-	if (obj.isRef()) {
-	  rootNum = obj.getRefNum();
-	  rootGen = obj.getRefGen();
-	  gotRoot = gTrue;
-	}
-	obj.free();
-      } else {
-	pos = 0;
+    if (*q == 't' && !strncmp(q, "trailer", 7)) {
+      if (constructTrailer(pos - start, &gotRoot)) {
+	trailerKind = xrefTrailerDict;
+	trailerPos = pos - start;
       }
-      delete parser;
 
     // look for object
-    } else if (isdigit(*p)) {
-      num = atoi(p);
+    } else if (isdigit(*q)) {
+      num = atoi(q);
       do {
-	++p;
-      } while (*p && isdigit(*p));
-      if (isspace(*p)) {
+	++q;
+      } while (*q && isdigit(*q));
+      if (isspace(*q)) {
 	do {
-	  ++p;
-	} while (*p && isspace(*p));
-	if (isdigit(*p)) {
-	  gen = atoi(p);
+	  ++q;
+	} while (*q && isspace(*q));
+	if (isdigit(*q)) {
+	  gen = atoi(q);
 	  do {
-	    ++p;
-	  } while (*p && isdigit(*p));
-	  if (isspace(*p)) {
+	    ++q;
+	  } while (*q && isdigit(*q));
+	  if (isspace(*q)) {
 	    do {
-	      ++p;
-	    } while (*p && isspace(*p));
-	    if (!strncmp(p, "obj", 3)) {
+	      ++q;
+	    } while (*q && isspace(*q));
+	    if (!strncmp(q, "obj", 3)) {
 	      if (num >= size) {
 		newSize = (num + 1 + 255) & ~255;
 		entries = (XRefEntry *)
 		            grealloc(entries, newSize * sizeof(XRefEntry));
 		for (i = size; i < newSize; ++i) {
 		  entries[i].offset = 0xffffffff;
-		  entries[i].used = gFalse;
+		  entries[i].gen = 0;
+		  entries[i].type = xrefEntryFree;
 		}
 		size = newSize;
 	      }
-	      if (!entries[num].used || gen >= entries[num].gen) {
+	      if (entries[num].type == xrefEntryFree ||
+		  gen >= entries[num].gen) {
 		entries[num].offset = pos - start;
 		entries[num].gen = gen;
-		entries[num].used = gTrue;
+		entries[num].type = xrefEntryUncompressed;
 	      }
+	      lastNum = num;
+	      lastPos = pos - start;
 	    }
 	  }
 	}
       }
 
-    } else if (!strncmp(p, "endstream", 9)) {
+    } else if (*q == 'e' && !strncmp(q, "endstream", 9)) {
       if (streamEndsLen == streamEndsSize) {
 	streamEndsSize += 64;
 	streamEnds = (Guint *)grealloc(streamEnds,
@@ -435,25 +1068,371 @@ GBool XRef::constructXRef() {
       }
       streamEnds[streamEndsLen++] = pos;
     }
+
+    // the rest only looks at an object's dictionary, which ends at
+    // 'stream' (or at the next object), so binary stream data isn't
+    // searched
+    if (lastNum < 0) {
+      continue;
+    }
+
+    // a cross-reference stream's dictionary can serve as the trailer
+    // (normally the dictionary is on the same line as, or the line
+    // after, the 'obj' keyword)
+    if ((q = strstr(line, "/XRef")) &&
+	strncmp(q, "/XRefStm", 8)) {
+      if (constructXRefStmTrailer(lastPos, &gotRoot)) {
+	trailerKind = xrefTrailerStream;
+	trailerPos = lastPos;
+      }
+      lastNum = -1;
+
+    // remember object streams
+    } else if (strstr(line, "/ObjStm")) {
+      if (objStmNumsLen == objStmNumsSize) {
+	objStmNumsSize += 64;
+	objStmNums = (int *)grealloc(objStmNums,
+				     objStmNumsSize * sizeof(int));
+      }
+      objStmNums[objStmNumsLen++] = lastNum;
+      lastNum = -1;
+
+    } else if (strstr(line, "stream")) {
+      lastNum = -1;
+    }
   }
+  gfree(buf);
+  reconstructTime = getTime() - reconstructTime;
 
-  if (gotRoot)
+  if (gotRoot) {
+    if (cacheFile) {
+      saveXRefCache(cacheFile, key);
+      delete cacheFile;
+    }
     return gTrue;
+  }
+  if (cacheFile) {
+    delete cacheFile;
+  }
 
   error(-1, "Couldn't find trailer dictionary");
   return gFalse;
 }
 
+// Read the dictionary after a 'trailer' keyword at <pos>.  Returns
+// true if it was a dictionary, and sets <gotRoot> if it has a Root.
+GBool XRef::constructTrailer(Guint pos, GBool *gotRoot) {
+  Parser *parser;
+  Object obj, obj2;
+  GBool isDict;
+
+  obj.initNull();
+  parser = new Parser(NULL,
+	     new Lexer(NULL,
+	       str->makeSubStream(start + pos + 7, gFalse, 0, &obj)));
+  parser->getObj(&obj);
+  if ((isDict = obj.isDict())) {
+    if (!trailerDict.isNone()) {
+      trailerDict.free();
+    }
+    trailerDict = obj;
+    trailerDict.dictLookupNF("Root", &obj2);
+    if (obj2.isRef()) {
+      rootNum = obj2.getRefNum();
+      rootGen = obj2.getRefGen();
+      *gotRoot = gTrue;
+    }
+    obj2.free();
+  } else {
+    obj.free();
+  }
+  delete parser;
+  return isDict;
+}
+
+// Read the object at <pos>; if it is a cross-reference stream with a
+// Root, its dictionary becomes the trailer dictionary.  Returns true
+// in that case.
+GBool XRef::constructXRefStmTrailer(Guint pos, GBool *gotRoot) {
+  Parser *parser;
+  Object obj, obj2;
+  GBool found;
+
+  found = gFalse;
+  obj.initNull();
+  parser = new Parser(NULL,
+	     new Lexer(NULL,
+	       str->makeSubStream(start + pos, gFalse, 0, &obj)));
+  parser->getObj(&obj);
+  obj.free();
+  parser->getObj(&obj);
+  obj.free();
+  parser->getObj(&obj);
+  obj.free();
+  if (parser->getObj(&obj)->isStream("XRef")) {
+    obj.streamGetDict()->lookupNF(atomRoot, &obj2);
+    if (obj2.isRef()) {
+      rootNum = obj2.getRefNum();
+      rootGen = obj2.getRefGen();
+      *gotRoot = found = gTrue;
+      if (!trailerDict.isNone())
+	trailerDict.free();
+      trailerDict.initDict(obj.streamGetDict());
+    }
+    obj2.free();
+  }
+  obj.free();
+  delete parser;
+  return found;
+}
+
+// Read the xref table from a document structure cache entry.  The
+// trailer dictionary is parsed again from the file.  Returns false if
+// the entry doesn't have a usable table.
+GBool XRef::loadDocCache(DocCache *docCache) {
+  GBool gotRoot;
+
+  if (!docCache->isLoaded()) {
+    return gFalse;
+  }
+  gotRoot = gFalse;
+  trailerKind = docCache->getTrailerKind();
+  trailerPos = docCache->getTrailerPos();
+  if (trailerKind == xrefTrailerDict) {
+    constructTrailer(trailerPos, &gotRoot);
+  } else if (trailerKind == xrefTrailerStream) {
+    constructXRefStmTrailer(trailerPos, &gotRoot);
+  }
+  if (!gotRoot) {
+    trailerDict.free();
+    trailerKind = xrefTrailerNone;
+    trailerPos = 0;
+    return gFalse;
+  }
+  lastXRefPos = docCache->getLastXRefPos();
+  size = docCache->getXRefSize();
+  entries = (XRefEntry *)gmalloc(size * sizeof(XRefEntry));
+  memcpy(entries, docCache->getXRefEntries(), size * sizeof(XRefEntry));
+  return gTrue;
+}
+
+// Load a reconstructed xref table saved by saveXRefCache.  Returns
+// false (leaving the table empty) if it is missing, stale, or bad.
+GBool XRef::loadXRefCache(GString *cacheFile, Guint *key) {
+  FILE *f;
+  Guint hdr[docCacheKeyLen + 7];
+  GBool gotRoot, ok1;
+  int i;
+
+  if (!(f = fopen(cacheFile->getCString(), "rb"))) {
+    return gFalse;
+  }
+  ok1 = gFalse;
+  if (fread(hdr, sizeof(Guint), docCacheKeyLen + 7, f) !=
+	docCacheKeyLen + 7) {
+    goto done;
+  }
+  for (i = 0; i < docCacheKeyLen; ++i) {
+    if (hdr[i] != key[i]) {
+      goto done;
+    }
+  }
+  size = (int)hdr[docCacheKeyLen];
+  streamEndsLen = (int)hdr[docCacheKeyLen + 1];
+  objStmNumsLen = (int)hdr[docCacheKeyLen + 2];
+  if (size <= 0 || size > (INT_MAX / (int)sizeof(XRefEntry)) ||
+      streamEndsLen < 0 || streamEndsLen > INT_MAX / (int)sizeof(Guint) ||
+      objStmNumsLen < 0 || objStmNumsLen > INT_MAX / (int)sizeof(int)) {
+    goto done;
+  }
+  entries = (XRefEntry *)gmalloc(size * sizeof(XRefEntry));
+  streamEnds = (Guint *)gmalloc((streamEndsLen ? streamEndsLen : 1) *
+				sizeof(Guint));
+  objStmNums = (int *)gmalloc((objStmNumsLen ? objStmNumsLen : 1) *
+			      sizeof(int));
+  if (fread(entries, sizeof(XRefEntry), size, f) != (size_t)size ||
+      fread(streamEnds, sizeof(Guint), streamEndsLen, f) !=
+        (size_t)streamEndsLen ||
+      fread(objStmNums, sizeof(int), objStmNumsLen, f) !=
+        (size_t)objStmNumsLen) {
+    goto done;
+  }
+  for (i = 0; i < size; ++i) {
+    if (entries[i].type != xrefEntryFree &&
+	entries[i].type != xrefEntryUncompressed) {
+      goto done;
+    }
+  }
+
+  // the trailer dictionary is parsed again from the file
+  gotRoot = gFalse;
+  trailerKind = (int)hdr[docCacheKeyLen + 5];
+  trailerPos = hdr[docCacheKeyLen + 6];
+  if (trailerKind == xrefTrailerDict) {
+    ok1 = constructTrailer(trailerPos, &gotRoot);
+  } else if (trailerKind == xrefTrailerStream) {
+    ok1 = constructXRefStmTrailer(trailerPos, &gotRoot);
+  }
+  rootNum = (int)hdr[docCacheKeyLen + 3];
+  rootGen = (int)hdr[docCacheKeyLen + 4];
+
+ done:
+  fclose(f);
+  if (!ok1) {
+    gfree(entries);
+    entries = NULL;
+    size = 0;
+    gfree(streamEnds);
+    streamEnds = NULL;
+    streamEndsLen = 0;
+    gfree(objStmNums);
+    objStmNums = NULL;
+    objStmNumsLen = 0;
+  }
+  return ok1;
+}
+
+// Save a reconstructed xref table for loadXRefCache.  The file is
+// written under a temporary name and then renamed, so a reader never
+// sees a partial file.
+void XRef::saveXRefCache(GString *cacheFile, Guint *key) {
+  FILE *f;
+  GString *tmpFile;
+  Guint hdr[docCacheKeyLen + 7];
+  GBool ok1;
+  int i;
+
+  tmpFile = cacheFile->copy();
+  tmpFile->append(".tmp");
+  if (!(f = fopen(tmpFile->getCString(), "wb"))) {
+    delete tmpFile;
+    return;
+  }
+  for (i = 0; i < docCacheKeyLen; ++i) {
+    hdr[i] = key[i];
+  }
+  hdr[docCacheKeyLen] = (Guint)size;
+  hdr[docCacheKeyLen + 1] = (Guint)streamEndsLen;
+  hdr[docCacheKeyLen + 2] = (Guint)objStmNumsLen;
+  hdr[docCacheKeyLen + 3] = (Guint)rootNum;
+  hdr[docCacheKeyLen + 4] = (Guint)rootGen;
+  hdr[docCacheKeyLen + 5] = (Guint)trailerKind;
+  hdr[docCacheKeyLen + 6] = trailerPos;
+  ok1 = fwrite(hdr, sizeof(Guint), docCacheKeyLen + 7, f) ==
+          docCacheKeyLen + 7 &&
+        fwrite(entries, sizeof(XRefEntry), size, f) == (size_t)size &&
+        fwrite(streamEnds, sizeof(Guint), streamEndsLen, f) ==
+          (size_t)streamEndsLen &&
+        fwrite(objStmNums, sizeof(int), objStmNumsLen, f) ==
+          (size_t)objStmNumsLen;
+  if (fclose(f) != 0) {
+    ok1 = gFalse;
+  }
+  if (!ok1 || rename(tmpFile->getCString(), cacheFile->getCString()) != 0) {
+    unlink(tmpFile->getCString());
+  }
+  delete tmpFile;
+}
+
+// Add xref entries for the objects in the object streams found by
+// constructXRef.  Objects with an uncompressed entry are left alone.
+void XRef::constructObjStmEntries() {
+  ObjectStream *objStr;
+  int num, i, j;
+
+  for (i = 0; i < objStmNumsLen; ++i) {
+    if (!(objStr = getObjectStream(objStmNums[i]))) {
+      continue;
+    }
+    for (j = 0; j < objStr->getNumObjects(); ++j) {
+      num = objStr->getObjNum(j);
+      if (num >= size && !growEntries((num + 1 + 255) & ~255)) {
+	continue;
+      }
+      if (entries[num].type == xrefEntryFree) {
+	entries[num].offset = (Guint)objStmNums[i];
+	entries[num].gen = j;
+	entries[num].type = xrefEntryCompressed;
+      }
+    }
+  }
+  gfree(objStmNums);
+  objStmNums = NULL;
+  objStmNumsLen = 0;
+}
+
 #ifndef NO_DECRYPTION
+// Look up the crypt filter named by <key> (StmF or StrF) in the
+// Encrypt dictionary of a V4 or V5 security handler.  Sets <alg>, and
+// <keyLen> if the filter gives a length.  Returns false if the filter
+// isn't one we can handle.
+static GBool getCryptFilter(Object *encrypt, char *key,
+			    CryptAlgorithm *alg, int *keyLen) {
+  Object nameObj, cfObj, filterObj, cfmObj, lengthObj;
+  GBool ok;
+
+  ok = gTrue;
+  encrypt->dictLookup(key, &nameObj);
+  if (!nameObj.isName() || nameObj.isName("Identity")) {
+    *alg = cryptNone;
+    nameObj.free();
+    return gTrue;
+  }
+  encrypt->dictLookup("CF", &cfObj);
+  if (cfObj.isDict()) {
+    cfObj.dictLookup(nameObj.getName(), &filterObj);
+  } else {
+    filterObj.initNull();
+  }
+  if (filterObj.isDict()) {
+    filterObj.dictLookup("CFM", &cfmObj);
+    if (cfmObj.isName("V2")) {
+      *alg = cryptRC4;
+    } else if (cfmObj.isName("AESV2")) {
+      *alg = cryptAES;
+      *keyLen = 16;
+    } else if (cfmObj.isName("AESV3")) {
+      *alg = cryptAES256;
+      *keyLen = 32;
+    } else if (cfmObj.isName("None") || cfmObj.isNull()) {
+      *alg = cryptNone;
+    } else {
+      ok = gFalse;
+    }
+    cfmObj.free();
+
+    // the length is supposed to be in bytes, but some writers give
+    // it in bits
+    if (*alg == cryptRC4) {
+      filterObj.dictLookup("Length", &lengthObj);
+      if (lengthObj.isInt()) {
+	*keyLen = lengthObj.getInt();
+	if (*keyLen > 16) {
+	  *keyLen /= 8;
+	}
+      }
+      lengthObj.free();
+    }
+  } else {
+    ok = gFalse;
+  }
+  filterObj.free();
+  cfObj.free();
+  nameObj.free();
+  return ok;
+}
+
 GBool XRef::checkEncrypted(GString *ownerPassword, GString *userPassword) {
   Object encrypt, filterObj, versionObj, revisionObj, lengthObj;
-  Object ownerKey, userKey, permissions, fileID, fileID1;
-  GBool encrypted1;
+  Object ownerKey, userKey, ownerEnc, userEnc, permissions;
+  Object fileID, fileID1, encMetaObj;
+  GBool encrypted1, encryptMetadata, supported;
   GBool ret;
 
   ret = gFalse;
 
   permFlags = defPermFlags;
+  strAlg = stmAlg = cryptRC4;
   trailerDict.dictLookup("Encrypt", &encrypt);
   if ((encrypted1 = encrypt.isDict())) {
     ret = gTrue;
@@ -464,14 +1443,21 @@ GBool XRef::checkEncrypted(GString *ownerPassword, GString *userPassword) {
       encrypt.dictLookup("Length", &lengthObj);
       encrypt.dictLookup("O", &ownerKey);
       encrypt.dictLookup("U", &userKey);
+      encrypt.dictLookup("OE", &ownerEnc);
+      encrypt.dictLookup("UE", &userEnc);
       encrypt.dictLookup("P", &permissions);
+      encrypt.dictLookup("EncryptMetadata", &encMetaObj);
       trailerDict.dictLookup("ID", &fileID);
+      if (fileID.isArray()) {
+	fileID.arrayGet(0, &fileID1);
+      } else {
+	fileID1.initNull();
+      }
       if (versionObj.isInt() &&
 	  revisionObj.isInt() &&
-	  ownerKey.isString() && ownerKey.getString()->getLength() == 32 &&
-	  userKey.isString() && userKey.getString()->getLength() == 32 &&
-	  permissions.isInt() &&
-	  fileID.isArray()) {
+	  ownerKey.isString() && ownerKey.getString()->getLength() >= 32 &&
+	  userKey.isString() && userKey.getString()->getLength() >= 32 &&
+	  permissions.isInt()) {
 	encVersion = versionObj.getInt();
 	encRevision = revisionObj.getInt();
 	if (lengthObj.isInt()) {
@@ -480,13 +1466,36 @@ GBool XRef::checkEncrypted(GString *ownerPassword, GString *userPassword) {
 	  keyLength = 5;
 	}
 	permFlags = permissions.getInt();
-	if (encVersion >= 1 && encVersion <= 2 &&
-	    encRevision >= 2 && encRevision <= 3) {
-	  fileID.arrayGet(0, &fileID1);
-	  if (fileID1.isString()) {
+	encryptMetadata = !encMetaObj.isBool() || encMetaObj.getBool();
+
+	// V 4 and 5 pick the algorithms with crypt filters; the file key
+	// length comes from the stream filter
+	supported = gTrue;
+	if (encVersion == 4 || encVersion == 5) {
+	  supported = getCryptFilter(&encrypt, "StrF", &strAlg, &keyLength) &&
+		      getCryptFilter(&encrypt, "StmF", &stmAlg, &keyLength);
+	}
+	if (encVersion == 5) {
+	  keyLength = 32;
+	} else if (keyLength > 16) {
+	  keyLength = 16;
+	}
+	if (supported &&
+	    ((encVersion >= 1 && encVersion <= 2 &&
+	      encRevision >= 2 && encRevision <= 3) ||
+	     (encVersion == 4 && encRevision == 4) ||
+	     (encVersion == 5 && (encRevision == 5 || encRevision == 6)))) {
+	  if (fileID1.isString() || encVersion == 5) {
 	    if (Decrypt::makeFileKey(encVersion, encRevision, keyLength,
 				     ownerKey.getString(), userKey.getString(),
-				     permFlags, fileID1.getString(),
+				     ownerEnc.isString() ? ownerEnc.getString()
+				                         : (GString *)NULL,
+				     userEnc.isString() ? userEnc.getString()
+				                        : (GString *)NULL,
+				     permFlags,
+				     fileID1.isString() ? fileID1.getString()
+				                        : (GString *)NULL,
+				     encryptMetadata,
 				     ownerPassword, userPassword, fileKey,
 				     &ownerPasswordOk)) {
 	      if (ownerPassword && !ownerPasswordOk) {
@@ -499,7 +1508,6 @@ GBool XRef::checkEncrypted(GString *ownerPassword, GString *userPassword) {
 	  } else {
 	    error(-1, "Weird encryption info");
 	  }
-	  fileID1.free();
 	} else {
 	  error(-1, "Unsupported version/revision (%d/%d) of Standard security handler",
 		encVersion, encRevision);
@@ -507,8 +1515,12 @@ GBool XRef::checkEncrypted(GString *ownerPassword, GString *userPassword) {
       } else {
 	error(-1, "Weird encryption info");
       }
+      fileID1.free();
       fileID.free();
+      encMetaObj.free();
       permissions.free();
+      userEnc.free();
+      ownerEnc.free();
       userKey.free();
       ownerKey.free();
       lengthObj.free();
@@ -580,17 +1592,37 @@ GBool XRef::okToAddNotes(GBool ignoreOwnerPW) {
 
 Object *XRef::fetch(int num, int gen, Object *obj) {
   XRefEntry *e;
+  XRefCacheEntry *ce;
+  ObjectStream *objStr;
   Parser *parser;
   Object obj1, obj2, obj3;
 
+  // the rest of a linearized file's table is read the first time an
+  // object that isn't in the first-page section is needed
+  if (mainXRefPending && num >= 0 &&
+      (num >= size || entries[num].offset == 0xffffffff)) {
+    readMainXRef();
+  }
+
   // check for bogus ref - this can happen in corrupted PDF files
   if (num < 0 || num >= size) {
     obj->initNull();
     return obj;
   }
 
+  // check the object cache
+  if (num < cacheSize && (ce = cache[num]) && ce->gen == gen) {
+    ++cacheHits;
+    return cacheGet(ce, obj);
+  }
+
   e = &entries[num];
-  if (e->gen == gen && e->offset != 0xffffffff) {
+  switch (e->type) {
+
+  case xrefEntryUncompressed:
+    if (e->gen != gen) {
+      goto err;
+    }
     obj1.initNull();
     parser = new Parser(this,
 	       new Lexer(this,
@@ -603,10 +1635,14 @@ Object *XRef::fetch(int num, int gen, Object *obj) {
 	obj3.isCmd("obj")) {
 #ifndef NO_DECRYPTION
       parser->getObj(obj, encrypted ? fileKey : (Guchar *)NULL, keyLength,
-		     num, gen);
+		     num, gen, strAlg, stmAlg);
 #else
       parser->getObj(obj);
 #endif
+      if (cacheMaxBytes > 0) {
+	++cacheMisses;
+	cacheAdd(num, gen, obj, parser);
+      }
     } else {
       obj->initNull();
     }
@@ -614,10 +1650,213 @@ Object *XRef::fetch(int num, int gen, Object *obj) {
     obj2.free();
     obj3.free();
     delete parser;
-  } else {
-    obj->initNull();
+    break;
+
+  case xrefEntryCompressed:
+    // an object stream's dictionary can't refer to compressed
+    // objects: they may be in the stream being loaded
+    if (objStrLoading) {
+      error(-1, "Compressed object %d used while loading an object stream",
+	    num);
+      goto err;
+    }
+    if (gen != 0 || !(objStr = getObjectStream((int)e->offset))) {
+      goto err;
+    }
+    objStr->getObject(e->gen, num, obj);
+    break;
+
+  default:
+    goto err;
   }
   return obj;
+
+ err:
+  obj->initNull();
+  return obj;
+}
+
+XRefEntry *XRef::getEntry(int num) {
+  if (mainXRefPending && num >= 0 &&
+      (num >= size || entries[num].offset == 0xffffffff)) {
+    readMainXRef();
+  }
+  if (num < 0 || num >= size) {
+    return NULL;
+  }
+  return &entries[num];
+}
+
+// Return the decoded object stream <objStrNum>, reading it if it is
+// not in the cache.
+ObjectStream *XRef::getObjectStream(int objStrNum) {
+  ObjectStream *objStr;
+  int i, j;
+
+  for (i = 0; i < xrefObjStrCacheSize && objStrs[i]; ++i) {
+    if (objStrs[i]->getObjStrNum() == objStrNum) {
+      objStr = objStrs[i];
+      for (j = i; j > 0; --j) {
+	objStrs[j] = objStrs[j-1];
+      }
+      objStrs[0] = objStr;
+      return objStr;
+    }
+  }
+
+  // object streams can't themselves be compressed
+  if (objStrNum < 0 || objStrNum >= size ||
+      entries[objStrNum].type != xrefEntryUncompressed) {
+    return NULL;
+  }
+  objStrLoading = gTrue;
+  objStr = new ObjectStream(this, objStrNum);
+  objStrLoading = gFalse;
+  if (!objStr->isOk()) {
+    delete objStr;
+    return NULL;
+  }
+  if (objStrs[xrefObjStrCacheSize - 1]) {
+    delete objStrs[xrefObjStrCacheSize - 1];
+  }
+  for (j = xrefObjStrCacheSize - 1; j > 0; --j) {
+    objStrs[j] = objStrs[j-1];
+  }
+  objStrs[0] = objStr;
+  return objStr;
+}
+
+// Return a copy of a cached object.  Dictionaries and arrays are
+// shared (reference counted); streams get a new sub-stream built from
+// the cached dictionary and data offset.
+Object *XRef::cacheGet(XRefCacheEntry *e, Object *obj) {
+  Object dictObj;
+  Stream *s;
+
+  // move the entry to the front of the LRU list
+  if (e != cacheHead) {
+    cacheUnlink(e);
+    e->prev = NULL;
+    e->next = cacheHead;
+    cacheHead->prev = e;
+    cacheHead = e;
+  }
+
+  if (!e->isStream) {
+    return e->obj.copy(obj);
+  }
+  e->obj.copy(&dictObj);
+  s = str->makeSubStream(e->streamStart, gTrue, e->streamLength, &dictObj);
+#ifndef NO_DECRYPTION
+  if (e->decrypt) {
+    s->getBaseStream()->doDecryption(fileKey, keyLength, stmAlg,
+				     e->num, e->gen);
+  }
+#endif
+  s = s->addFilters(&dictObj);
+  return obj->initStream(s);
+}
+
+// Add a freshly parsed object to the cache, evicting the least
+// recently used entries to stay within the byte limit.
+void XRef::cacheAdd(int num, int gen, Object *obj, Parser *parser) {
+  XRefCacheEntry *e;
+  int i;
+
+  if (!obj->isDict() && !obj->isArray() && !obj->isStream()) {
+    return;
+  }
+  if (num >= cacheSize) {
+    i = cacheSize;
+    cacheSize = size;
+    cache = (XRefCacheEntry **)grealloc(cache, cacheSize *
+					sizeof(XRefCacheEntry *));
+    for (; i < cacheSize; ++i) {
+      cache[i] = NULL;
+    }
+  }
+
+  e = new XRefCacheEntry;
+  e->num = num;
+  e->gen = gen;
+  if (obj->isStream()) {
+    e->obj.initDict(obj->streamGetDict());
+    e->isStream = gTrue;
+    e->streamStart = parser->getStreamStart();
+    e->streamLength = parser->getStreamLength();
+#ifndef NO_DECRYPTION
+    e->decrypt = obj->getStream()->getBaseStream()->getDecrypt() != NULL;
+#else
+    e->decrypt = gFalse;
+#endif
+  } else {
+    obj->copy(&e->obj);
+    e->isStream = gFalse;
+    e->streamStart = e->streamLength = 0;
+    e->decrypt = gFalse;
+  }
+  e->bytes = sizeof(XRefCacheEntry) + e->obj.getSize();
+  if (e->bytes > cacheMaxBytes) {
+    e->obj.free();
+    delete e;
+    return;
+  }
+
+  // replace any entry with a different generation number
+  if (cache[num]) {
+    cacheUnlink(cache[num]);
+    cacheBytes -= cache[num]->bytes;
+    cache[num]->obj.free();
+    delete cache[num];
+  }
+
+  e->prev = NULL;
+  e->next = cacheHead;
+  if (cacheHead) {
+    cacheHead->prev = e;
+  } else {
+    cacheTail = e;
+  }
+  cacheHead = e;
+  cache[num] = e;
+  cacheBytes += e->bytes;
+
+  while (cacheBytes > cacheMaxBytes) {
+    e = cacheTail;
+    cacheUnlink(e);
+    cache[e->num] = NULL;
+    cacheBytes -= e->bytes;
+    e->obj.free();
+    delete e;
+  }
+}
+
+void XRef::cacheUnlink(XRefCacheEntry *e) {
+  if (e->prev) {
+    e->prev->next = e->next;
+  } else {
+    cacheHead = e->next;
+  }
+  if (e->next) {
+    e->next->prev = e->prev;
+  } else {
+    cacheTail = e->prev;
+  }
+}
+
+void XRef::cacheFree() {
+  XRefCacheEntry *e, *next;
+
+  for (e = cacheHead; e; e = next) {
+    next = e->next;
+    e->obj.free();
+    delete e;
+  }
+  cacheHead = cacheTail = NULL;
+  cacheBytes = 0;
+  gfree(cache);
+  cache = NULL;
+  cacheSize = 0;
 }
 
 Object *XRef::getDocInfo(Object *obj) {
@@ -15,25 +15,61 @@
 
 #include "../goo/gtypes.h"
 #include "Object.h"
+#ifndef NO_DECRYPTION
+#include "Decrypt.h"
+#endif
 class Dict;
 class Stream;
 class BaseStream;
+class Parser;
+class ObjectStream;
+class DocCache;
+class DisplayListCache;
+struct XRefCacheEntry;
 
 //------------------------------------------------------------------------
 // XRef
 //------------------------------------------------------------------------
 
+enum XRefEntryType {
+  xrefEntryFree,
+  xrefEntryUncompressed,
+  xrefEntryCompressed
+};
+
+// For compressed entries, <offset> is the object number of the object
+// stream and <gen> is the index of the object within that stream.
 struct XRefEntry {
   Guint offset;
   int gen;
-  GBool used;
+  XRefEntryType type;
 };
 
+// Where the trailer dictionary is.
+enum XRefTrailerKind {
+  xrefTrailerNone,
+  xrefTrailerDict,		// after the 'trailer' keyword
+  xrefTrailerStream		// cross-reference stream dictionary
+};
+
+// Number of decoded object streams kept by each XRef.
+#define xrefObjStrCacheSize 4
+
 class XRef {
 public:
 
-  // Constructor.  Read xref table from stream.
-  XRef(BaseStream *strA, GString *ownerPassword, GString *userPassword);
+  // Constructor.  Read xref table from stream.  If the table has to
+  // be reconstructed and <fileName> is given, the result is cached in
+  // the xrefCacheDir (if one is set) for the next time the file is
+  // opened.  If <docCacheA> is given, the table is read from it if it
+  // has been loaded, and stored in it otherwise; page display lists
+  // are saved in it too, so it has to outlive the XRef.  If
+  // <linearized> is set, only the first-page section of the table is
+  // read; the rest is read the first time an object that isn't in it
+  // is fetched.
+  XRef(BaseStream *strA, GString *ownerPassword, GString *userPassword,
+       GString *fileName = NULL, DocCache *docCacheA = NULL,
+       GBool linearized = gFalse);
 
   // Destructor.
   ~XRef();
@@ -70,6 +106,10 @@ public:
   // Return the number of objects in the xref table.
   int getNumObjects() { return size; }
 
+  // Return the xref entry for object <num>, or NULL if there isn't
+  // one.
+  XRefEntry *getEntry(int num);
+
   // Return the offset of the last xref table.
   Guint getLastXRefPos() { return lastXRefPos; }
 
@@ -81,6 +121,32 @@ public:
   // Returns false if unknown or file is not damaged.
   GBool getStreamEnd(Guint streamStart, Guint *streamEnd);
 
+  // Object cache statistics: the number of fetches served from the
+  // cache, the number that had to be parsed, and the (estimated)
+  // number of bytes currently held by the cache.
+  int getCacheHits() { return cacheHits; }
+  int getCacheMisses() { return cacheMisses; }
+  int getCacheBytes() { return cacheBytes; }
+
+  // Was the xref table reconstructed (because the file is damaged)?
+  // Was it loaded from the reconstructed xref cache?  How long did
+  // reconstructing (or loading) it take, in milliseconds?
+  GBool isReconstructed() { return reconstructed; }
+  GBool isReconstructedFromCache() { return reconstructedFromCache; }
+  double getReconstructTime() { return reconstructTime; }
+
+  // Get the cache of form XObject display lists for this document
+  // (NULL if it is disabled).  It is used by Gfx.
+  DisplayListCache *getFormCache() { return formCache; }
+
+  // Get the cache of page display lists, keyed by page number (NULL
+  // if it is disabled).  It is used by Page.
+  DisplayListCache *getPageListCache() { return pageListCache; }
+
+  // Get the document structure cache, where page display lists are
+  // saved for the next time the file is opened (NULL if they aren't).
+  DocCache *getDocCache() { return docCache; }
+
 private:
 
   BaseStream *str;		// input stream
@@ -96,21 +162,65 @@ private:
   Guint *streamEnds;		// 'endstream' positions - only used in
 				//   damaged files
   int streamEndsLen;		// number of valid entries in streamEnds
+  XRefCacheEntry **cache;	// parsed object cache, indexed by object
+				//   number
+  int cacheSize;		// size of <cache> array
+  XRefCacheEntry *cacheHead;	// LRU list of cache entries, most
+  XRefCacheEntry *cacheTail;	//   recently used first
+  int cacheBytes;		// bytes held by the cache
+  int cacheMaxBytes;		// max bytes held by the cache
+  int cacheHits;		// number of cache hits
+  int cacheMisses;		// number of cache misses
+  DisplayListCache *formCache;	// form XObject display lists
+  DisplayListCache *pageListCache;	// page display lists
+  DocCache *docCache;		// saved page display lists (not owned)
+  ObjectStream *		// decoded object streams, most recently
+    objStrs[xrefObjStrCacheSize];	//   used first
+  GBool objStrLoading;		// set while an object stream is read
+  int *objStmNums;		// object streams found by constructXRef
+  int objStmNumsLen;		// number of entries in <objStmNums>
+  GBool reconstructed;		// set if the xref table was reconstructed
+  GBool reconstructedFromCache;	// set if it came from the cache
+  double reconstructTime;	// time taken to reconstruct it, in ms
+  int trailerKind;		// where the trailer dictionary is
+  Guint trailerPos;		//   (see XRefTrailerKind)
+  GBool mainXRefPending;	// set if the rest of a linearized file's
+  Guint mainXRefPos;		//   table hasn't been read yet, and its
+				//   offset
 #ifndef NO_DECRYPTION
   GBool encrypted;		// true if file is encrypted
   int encVersion;		// encryption algorithm
   int encRevision;		// security handler revision
   int keyLength;		// length of key, in bytes
   int permFlags;		// permission bits
-  Guchar fileKey[16];		// file decryption key
+  Guchar fileKey[maxFileKeyLength];	// file decryption key
+  CryptAlgorithm strAlg;	// string encryption (StrF)
+  CryptAlgorithm stmAlg;	// stream encryption (StmF)
   GBool ownerPasswordOk;	// true if owner password is correct
 #endif
 
   Guint readTrailer();
-  GBool readXRef(Guint *pos);
-  GBool constructXRef();
+  GBool readXRef(Guint *pos, GBool xrefStm = gFalse);
+  GBool readXRefTable(Guint *pos);
+  GBool readXRefStream(Stream *xrefStr, Guint *pos, GBool xrefStm);
+  GBool readXRefStreamSection(Stream *xrefStr, int *w, int first, int n,
+			      GBool xrefStm);
+  GBool growEntries(int newSize);
+  void readMainXRef();
+  GBool constructXRef(GString *fileName);
+  GBool constructTrailer(Guint pos, GBool *gotRoot);
+  GBool constructXRefStmTrailer(Guint pos, GBool *gotRoot);
+  GBool loadDocCache(DocCache *docCache);
+  GBool loadXRefCache(GString *cacheFile, Guint *key);
+  void saveXRefCache(GString *cacheFile, Guint *key);
+  void constructObjStmEntries();
+  ObjectStream *getObjectStream(int objStrNum);
   GBool checkEncrypted(GString *ownerPassword, GString *userPassword);
   Guint strToUnsigned(char *s);
+  Object *cacheGet(XRefCacheEntry *e, Object *obj);
+  void cacheAdd(int num, int gen, Object *obj, Parser *parser);
+  void cacheUnlink(XRefCacheEntry *e);
+  void cacheFree();
 };
 
 #endif
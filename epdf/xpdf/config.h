@@ -17,8 +17,8 @@
 #define xpdfVersion "1.00"
 
 // supported PDF version
-#define supportedPDFVersionStr "1.4"
-#define supportedPDFVersionNum 1.4
+#define supportedPDFVersionStr "2.0"
+#define supportedPDFVersionNum 2.0
 
 // copyright notice
 #define xpdfCopyright "Copyright 1996-2002 Derek B. Noonburg"
@@ -47,6 +47,13 @@
 #define xpdfUserConfigFile ".xpdfrc"
 #endif
 
+// document structure cache dir, relative to the user's home directory
+#if defined(VMS) || (defined(WIN32) && !defined(__CYGWIN32__))
+#define xpdfDocCacheDir "xpdfcache"
+#else
+#define xpdfDocCacheDir ".xpdfcache"
+#endif
+
 // system config file name (set via the configure script)
 #ifdef SYSTEM_XPDFRC
 #define xpdfSysConfigFile SYSTEM_XPDFRC
@@ -66,6 +73,30 @@
 // number of fonts (combined t1lib, FreeType, X server) to cache
 #define xOutFontCacheSize 64
 
+//------------------------------------------------------------------------
+// object cache
+//------------------------------------------------------------------------
+
+// default number of bytes of parsed objects to keep in each XRef's
+// object cache
+#define defObjectCacheSize (1024 * 1024)
+
+// default number of bytes of form XObject display lists to keep for
+// each document
+#define defFormCacheSize (4 * 1024 * 1024)
+
+// default number of bytes of page display lists to keep for each
+// document
+#define defPageListCacheSize (16 * 1024 * 1024)
+
+//------------------------------------------------------------------------
+// DCT decoder
+//------------------------------------------------------------------------
+
+// default limit (in bytes) on the coefficient buffer a progressive or
+// multi-scan JPEG image needs
+#define defDCTCoefLimit (128 * 1024 * 1024)
+
 //------------------------------------------------------------------------
 // popen
 //------------------------------------------------------------------------